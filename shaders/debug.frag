@@ -1,8 +1,10 @@
 #version 450 core
 
+in vec4 color;
+
 out vec4 outColor;
 
 void main()
 {
-	outColor = vec4(1.0f, 0.0f, 0.0f, 1.0f);
+	outColor = color;
 }
\ No newline at end of file
@@ -0,0 +1,14 @@
+#version 460 core
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec4 inColor;
+
+out vec4 color;
+
+uniform mat4 viewProj;
+
+void main()
+{
+	color = inColor;
+	gl_Position = viewProj * vec4(inPos, 1.0f);
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#version 460 core
+
+layout (location = 0) in vec4 inColor;
+layout (location = 1) in vec2 inCorner;
+
+out vec4 outColor;
+
+void main()
+{
+	// Round, with a soft edge
+	const float edge = 1.0f - smoothstep(0.6f, 1.0f, length(inCorner));
+	if (edge <= 0.0f)
+	{
+		discard;
+	}
+	outColor = vec4(inColor.rgb, inColor.a * edge);
+}
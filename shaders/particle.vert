@@ -0,0 +1,41 @@
+#version 460 core
+
+// Per instance: the particle's position and its life fraction and seed packed as 16 bits each
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in uint inLifeAndSeed;
+
+uniform mat4 viewProj;
+// World space axes of the view, so quads always face the camera
+uniform vec3 cameraRight;
+uniform vec3 cameraUp;
+
+uniform vec4 startColor;
+uniform vec4 endColor;
+uniform float startSize;
+uniform float endSize;
+uniform float colorVariance;
+
+layout (location = 0) out vec4 outColor;
+layout (location = 1) out vec2 outCorner;
+
+vec3 hue(float h)
+{
+	return clamp(abs(mod(h * 6.0f + vec3(0.0f, 4.0f, 2.0f), 6.0f) - 3.0f) - 1.0f, 0.0f, 1.0f);
+}
+
+void main()
+{
+	const float life = float(inLifeAndSeed & 0xFFFFu) / 65535.0f;
+	const float seed = float(inLifeAndSeed >> 16) / 65535.0f;
+
+	// A triangle strip of four vertices per instance
+	const vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0f - 1.0f;
+	const float size = mix(startSize, endSize, life);
+	const vec3 worldPos = inPos + (cameraRight * corner.x + cameraUp * corner.y) * size;
+
+	gl_Position = viewProj * vec4(worldPos, 1.0f);
+
+	const vec4 color = mix(startColor, endColor, life);
+	outColor = vec4(mix(color.rgb, hue(seed), colorVariance), color.a);
+	outCorner = corner;
+}
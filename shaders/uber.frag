@@ -2,11 +2,43 @@
 
 layout (location = 0) in vec3 inNorm;
 layout (location = 1) in vec2 inTex;
+layout (location = 2) in vec3 inWorldPos;
+layout (location = 3) in float inViewDepth;
 
 uniform bool      textured;
 uniform sampler2D inTexture;
 uniform vec3      color;
 
+struct PointLight
+{
+	vec3  position;
+	float radius;
+	vec3  color;
+	float intensity;
+};
+
+layout (std430, binding = 1) readonly buffer Lights
+{
+	PointLight lights[];
+};
+
+// Offset into lightIndices and count for each froxel, x fastest, then y, then slice
+layout (std430, binding = 2) readonly buffer Clusters
+{
+	uvec2 clusters[];
+};
+
+layout (std430, binding = 3) readonly buffer LightIndices
+{
+	uint lightIndices[];
+};
+
+uniform uvec3 clusterCount;
+// slice = log(view depth) * x + y
+uniform vec2  clusterSlicing;
+// The scaled region being drawn, which tiles split evenly
+uniform vec2  viewportSize;
+
 out vec4 outColor;
 
 void main()
@@ -22,8 +54,28 @@ void main()
 
 	const float ambient = 0.7f;
 
+	const vec3 normal = normalize(inNorm);
 	const vec3 lightDir = normalize(const vec3(-1.0f, 2.0f, 1.5f));
-	float diffuse = max(dot(inNorm, lightDir), 0);
+	float diffuse = max(dot(normal, lightDir), 0);
+
+	const uvec2 tile = min(uvec2(gl_FragCoord.xy / viewportSize * vec2(clusterCount.xy)), clusterCount.xy - 1u);
+	const uint slice = uint(clamp(log(max(inViewDepth, 1e-4f)) * clusterSlicing.x + clusterSlicing.y, 0.0f, float(clusterCount.z - 1u)));
+	const uvec2 cluster = clusters[(slice * clusterCount.y + tile.y) * clusterCount.x + tile.x];
+
+	vec3 pointLight = vec3(0.0f);
+	for (uint i = 0; i < cluster.y; ++i)
+	{
+		const PointLight light = lights[lightIndices[cluster.x + i]];
+
+		const vec3 toLight = light.position - inWorldPos;
+		const float distance = length(toLight);
+
+		// Inverse square falloff windowed to reach zero at the radius
+		const float window = clamp(1.0f - pow(distance / light.radius, 4.0f), 0.0f, 1.0f);
+		const float attenuation = window * window / (distance * distance + 1.0f);
+
+		pointLight += light.color * light.intensity * attenuation * max(dot(normal, toLight / max(distance, 1e-4f)), 0.0f);
+	}
 
-	outColor = vec4(outColor.rgb * (diffuse + ambient), outColor.a);
-}
\ No newline at end of file
+	outColor = vec4(outColor.rgb * (diffuse + ambient + pointLight), outColor.a);
+}
@@ -4,14 +4,33 @@ layout (location = 0) in vec3 inPos;
 layout (location = 1) in vec3 inNorm;
 layout (location = 2) in vec2 inTex;
 
-uniform mat4 transform;
+// World matrix per scene node; draws pass the node as their base instance
+layout (std430, binding = 0) readonly buffer Transforms
+{
+	mat4 transforms[];
+};
+
+// Matching normal matrices, computed once per node when its transform changes
+layout (std430, binding = 5) readonly buffer NormalMatrices
+{
+	mat3 normalMatrices[];
+};
+
+uniform mat4 viewProj;
+uniform mat4 view;
 
 layout (location = 0) out vec3 outNorm;
 layout (location = 1) out vec2 outTex;
+layout (location = 2) out vec3 outWorldPos;
+layout (location = 3) out float outViewDepth;
 
 void main()
 {
-	gl_Position = transform * vec4(inPos, 1.0f);
-	outNorm = inNorm;
+	const vec4 worldPos = transforms[gl_BaseInstance] * vec4(inPos, 1.0f);
+
+	gl_Position = viewProj * worldPos;
+	outNorm = normalMatrices[gl_BaseInstance] * inNorm;
 	outTex = inTex;
-}
\ No newline at end of file
+	outWorldPos = worldPos.xyz;
+	outViewDepth = -(view * worldPos).z;
+}
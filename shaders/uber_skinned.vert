@@ -0,0 +1,64 @@
+#version 460 core
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNorm;
+layout (location = 2) in vec2 inTex;
+layout (location = 3) in uvec4 inJoints;
+layout (location = 4) in vec4 inWeights;
+
+// World matrix per scene node; draws pass the node as their base instance
+layout (std430, binding = 0) readonly buffer Transforms
+{
+	mat4 transforms[];
+};
+
+// Matching normal matrices, computed once per node when its transform changes
+layout (std430, binding = 5) readonly buffer NormalMatrices
+{
+	mat3 normalMatrices[];
+};
+
+// Every character's skinning matrices back to back; draws pass where theirs start
+layout (std430, binding = 4) readonly buffer Palettes
+{
+	mat4 palettes[];
+};
+
+uniform mat4 viewProj;
+uniform mat4 view;
+uniform uint paletteOffset;
+
+// Inverse transpose times the determinant, which the normalize below cancels. Blended
+// skins are not rigid, so mat3(skin) alone would bend normals under squash and stretch.
+mat3 cofactors(mat3 m)
+{
+	const mat3 c = mat3(cross(m[1], m[2]), cross(m[2], m[0]), cross(m[0], m[1]));
+	return dot(m[0], c[0]) < 0.0f ? -c : c;
+}
+
+layout (location = 0) out vec3 outNorm;
+layout (location = 1) out vec2 outTex;
+layout (location = 2) out vec3 outWorldPos;
+layout (location = 3) out float outViewDepth;
+
+void main()
+{
+	// Primitives of a skinned model that are not skinned themselves carry no weights
+	mat4 skin = mat4(1.0f);
+	if (dot(inWeights, vec4(1.0f)) > 0.0f)
+	{
+		skin = palettes[paletteOffset + inJoints.x] * inWeights.x
+			+ palettes[paletteOffset + inJoints.y] * inWeights.y
+			+ palettes[paletteOffset + inJoints.z] * inWeights.z
+			+ palettes[paletteOffset + inJoints.w] * inWeights.w;
+	}
+
+	const vec4 worldPos = transforms[gl_BaseInstance] * (skin * vec4(inPos, 1.0f));
+
+	gl_Position = viewProj * worldPos;
+	// The inverse transpose of node * skin is the product of theirs
+	outNorm = normalize(normalMatrices[gl_BaseInstance] * (cofactors(mat3(skin)) * inNorm));
+	outTex = inTex;
+	outWorldPos = worldPos.xyz;
+	outViewDepth = -(view * worldPos).z;
+}
@@ -0,0 +1,351 @@
+#include "animation.hpp"
+
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+#include <xmmintrin.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+
+	// Four columns of a column major matrix, one register each
+	struct Matrix
+	{
+		__m128 columns[4];
+	};
+
+	Matrix load(const glm::mat4& matrix)
+	{
+		return { { _mm_loadu_ps(&matrix[0][0]), _mm_loadu_ps(&matrix[1][0]), _mm_loadu_ps(&matrix[2][0]), _mm_loadu_ps(&matrix[3][0]) } };
+	}
+
+	void store(const Matrix& matrix, glm::mat4& out)
+	{
+		for (int i{ 0 }; i < 4; ++i)
+		{
+			_mm_storeu_ps(&out[i][0], matrix.columns[i]);
+		}
+	}
+
+	// Each column of the product is a's columns weighted by the matching column of b
+	Matrix multiply(const Matrix& a, const Matrix& b)
+	{
+		Matrix out{};
+		for (int i{ 0 }; i < 4; ++i)
+		{
+			const __m128 column{ b.columns[i] };
+			__m128 sum{ _mm_mul_ps(a.columns[0], _mm_shuffle_ps(column, column, _MM_SHUFFLE(0, 0, 0, 0))) };
+			sum = _mm_add_ps(sum, _mm_mul_ps(a.columns[1], _mm_shuffle_ps(column, column, _MM_SHUFFLE(1, 1, 1, 1))));
+			sum = _mm_add_ps(sum, _mm_mul_ps(a.columns[2], _mm_shuffle_ps(column, column, _MM_SHUFFLE(2, 2, 2, 2))));
+			sum = _mm_add_ps(sum, _mm_mul_ps(a.columns[3], _mm_shuffle_ps(column, column, _MM_SHUFFLE(3, 3, 3, 3))));
+			out.columns[i] = sum;
+		}
+		return out;
+	}
+
+	// Translation, rotation and scale composed as T * R * S, like glTF nodes
+	Matrix compose(const Animation::Transform& transform)
+	{
+		const glm::quat& q{ transform.rotation };
+		const float xx{ q.x * q.x }, yy{ q.y * q.y }, zz{ q.z * q.z };
+		const float xy{ q.x * q.y }, xz{ q.x * q.z }, yz{ q.y * q.z };
+		const float wx{ q.w * q.x }, wy{ q.w * q.y }, wz{ q.w * q.z };
+
+		const glm::vec3& s{ transform.scale };
+		const glm::vec3& t{ transform.translation };
+		return { {
+			_mm_setr_ps((1.0f - 2.0f * (yy + zz)) * s.x, 2.0f * (xy + wz) * s.x, 2.0f * (xz - wy) * s.x, 0.0f),
+			_mm_setr_ps(2.0f * (xy - wz) * s.y, (1.0f - 2.0f * (xx + zz)) * s.y, 2.0f * (yz + wx) * s.y, 0.0f),
+			_mm_setr_ps(2.0f * (xz + wy) * s.z, 2.0f * (yz - wx) * s.z, (1.0f - 2.0f * (xx + yy)) * s.z, 0.0f),
+			_mm_setr_ps(t.x, t.y, t.z, 1.0f),
+		} };
+	}
+
+	glm::quat toQuat(const glm::vec4& value)
+	{
+		return { value.w, value.x, value.y, value.z };
+	}
+
+	// Normalized linear interpolation along the shorter arc. Close to slerp for the small
+	// steps between keyframes, for a fraction of the cost.
+	glm::quat nlerp(const glm::quat& a, const glm::quat& b, float weight)
+	{
+		const float sign{ glm::dot(a, b) < 0.0f ? -1.0f : 1.0f };
+		return glm::normalize(a * (1.0f - weight) + b * (sign * weight));
+	}
+
+	glm::vec4 sampleTrack(const Animation::Track& track, float time)
+	{
+		const std::vector<float>& times{ track.times };
+		const bool cubic{ track.interpolation == Animation::Interpolation::cubicSpline };
+		const auto value{ [&](std::size_t key) { return track.values[cubic ? key * 3 + 1 : key]; } };
+
+		const std::size_t next{ static_cast<std::size_t>(std::upper_bound(times.begin(), times.end(), time) - times.begin()) };
+		if (next == 0)
+		{
+			return value(0);
+		}
+		if (next == times.size())
+		{
+			return value(times.size() - 1);
+		}
+
+		const std::size_t key{ next - 1 };
+		const float span{ times[next] - times[key] };
+		const float s{ span > 0.0f ? (time - times[key]) / span : 0.0f };
+
+		switch (track.interpolation)
+		{
+		case Animation::Interpolation::step:
+			return value(key);
+
+		case Animation::Interpolation::cubicSpline:
+		{
+			// Hermite between the two values with the out tangent of the first key and the
+			// in tangent of the second, both scaled by the key spacing
+			const float s2{ s * s };
+			const float s3{ s2 * s };
+			const glm::vec4 result{ (2.0f * s3 - 3.0f * s2 + 1.0f) * value(key) + span * (s3 - 2.0f * s2 + s) * track.values[key * 3 + 2]
+				+ (-2.0f * s3 + 3.0f * s2) * value(next) + span * (s3 - s2) * track.values[next * 3] };
+			return track.path == Animation::Path::rotation ? glm::normalize(result) : result;
+		}
+
+		default:
+			if (track.path == Animation::Path::rotation)
+			{
+				const glm::quat q{ nlerp(toQuat(value(key)), toQuat(value(next)), s) };
+				return { q.x, q.y, q.z, q.w };
+			}
+			return glm::mix(value(key), value(next), s);
+		}
+	}
+
+	float wrap(float time, float duration, bool loop)
+	{
+		if (duration <= 0.0f)
+		{
+			return 0.0f;
+		}
+		if (!loop)
+		{
+			return std::min(time, duration);
+		}
+
+		const float wrapped{ std::fmod(time, duration) };
+		return wrapped < 0.0f ? wrapped + duration : wrapped;
+	}
+
+}
+
+namespace Animation
+{
+
+	int Rig::findClip(std::string_view name) const
+	{
+		for (std::size_t i{ 0 }; i < clips.size(); ++i)
+		{
+			if (clips[i].name == name)
+			{
+				return static_cast<int>(i);
+			}
+		}
+		return -1;
+	}
+
+	void sample(const Clip& clip, float time, std::span<Transform> pose)
+	{
+		for (const Track& track : clip.tracks)
+		{
+			if (track.times.empty() || track.joint >= pose.size())
+			{
+				continue;
+			}
+
+			const glm::vec4 value{ sampleTrack(track, time) };
+			Transform& transform{ pose[track.joint] };
+			switch (track.path)
+			{
+			case Path::translation: transform.translation = glm::vec3{ value }; break;
+			case Path::rotation: transform.rotation = toQuat(value); break;
+			case Path::scale: transform.scale = glm::vec3{ value }; break;
+			}
+		}
+	}
+
+	void blend(std::span<const Transform> from, std::span<const Transform> to, float weight, std::span<Transform> out)
+	{
+		for (std::size_t i{ 0 }; i < out.size(); ++i)
+		{
+			out[i] =
+			{
+				.translation{ glm::mix(from[i].translation, to[i].translation, weight) },
+				.rotation{ nlerp(from[i].rotation, to[i].rotation, weight) },
+				.scale{ glm::mix(from[i].scale, to[i].scale, weight) },
+			};
+		}
+	}
+
+	void buildPalette(const Rig& rig, std::span<const Transform> pose, std::span<glm::mat4> palette)
+	{
+		// Model space first, so children can read their parent's finished matrix
+		for (std::size_t i{ 0 }; i < rig.joints.size(); ++i)
+		{
+			const Joint& joint{ rig.joints[i] };
+			const Matrix parent{ load(joint.parent == -1 ? joint.origin : palette[joint.parent]) };
+			store(multiply(parent, compose(pose[i])), palette[i]);
+		}
+
+		for (std::size_t i{ 0 }; i < rig.joints.size(); ++i)
+		{
+			store(multiply(load(palette[i]), load(rig.joints[i].inverseBind)), palette[i]);
+		}
+	}
+
+}
+
+Animator::Handle Animator::add(std::shared_ptr<const Animation::Rig> rig)
+{
+	// Models come with their first clip already playing
+	const int clip{ rig->clips.empty() ? -1 : 0 };
+	return m_characters.insert({ .rig{ std::move(rig) }, .clip{ clip } });
+}
+
+void Animator::remove(Handle character)
+{
+	m_characters.erase(character);
+}
+
+void Animator::play(Handle handle, int clip, float fadeSeconds, bool loop)
+{
+	Character* character{ m_characters.get(handle) };
+	if (!character || clip >= static_cast<int>(character->rig->clips.size()))
+	{
+		return;
+	}
+
+	character->loop = loop;
+	if (clip == character->clip)
+	{
+		return;
+	}
+
+	character->previousClip = fadeSeconds > 0.0f ? character->clip : -1;
+	character->previousTime = character->time;
+	character->fade = 0.0f;
+	character->fadeDuration = fadeSeconds;
+	character->clip = clip;
+	character->time = 0.0f;
+}
+
+void Animator::setSpeed(Handle handle, float speed)
+{
+	if (Character* character{ m_characters.get(handle) })
+	{
+		character->speed = speed;
+	}
+}
+
+void Animator::advance(float seconds)
+{
+	for (Character& character : m_characters)
+	{
+		const std::vector<Animation::Clip>& clips{ character.rig->clips };
+		const float step{ seconds * character.speed };
+
+		if (character.clip != -1)
+		{
+			character.time = wrap(character.time + step, clips[character.clip].duration, character.loop);
+		}
+
+		if (character.previousClip != -1)
+		{
+			character.previousTime = wrap(character.previousTime + step, clips[character.previousClip].duration, true);
+			character.fade += seconds;
+			if (character.fade >= character.fadeDuration)
+			{
+				character.previousClip = -1;
+			}
+		}
+	}
+}
+
+void Animator::evaluate(JobSystem* jobs)
+{
+	const auto start{ std::chrono::steady_clock::now() };
+
+	std::uint32_t joints{ 0 };
+	for (Character& character : m_characters)
+	{
+		character.paletteOffset = joints;
+		joints += static_cast<std::uint32_t>(character.rig->joints.size());
+	}
+	// Keeps its capacity, so a steady cast of characters does not allocate
+	m_palette.resize(joints);
+
+	const auto evaluateRange{ [this](std::size_t begin, std::size_t end)
+		{
+			// One per thread, grown to the largest rig it has seen
+			thread_local std::vector<Animation::Transform> scratch{};
+			for (std::size_t i{ begin }; i < end; ++i)
+			{
+				evaluateCharacter(m_characters.begin()[i], scratch);
+			}
+		} };
+
+	// Characters only write their own palette range
+	if (jobs)
+	{
+		jobs->parallelFor(m_characters.size(), 32, evaluateRange);
+	}
+	else
+	{
+		evaluateRange(0, m_characters.size());
+	}
+
+	m_stats.characters = m_characters.size();
+	m_stats.joints = joints;
+	m_stats.evaluateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Animator::evaluateCharacter(const Character& character, std::vector<Animation::Transform>& scratch)
+{
+	const Animation::Rig& rig{ *character.rig };
+	const std::size_t jointCount{ rig.joints.size() };
+	if (scratch.size() < jointCount * 2)
+	{
+		scratch.resize(jointCount * 2);
+	}
+
+	const std::span<Animation::Transform> pose{ scratch.data(), jointCount };
+	for (std::size_t i{ 0 }; i < jointCount; ++i)
+	{
+		pose[i] = rig.joints[i].rest;
+	}
+	if (character.clip != -1)
+	{
+		Animation::sample(rig.clips[character.clip], character.time, pose);
+	}
+
+	if (character.previousClip != -1 && character.fadeDuration > 0.0f)
+	{
+		const std::span<Animation::Transform> previous{ scratch.data() + jointCount, jointCount };
+		for (std::size_t i{ 0 }; i < jointCount; ++i)
+		{
+			previous[i] = rig.joints[i].rest;
+		}
+		Animation::sample(rig.clips[character.previousClip], character.previousTime, previous);
+		Animation::blend(previous, pose, std::min(character.fade / character.fadeDuration, 1.0f), pose);
+	}
+
+	Animation::buildPalette(rig, pose, std::span<glm::mat4>{ m_palette }.subspan(character.paletteOffset, jointCount));
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "jobs.hpp"
+#include "slot_map.hpp"
+
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Animation
+{
+
+	struct Transform
+	{
+		glm::vec3 translation{ 0.0f };
+		glm::quat rotation{ 1.0f, 0.0f, 0.0f, 0.0f };
+		glm::vec3 scale{ 1.0f };
+	};
+
+	struct Joint
+	{
+		// Always before the joint itself, so poses resolve in one pass
+		int parent{ -1 };
+		Transform rest{};
+		glm::mat4 inverseBind{ 1.0f };
+		// For roots, the fixed nodes above the joint that are not joints themselves
+		glm::mat4 origin{ 1.0f };
+	};
+
+	enum class Path : std::uint8_t
+	{
+		translation,
+		rotation,
+		scale,
+	};
+
+	enum class Interpolation : std::uint8_t
+	{
+		step,
+		linear,
+		cubicSpline,
+	};
+
+	// Keyframes of one part of one joint's transform. Rotations are stored XYZW in vec4s, the
+	// rest use xyz; cubic splines keep an in tangent, the value and an out tangent per key.
+	struct Track
+	{
+		std::uint16_t joint{};
+		Path path{ Path::translation };
+		Interpolation interpolation{ Interpolation::linear };
+		std::vector<float> times{};
+		std::vector<glm::vec4> values{};
+	};
+
+	struct Clip
+	{
+		std::string name{};
+		float duration{};
+		std::vector<Track> tracks{};
+	};
+
+	// A skeleton and the clips made for it; shared by every character using the model
+	struct Rig
+	{
+		std::vector<Joint> joints{};
+		std::vector<Clip> clips{};
+
+		// -1 when no clip has the name
+		int findClip(std::string_view name) const;
+	};
+
+	// Overwrites the parts of pose the clip animates at time, which wraps when looping
+	void sample(const Clip& clip, float time, std::span<Transform> pose);
+
+	// Linear for translation and scale, normalized linear along the shorter arc for rotation
+	void blend(std::span<const Transform> from, std::span<const Transform> to, float weight, std::span<Transform> out);
+
+	// Skinning matrices, model space joint times inverse bind, for a local pose
+	void buildPalette(const Rig& rig, std::span<const Transform> pose, std::span<glm::mat4> palette);
+
+}
+
+// Animated characters. Gameplay picks clips and advances time at its own rate; evaluate then
+// samples, blends and skins every character once a frame, batched over the job system, into
+// one packed palette the renderer uploads as it is.
+class Animator final
+{
+public:
+
+	struct Character
+	{
+		std::shared_ptr<const Animation::Rig> rig{};
+
+		int clip{ -1 };
+		float time{};
+		// The clip faded out of, until fade reaches fadeDuration
+		int previousClip{ -1 };
+		float previousTime{};
+		float fade{};
+		float fadeDuration{};
+
+		float speed{ 1.0f };
+		bool loop{ true };
+
+		// First matrix in palette(), assigned by evaluate
+		std::uint32_t paletteOffset{};
+	};
+
+	using Handle = SlotMap<Character>::Handle;
+
+	struct Stats
+	{
+		std::size_t characters{};
+		std::size_t joints{};
+		double evaluateMs{};
+	};
+
+	Animator() = default;
+	Animator(const Animator&) = delete;
+	Animator& operator=(const Animator&) = delete;
+
+	Handle add(std::shared_ptr<const Animation::Rig> rig);
+	void remove(Handle character);
+
+	// Cross-fades from whatever is playing; a zero fade cuts
+	void play(Handle character, int clip, float fadeSeconds = 0.2f, bool loop = true);
+	void setSpeed(Handle character, float speed);
+
+	// Moves every character's clocks on
+	void advance(float seconds);
+
+	// Poses every character into palette(); without jobs it runs on the calling thread
+	void evaluate(JobSystem* jobs);
+
+	// Valid until the next evaluate
+	std::span<const glm::mat4> palette() const { return m_palette; }
+	const Character* character(Handle character) const { return m_characters.get(character); }
+
+	const Stats& stats() const { return m_stats; }
+
+private:
+
+	void evaluateCharacter(const Character& character, std::vector<Animation::Transform>& scratch);
+
+	SlotMap<Character> m_characters{};
+	std::vector<glm::mat4> m_palette{};
+
+	Stats m_stats{};
+};
@@ -0,0 +1,199 @@
+#include "batch_sim.hpp"
+
+#include "glm/glm.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace
+{
+
+	// The same tuning as the windowed game's update()
+	constexpr float deltaTime{ 1.0f / 60.0f };
+	constexpr float gravity{ 0.6f / 60.0f };
+	constexpr float moveSpeed{ 1.5f };
+	constexpr float jumpVelocity{ 0.20f };
+	constexpr float friction{ 0.7f };
+	constexpr float separation{ 0.0005f };
+
+	// Environments per job; large enough that the policy call and job overhead vanish
+	constexpr std::size_t grain{ 1024 };
+
+}
+
+BatchSim::BatchSim(const Level::Manifest& manifest, std::size_t environmentCount)
+	: m_environmentCount{ environmentCount }
+{
+	for (const Level::CellDesc& cell : manifest.cells)
+	{
+		for (const Level::Box& box : cell.boxes)
+		{
+			m_statics.push_back({ box.pos - box.scl - m_playerHalfExtents, box.pos + box.scl + m_playerHalfExtents });
+		}
+		for (const Level::EnemySpawn& spawn : cell.enemies)
+		{
+			if (spawn.chase)
+			{
+				++m_skippedChasers;
+				continue;
+			}
+			m_enemyPaths.push_back(spawn);
+		}
+	}
+
+	m_enemies.resize(m_enemyPaths.size());
+
+	m_posX.resize(environmentCount);
+	m_posY.resize(environmentCount);
+	m_posZ.resize(environmentCount);
+	m_velX.resize(environmentCount);
+	m_velY.resize(environmentCount);
+	m_velZ.resize(environmentCount);
+	m_airTime.resize(environmentCount);
+	m_deaths.resize(environmentCount);
+	m_kills.resize(environmentCount);
+	m_enemyAlive.resize(m_enemyPaths.size() * environmentCount);
+	m_inputs.resize(environmentCount);
+
+	reset();
+}
+
+void BatchSim::reset()
+{
+	m_tick = 0;
+
+	std::fill(m_posX.begin(), m_posX.end(), spawnPosition.x);
+	std::fill(m_posY.begin(), m_posY.end(), spawnPosition.y);
+	std::fill(m_posZ.begin(), m_posZ.end(), spawnPosition.z);
+	std::fill(m_velX.begin(), m_velX.end(), 0.0f);
+	std::fill(m_velY.begin(), m_velY.end(), 0.0f);
+	std::fill(m_velZ.begin(), m_velZ.end(), 0.0f);
+	std::fill(m_airTime.begin(), m_airTime.end(), 1.0f);
+	std::fill(m_deaths.begin(), m_deaths.end(), 0u);
+	std::fill(m_kills.begin(), m_kills.end(), 0u);
+	std::fill(m_enemyAlive.begin(), m_enemyAlive.end(), static_cast<unsigned char>(1));
+}
+
+void BatchSim::step(JobSystem& jobs, const Policy& policy)
+{
+	// Enemies follow the game's path formula on simulated time rather than wall clock time
+	const float speed{ std::sin(static_cast<float>(m_tick) * deltaTime) + 1.0f };
+	for (std::size_t i{ 0 }; i < m_enemyPaths.size(); ++i)
+	{
+		const Level::EnemySpawn& path{ m_enemyPaths[i] };
+		m_enemies[i] = ((path.b - path.a) / 2.0f) * speed + path.a;
+	}
+
+	jobs.parallelFor(m_environmentCount, grain, [&](std::size_t begin, std::size_t end)
+		{
+			policy(*this, begin, end, m_inputs.data() + begin);
+			stepRange(begin, end);
+		});
+
+	++m_tick;
+}
+
+void BatchSim::stepRange(std::size_t begin, std::size_t end)
+{
+	for (std::size_t env{ begin }; env < end; ++env)
+	{
+		const Input& input{ m_inputs[env] };
+
+		glm::vec3 position{ m_posX[env], m_posY[env], m_posZ[env] };
+		glm::vec3 velocity{ m_velX[env], m_velY[env], m_velZ[env] };
+		float airTime{ m_airTime[env] + deltaTime };
+
+		const float cosYaw{ std::cos(glm::radians(input.yaw)) };
+		const float sinYaw{ std::sin(glm::radians(input.yaw)) };
+		velocity.x += (-cosYaw * input.forward + sinYaw * input.strafe) * moveSpeed * deltaTime;
+		velocity.z += (sinYaw * input.forward + cosYaw * input.strafe) * moveSpeed * deltaTime;
+
+		if (input.jump && airTime < 0.1f)
+		{
+			velocity.y = jumpVelocity;
+		}
+
+		velocity.y -= gravity;
+		if (moveAxis(position, velocity, 1))
+		{
+			airTime = 0.0f;
+		}
+		moveAxis(position, velocity, 0);
+		velocity.x *= friction;
+		moveAxis(position, velocity, 2);
+		velocity.z *= friction;
+
+		bool died{ position.y < -2.0f };
+
+		for (std::size_t i{ 0 }; i < m_enemies.size() && !died; ++i)
+		{
+			unsigned char& alive{ m_enemyAlive[i * m_environmentCount + env] };
+			if (alive && glm::all(glm::lessThanEqual(glm::abs(position - m_enemies[i]), m_playerHalfExtents + glm::vec3{ 1.0f })))
+			{
+				if (velocity.y < 0.0f)
+				{
+					alive = 0;
+					++m_kills[env];
+				}
+				else
+				{
+					died = true;
+				}
+			}
+		}
+
+		if (died)
+		{
+			position = spawnPosition;
+			velocity = glm::vec3{ 0.0f };
+			airTime = 1.0f;
+			++m_deaths[env];
+		}
+
+		m_posX[env] = position.x;
+		m_posY[env] = position.y;
+		m_posZ[env] = position.z;
+		m_velX[env] = velocity.x;
+		m_velY[env] = velocity.y;
+		m_velZ[env] = velocity.z;
+		m_airTime[env] = airTime;
+	}
+}
+
+bool BatchSim::moveAxis(glm::vec3& position, glm::vec3& velocity, int axis) const
+{
+	const float move{ velocity[axis] };
+	if (move == 0.0f)
+	{
+		return false;
+	}
+
+	position[axis] += move;
+
+	bool hit{ false };
+	float limit{ move < 0.0f ? -INFINITY : INFINITY };
+
+	for (const Bounds& box : m_statics)
+	{
+		if (!glm::all(glm::greaterThan(position, box.min)) || !glm::all(glm::lessThan(position, box.max)))
+		{
+			continue;
+		}
+
+		hit = true;
+		limit = move < 0.0f ? std::max(limit, box.max[axis]) : std::min(limit, box.min[axis]);
+	}
+
+	if (!hit)
+	{
+		return false;
+	}
+
+	position[axis] = limit + (move < 0.0f ? separation : -separation);
+	velocity[axis] = 0.0f;
+
+	return axis == 1 && move < 0.0f;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "jobs.hpp"
+#include "level.hpp"
+
+#include "glm/glm.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Many independent copies of the player's game state stepped in lockstep, without a
+// window or renderer. The level's boxes and enemy paths are shared and read-only;
+// per-environment state is kept one array per field so stepping a range of
+// environments walks contiguous memory. Crates are not simulated, and neither are
+// chasers: they follow a flow field toward their own environment's player, which would
+// need a field per environment, so chase spawns are left out rather than standing still.
+// Only patrolling enemies are met.
+class BatchSim final
+{
+public:
+
+	// forward and strafe in [-1, 1] as W/S and A/D would give, yaw in degrees like the game camera
+	struct Input
+	{
+		float forward{};
+		float strafe{};
+		float yaw{ -90.0f };
+		bool jump{ false };
+	};
+
+	// Fills inputs[i] for environments [begin, end). Called from several workers at
+	// once on disjoint ranges, so it must only write its own range.
+	using Policy = std::function<void(const BatchSim& sim, std::size_t begin, std::size_t end, Input* inputs)>;
+
+	BatchSim(const Level::Manifest& manifest, std::size_t environmentCount);
+	BatchSim(const BatchSim&) = delete;
+	BatchSim& operator=(const BatchSim&) = delete;
+
+	void reset();
+
+	// One fixed tick for every environment
+	void step(JobSystem& jobs, const Policy& policy);
+
+	std::size_t environmentCount() const { return m_environmentCount; }
+	std::uint64_t tick() const { return m_tick; }
+	std::uint64_t environmentSteps() const { return m_tick * m_environmentCount; }
+
+	glm::vec3 position(std::size_t env) const { return { m_posX[env], m_posY[env], m_posZ[env] }; }
+	glm::vec3 velocity(std::size_t env) const { return { m_velX[env], m_velY[env], m_velZ[env] }; }
+	bool grounded(std::size_t env) const { return m_airTime[env] == 0.0f; }
+	std::uint32_t deaths(std::size_t env) const { return m_deaths[env]; }
+	std::uint32_t kills(std::size_t env) const { return m_kills[env]; }
+	// Chase spawns in the level that the batch leaves out
+	std::size_t skippedChasers() const { return m_skippedChasers; }
+
+	static constexpr glm::vec3 spawnPosition{ 0.0f, 6.0f, 2.3f };
+
+private:
+
+	// Static boxes grown by the player's half extents, so the player collides as a point
+	struct Bounds
+	{
+		glm::vec3 min{};
+		glm::vec3 max{};
+	};
+
+	static constexpr glm::vec3 m_playerHalfExtents{ 1.0f };
+
+	void stepRange(std::size_t begin, std::size_t end);
+	// Returns true when the move was stopped by a floor
+	bool moveAxis(glm::vec3& position, glm::vec3& velocity, int axis) const;
+
+	std::size_t m_environmentCount{};
+	std::uint64_t m_tick{};
+
+	std::vector<Bounds> m_statics{};
+	std::vector<Level::EnemySpawn> m_enemyPaths{};
+	std::size_t m_skippedChasers{};
+	// This tick's enemy positions, the same in every environment
+	std::vector<glm::vec3> m_enemies{};
+
+	std::vector<float> m_posX{};
+	std::vector<float> m_posY{};
+	std::vector<float> m_posZ{};
+	std::vector<float> m_velX{};
+	std::vector<float> m_velY{};
+	std::vector<float> m_velZ{};
+	std::vector<float> m_airTime{};
+	std::vector<std::uint32_t> m_deaths{};
+	std::vector<std::uint32_t> m_kills{};
+	// Indexed [enemy * environmentCount + env]
+	std::vector<unsigned char> m_enemyAlive{};
+
+	std::vector<Input> m_inputs{};
+};
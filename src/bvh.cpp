@@ -0,0 +1,920 @@
+#include "bvh.hpp"
+
+#include "glm/glm.hpp"
+
+#include <xmmintrin.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace
+{
+
+	constexpr std::uint32_t none{ 0xFFFFFFFF };
+	constexpr int binCount{ 16 };
+	constexpr std::uint32_t maxLeafSize{ 4 };
+	// Leaves are forced to split above this even when SAH prefers to keep them
+	constexpr std::uint32_t hardLeafSize{ 16 };
+	// Past this binary depth nodes split at the object median instead of by SAH, which halves
+	// them every level, so no input can make the recursive build or collapse run deep
+	constexpr int maxSahDepth{ 48 };
+
+	float halfArea(const glm::vec3& min, const glm::vec3& max)
+	{
+		const glm::vec3 extent{ glm::max(max - min, glm::vec3{ 0.0f }) };
+		return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+	}
+
+	// Two sided Moller-Trumbore; distance is along the unnormalised direction
+	bool rayTriangle(const glm::vec3& origin, const glm::vec3& direction, const TriangleBvh::Triangle& triangle, float& distance)
+	{
+		const glm::vec3 e1{ triangle.v1 - triangle.v0 };
+		const glm::vec3 e2{ triangle.v2 - triangle.v0 };
+		const glm::vec3 p{ glm::cross(direction, e2) };
+		const float det{ glm::dot(e1, p) };
+		if (std::abs(det) < 1e-12f)
+		{
+			return false;
+		}
+
+		const float inverse{ 1.0f / det };
+		const glm::vec3 s{ origin - triangle.v0 };
+		const float u{ glm::dot(s, p) * inverse };
+		if (u < 0.0f || u > 1.0f)
+		{
+			return false;
+		}
+
+		const glm::vec3 q{ glm::cross(s, e1) };
+		const float v{ glm::dot(direction, q) * inverse };
+		if (v < 0.0f || u + v > 1.0f)
+		{
+			return false;
+		}
+
+		const float t{ glm::dot(e2, q) * inverse };
+		if (t < 0.0f || t >= distance)
+		{
+			return false;
+		}
+
+		distance = t;
+		return true;
+	}
+
+	glm::vec3 faceNormal(const TriangleBvh::Triangle& triangle, const glm::vec3& towards)
+	{
+		const glm::vec3 normal{ glm::cross(triangle.v1 - triangle.v0, triangle.v2 - triangle.v0) };
+		const float length{ glm::length(normal) };
+		if (length == 0.0f)
+		{
+			return glm::vec3{ 0.0f, 1.0f, 0.0f };
+		}
+		return glm::dot(normal, towards) < 0.0f ? -normal / length : normal / length;
+	}
+
+	// Ericson, Real-Time Collision Detection 5.1.5
+	glm::vec3 closestPointOnTriangle(const glm::vec3& p, const TriangleBvh::Triangle& triangle)
+	{
+		const glm::vec3& a{ triangle.v0 };
+		const glm::vec3& b{ triangle.v1 };
+		const glm::vec3& c{ triangle.v2 };
+
+		const glm::vec3 ab{ b - a };
+		const glm::vec3 ac{ c - a };
+		const glm::vec3 ap{ p - a };
+		const float d1{ glm::dot(ab, ap) };
+		const float d2{ glm::dot(ac, ap) };
+		if (d1 <= 0.0f && d2 <= 0.0f) return a;
+
+		const glm::vec3 bp{ p - b };
+		const float d3{ glm::dot(ab, bp) };
+		const float d4{ glm::dot(ac, bp) };
+		if (d3 >= 0.0f && d4 <= d3) return b;
+
+		const float vc{ d1 * d4 - d3 * d2 };
+		if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return a + ab * (d1 / (d1 - d3));
+
+		const glm::vec3 cp{ p - c };
+		const float d5{ glm::dot(ab, cp) };
+		const float d6{ glm::dot(ac, cp) };
+		if (d6 >= 0.0f && d5 <= d6) return c;
+
+		const float vb{ d5 * d2 - d1 * d6 };
+		if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return a + ac * (d2 / (d2 - d6));
+
+		const float va{ d3 * d6 - d5 * d4 };
+		if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+		const float denominator{ 1.0f / (va + vb + vc) };
+		return a + ab * (vb * denominator) + ac * (vc * denominator);
+	}
+
+	// First t >= 0 where a sphere of radius moving along the unit direction touches the point
+	bool raySphere(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& centre, float radius, float& distance)
+	{
+		const glm::vec3 m{ origin - centre };
+		const float b{ glm::dot(m, direction) };
+		const float c{ glm::dot(m, m) - radius * radius };
+		if (c > 0.0f && b > 0.0f)
+		{
+			return false;
+		}
+
+		const float discriminant{ b * b - c };
+		if (discriminant < 0.0f)
+		{
+			return false;
+		}
+
+		distance = std::max(-b - std::sqrt(discriminant), 0.0f);
+		return true;
+	}
+
+	// Same against the capsule side around segment ab; the caps are left to raySphere
+	bool rayCylinder(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& a, const glm::vec3& b, float radius, float& distance)
+	{
+		const glm::vec3 ab{ b - a };
+		const glm::vec3 ao{ origin - a };
+		const float abab{ glm::dot(ab, ab) };
+		const float abd{ glm::dot(ab, direction) };
+		const float abao{ glm::dot(ab, ao) };
+
+		const float qa{ abab - abd * abd };
+		const float qb{ abab * glm::dot(ao, direction) - abd * abao };
+		const float qc{ abab * glm::dot(ao, ao) - abao * abao - radius * radius * abab };
+
+		if (qc < 0.0f)
+		{
+			// Starts inside the infinite cylinder
+			const float s{ abao / abab };
+			if (s >= 0.0f && s <= 1.0f)
+			{
+				distance = 0.0f;
+				return true;
+			}
+			return false;
+		}
+
+		if (qa < 1e-12f)
+		{
+			return false;
+		}
+
+		const float discriminant{ qb * qb - qa * qc };
+		if (discriminant < 0.0f)
+		{
+			return false;
+		}
+
+		const float t{ (-qb - std::sqrt(discriminant)) / qa };
+		if (t < 0.0f)
+		{
+			return false;
+		}
+
+		const float s{ (abao + t * abd) / abab };
+		if (s < 0.0f || s > 1.0f)
+		{
+			return false;
+		}
+
+		distance = t;
+		return true;
+	}
+
+	// Distance along the unit direction until the sphere touches the triangle, tested as the
+	// ray against the triangle's Minkowski sum with the sphere: the offset face, the edge
+	// cylinders and the vertex spheres
+	bool sphereTriangle(const glm::vec3& origin, const glm::vec3& direction, float radius, const TriangleBvh::Triangle& triangle, float& distance)
+	{
+		// Cheap reject against a sphere bounding the triangle before the exact feature tests
+		const glm::vec3 centre{ (triangle.v0 + triangle.v1 + triangle.v2) / 3.0f };
+		const float bound{ std::max({ glm::distance(centre, triangle.v0), glm::distance(centre, triangle.v1), glm::distance(centre, triangle.v2) }) };
+		float boundDistance{};
+		if (!raySphere(origin, direction, centre, bound + radius, boundDistance) || boundDistance >= distance)
+		{
+			return false;
+		}
+
+		float best{ distance };
+
+		const glm::vec3 normal{ faceNormal(triangle, origin - triangle.v0) };
+		const float height{ glm::dot(origin - triangle.v0, normal) };
+		const auto insideFace{ [&](const glm::vec3& point)
+			{
+				return glm::distance(closestPointOnTriangle(point, triangle), point) < 1e-4f + 1e-5f * glm::length(point);
+			} };
+
+		if (height <= radius)
+		{
+			if (insideFace(origin - normal * height))
+			{
+				distance = 0.0f;
+				return true;
+			}
+		}
+		else
+		{
+			const float approach{ -glm::dot(direction, normal) };
+			if (approach > 0.0f)
+			{
+				const float t{ (height - radius) / approach };
+				if (t < best && insideFace(origin + direction * t - normal * radius))
+				{
+					best = t;
+				}
+			}
+		}
+
+		const glm::vec3 vertices[3]{ triangle.v0, triangle.v1, triangle.v2 };
+		for (int i{ 0 }; i < 3; ++i)
+		{
+			float t{};
+			if (rayCylinder(origin, direction, vertices[i], vertices[(i + 1) % 3], radius, t) && t < best)
+			{
+				best = t;
+			}
+			if (raySphere(origin, direction, vertices[i], radius, t) && t < best)
+			{
+				best = t;
+			}
+		}
+
+		if (best < distance)
+		{
+			distance = best;
+			return true;
+		}
+		return false;
+	}
+
+	// Separating axis test, Akenine-Moller
+	bool triangleBox(const TriangleBvh::Triangle& triangle, const glm::vec3& centre, const glm::vec3& half)
+	{
+		const glm::vec3 v[3]{ triangle.v0 - centre, triangle.v1 - centre, triangle.v2 - centre };
+
+		for (int axis{ 0 }; axis < 3; ++axis)
+		{
+			const float min{ std::min({ v[0][axis], v[1][axis], v[2][axis] }) };
+			const float max{ std::max({ v[0][axis], v[1][axis], v[2][axis] }) };
+			if (min > half[axis] || max < -half[axis])
+			{
+				return false;
+			}
+		}
+
+		const glm::vec3 edges[3]{ v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+
+		const glm::vec3 normal{ glm::cross(edges[0], edges[1]) };
+		if (std::abs(glm::dot(normal, v[0])) > glm::dot(half, glm::abs(normal)))
+		{
+			return false;
+		}
+
+		for (int axis{ 0 }; axis < 3; ++axis)
+		{
+			glm::vec3 unit{ 0.0f };
+			unit[axis] = 1.0f;
+
+			for (const glm::vec3& edge : edges)
+			{
+				const glm::vec3 separating{ glm::cross(unit, edge) };
+				const float p0{ glm::dot(v[0], separating) };
+				const float p1{ glm::dot(v[1], separating) };
+				const float p2{ glm::dot(v[2], separating) };
+				const float r{ glm::dot(half, glm::abs(separating)) };
+				if (std::min({ p0, p1, p2 }) > r || std::max({ p0, p1, p2 }) < -r)
+				{
+					return false;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	struct RaySlabs
+	{
+		__m128 originX;
+		__m128 originY;
+		__m128 originZ;
+		__m128 inverseX;
+		__m128 inverseY;
+		__m128 inverseZ;
+	};
+
+	RaySlabs raySlabs(const glm::vec3& origin, const glm::vec3& direction)
+	{
+		const glm::vec3 inverse{ 1.0f / direction };
+		return
+		{
+			_mm_set1_ps(origin.x), _mm_set1_ps(origin.y), _mm_set1_ps(origin.z),
+			_mm_set1_ps(inverse.x), _mm_set1_ps(inverse.y), _mm_set1_ps(inverse.z),
+		};
+	}
+
+	// Slab test of one ray against four boxes; returns the hit mask and writes each box's
+	// entry distance
+	int rayBoxes(const RaySlabs& ray, float maxDistance, __m128 minX, __m128 minY, __m128 minZ, __m128 maxX, __m128 maxY, __m128 maxZ, __m128& entry)
+	{
+		const __m128 x0{ _mm_mul_ps(_mm_sub_ps(minX, ray.originX), ray.inverseX) };
+		const __m128 x1{ _mm_mul_ps(_mm_sub_ps(maxX, ray.originX), ray.inverseX) };
+		const __m128 y0{ _mm_mul_ps(_mm_sub_ps(minY, ray.originY), ray.inverseY) };
+		const __m128 y1{ _mm_mul_ps(_mm_sub_ps(maxY, ray.originY), ray.inverseY) };
+		const __m128 z0{ _mm_mul_ps(_mm_sub_ps(minZ, ray.originZ), ray.inverseZ) };
+		const __m128 z1{ _mm_mul_ps(_mm_sub_ps(maxZ, ray.originZ), ray.inverseZ) };
+
+		const __m128 near{ _mm_max_ps(_mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)), _mm_max_ps(_mm_min_ps(z0, z1), _mm_setzero_ps())) };
+		const __m128 far{ _mm_min_ps(_mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)), _mm_min_ps(_mm_max_ps(z0, z1), _mm_set1_ps(maxDistance))) };
+
+		entry = near;
+		return _mm_movemask_ps(_mm_cmple_ps(near, far));
+	}
+
+	// Mask of the four boxes touching [min, max]
+	int boxBoxes(const glm::vec3& min, const glm::vec3& max,
+		const float* minX, const float* minY, const float* minZ, const float* maxX, const float* maxY, const float* maxZ)
+	{
+		const __m128 separatedX{ _mm_or_ps(_mm_cmpgt_ps(_mm_load_ps(minX), _mm_set1_ps(max.x)), _mm_cmplt_ps(_mm_load_ps(maxX), _mm_set1_ps(min.x))) };
+		const __m128 separatedY{ _mm_or_ps(_mm_cmpgt_ps(_mm_load_ps(minY), _mm_set1_ps(max.y)), _mm_cmplt_ps(_mm_load_ps(maxY), _mm_set1_ps(min.y))) };
+		const __m128 separatedZ{ _mm_or_ps(_mm_cmpgt_ps(_mm_load_ps(minZ), _mm_set1_ps(max.z)), _mm_cmplt_ps(_mm_load_ps(maxZ), _mm_set1_ps(min.z))) };
+		return ~_mm_movemask_ps(_mm_or_ps(separatedX, _mm_or_ps(separatedY, separatedZ))) & 0xF;
+	}
+
+}
+
+TriangleBvh::TriangleBvh(std::span<const Triangle> triangles)
+{
+	const auto start{ std::chrono::steady_clock::now() };
+
+	if (triangles.empty())
+	{
+		return;
+	}
+
+	const std::uint32_t count{ static_cast<std::uint32_t>(triangles.size()) };
+
+	std::vector<BuildNode> bounds(count);
+	std::vector<glm::vec3> centroids(count);
+	std::vector<std::uint32_t> order(count);
+	for (std::uint32_t i{ 0 }; i < count; ++i)
+	{
+		const Triangle& triangle{ triangles[i] };
+		bounds[i].min = glm::min(triangle.v0, glm::min(triangle.v1, triangle.v2));
+		bounds[i].max = glm::max(triangle.v0, glm::max(triangle.v1, triangle.v2));
+		centroids[i] = (bounds[i].min + bounds[i].max) * 0.5f;
+		order[i] = i;
+	}
+
+	std::vector<BuildNode> nodes{};
+	nodes.reserve(static_cast<std::size_t>(count) * 2);
+	nodes.emplace_back();
+	buildBinary(nodes, 0, order, centroids, bounds, 0, count, 0);
+
+	m_triangles.resize(count);
+	m_triangleIds = order;
+	for (std::uint32_t i{ 0 }; i < count; ++i)
+	{
+		m_triangles[i] = triangles[order[i]];
+	}
+
+	m_nodes.reserve(nodes.size() / 2 + 1);
+	collapse(nodes, 0, 1);
+
+	m_stats.triangles = count;
+	m_stats.nodes = m_nodes.size();
+	// Each level pops one node and pushes at most four children
+	m_stackNeeded = static_cast<std::size_t>(m_stats.depth) * 3 + 1;
+	m_stats.buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void TriangleBvh::buildBinary(std::vector<BuildNode>& nodes, std::uint32_t index, std::vector<std::uint32_t>& order,
+	const std::vector<glm::vec3>& centroids, const std::vector<BuildNode>& bounds, std::uint32_t begin, std::uint32_t end, int depth)
+{
+	glm::vec3 min{ INFINITY };
+	glm::vec3 max{ -INFINITY };
+	glm::vec3 centroidMin{ INFINITY };
+	glm::vec3 centroidMax{ -INFINITY };
+	for (std::uint32_t i{ begin }; i < end; ++i)
+	{
+		min = glm::min(min, bounds[order[i]].min);
+		max = glm::max(max, bounds[order[i]].max);
+		centroidMin = glm::min(centroidMin, centroids[order[i]]);
+		centroidMax = glm::max(centroidMax, centroids[order[i]]);
+	}
+
+	nodes[index].min = min;
+	nodes[index].max = max;
+	nodes[index].first = begin;
+	nodes[index].count = end - begin;
+
+	const std::uint32_t count{ end - begin };
+	if (count <= 1)
+	{
+		return;
+	}
+
+	if (depth >= maxSahDepth)
+	{
+		if (count <= maxLeafSize)
+		{
+			return;
+		}
+
+		// Object median along the widest centroid axis
+		const glm::vec3 extent{ centroidMax - centroidMin };
+		const int axis{ extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2 };
+		const std::uint32_t middle{ begin + count / 2 };
+		std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+			[&](std::uint32_t a, std::uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+		splitNode(nodes, index, order, centroids, bounds, begin, middle, end, depth);
+		return;
+	}
+
+	// Binned SAH over all three axes, costs relative to intersecting one triangle
+	int bestAxis{ -1 };
+	int bestSplit{ 0 };
+	float bestCost{ INFINITY };
+
+	for (int axis{ 0 }; axis < 3; ++axis)
+	{
+		const float extent{ centroidMax[axis] - centroidMin[axis] };
+		if (extent <= 0.0f)
+		{
+			continue;
+		}
+		const float scale{ binCount / extent };
+
+		std::array<glm::vec3, binCount> binMin{};
+		std::array<glm::vec3, binCount> binMax{};
+		std::array<std::uint32_t, binCount> binCounts{};
+		binMin.fill(glm::vec3{ INFINITY });
+		binMax.fill(glm::vec3{ -INFINITY });
+
+		for (std::uint32_t i{ begin }; i < end; ++i)
+		{
+			const int bin{ std::min(binCount - 1, static_cast<int>((centroids[order[i]][axis] - centroidMin[axis]) * scale)) };
+			binMin[bin] = glm::min(binMin[bin], bounds[order[i]].min);
+			binMax[bin] = glm::max(binMax[bin], bounds[order[i]].max);
+			++binCounts[bin];
+		}
+
+		// Right to left sweep first, then combine while sweeping left to right
+		std::array<float, binCount> rightCost{};
+		glm::vec3 sweepMin{ INFINITY };
+		glm::vec3 sweepMax{ -INFINITY };
+		std::uint32_t sweepCount{ 0 };
+		for (int bin{ binCount - 1 }; bin > 0; --bin)
+		{
+			sweepMin = glm::min(sweepMin, binMin[bin]);
+			sweepMax = glm::max(sweepMax, binMax[bin]);
+			sweepCount += binCounts[bin];
+			rightCost[bin] = sweepCount == 0 ? 0.0f : halfArea(sweepMin, sweepMax) * sweepCount;
+		}
+
+		sweepMin = glm::vec3{ INFINITY };
+		sweepMax = glm::vec3{ -INFINITY };
+		sweepCount = 0;
+		for (int bin{ 0 }; bin < binCount - 1; ++bin)
+		{
+			sweepMin = glm::min(sweepMin, binMin[bin]);
+			sweepMax = glm::max(sweepMax, binMax[bin]);
+			sweepCount += binCounts[bin];
+			if (sweepCount == 0 || sweepCount == count)
+			{
+				continue;
+			}
+
+			const float cost{ halfArea(sweepMin, sweepMax) * sweepCount + rightCost[bin + 1] };
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = bin;
+			}
+		}
+	}
+
+	const float area{ std::max(halfArea(min, max), 1e-12f) };
+	const bool splitPays{ bestAxis >= 0 && 1.0f + bestCost / area < static_cast<float>(count) };
+	if (count <= maxLeafSize && !splitPays)
+	{
+		return;
+	}
+
+	std::uint32_t middle{};
+	if (bestAxis >= 0)
+	{
+		const float scale{ binCount / (centroidMax[bestAxis] - centroidMin[bestAxis]) };
+		middle = static_cast<std::uint32_t>(std::partition(order.begin() + begin, order.begin() + end, [&](std::uint32_t triangle)
+			{
+				return std::min(binCount - 1, static_cast<int>((centroids[triangle][bestAxis] - centroidMin[bestAxis]) * scale)) <= bestSplit;
+			}) - order.begin());
+	}
+	else if (count > hardLeafSize)
+	{
+		// Every centroid coincides; split by count so leaves stay bounded
+		middle = begin + count / 2;
+	}
+	else
+	{
+		return;
+	}
+
+	splitNode(nodes, index, order, centroids, bounds, begin, middle, end, depth);
+}
+
+void TriangleBvh::splitNode(std::vector<BuildNode>& nodes, std::uint32_t index, std::vector<std::uint32_t>& order,
+	const std::vector<glm::vec3>& centroids, const std::vector<BuildNode>& bounds, std::uint32_t begin, std::uint32_t middle, std::uint32_t end, int depth)
+{
+	const std::uint32_t children{ static_cast<std::uint32_t>(nodes.size()) };
+	nodes.emplace_back();
+	nodes.emplace_back();
+	nodes[index].first = children;
+	nodes[index].count = 0;
+
+	buildBinary(nodes, children, order, centroids, bounds, begin, middle, depth + 1);
+	buildBinary(nodes, children + 1, order, centroids, bounds, middle, end, depth + 1);
+}
+
+std::uint32_t TriangleBvh::collapse(const std::vector<BuildNode>& nodes, std::uint32_t binary, int depth)
+{
+	m_stats.depth = std::max(m_stats.depth, depth);
+
+	// Open the largest inner children until there are four
+	std::array<std::uint32_t, 4> children{};
+	std::size_t childCount{ 0 };
+	if (nodes[binary].count != 0)
+	{
+		children[childCount++] = binary;
+	}
+	else
+	{
+		children[childCount++] = nodes[binary].first;
+		children[childCount++] = nodes[binary].first + 1;
+	}
+
+	while (childCount < 4)
+	{
+		std::size_t open{ childCount };
+		float openArea{ -1.0f };
+		for (std::size_t i{ 0 }; i < childCount; ++i)
+		{
+			const BuildNode& child{ nodes[children[i]] };
+			const float area{ halfArea(child.min, child.max) };
+			if (child.count == 0 && area > openArea)
+			{
+				open = i;
+				openArea = area;
+			}
+		}
+
+		if (open == childCount)
+		{
+			break;
+		}
+
+		const std::uint32_t opened{ nodes[children[open]].first };
+		children[open] = opened;
+		children[childCount++] = opened + 1;
+	}
+
+	const std::uint32_t index{ static_cast<std::uint32_t>(m_nodes.size()) };
+	m_nodes.emplace_back();
+	for (int i{ 0 }; i < 4; ++i)
+	{
+		Node& node{ m_nodes[index] };
+		node.minX[i] = node.minY[i] = node.minZ[i] = INFINITY;
+		node.maxX[i] = node.maxY[i] = node.maxZ[i] = -INFINITY;
+		node.first[i] = none;
+		node.count[i] = 0;
+	}
+
+	for (std::size_t i{ 0 }; i < childCount; ++i)
+	{
+		const BuildNode& child{ nodes[children[i]] };
+
+		std::uint32_t first{ child.first };
+		if (child.count == 0)
+		{
+			first = collapse(nodes, children[i], depth + 1);
+		}
+		else
+		{
+			++m_stats.leaves;
+		}
+
+		// collapse may have grown m_nodes
+		Node& node{ m_nodes[index] };
+		node.minX[i] = child.min.x;
+		node.minY[i] = child.min.y;
+		node.minZ[i] = child.min.z;
+		node.maxX[i] = child.max.x;
+		node.maxY[i] = child.max.y;
+		node.maxZ[i] = child.max.z;
+		node.first[i] = first;
+		node.count[i] = child.count;
+	}
+
+	return index;
+}
+
+// boxTest(node, entry) returns the mask of children to visit and may write each one's
+// entry distance for front to back ordering. leafVisit(first, count, child) runs right
+// after the boxTest of the node holding the leaf in slot child, and returns true to stop.
+template <typename BoxTest, typename LeafVisit>
+void TriangleBvh::traverse(BoxTest&& boxTest, LeafVisit&& leafVisit) const
+{
+	if (m_nodes.empty())
+	{
+		return;
+	}
+
+	// Sized from the tree's depth, so pushes never overflow; trees too deep for the local
+	// array traverse with a heap one instead
+	std::uint32_t localStack[m_stackSize];
+	std::vector<std::uint32_t> heapStack{};
+	std::uint32_t* stack{ localStack };
+	if (m_stackNeeded > m_stackSize)
+	{
+		heapStack.resize(m_stackNeeded);
+		stack = heapStack.data();
+	}
+
+	std::size_t stackSize{ 0 };
+	stack[stackSize++] = 0;
+
+	while (stackSize != 0)
+	{
+		const Node& node{ m_nodes[stack[--stackSize]] };
+
+		alignas(16) float entry[4]{};
+		int mask{ boxTest(node, entry) };
+		for (int i{ 0 }; i < 4; ++i)
+		{
+			if (node.first[i] == none)
+			{
+				mask &= ~(1 << i);
+			}
+		}
+
+		// Leaves right away, then inner children pushed far to near so the nearest pops first
+		std::uint32_t inner[4];
+		float innerEntry[4];
+		int innerCount{ 0 };
+		for (int i{ 0 }; i < 4; ++i)
+		{
+			if (!(mask & (1 << i)))
+			{
+				continue;
+			}
+
+			if (node.count[i] != 0)
+			{
+				if (leafVisit(node.first[i], node.count[i], i))
+				{
+					return;
+				}
+				continue;
+			}
+
+			int slot{ innerCount++ };
+			while (slot > 0 && innerEntry[slot - 1] < entry[i])
+			{
+				inner[slot] = inner[slot - 1];
+				innerEntry[slot] = innerEntry[slot - 1];
+				--slot;
+			}
+			inner[slot] = node.first[i];
+			innerEntry[slot] = entry[i];
+		}
+
+		for (int i{ 0 }; i < innerCount; ++i)
+		{
+			stack[stackSize++] = inner[i];
+		}
+	}
+}
+
+bool TriangleBvh::raycast(const Ray& ray, Hit& hit) const
+{
+	const RaySlabs slabs{ raySlabs(ray.origin, ray.direction) };
+	float best{ std::min(ray.maxDistance, hit.distance) };
+	std::uint32_t bestTriangle{ none };
+
+	traverse([&](const Node& node, float* entry)
+		{
+			__m128 near{};
+			const int mask{ rayBoxes(slabs, best,
+				_mm_load_ps(node.minX), _mm_load_ps(node.minY), _mm_load_ps(node.minZ),
+				_mm_load_ps(node.maxX), _mm_load_ps(node.maxY), _mm_load_ps(node.maxZ), near) };
+			_mm_store_ps(entry, near);
+			return mask;
+		},
+		[&](std::uint32_t first, std::uint32_t count, int)
+		{
+			for (std::uint32_t i{ first }; i < first + count; ++i)
+			{
+				if (rayTriangle(ray.origin, ray.direction, m_triangles[i], best))
+				{
+					bestTriangle = i;
+				}
+			}
+			return false;
+		});
+
+	if (bestTriangle == none)
+	{
+		return false;
+	}
+
+	hit.distance = best;
+	hit.triangle = m_triangleIds[bestTriangle];
+	hit.normal = faceNormal(m_triangles[bestTriangle], -ray.direction);
+	return true;
+}
+
+bool TriangleBvh::sphereCast(const Ray& ray, float radius, Hit& hit) const
+{
+	const float length{ glm::length(ray.direction) };
+	if (length == 0.0f)
+	{
+		return false;
+	}
+	const glm::vec3 direction{ ray.direction / length };
+
+	const RaySlabs slabs{ raySlabs(ray.origin, ray.direction) };
+	const __m128 grow{ _mm_set1_ps(radius) };
+
+	// Boxes are tested in units of ray.direction, triangles in world units
+	float best{ std::min(ray.maxDistance, hit.distance) };
+	std::uint32_t bestTriangle{ none };
+
+	traverse([&](const Node& node, float* entry)
+		{
+			__m128 near{};
+			const int mask{ rayBoxes(slabs, best,
+				_mm_sub_ps(_mm_load_ps(node.minX), grow), _mm_sub_ps(_mm_load_ps(node.minY), grow), _mm_sub_ps(_mm_load_ps(node.minZ), grow),
+				_mm_add_ps(_mm_load_ps(node.maxX), grow), _mm_add_ps(_mm_load_ps(node.maxY), grow), _mm_add_ps(_mm_load_ps(node.maxZ), grow), near) };
+			_mm_store_ps(entry, near);
+			return mask;
+		},
+		[&](std::uint32_t first, std::uint32_t count, int)
+		{
+			for (std::uint32_t i{ first }; i < first + count; ++i)
+			{
+				float distance{ best * length };
+				if (sphereTriangle(ray.origin, direction, radius, m_triangles[i], distance))
+				{
+					best = distance / length;
+					bestTriangle = i;
+				}
+			}
+			return false;
+		});
+
+	if (bestTriangle == none)
+	{
+		return false;
+	}
+
+	const glm::vec3 centre{ ray.origin + ray.direction * best };
+	const glm::vec3 away{ centre - closestPointOnTriangle(centre, m_triangles[bestTriangle]) };
+	const float awayLength{ glm::length(away) };
+
+	hit.distance = best;
+	hit.triangle = m_triangleIds[bestTriangle];
+	hit.normal = awayLength > 1e-6f ? away / awayLength : faceNormal(m_triangles[bestTriangle], -ray.direction);
+	return true;
+}
+
+void TriangleBvh::raycastPacket(std::span<const Ray> rays, std::span<Hit> hits) const
+{
+	constexpr std::size_t maxPacket{ 64 };
+	if (rays.size() > maxPacket)
+	{
+		raycastPacket(rays.first(maxPacket), hits.first(maxPacket));
+		raycastPacket(rays.subspan(maxPacket), hits.subspan(maxPacket));
+		return;
+	}
+
+	std::array<RaySlabs, maxPacket> slabs;
+	std::array<float, maxPacket> best;
+	std::array<std::uint32_t, maxPacket> bestTriangle;
+	for (std::size_t r{ 0 }; r < rays.size(); ++r)
+	{
+		slabs[r] = raySlabs(rays[r].origin, rays[r].direction);
+		best[r] = std::min(rays[r].maxDistance, hits[r].distance);
+		bestTriangle[r] = none;
+	}
+
+	// A child is visited when any ray of the packet enters it; its triangles are then only
+	// tested against the rays that entered it
+	std::array<int, maxPacket> rayMasks;
+
+	traverse([&](const Node& node, float* entry)
+		{
+			const __m128 minX{ _mm_load_ps(node.minX) };
+			const __m128 minY{ _mm_load_ps(node.minY) };
+			const __m128 minZ{ _mm_load_ps(node.minZ) };
+			const __m128 maxX{ _mm_load_ps(node.maxX) };
+			const __m128 maxY{ _mm_load_ps(node.maxY) };
+			const __m128 maxZ{ _mm_load_ps(node.maxZ) };
+
+			int mask{ 0 };
+			__m128 nearest{ _mm_set1_ps(INFINITY) };
+			for (std::size_t r{ 0 }; r < rays.size(); ++r)
+			{
+				__m128 near{};
+				rayMasks[r] = rayBoxes(slabs[r], best[r], minX, minY, minZ, maxX, maxY, maxZ, near);
+				mask |= rayMasks[r];
+				nearest = _mm_min_ps(nearest, near);
+			}
+			_mm_store_ps(entry, nearest);
+			return mask;
+		},
+		[&](std::uint32_t first, std::uint32_t count, int child)
+		{
+			for (std::size_t r{ 0 }; r < rays.size(); ++r)
+			{
+				if (!(rayMasks[r] & (1 << child)))
+				{
+					continue;
+				}
+
+				for (std::uint32_t i{ first }; i < first + count; ++i)
+				{
+					if (rayTriangle(rays[r].origin, rays[r].direction, m_triangles[i], best[r]))
+					{
+						bestTriangle[r] = i;
+					}
+				}
+			}
+			return false;
+		});
+
+	for (std::size_t r{ 0 }; r < rays.size(); ++r)
+	{
+		if (bestTriangle[r] != none)
+		{
+			hits[r].distance = best[r];
+			hits[r].triangle = m_triangleIds[bestTriangle[r]];
+			hits[r].normal = faceNormal(m_triangles[bestTriangle[r]], -rays[r].direction);
+		}
+	}
+}
+
+bool TriangleBvh::overlaps(const glm::vec3& min, const glm::vec3& max) const
+{
+	bool found{ false };
+	const glm::vec3 centre{ (min + max) * 0.5f };
+	const glm::vec3 half{ (max - min) * 0.5f };
+
+	traverse([&](const Node& node, float*)
+		{
+			return boxBoxes(min, max, node.minX, node.minY, node.minZ, node.maxX, node.maxY, node.maxZ);
+		},
+		[&](std::uint32_t first, std::uint32_t count, int)
+		{
+			for (std::uint32_t i{ first }; i < first + count; ++i)
+			{
+				if (triangleBox(m_triangles[i], centre, half))
+				{
+					found = true;
+					return true;
+				}
+			}
+			return false;
+		});
+
+	return found;
+}
+
+void TriangleBvh::overlapping(const glm::vec3& min, const glm::vec3& max, std::vector<std::uint32_t>& triangles) const
+{
+	const glm::vec3 centre{ (min + max) * 0.5f };
+	const glm::vec3 half{ (max - min) * 0.5f };
+
+	traverse([&](const Node& node, float*)
+		{
+			return boxBoxes(min, max, node.minX, node.minY, node.minZ, node.maxX, node.maxY, node.maxZ);
+		},
+		[&](std::uint32_t first, std::uint32_t count, int)
+		{
+			for (std::uint32_t i{ first }; i < first + count; ++i)
+			{
+				if (triangleBox(m_triangles[i], centre, half))
+				{
+					triangles.push_back(m_triangleIds[i]);
+				}
+			}
+			return false;
+		});
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Static triangle soup in a 4-wide bounding volume hierarchy. The tree is built as a
+// binary tree with binned SAH and then collapsed so every node holds the bounds of up to
+// four children in SoA form, letting one SSE slab test cover all four. Triangles are
+// copied and reordered into leaf order; hits report the caller's original index.
+class TriangleBvh final
+{
+public:
+
+	struct Triangle
+	{
+		glm::vec3 v0{};
+		glm::vec3 v1{};
+		glm::vec3 v2{};
+	};
+
+	// Distances are along direction, which does not need to be normalised for raycasts.
+	// Sphere casts measure in units of its length too.
+	struct Ray
+	{
+		glm::vec3 origin{};
+		glm::vec3 direction{};
+		float maxDistance{ INFINITY };
+	};
+
+	struct Hit
+	{
+		float distance{ INFINITY };
+		std::uint32_t triangle{ 0xFFFFFFFF };
+		// Facing the ray, or for sphere casts pointing from the contact to the sphere centre
+		glm::vec3 normal{};
+
+		bool hit() const { return triangle != 0xFFFFFFFF; }
+	};
+
+	struct Stats
+	{
+		std::size_t triangles{};
+		std::size_t nodes{};
+		std::size_t leaves{};
+		int depth{};
+		double buildMs{};
+	};
+
+	TriangleBvh() = default;
+	explicit TriangleBvh(std::span<const Triangle> triangles);
+	TriangleBvh(const TriangleBvh&) = delete;
+	TriangleBvh& operator=(const TriangleBvh&) = delete;
+	TriangleBvh(TriangleBvh&&) = default;
+	TriangleBvh& operator=(TriangleBvh&&) = default;
+
+	// Each returns true and fills hit only when something is closer than hit.distance,
+	// so several trees can be queried in turn with the same Hit
+	bool raycast(const Ray& ray, Hit& hit) const;
+	bool sphereCast(const Ray& ray, float radius, Hit& hit) const;
+
+	// Rays that start close together and point the same way (camera rigs, ground probes
+	// under one body) share one traversal; hits.size() must equal rays.size()
+	void raycastPacket(std::span<const Ray> rays, std::span<Hit> hits) const;
+
+	bool overlaps(const glm::vec3& min, const glm::vec3& max) const;
+	// Appends the original index of every triangle touching the box
+	void overlapping(const glm::vec3& min, const glm::vec3& max, std::vector<std::uint32_t>& triangles) const;
+
+	bool empty() const { return m_nodes.empty(); }
+	const Stats& stats() const { return m_stats; }
+
+private:
+
+	// A child with count 0 is the inner node at index first; otherwise it is a leaf
+	// covering triangles [first, first + count). Unused slots have inverted bounds.
+	struct alignas(16) Node
+	{
+		float minX[4];
+		float minY[4];
+		float minZ[4];
+		float maxX[4];
+		float maxY[4];
+		float maxZ[4];
+		std::uint32_t first[4];
+		std::uint32_t count[4];
+	};
+
+	struct BuildNode
+	{
+		glm::vec3 min{};
+		glm::vec3 max{};
+		// Index of the left child, the right one follows it; or the first triangle of a leaf
+		std::uint32_t first{};
+		std::uint32_t count{};
+	};
+
+	// Traversal stack entries kept on the stack; deeper trees fall back to the heap
+	static constexpr std::size_t m_stackSize{ 256 };
+
+	// Fills nodes[index] from triangles order[begin, end), appending its children
+	void buildBinary(std::vector<BuildNode>& nodes, std::uint32_t index, std::vector<std::uint32_t>& order,
+		const std::vector<glm::vec3>& centroids, const std::vector<BuildNode>& bounds, std::uint32_t begin, std::uint32_t end, int depth);
+	// Makes nodes[index] inner with children over [begin, middle) and [middle, end)
+	void splitNode(std::vector<BuildNode>& nodes, std::uint32_t index, std::vector<std::uint32_t>& order,
+		const std::vector<glm::vec3>& centroids, const std::vector<BuildNode>& bounds, std::uint32_t begin, std::uint32_t middle, std::uint32_t end, int depth);
+	std::uint32_t collapse(const std::vector<BuildNode>& nodes, std::uint32_t binary, int depth);
+
+	template <typename BoxTest, typename LeafVisit>
+	void traverse(BoxTest&& boxTest, LeafVisit&& leafVisit) const;
+
+	std::vector<Node> m_nodes{};
+	std::vector<Triangle> m_triangles{};
+	std::vector<std::uint32_t> m_triangleIds{};
+
+	// Deepest traversal stack any query can need
+	std::size_t m_stackNeeded{ 1 };
+	Stats m_stats{};
+};
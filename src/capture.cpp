@@ -0,0 +1,234 @@
+#include "capture.hpp"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+namespace
+{
+
+	void encode(const unsigned char* pixels, GLsizei width, GLsizei height, FrameCapture::Encoding encoding, const std::string& path)
+	{
+		// Rows come back from GL bottom up
+		const std::size_t rowSize{ static_cast<std::size_t>(width) * 4 };
+		bool written{};
+		if (encoding == FrameCapture::Encoding::png)
+		{
+			written = stbi_write_png(path.c_str(), width, height, 4, pixels, static_cast<int>(rowSize)) != 0;
+		}
+		else
+		{
+			std::ofstream file{ path, std::ios::binary };
+			for (GLsizei y{ height - 1 }; file && y >= 0; --y)
+			{
+				file.write(reinterpret_cast<const char*>(pixels + static_cast<std::size_t>(y) * rowSize), static_cast<std::streamsize>(rowSize));
+			}
+			written = static_cast<bool>(file);
+		}
+
+		if (!written)
+		{
+			std::cerr << "CAPTURE, ERROR: Cannot write " << path << '\n';
+		}
+	}
+
+}
+
+FrameCapture::FrameCapture()
+{
+	// Global to stb, and nothing else writes images
+	stbi_flip_vertically_on_write(1);
+}
+
+void FrameCapture::screenshot(std::string_view path)
+{
+	std::error_code error{};
+	std::filesystem::create_directories(std::filesystem::path{ path }.parent_path(), error);
+	m_screenshotPath = path;
+}
+
+void FrameCapture::startSequence(std::string_view directory, Encoding encoding)
+{
+	std::error_code error{};
+	std::filesystem::create_directories(directory, error);
+	if (error)
+	{
+		std::cerr << "CAPTURE, ERROR: Cannot create " << directory << ": " << error.message() << '\n';
+		return;
+	}
+
+	m_recording = true;
+	m_directory = directory;
+	m_encoding = encoding;
+	m_sequenceFrame = 0;
+}
+
+void FrameCapture::stopSequence()
+{
+	m_recording = false;
+}
+
+void FrameCapture::update(GLState& state, GLuint framebuffer, GLsizei width, GLsizei height, JobSystem* jobs)
+{
+	const auto start{ std::chrono::steady_clock::now() };
+
+	retire(jobs);
+
+	const bool screenshot{ !m_screenshotPath.empty() };
+	if (screenshot || m_recording)
+	{
+		Slot* free{ nullptr };
+		for (Slot& slot : m_slots)
+		{
+			if (slot.state == SlotState::idle)
+			{
+				free = &slot;
+				break;
+			}
+		}
+
+		if (free)
+		{
+			readback(*free, state, framebuffer, width, height);
+
+			if (screenshot)
+			{
+				free->encoding = Encoding::png;
+				free->path = std::move(m_screenshotPath);
+				m_screenshotPath.clear();
+			}
+			else
+			{
+				char name[48]{};
+				std::snprintf(name, sizeof(name), m_encoding == Encoding::png ? "frame_%06llu.png" : "frame_%06llu_%dx%d.rgba",
+					static_cast<unsigned long long>(m_sequenceFrame), width, height);
+				free->encoding = m_encoding;
+				free->path = (std::filesystem::path{ m_directory } / name).string();
+			}
+			++m_stats.captured;
+		}
+		else
+		{
+			++m_stats.dropped;
+		}
+
+		// Frame numbers keep counting through drops, so gaps show in the sequence
+		if (m_recording && !screenshot)
+		{
+			++m_sequenceFrame;
+		}
+	}
+
+	m_stats.inFlight = 0;
+	m_stats.bufferBytes = 0;
+	for (const Slot& slot : m_slots)
+	{
+		m_stats.inFlight += slot.state != SlotState::idle;
+		m_stats.bufferBytes += slot.capacity;
+	}
+
+	m_stats.updateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void FrameCapture::destroy(GLState& state)
+{
+	for (Slot& slot : m_slots)
+	{
+		if (slot.job.valid())
+		{
+			slot.job.get();
+		}
+		if (slot.fence)
+		{
+			glDeleteSync(slot.fence);
+		}
+		if (slot.buffer)
+		{
+			state.forgetBuffer(slot.buffer);
+			glUnmapNamedBuffer(slot.buffer);
+			glDeleteBuffers(1, &slot.buffer);
+		}
+		slot = {};
+	}
+}
+
+void FrameCapture::retire(JobSystem* jobs)
+{
+	for (Slot& slot : m_slots)
+	{
+		if (slot.state == SlotState::reading)
+		{
+			// Zero timeout: only asks whether the copy is done
+			const GLenum status{ glClientWaitSync(slot.fence, 0, 0) };
+			if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+			{
+				glDeleteSync(slot.fence);
+				slot.fence = nullptr;
+				slot.state = SlotState::encoding;
+
+				// The mapping is coherent, so after the fence the job can read it directly
+				auto job{ [pixels{ slot.mapped }, width{ slot.width }, height{ slot.height }, encoding{ slot.encoding }, path{ slot.path }]()
+					{
+						encode(pixels, width, height, encoding, path);
+					} };
+
+				if (jobs)
+				{
+					slot.job = jobs->submit(std::move(job));
+				}
+				else
+				{
+					job();
+					slot.state = SlotState::idle;
+					++m_stats.written;
+				}
+			}
+		}
+		else if (slot.state == SlotState::encoding && slot.job.wait_for(std::chrono::seconds{ 0 }) == std::future_status::ready)
+		{
+			slot.job.get();
+			slot.state = SlotState::idle;
+			++m_stats.written;
+		}
+	}
+}
+
+void FrameCapture::readback(Slot& slot, GLState& state, GLuint framebuffer, GLsizei width, GLsizei height)
+{
+	const std::size_t size{ static_cast<std::size_t>(width) * height * 4 };
+	if (slot.capacity < size)
+	{
+		if (slot.buffer)
+		{
+			state.forgetBuffer(slot.buffer);
+			glUnmapNamedBuffer(slot.buffer);
+			glDeleteBuffers(1, &slot.buffer);
+		}
+
+		const GLbitfield flags{ GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT };
+		glCreateBuffers(1, &slot.buffer);
+		glNamedBufferStorage(slot.buffer, static_cast<GLsizeiptr>(size), nullptr, flags | GL_CLIENT_STORAGE_BIT);
+		slot.mapped = static_cast<const unsigned char*>(glMapNamedBufferRange(slot.buffer, 0, static_cast<GLsizeiptr>(size), flags));
+		slot.capacity = size;
+	}
+
+	state.bindFramebuffer(framebuffer);
+	state.bindPixelPackBuffer(slot.buffer);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	// Other readbacks and texture downloads expect client memory
+	state.bindPixelPackBuffer(0);
+
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.width = width;
+	slot.height = height;
+	slot.state = SlotState::reading;
+}
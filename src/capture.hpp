@@ -0,0 +1,100 @@
+#pragma once
+
+#include "gl_state.hpp"
+#include "jobs.hpp"
+
+#include "glad/glad.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <string>
+#include <string_view>
+
+// Frame grabs for screenshots and QA recordings. Each capture reads the frame into one of a
+// ring of persistently mapped pixel pack buffers and fences it; a few frames later, once the
+// fence has passed, a job encodes straight out of the mapping. The render thread never waits
+// on the GPU, and when every buffer is still busy the frame is dropped rather than stalled.
+class FrameCapture final
+{
+public:
+
+	enum class Encoding
+	{
+		png,
+		// Top down RGBA8 with the size in the file name; cheap enough to keep up with a sequence
+		raw,
+	};
+
+	struct Stats
+	{
+		std::uint64_t captured{};
+		std::uint64_t written{};
+		std::uint64_t dropped{};
+		std::size_t inFlight{};
+		// Pixel pack storage held by the ring
+		std::size_t bufferBytes{};
+		// Render thread time spent in the last update
+		double updateMs{};
+	};
+
+	FrameCapture();
+	FrameCapture(const FrameCapture&) = delete;
+	FrameCapture& operator=(const FrameCapture&) = delete;
+
+	// The next frame is written to path as PNG
+	void screenshot(std::string_view path);
+
+	// Every frame from now on is written to directory as frame_000000 onwards
+	void startSequence(std::string_view directory, Encoding encoding);
+	void stopSequence();
+	bool recording() const { return m_recording; }
+
+	// Call once a frame after the image is complete in framebuffer, on the GL thread. Without
+	// jobs, encoding runs inline.
+	void update(GLState& state, GLuint framebuffer, GLsizei width, GLsizei height, JobSystem* jobs);
+
+	const Stats& stats() const { return m_stats; }
+
+	// Waits for outstanding encodes
+	void destroy(GLState& state);
+
+private:
+
+	enum class SlotState
+	{
+		idle,
+		reading,
+		encoding,
+	};
+
+	struct Slot
+	{
+		SlotState state{ SlotState::idle };
+		GLuint buffer{};
+		const unsigned char* mapped{};
+		std::size_t capacity{ 0 };
+		GLsync fence{};
+		GLsizei width{};
+		GLsizei height{};
+		Encoding encoding{ Encoding::png };
+		std::string path{};
+		std::future<void> job{};
+	};
+
+	// Enough for the encodes of a few frames to overlap before captures get dropped
+	static constexpr int m_slotCount{ 4 };
+
+	void retire(JobSystem* jobs);
+	void readback(Slot& slot, GLState& state, GLuint framebuffer, GLsizei width, GLsizei height);
+
+	Slot m_slots[m_slotCount]{};
+
+	std::string m_screenshotPath{};
+	bool m_recording{ false };
+	std::string m_directory{};
+	Encoding m_encoding{ Encoding::raw };
+	std::uint64_t m_sequenceFrame{ 0 };
+
+	Stats m_stats{};
+};
@@ -0,0 +1,162 @@
+#include "debug_draw.hpp"
+
+#include "glm/glm.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace
+{
+
+	constexpr int circleSegments{ 16 };
+
+	// Unit circle points, shared by every sphere
+	const std::array<glm::vec2, circleSegments> circle{ []()
+		{
+			std::array<glm::vec2, circleSegments> points{};
+			for (int i{ 0 }; i < circleSegments; ++i)
+			{
+				const float angle{ 6.28318530718f * static_cast<float>(i) / static_cast<float>(circleSegments) };
+				points[i] = { std::cos(angle), std::sin(angle) };
+			}
+			return points;
+		}() };
+
+	std::uint32_t packColor(const glm::vec4& color)
+	{
+		const auto channel{ [](float value) { return static_cast<std::uint32_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f)); } };
+		return channel(color.r) | (channel(color.g) << 8) | (channel(color.b) << 16) | (channel(color.a) << 24);
+	}
+
+	// Corner i has bit 0 for x, bit 1 for y and bit 2 for z; each edge flips one bit
+	constexpr int boxEdges[12][2]{ { 0, 1 }, { 2, 3 }, { 4, 5 }, { 6, 7 }, { 0, 2 }, { 1, 3 }, { 4, 6 }, { 5, 7 }, { 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 } };
+
+}
+
+void DebugDraw::line(const glm::vec3& a, const glm::vec3& b, const glm::vec4& color, float duration)
+{
+	Vertex* out{ addLines(1, expiryAfter(duration)) };
+	const std::uint32_t packed{ packColor(color) };
+	out[0] = { a, packed };
+	out[1] = { b, packed };
+}
+
+void DebugDraw::box(const glm::vec3& min, const glm::vec3& max, const glm::vec4& color, float duration)
+{
+	const std::uint32_t packed{ packColor(color) };
+	const auto corner{ [&](int i) { return glm::vec3{ i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z }; } };
+	Vertex* out{ addLines(12, expiryAfter(duration)) };
+	for (const auto& edge : boxEdges)
+	{
+		*out++ = { corner(edge[0]), packed };
+		*out++ = { corner(edge[1]), packed };
+	}
+}
+
+void DebugDraw::box(const glm::mat4& transform, const glm::vec4& color, float duration)
+{
+	const std::uint32_t packed{ packColor(color) };
+	glm::vec3 corners[8]{};
+	for (int i{ 0 }; i < 8; ++i)
+	{
+		corners[i] = glm::vec3{ transform * glm::vec4{ i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f, 1.0f } };
+	}
+	Vertex* out{ addLines(12, expiryAfter(duration)) };
+	for (const auto& edge : boxEdges)
+	{
+		*out++ = { corners[edge[0]], packed };
+		*out++ = { corners[edge[1]], packed };
+	}
+}
+
+void DebugDraw::sphere(const glm::vec3& center, float radius, const glm::vec4& color, float duration)
+{
+	const std::uint32_t packed{ packColor(color) };
+	Vertex* out{ addLines(circleSegments * 3, expiryAfter(duration)) };
+	for (int i{ 0 }; i < circleSegments; ++i)
+	{
+		const glm::vec2 a{ circle[i] * radius };
+		const glm::vec2 b{ circle[(i + 1) % circleSegments] * radius };
+		*out++ = { center + glm::vec3{ a.x, a.y, 0.0f }, packed };
+		*out++ = { center + glm::vec3{ b.x, b.y, 0.0f }, packed };
+		*out++ = { center + glm::vec3{ a.x, 0.0f, a.y }, packed };
+		*out++ = { center + glm::vec3{ b.x, 0.0f, b.y }, packed };
+		*out++ = { center + glm::vec3{ 0.0f, a.x, a.y }, packed };
+		*out++ = { center + glm::vec3{ 0.0f, b.x, b.y }, packed };
+	}
+}
+
+void DebugDraw::arrow(const glm::vec3& from, const glm::vec3& to, const glm::vec4& color, float duration)
+{
+	const glm::vec3 shaft{ to - from };
+	const float length{ glm::length(shaft) };
+	if (length <= 0.0f)
+	{
+		return;
+	}
+
+	const std::uint32_t packed{ packColor(color) };
+	Vertex* out{ addLines(5, expiryAfter(duration)) };
+	*out++ = { from, packed };
+	*out++ = { to, packed };
+
+	// Four barbs a fifth of the shaft long, on two axes perpendicular to it
+	const glm::vec3 direction{ shaft / length };
+	const glm::vec3 helper{ std::abs(direction.y) < 0.9f ? glm::vec3{ 0.0f, 1.0f, 0.0f } : glm::vec3{ 1.0f, 0.0f, 0.0f } };
+	const glm::vec3 side{ glm::normalize(glm::cross(direction, helper)) };
+	const glm::vec3 up{ glm::cross(side, direction) };
+	const float barb{ length * 0.2f };
+	const glm::vec3 base{ to - direction * barb };
+	for (const glm::vec3& offset : { side, -side, up, -up })
+	{
+		*out++ = { to, packed };
+		*out++ = { base + offset * (barb * 0.5f), packed };
+	}
+}
+
+void DebugDraw::endFrame()
+{
+	m_frameVertices.clear();
+
+	// Compacts in place, keeping the order of the survivors
+	const Clock::time_point now{ Clock::now() };
+	std::size_t kept{ 0 };
+	for (std::size_t i{ 0 }; i < m_expiry.size(); ++i)
+	{
+		if (m_expiry[i] > now)
+		{
+			m_expiry[kept] = m_expiry[i];
+			m_timedVertices[kept * 2] = m_timedVertices[i * 2];
+			m_timedVertices[kept * 2 + 1] = m_timedVertices[i * 2 + 1];
+			++kept;
+		}
+	}
+	m_expiry.resize(kept);
+	m_timedVertices.resize(kept * 2);
+}
+
+DebugDraw::Clock::time_point DebugDraw::expiryAfter(float duration)
+{
+	if (duration <= 0.0f)
+	{
+		return {};
+	}
+	return Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>{ duration });
+}
+
+DebugDraw::Vertex* DebugDraw::addLines(std::size_t count, Clock::time_point expiry)
+{
+	std::vector<Vertex>& vertices{ expiry != Clock::time_point{} ? m_timedVertices : m_frameVertices };
+	if (&vertices == &m_timedVertices)
+	{
+		m_expiry.insert(m_expiry.end(), count, expiry);
+	}
+
+	const std::size_t first{ vertices.size() };
+	vertices.resize(first + count * 2);
+	return vertices.data() + first;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Immediate mode lines for visualising collision, navigation and the like. Everything is
+// turned into a line list on the CPU, which the renderer streams into one buffer and draws
+// in a single call on top of the scene. Shapes with a duration stay for that many seconds;
+// the rest are drawn by the next frame only. Not thread-safe: call from the main thread.
+class DebugDraw final
+{
+public:
+
+	struct Vertex
+	{
+		glm::vec3 position{};
+		// RGBA8, red in the lowest byte
+		std::uint32_t color{};
+	};
+
+	struct Stats
+	{
+		std::size_t lines{};
+		std::size_t timedLines{};
+	};
+
+	static constexpr glm::vec4 red{ 1.0f, 0.0f, 0.0f, 1.0f };
+
+	DebugDraw() = default;
+	DebugDraw(const DebugDraw&) = delete;
+	DebugDraw& operator=(const DebugDraw&) = delete;
+
+	void line(const glm::vec3& a, const glm::vec3& b, const glm::vec4& color = red, float duration = 0.0f);
+	void box(const glm::vec3& min, const glm::vec3& max, const glm::vec4& color = red, float duration = 0.0f);
+	// The [-1, 1] cube under transform, for oriented boxes
+	void box(const glm::mat4& transform, const glm::vec4& color = red, float duration = 0.0f);
+	// Three great circles
+	void sphere(const glm::vec3& center, float radius, const glm::vec4& color = red, float duration = 0.0f);
+	void arrow(const glm::vec3& from, const glm::vec3& to, const glm::vec4& color = red, float duration = 0.0f);
+
+	// This frame's lines, then the timed ones; both stay valid until endFrame
+	std::span<const Vertex> frameVertices() const { return m_frameVertices; }
+	std::span<const Vertex> timedVertices() const { return m_timedVertices; }
+
+	// Called by the renderer once the lines are drawn: forgets this frame's lines and the
+	// timed lines that have run out
+	void endFrame();
+
+	Stats stats() const { return { (m_frameVertices.size() + m_timedVertices.size()) / 2, m_timedVertices.size() / 2 }; }
+
+private:
+
+	using Clock = std::chrono::steady_clock;
+
+	// The default time point stands for this frame only
+	static Clock::time_point expiryAfter(float duration);
+	// Room for count lines, two vertices each, for the caller to fill in
+	Vertex* addLines(std::size_t count, Clock::time_point expiry);
+
+	// Capacity is kept between frames, so steady use does not allocate
+	std::vector<Vertex> m_frameVertices{};
+	std::vector<Vertex> m_timedVertices{};
+	// One per timed line
+	std::vector<Clock::time_point> m_expiry{};
+};
@@ -0,0 +1,278 @@
+#include "ecs.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace Ecs
+{
+
+	namespace
+	{
+
+		struct ComponentInfo
+		{
+			std::size_t size{};
+			std::size_t alignment{};
+		};
+
+		std::mutex registryMutex{};
+		std::vector<ComponentInfo> registry{};
+
+		ComponentInfo componentInfo(ComponentId component)
+		{
+			std::lock_guard lock{ registryMutex };
+			return registry[component];
+		}
+
+		std::size_t alignUp(std::size_t value, std::size_t alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+	}
+
+	ComponentId registerComponent(std::size_t size, std::size_t alignment)
+	{
+		std::lock_guard lock{ registryMutex };
+
+		if (registry.size() >= maxComponents)
+		{
+			std::cerr << "ECS, ERROR: More than " << maxComponents << " component types registered\n";
+			std::abort();
+		}
+
+		registry.push_back({ size, alignment });
+		return static_cast<ComponentId>(registry.size() - 1);
+	}
+
+	World::World()
+	{
+		archetypeFor(0);
+	}
+
+	World::~World()
+	{
+		for (const auto& archetype : m_archetypes)
+		{
+			for (const Chunk& chunk : archetype->chunks)
+			{
+				::operator delete(chunk.data, std::align_val_t{ m_chunkAlignment });
+			}
+		}
+	}
+
+	Entity World::create()
+	{
+		const Entity entity{ allocateEntity() };
+		place(entity, 0);
+		return entity;
+	}
+
+	void World::destroy(Entity entity)
+	{
+		if (!alive(entity))
+		{
+			return;
+		}
+
+		const Location location{ m_locations[entity.index] };
+		removeRow(location.archetype, location.row);
+
+		++m_generations[entity.index];
+		m_freeIndices.push_back(entity.index);
+		--m_liveCount;
+	}
+
+	bool World::alive(Entity entity) const
+	{
+		return entity.index < m_generations.size() && m_generations[entity.index] == entity.generation;
+	}
+
+	std::size_t World::chunkCount() const
+	{
+		std::size_t count{ 0 };
+		for (const auto& archetype : m_archetypes)
+		{
+			count += archetype->chunks.size();
+		}
+		return count;
+	}
+
+	Entity World::allocateEntity()
+	{
+		++m_liveCount;
+
+		if (!m_freeIndices.empty())
+		{
+			const std::uint32_t index{ m_freeIndices.back() };
+			m_freeIndices.pop_back();
+			return { index, m_generations[index] };
+		}
+
+		m_generations.push_back(0);
+		m_locations.emplace_back();
+		return { static_cast<std::uint32_t>(m_generations.size() - 1), 0 };
+	}
+
+	std::uint32_t World::archetypeFor(Signature signature)
+	{
+		const auto it{ m_archetypeLookup.find(signature) };
+		if (it != m_archetypeLookup.end())
+		{
+			return it->second;
+		}
+
+		auto archetype{ std::make_unique<Archetype>() };
+		archetype->signature = signature;
+
+		std::size_t rowBytes{ sizeof(Entity) };
+		std::size_t padding{ 0 };
+		for (ComponentId component{ 0 }; component < maxComponents; ++component)
+		{
+			if (signature & (Signature{ 1 } << component))
+			{
+				const ComponentInfo info{ componentInfo(component) };
+				archetype->components.push_back(component);
+				archetype->sizes[component] = static_cast<std::uint32_t>(info.size);
+
+				rowBytes += info.size;
+				padding += info.alignment;
+			}
+		}
+
+		// Oversized rows still get one entity per chunk
+		archetype->capacity = static_cast<std::uint32_t>(std::max<std::size_t>(1, (m_chunkBytes - std::min(padding, m_chunkBytes)) / rowBytes));
+
+		std::size_t offset{ sizeof(Entity) * archetype->capacity };
+		for (const ComponentId component : archetype->components)
+		{
+			offset = alignUp(offset, componentInfo(component).alignment);
+			archetype->offsets[component] = static_cast<std::uint32_t>(offset);
+			offset += archetype->sizes[component] * archetype->capacity;
+		}
+		archetype->chunkBytes = alignUp(std::max(offset, std::size_t{ 1 }), m_chunkAlignment);
+
+		const std::uint32_t index{ static_cast<std::uint32_t>(m_archetypes.size()) };
+		m_archetypes.push_back(std::move(archetype));
+		m_archetypeLookup.emplace(signature, index);
+
+		return index;
+	}
+
+	Signature World::signature(Entity entity) const
+	{
+		return m_archetypes[m_locations[entity.index].archetype]->signature;
+	}
+
+	void World::place(Entity entity, std::uint32_t archetypeIndex)
+	{
+		Archetype& archetype{ *m_archetypes[archetypeIndex] };
+
+		const std::uint32_t row{ archetype.count };
+		if (row / archetype.capacity >= archetype.chunks.size())
+		{
+			archetype.chunks.push_back({ static_cast<std::byte*>(::operator new(archetype.chunkBytes, std::align_val_t{ m_chunkAlignment })), 0 });
+		}
+
+		++archetype.chunks[row / archetype.capacity].count;
+		++archetype.count;
+
+		entityAt(archetype, row) = entity;
+		m_locations[entity.index] = { archetypeIndex, row };
+	}
+
+	void World::relocate(Entity entity, Signature signature)
+	{
+		if (!alive(entity))
+		{
+			std::cerr << "ECS, ERROR: Changing the components of a dead entity\n";
+			return;
+		}
+
+		const Location from{ m_locations[entity.index] };
+		if (m_archetypes[from.archetype]->signature == signature)
+		{
+			return;
+		}
+
+		// archetypeFor may grow m_archetypes, so look both up afterwards
+		const std::uint32_t target{ archetypeFor(signature) };
+		place(entity, target);
+
+		const Archetype& source{ *m_archetypes[from.archetype] };
+		const Archetype& destination{ *m_archetypes[target] };
+		const std::uint32_t row{ m_locations[entity.index].row };
+
+		for (const ComponentId component : source.components)
+		{
+			if (destination.signature & (Signature{ 1 } << component))
+			{
+				std::memcpy(componentAt(destination, row, component), componentAt(source, from.row, component), source.sizes[component]);
+			}
+		}
+
+		removeRow(from.archetype, from.row);
+	}
+
+	void World::removeRow(std::uint32_t archetypeIndex, std::uint32_t row)
+	{
+		Archetype& archetype{ *m_archetypes[archetypeIndex] };
+
+		const std::uint32_t last{ archetype.count - 1 };
+		if (row != last)
+		{
+			const Entity moved{ entityAt(archetype, last) };
+			entityAt(archetype, row) = moved;
+			for (const ComponentId component : archetype.components)
+			{
+				std::memcpy(componentAt(archetype, row, component), componentAt(archetype, last, component), archetype.sizes[component]);
+			}
+			m_locations[moved.index].row = row;
+		}
+
+		--archetype.chunks[last / archetype.capacity].count;
+		--archetype.count;
+
+		// One empty chunk is kept around so spawning and despawning across a boundary does not thrash
+		const std::size_t usedChunks{ (archetype.count + archetype.capacity - 1) / archetype.capacity };
+		while (archetype.chunks.size() > usedChunks + 1)
+		{
+			::operator delete(archetype.chunks.back().data, std::align_val_t{ m_chunkAlignment });
+			archetype.chunks.pop_back();
+		}
+	}
+
+	Entity& World::entityAt(const Archetype& archetype, std::uint32_t row)
+	{
+		const Chunk& chunk{ archetype.chunks[row / archetype.capacity] };
+		return reinterpret_cast<Entity*>(chunk.data)[row % archetype.capacity];
+	}
+
+	std::byte* World::componentAt(const Archetype& archetype, std::uint32_t row, ComponentId component)
+	{
+		const Chunk& chunk{ archetype.chunks[row / archetype.capacity] };
+		return chunk.data + archetype.offsets[component] + static_cast<std::size_t>(archetype.sizes[component]) * (row % archetype.capacity);
+	}
+
+	void* World::componentPointer(Entity entity, ComponentId component) const
+	{
+		const Location location{ m_locations[entity.index] };
+		return componentAt(*m_archetypes[location.archetype], location.row, component);
+	}
+
+	void World::write(Entity entity, ComponentId component, const void* data)
+	{
+		const Location location{ m_locations[entity.index] };
+		const Archetype& archetype{ *m_archetypes[location.archetype] };
+		std::memcpy(componentAt(archetype, location.row, component), data, archetype.sizes[component]);
+	}
+
+}
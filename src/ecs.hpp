@@ -0,0 +1,263 @@
+#pragma once
+
+#include "jobs.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Ecs
+{
+
+	// A destroyed entity's index is reused with a bumped generation, so stale handles fail alive()
+	struct Entity
+	{
+		std::uint32_t index{ 0xFFFFFFFF };
+		std::uint32_t generation{};
+
+		bool operator==(const Entity&) const = default;
+	};
+
+	inline constexpr Entity nullEntity{};
+
+	using ComponentId = std::uint32_t;
+	using Signature = std::uint64_t;
+
+	inline constexpr std::size_t maxComponents{ 64 };
+
+	ComponentId registerComponent(std::size_t size, std::size_t alignment);
+
+	// Components are relocated with memcpy between archetypes and never have destructors run
+	template <typename Component>
+	ComponentId registeredComponentId()
+	{
+		static_assert(std::is_trivially_copyable_v<Component> && std::is_trivially_destructible_v<Component>,
+			"ECS components must be trivially copyable and destructible");
+
+		static const ComponentId id{ registerComponent(sizeof(Component), alignof(Component)) };
+		return id;
+	}
+
+	// const T and T share an id, queries use const to mark read-only access
+	template <typename T>
+	ComponentId componentId()
+	{
+		return registeredComponentId<std::remove_cvref_t<T>>();
+	}
+
+	template <typename... Ts>
+	Signature signatureOf()
+	{
+		return (Signature{ 0 } | ... | (Signature{ 1 } << componentId<Ts>()));
+	}
+
+	// Entities with the same set of components share an archetype, which stores them in
+	// fixed size chunks with one tightly packed array per component. Queries walk those
+	// arrays linearly. Structural changes (create, destroy, add, remove) must not happen
+	// while a query on the same world is running.
+	class World final
+	{
+	public:
+
+		World();
+		World(const World&) = delete;
+		World& operator=(const World&) = delete;
+
+		~World();
+
+		Entity create();
+
+		template <typename... Ts>
+		Entity create(const Ts&... components)
+		{
+			const Entity entity{ allocateEntity() };
+			place(entity, archetypeFor(signatureOf<Ts...>()));
+			(write(entity, componentId<Ts>(), &components), ...);
+			return entity;
+		}
+
+		void destroy(Entity entity);
+		bool alive(Entity entity) const;
+
+		template <typename T>
+		void add(Entity entity, const T& component)
+		{
+			const ComponentId id{ componentId<T>() };
+			relocate(entity, signature(entity) | (Signature{ 1 } << id));
+			write(entity, id, &component);
+		}
+
+		template <typename T>
+		void remove(Entity entity)
+		{
+			relocate(entity, signature(entity) & ~(Signature{ 1 } << componentId<T>()));
+		}
+
+		template <typename T>
+		bool has(Entity entity) const
+		{
+			return alive(entity) && (signature(entity) & (Signature{ 1 } << componentId<T>()));
+		}
+
+		// nullptr when the entity is dead or lacks the component; invalidated by structural changes
+		template <typename T>
+		T* get(Entity entity)
+		{
+			return has<T>(entity) ? static_cast<T*>(componentPointer(entity, componentId<T>())) : nullptr;
+		}
+
+		// f(Entity, Ts&...) for every entity that has all of Ts
+		template <typename... Ts, typename F>
+		void each(F&& f)
+		{
+			const Signature required{ signatureOf<Ts...>() };
+			for (const auto& archetype : m_archetypes)
+			{
+				if ((archetype->signature & required) == required)
+				{
+					for (const Chunk& chunk : archetype->chunks)
+					{
+						eachInChunk<Ts...>(*archetype, chunk, f);
+					}
+				}
+			}
+		}
+
+		// f(count, const Entity*, Ts*...) once per chunk, for loops that want the raw arrays
+		template <typename... Ts, typename F>
+		void eachChunk(F&& f)
+		{
+			const Signature required{ signatureOf<Ts...>() };
+			for (const auto& archetype : m_archetypes)
+			{
+				if ((archetype->signature & required) == required)
+				{
+					for (const Chunk& chunk : archetype->chunks)
+					{
+						if (chunk.count != 0)
+						{
+							f(static_cast<std::size_t>(chunk.count), entities(chunk), column<Ts>(*archetype, chunk)...);
+						}
+					}
+				}
+			}
+		}
+
+		// Like each, with chunks spread over the job system; f runs concurrently on
+		// different entities. Not reentrant on the same world.
+		template <typename... Ts, typename F>
+		void parallelEach(JobSystem& jobs, F&& f)
+		{
+			const Signature required{ signatureOf<Ts...>() };
+
+			m_queryChunks.clear();
+			for (const auto& archetype : m_archetypes)
+			{
+				if ((archetype->signature & required) == required)
+				{
+					for (const Chunk& chunk : archetype->chunks)
+					{
+						if (chunk.count != 0)
+						{
+							m_queryChunks.emplace_back(archetype.get(), &chunk);
+						}
+					}
+				}
+			}
+
+			jobs.parallelFor(m_queryChunks.size(), 1, [&](std::size_t begin, std::size_t end)
+				{
+					for (std::size_t i{ begin }; i < end; ++i)
+					{
+						eachInChunk<Ts...>(*m_queryChunks[i].first, *m_queryChunks[i].second, f);
+					}
+				});
+		}
+
+		std::size_t entityCount() const { return m_liveCount; }
+		std::size_t archetypeCount() const { return m_archetypes.size(); }
+		std::size_t chunkCount() const;
+
+	private:
+
+		struct Chunk
+		{
+			std::byte* data{};
+			std::uint32_t count{};
+		};
+
+		struct Archetype
+		{
+			Signature signature{};
+			std::vector<ComponentId> components{};
+			// Byte offset of each component's array inside a chunk; entities sit at offset 0
+			std::array<std::uint32_t, maxComponents> offsets{};
+			std::array<std::uint32_t, maxComponents> sizes{};
+			std::uint32_t capacity{};
+			std::size_t chunkBytes{};
+
+			std::vector<Chunk> chunks{};
+			std::uint32_t count{};
+		};
+
+		struct Location
+		{
+			std::uint32_t archetype{};
+			std::uint32_t row{};
+		};
+
+		static constexpr std::size_t m_chunkBytes{ 16 * 1024 };
+		static constexpr std::size_t m_chunkAlignment{ 64 };
+
+		static const Entity* entities(const Chunk& chunk) { return reinterpret_cast<const Entity*>(chunk.data); }
+
+		template <typename T>
+		static T* column(const Archetype& archetype, const Chunk& chunk)
+		{
+			return reinterpret_cast<T*>(chunk.data + archetype.offsets[componentId<T>()]);
+		}
+
+		template <typename... Ts, typename F>
+		static void eachInChunk(const Archetype& archetype, const Chunk& chunk, F& f)
+		{
+			const Entity* chunkEntities{ entities(chunk) };
+			const std::tuple<Ts*...> columns{ column<Ts>(archetype, chunk)... };
+
+			for (std::uint32_t i{ 0 }; i < chunk.count; ++i)
+			{
+				std::apply([&](auto*... arrays) { f(chunkEntities[i], arrays[i]...); }, columns);
+			}
+		}
+
+		Entity allocateEntity();
+		std::uint32_t archetypeFor(Signature signature);
+
+		Signature signature(Entity entity) const;
+		void place(Entity entity, std::uint32_t archetype);
+		void relocate(Entity entity, Signature signature);
+		// Fills the hole with the archetype's last row, keeping every chunk but the last full
+		void removeRow(std::uint32_t archetype, std::uint32_t row);
+
+		static Entity& entityAt(const Archetype& archetype, std::uint32_t row);
+		static std::byte* componentAt(const Archetype& archetype, std::uint32_t row, ComponentId component);
+		void* componentPointer(Entity entity, ComponentId component) const;
+		void write(Entity entity, ComponentId component, const void* data);
+
+		std::vector<std::unique_ptr<Archetype>> m_archetypes{};
+		std::unordered_map<Signature, std::uint32_t> m_archetypeLookup{};
+
+		std::vector<std::uint32_t> m_generations{};
+		std::vector<Location> m_locations{};
+		std::vector<std::uint32_t> m_freeIndices{};
+		std::size_t m_liveCount{};
+
+		std::vector<std::pair<const Archetype*, const Chunk*>> m_queryChunks{};
+	};
+
+}
@@ -0,0 +1,217 @@
+#include "gl_state.hpp"
+
+#include "glad/glad.h"
+
+#include <iostream>
+
+void GLState::invalidate()
+{
+	m_framebuffer = m_unknown;
+	m_viewport = { -1, -1, -1, -1 };
+
+	m_capabilities.fill(-1);
+	m_polygonMode = m_unknown;
+	m_depthMask = -1;
+	m_blendFunc = { m_unknown, m_unknown };
+
+	m_program = m_unknown;
+
+	m_vertexArray = m_unknown;
+	// Keeps the map's nodes, since this runs every frame after ImGui
+	for (auto& [vertexArray, elementBuffer] : m_elementBuffers)
+	{
+		elementBuffer = m_unknown;
+	}
+	m_pixelPackBuffer = m_unknown;
+
+	m_textures.fill(m_unknown);
+}
+
+void GLState::bindFramebuffer(GLuint framebuffer)
+{
+	if (changed(m_framebuffer != framebuffer))
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		m_framebuffer = framebuffer;
+	}
+}
+
+void GLState::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	const std::array<GLint, 4> viewport{ x, y, width, height };
+	if (changed(m_viewport != viewport))
+	{
+		glViewport(x, y, width, height);
+		m_viewport = viewport;
+	}
+}
+
+void GLState::enable(GLenum capability)
+{
+	setCapability(capability, true);
+}
+
+void GLState::disable(GLenum capability)
+{
+	setCapability(capability, false);
+}
+
+void GLState::polygonMode(GLenum mode)
+{
+	if (changed(m_polygonMode != mode))
+	{
+		glPolygonMode(GL_FRONT_AND_BACK, mode);
+		m_polygonMode = mode;
+	}
+}
+
+void GLState::depthMask(GLboolean write)
+{
+	if (changed(m_depthMask != static_cast<int>(write)))
+	{
+		glDepthMask(write);
+		m_depthMask = write;
+	}
+}
+
+void GLState::blendFunc(GLenum source, GLenum destination)
+{
+	const std::array<GLenum, 2> blendFunc{ source, destination };
+	if (changed(m_blendFunc != blendFunc))
+	{
+		glBlendFunc(source, destination);
+		m_blendFunc = blendFunc;
+	}
+}
+
+void GLState::useProgram(GLuint program)
+{
+	if (changed(m_program != program))
+	{
+		glUseProgram(program);
+		m_program = program;
+	}
+}
+
+void GLState::bindVertexArray(GLuint vertexArray)
+{
+	if (changed(m_vertexArray != vertexArray))
+	{
+		glBindVertexArray(vertexArray);
+		m_vertexArray = vertexArray;
+	}
+}
+
+void GLState::bindElementBuffer(GLuint buffer)
+{
+	if (m_vertexArray == m_unknown || m_vertexArray == 0)
+	{
+		std::cerr << "ENGINE, ERROR, MEDIUM, GLState::bindElementBuffer called without a vertex array bound\n";
+		return;
+	}
+
+	auto [it, inserted]{ m_elementBuffers.try_emplace(m_vertexArray, m_unknown) };
+	if (changed(it->second != buffer))
+	{
+		glVertexArrayElementBuffer(m_vertexArray, buffer);
+		it->second = buffer;
+	}
+}
+
+void GLState::bindPixelPackBuffer(GLuint buffer)
+{
+	if (changed(m_pixelPackBuffer != buffer))
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+		m_pixelPackBuffer = buffer;
+	}
+}
+
+void GLState::bindTextureUnit(GLuint unit, GLuint texture)
+{
+	if (unit >= maxTextureUnits)
+	{
+		++m_stats.issued;
+		glBindTextureUnit(unit, texture);
+		return;
+	}
+
+	if (changed(m_textures[unit] != texture))
+	{
+		glBindTextureUnit(unit, texture);
+		m_textures[unit] = texture;
+	}
+}
+
+void GLState::forgetFramebuffer(GLuint framebuffer)
+{
+	if (m_framebuffer == framebuffer)
+	{
+		m_framebuffer = m_unknown;
+	}
+}
+
+void GLState::forgetVertexArray(GLuint vertexArray)
+{
+	m_elementBuffers.erase(vertexArray);
+	if (m_vertexArray == vertexArray)
+	{
+		m_vertexArray = m_unknown;
+	}
+}
+
+void GLState::forgetBuffer(GLuint buffer)
+{
+	for (auto& [vertexArray, elementBuffer] : m_elementBuffers)
+	{
+		if (elementBuffer == buffer)
+		{
+			elementBuffer = m_unknown;
+		}
+	}
+	if (m_pixelPackBuffer == buffer)
+	{
+		m_pixelPackBuffer = m_unknown;
+	}
+}
+
+void GLState::forgetTexture(GLuint texture)
+{
+	for (auto& unitTexture : m_textures)
+	{
+		if (unitTexture == texture)
+		{
+			unitTexture = m_unknown;
+		}
+	}
+}
+
+int GLState::capabilityIndex(GLenum capability)
+{
+	switch (capability)
+	{
+	case GL_DEPTH_TEST: return DEPTH_TEST;
+	case GL_CULL_FACE: return CULL_FACE;
+	case GL_MULTISAMPLE: return MULTISAMPLE;
+	case GL_BLEND: return BLEND;
+	default: return -1;
+	}
+}
+
+void GLState::setCapability(GLenum capability, bool enabled)
+{
+	const int index{ capabilityIndex(capability) };
+	if (index == -1)
+	{
+		// Untracked capabilities always go through
+		++m_stats.issued;
+		enabled ? glEnable(capability) : glDisable(capability);
+		return;
+	}
+
+	if (changed(m_capabilities[index] != static_cast<int>(enabled)))
+	{
+		enabled ? glEnable(capability) : glDisable(capability);
+		m_capabilities[index] = enabled;
+	}
+}
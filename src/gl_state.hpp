@@ -0,0 +1,109 @@
+#pragma once
+
+#include "glad/glad.h"
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+
+// Shadows the bits of OpenGL state the renderer touches so redundant binds and
+// toggles never reach the driver. Object creation and uploads go through DSA
+// and do not need the cache.
+class GLState final
+{
+public:
+
+	GLState() { invalidate(); }
+	GLState(const GLState&) = delete;
+	GLState& operator=(const GLState&) = delete;
+
+	struct Stats
+	{
+		std::uint64_t issued{};
+		std::uint64_t skipped{};
+	};
+
+	// Forget everything; call after code outside the renderer changed GL state
+	void invalidate();
+
+	void bindFramebuffer(GLuint framebuffer);
+	void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+	void enable(GLenum capability);
+	void disable(GLenum capability);
+	void polygonMode(GLenum mode);
+	void depthMask(GLboolean write);
+	void blendFunc(GLenum source, GLenum destination);
+
+	void useProgram(GLuint program);
+
+	void bindVertexArray(GLuint vertexArray);
+	void bindElementBuffer(GLuint buffer);
+	void bindPixelPackBuffer(GLuint buffer);
+
+	void bindTextureUnit(GLuint unit, GLuint texture);
+
+	// Call before deleting an object so a recycled name is not mistaken for a live binding
+	void forgetFramebuffer(GLuint framebuffer);
+	void forgetVertexArray(GLuint vertexArray);
+	void forgetBuffer(GLuint buffer);
+	void forgetTexture(GLuint texture);
+
+	void resetStats() { m_stats = {}; }
+	const Stats& stats() const { return m_stats; }
+
+	static constexpr GLuint maxTextureUnits{ 16 };
+
+private:
+
+	enum Capability
+	{
+		DEPTH_TEST,
+		CULL_FACE,
+		MULTISAMPLE,
+		BLEND,
+		CAPABILITY_COUNT,
+	};
+
+	static int capabilityIndex(GLenum capability);
+
+	void setCapability(GLenum capability, bool enabled);
+
+	bool changed(bool different)
+	{
+		if (different)
+		{
+			++m_stats.issued;
+		}
+		else
+		{
+			++m_stats.skipped;
+		}
+
+		return different;
+	}
+
+	// Sentinel that no real GL object name or enum takes
+	static constexpr GLuint m_unknown{ 0xFFFFFFFFu };
+
+	GLuint m_framebuffer{};
+	std::array<GLint, 4> m_viewport{};
+
+	// -1 unknown, 0 disabled, 1 enabled
+	std::array<int, CAPABILITY_COUNT> m_capabilities{};
+	GLenum m_polygonMode{};
+	// -1 unknown, otherwise the GLboolean last set
+	int m_depthMask{};
+	std::array<GLenum, 2> m_blendFunc{};
+
+	GLuint m_program{};
+
+	GLuint m_vertexArray{};
+	// Element buffer binding is vertex array state, so it is tracked per vertex array
+	std::unordered_map<GLuint, GLuint> m_elementBuffers{};
+	GLuint m_pixelPackBuffer{};
+
+	std::array<GLuint, maxTextureUnits> m_textures{};
+
+	Stats m_stats{};
+};
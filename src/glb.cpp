@@ -0,0 +1,819 @@
+#include "glb.hpp"
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/quaternion.hpp"
+#include "glm/gtx/matrix_decompose.hpp"
+#include "glm/gtx/quaternion.hpp"
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory_resource>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+	constexpr std::uint32_t glbMagic{ 0x46546C67 };
+	constexpr std::uint32_t jsonChunk{ 0x4E4F534A };
+	constexpr std::uint32_t binChunk{ 0x004E4942 };
+
+	// Pull parser over the JSON chunk. Nothing is built for values nobody asks for: each key
+	// callback either reads its value or skips it, so extras, cameras and the like cost one
+	// pass over their characters. Strings come back as views of the raw bytes,
+	// escapes included, which is enough for glTF's keys and enums.
+	class JsonReader final
+	{
+	public:
+
+		explicit JsonReader(std::span<const unsigned char> json)
+			: m_at{ reinterpret_cast<const char*>(json.data()) }, m_end{ reinterpret_cast<const char*>(json.data() + json.size()) }
+		{
+		}
+
+		template<typename Visit>
+		void object(Visit&& visit)
+		{
+			expect('{');
+			if (consume('}'))
+			{
+				return;
+			}
+			do
+			{
+				const std::string_view key{ string() };
+				expect(':');
+				visit(key);
+			} while (consume(','));
+			expect('}');
+		}
+
+		template<typename Visit>
+		void array(Visit&& visit)
+		{
+			expect('[');
+			if (consume(']'))
+			{
+				return;
+			}
+			do
+			{
+				visit();
+			} while (consume(','));
+			expect(']');
+		}
+
+		std::string_view string()
+		{
+			expect('"');
+			const char* start{ m_at };
+			while (m_at < m_end && *m_at != '"')
+			{
+				m_at += *m_at == '\\' ? 2 : 1;
+			}
+			if (m_at >= m_end)
+			{
+				fail("unterminated string");
+			}
+			return { start, static_cast<std::size_t>(m_at++ - start) };
+		}
+
+		double number()
+		{
+			skipSpace();
+			double value{};
+			const auto [end, error] { std::from_chars(m_at, m_end, value) };
+			if (error != std::errc{})
+			{
+				fail("expected a number");
+			}
+			m_at = end;
+			return value;
+		}
+
+		// Indices and sizes; anything negative or fractional is malformed
+		std::size_t count()
+		{
+			const double value{ number() };
+			if (value < 0.0 || value != static_cast<double>(static_cast<std::size_t>(value)))
+			{
+				fail("expected a non-negative integer");
+			}
+			return static_cast<std::size_t>(value);
+		}
+
+		int index()
+		{
+			const std::size_t value{ count() };
+			if (value > static_cast<std::size_t>(std::numeric_limits<int>::max()))
+			{
+				fail("index out of range");
+			}
+			return static_cast<int>(value);
+		}
+
+		template<std::size_t size>
+		void numbers(float (&values)[size])
+		{
+			std::size_t i{ 0 };
+			array([&]()
+				{
+					const float value{ static_cast<float>(number()) };
+					if (i < size)
+					{
+						values[i++] = value;
+					}
+				});
+			if (i != size)
+			{
+				fail("wrong number of components");
+			}
+		}
+
+		void skip()
+		{
+			skipSpace();
+			if (m_at >= m_end)
+			{
+				fail("unexpected end");
+			}
+
+			switch (*m_at)
+			{
+			case '{': object([this](std::string_view) { skip(); }); break;
+			case '[': array([this]() { skip(); }); break;
+			case '"': string(); break;
+			case 't': literal("true"); break;
+			case 'f': literal("false"); break;
+			case 'n': literal("null"); break;
+			default: number(); break;
+			}
+		}
+
+		[[noreturn]] void fail(const char* what) const
+		{
+			throw std::out_of_range{ std::string{ what } + " in JSON chunk" };
+		}
+
+	private:
+
+		void skipSpace()
+		{
+			while (m_at < m_end && (*m_at == ' ' || *m_at == '\n' || *m_at == '\r' || *m_at == '\t'))
+			{
+				++m_at;
+			}
+		}
+
+		bool consume(char c)
+		{
+			skipSpace();
+			if (m_at < m_end && *m_at == c)
+			{
+				++m_at;
+				return true;
+			}
+			return false;
+		}
+
+		void expect(char c)
+		{
+			if (!consume(c))
+			{
+				fail("unexpected character");
+			}
+		}
+
+		void literal(std::string_view text)
+		{
+			if (static_cast<std::size_t>(m_end - m_at) < text.size() || std::string_view{ m_at, text.size() } != text)
+			{
+				fail("unexpected literal");
+			}
+			m_at += text.size();
+		}
+
+		const char* m_at{};
+		const char* m_end{};
+	};
+
+	struct BufferView
+	{
+		std::size_t offset{};
+		std::size_t length{};
+		std::size_t stride{};
+		int buffer{ 0 };
+	};
+
+	// As written in the JSON; checked and resolved once every array has been read, since the
+	// top level keys can come in any order
+	struct RawAccessor
+	{
+		int view{ -1 };
+		std::size_t offset{};
+		std::size_t count{};
+		int componentType{};
+		int components{};
+	};
+
+	struct RawMaterial
+	{
+		glm::vec3 color{ 1.0f };
+		int texture{ -1 };
+	};
+
+	std::uint32_t readU32(std::span<const unsigned char> bytes, std::size_t offset)
+	{
+		if (offset + 4 > bytes.size())
+		{
+			throw std::out_of_range{ "truncated header" };
+		}
+
+		std::uint32_t value{};
+		std::memcpy(&value, bytes.data() + offset, 4);
+		return value;
+	}
+
+	void checkIndex(int index, std::size_t count, const char* what)
+	{
+		if (index != -1 && static_cast<std::size_t>(index) >= count)
+		{
+			throw std::out_of_range{ std::string{ what } + " index " + std::to_string(index) + " out of range" };
+		}
+	}
+
+	int componentCount(std::string_view type)
+	{
+		if (type == "SCALAR") return 1;
+		if (type == "VEC2") return 2;
+		if (type == "VEC3") return 3;
+		if (type == "VEC4") return 4;
+		if (type == "MAT4") return 16;
+		throw std::out_of_range{ "unsupported accessor type " + std::string{ type } };
+	}
+
+	std::size_t componentSize(int componentType)
+	{
+		switch (componentType)
+		{
+		case 5120: case 5121: return 1;
+		case 5122: case 5123: return 2;
+		case 5125: case 5126: return 4;
+		}
+		throw std::out_of_range{ "unsupported component type " + std::to_string(componentType) };
+	}
+
+	Glb::Node readNode(JsonReader& reader, std::pmr::memory_resource* memory)
+	{
+		Glb::Node node{ .children{ std::pmr::vector<int>{ memory } } };
+
+		bool hasMatrix{ false };
+		float matrix[16]{};
+		float translation[3]{ 0.0f, 0.0f, 0.0f };
+		float rotation[4]{ 0.0f, 0.0f, 0.0f, 1.0f };
+		float scale[3]{ 1.0f, 1.0f, 1.0f };
+
+		reader.object([&](std::string_view key)
+			{
+				if (key == "mesh") node.mesh = reader.index();
+				else if (key == "skin") node.skin = reader.index();
+				else if (key == "children") reader.array([&]() { node.children.push_back(reader.index()); });
+				else if (key == "matrix") { reader.numbers(matrix); hasMatrix = true; }
+				else if (key == "translation") reader.numbers(translation);
+				else if (key == "rotation") reader.numbers(rotation);
+				else if (key == "scale") reader.numbers(scale);
+				else reader.skip();
+			});
+
+		if (hasMatrix)
+		{
+			// Column major, as glm stores it
+			for (int i{ 0 }; i < 16; ++i)
+			{
+				node.transform[i / 4][i % 4] = matrix[i];
+			}
+
+			glm::vec3 skew{};
+			glm::vec4 perspective{};
+			glm::decompose(node.transform, node.scale, node.rotation, node.translation, skew, perspective);
+		}
+		else
+		{
+			// glTF stores XYZW, glm quaternions are constructed WXYZ
+			node.translation = { translation[0], translation[1], translation[2] };
+			node.rotation = glm::quat{ rotation[3], rotation[0], rotation[1], rotation[2] };
+			node.scale = { scale[0], scale[1], scale[2] };
+			node.transform = glm::translate(glm::mat4{ 1.0f }, node.translation);
+			node.transform *= glm::toMat4(node.rotation);
+			node.transform = glm::scale(node.transform, node.scale);
+		}
+
+		return node;
+	}
+
+	Glb::Mesh readMesh(JsonReader& reader, std::pmr::memory_resource* memory)
+	{
+		Glb::Mesh mesh{ .primitives{ std::pmr::vector<Glb::Primitive>{ memory } } };
+		reader.object([&](std::string_view key)
+			{
+				if (key != "primitives")
+				{
+					reader.skip();
+					return;
+				}
+
+				reader.array([&]()
+					{
+						Glb::Primitive& primitive{ mesh.primitives.emplace_back() };
+						reader.object([&](std::string_view key)
+							{
+								if (key == "indices") primitive.indices = reader.index();
+								else if (key == "material") primitive.material = reader.index();
+								else if (key == "attributes")
+								{
+									reader.object([&](std::string_view attribute)
+										{
+											if (attribute == "POSITION") primitive.position = reader.index();
+											else if (attribute == "NORMAL") primitive.normal = reader.index();
+											else if (attribute == "TEXCOORD_0") primitive.texCoord = reader.index();
+											else if (attribute == "JOINTS_0") primitive.joints = reader.index();
+											else if (attribute == "WEIGHTS_0") primitive.weights = reader.index();
+											else reader.skip();
+										});
+								}
+								else reader.skip();
+							});
+					});
+			});
+		return mesh;
+	}
+
+	Glb::Skin readSkin(JsonReader& reader, std::pmr::memory_resource* memory)
+	{
+		Glb::Skin skin{ .joints{ std::pmr::vector<int>{ memory } } };
+		reader.object([&](std::string_view key)
+			{
+				if (key == "joints") reader.array([&]() { skin.joints.push_back(reader.index()); });
+				else if (key == "inverseBindMatrices") skin.inverseBindMatrices = reader.index();
+				else reader.skip();
+			});
+		return skin;
+	}
+
+	Glb::Animation readAnimation(JsonReader& reader, std::pmr::memory_resource* memory)
+	{
+		Glb::Animation animation
+		{
+			.samplers{ std::pmr::vector<Glb::AnimationSampler>{ memory } },
+			.channels{ std::pmr::vector<Glb::AnimationChannel>{ memory } },
+		};
+		reader.object([&](std::string_view key)
+			{
+				if (key == "name")
+				{
+					animation.name = reader.string();
+				}
+				else if (key == "samplers")
+				{
+					reader.array([&]()
+						{
+							Glb::AnimationSampler& sampler{ animation.samplers.emplace_back() };
+							reader.object([&](std::string_view key)
+								{
+									if (key == "input") sampler.input = reader.index();
+									else if (key == "output") sampler.output = reader.index();
+									else if (key == "interpolation")
+									{
+										const std::string_view interpolation{ reader.string() };
+										if (interpolation == "STEP") sampler.interpolation = Glb::Interpolation::step;
+										else if (interpolation == "CUBICSPLINE") sampler.interpolation = Glb::Interpolation::cubicSpline;
+										else if (interpolation == "LINEAR") sampler.interpolation = Glb::Interpolation::linear;
+										else reader.fail("unknown interpolation");
+									}
+									else reader.skip();
+								});
+						});
+				}
+				else if (key == "channels")
+				{
+					reader.array([&]()
+						{
+							Glb::AnimationChannel& channel{ animation.channels.emplace_back() };
+							reader.object([&](std::string_view key)
+								{
+									if (key == "sampler")
+									{
+										channel.sampler = reader.index();
+									}
+									else if (key == "target")
+									{
+										reader.object([&](std::string_view key)
+											{
+												if (key == "node") channel.node = reader.index();
+												else if (key == "path")
+												{
+													const std::string_view path{ reader.string() };
+													if (path == "translation") channel.path = Glb::AnimationPath::translation;
+													else if (path == "rotation") channel.path = Glb::AnimationPath::rotation;
+													else if (path == "scale") channel.path = Glb::AnimationPath::scale;
+													else if (path == "weights") channel.path = Glb::AnimationPath::weights;
+													else reader.fail("unknown animation path");
+												}
+												else reader.skip();
+											});
+									}
+									else reader.skip();
+								});
+						});
+				}
+				else reader.skip();
+			});
+		return animation;
+	}
+
+	RawMaterial readMaterial(JsonReader& reader)
+	{
+		RawMaterial material{};
+		reader.object([&](std::string_view key)
+			{
+				if (key != "pbrMetallicRoughness")
+				{
+					reader.skip();
+					return;
+				}
+
+				reader.object([&](std::string_view key)
+					{
+						if (key == "baseColorFactor")
+						{
+							float factor[4]{};
+							reader.numbers(factor);
+							material.color = { factor[0], factor[1], factor[2] };
+						}
+						else if (key == "baseColorTexture")
+						{
+							reader.object([&](std::string_view key)
+								{
+									if (key == "index") material.texture = reader.index();
+									else reader.skip();
+								});
+						}
+						else reader.skip();
+					});
+			});
+		return material;
+	}
+
+	Glb::Document parseChunks(std::span<const unsigned char> bytes, std::pmr::memory_resource* memory)
+	{
+		if (readU32(bytes, 0) != glbMagic || readU32(bytes, 4) != 2)
+		{
+			throw std::out_of_range{ "not a version 2 GLB file" };
+		}
+
+		std::span<const unsigned char> json{};
+		std::span<const unsigned char> bin{};
+		for (std::size_t offset{ 12 }; offset + 8 <= bytes.size();)
+		{
+			const std::size_t length{ readU32(bytes, offset) };
+			const std::uint32_t type{ readU32(bytes, offset + 4) };
+			if (offset + 8 + length > bytes.size())
+			{
+				throw std::out_of_range{ "truncated chunk" };
+			}
+
+			if (type == jsonChunk && json.empty())
+			{
+				json = bytes.subspan(offset + 8, length);
+			}
+			else if (type == binChunk && bin.empty())
+			{
+				bin = bytes.subspan(offset + 8, length);
+			}
+			offset += 8 + length;
+		}
+
+		Glb::Document document
+		{
+			.accessors{ std::pmr::vector<Glb::Accessor>{ memory } },
+			.meshes{ std::pmr::vector<Glb::Mesh>{ memory } },
+			.nodes{ std::pmr::vector<Glb::Node>{ memory } },
+			.materials{ std::pmr::vector<Glb::Material>{ memory } },
+			.skins{ std::pmr::vector<Glb::Skin>{ memory } },
+			.animations{ std::pmr::vector<Glb::Animation>{ memory } },
+			.images{ std::pmr::vector<std::span<const unsigned char>>{ memory } },
+			.roots{ std::pmr::vector<int>{ memory } },
+		};
+
+		std::pmr::vector<BufferView> views{ memory };
+		std::pmr::vector<RawAccessor> accessors{ memory };
+		std::pmr::vector<RawMaterial> materials{ memory };
+		std::pmr::vector<int> textureImages{ memory };
+		std::pmr::vector<int> imageViews{ memory };
+
+		JsonReader reader{ json };
+		reader.object([&](std::string_view key)
+			{
+				if (key == "scenes")
+				{
+					reader.array([&]()
+						{
+							reader.object([&](std::string_view key)
+								{
+									if (key == "nodes") reader.array([&]() { document.roots.push_back(reader.index()); });
+									else reader.skip();
+								});
+						});
+				}
+				else if (key == "nodes")
+				{
+					reader.array([&]() { document.nodes.push_back(readNode(reader, memory)); });
+				}
+				else if (key == "meshes")
+				{
+					reader.array([&]() { document.meshes.push_back(readMesh(reader, memory)); });
+				}
+				else if (key == "materials")
+				{
+					reader.array([&]() { materials.push_back(readMaterial(reader)); });
+				}
+				else if (key == "skins")
+				{
+					reader.array([&]() { document.skins.push_back(readSkin(reader, memory)); });
+				}
+				else if (key == "animations")
+				{
+					reader.array([&]() { document.animations.push_back(readAnimation(reader, memory)); });
+				}
+				else if (key == "accessors")
+				{
+					reader.array([&]()
+						{
+							RawAccessor& accessor{ accessors.emplace_back() };
+							reader.object([&](std::string_view key)
+								{
+									if (key == "bufferView") accessor.view = reader.index();
+									else if (key == "byteOffset") accessor.offset = reader.count();
+									else if (key == "count") accessor.count = reader.count();
+									else if (key == "componentType") accessor.componentType = reader.index();
+									else if (key == "type") accessor.components = componentCount(reader.string());
+									else if (key == "sparse") reader.fail("sparse accessors are not supported");
+									else reader.skip();
+								});
+						});
+				}
+				else if (key == "bufferViews")
+				{
+					reader.array([&]()
+						{
+							BufferView& view{ views.emplace_back() };
+							reader.object([&](std::string_view key)
+								{
+									if (key == "buffer") view.buffer = reader.index();
+									else if (key == "byteOffset") view.offset = reader.count();
+									else if (key == "byteLength") view.length = reader.count();
+									else if (key == "byteStride") view.stride = reader.count();
+									else reader.skip();
+								});
+						});
+				}
+				else if (key == "buffers")
+				{
+					// Only the embedded buffer is supported; it is the BIN chunk
+					reader.array([&]()
+						{
+							reader.object([&](std::string_view key)
+								{
+									if (key == "uri") reader.fail("external buffers are not supported");
+									reader.skip();
+								});
+						});
+				}
+				else if (key == "textures")
+				{
+					reader.array([&]()
+						{
+							int& image{ textureImages.emplace_back(-1) };
+							reader.object([&](std::string_view key)
+								{
+									if (key == "source") image = reader.index();
+									else reader.skip();
+								});
+						});
+				}
+				else if (key == "images")
+				{
+					reader.array([&]()
+						{
+							int& view{ imageViews.emplace_back(-1) };
+							reader.object([&](std::string_view key)
+								{
+									if (key == "bufferView") view = reader.index();
+									else if (key == "uri") reader.fail("images outside the GLB are not supported");
+									else reader.skip();
+								});
+						});
+				}
+				else
+				{
+					reader.skip();
+				}
+			});
+
+		for (const BufferView& view : views)
+		{
+			if (view.buffer != 0 || view.offset > bin.size() || view.length > bin.size() - view.offset)
+			{
+				throw std::out_of_range{ "buffer view outside the BIN chunk" };
+			}
+		}
+
+		for (const RawAccessor& raw : accessors)
+		{
+			if (raw.components == 0)
+			{
+				throw std::out_of_range{ "accessor without a type" };
+			}
+
+			Glb::Accessor accessor{ .count{ raw.count }, .componentType{ raw.componentType }, .components{ raw.components } };
+
+			const std::size_t elementSize{ componentSize(raw.componentType) * static_cast<std::size_t>(raw.components) };
+			accessor.stride = elementSize;
+
+			// Accessors without a view are all zeros, which no loaded attribute relies on
+			checkIndex(raw.view, views.size(), "buffer view");
+			if (raw.view != -1 && raw.count > 0)
+			{
+				const BufferView& view{ views[raw.view] };
+				accessor.stride = view.stride ? view.stride : elementSize;
+				// Divides rather than multiplies, so huge counts cannot wrap around and pass
+				if (raw.offset > view.length || elementSize > view.length - raw.offset
+					|| raw.count - 1 > (view.length - raw.offset - elementSize) / accessor.stride)
+				{
+					throw std::out_of_range{ "accessor overruns its buffer view" };
+				}
+				accessor.data = bin.data() + view.offset + raw.offset;
+			}
+
+			document.accessors.push_back(accessor);
+		}
+
+		for (const int view : imageViews)
+		{
+			if (view == -1)
+			{
+				throw std::out_of_range{ "image without a buffer view" };
+			}
+			checkIndex(view, views.size(), "buffer view");
+			document.images.push_back(bin.subspan(views[view].offset, views[view].length));
+		}
+
+		for (const int image : textureImages)
+		{
+			checkIndex(image, document.images.size(), "image");
+		}
+
+		for (const RawMaterial& raw : materials)
+		{
+			checkIndex(raw.texture, textureImages.size(), "texture");
+			document.materials.push_back({ raw.color, raw.texture != -1 ? textureImages[raw.texture] : -1 });
+		}
+
+		for (const Glb::Mesh& mesh : document.meshes)
+		{
+			for (const Glb::Primitive& primitive : mesh.primitives)
+			{
+				for (const int accessor : { primitive.indices, primitive.position, primitive.normal, primitive.texCoord, primitive.joints, primitive.weights })
+				{
+					checkIndex(accessor, document.accessors.size(), "accessor");
+				}
+				checkIndex(primitive.material, document.materials.size(), "material");
+			}
+		}
+
+		for (const Glb::Skin& skin : document.skins)
+		{
+			checkIndex(skin.inverseBindMatrices, document.accessors.size(), "accessor");
+			for (const int joint : skin.joints)
+			{
+				checkIndex(joint, document.nodes.size(), "node");
+			}
+		}
+
+		for (const Glb::Animation& animation : document.animations)
+		{
+			for (const Glb::AnimationSampler& sampler : animation.samplers)
+			{
+				if (sampler.input == -1 || sampler.output == -1)
+				{
+					throw std::out_of_range{ "animation sampler without input or output" };
+				}
+				checkIndex(sampler.input, document.accessors.size(), "accessor");
+				checkIndex(sampler.output, document.accessors.size(), "accessor");
+			}
+			for (const Glb::AnimationChannel& channel : animation.channels)
+			{
+				if (channel.sampler == -1)
+				{
+					throw std::out_of_range{ "animation channel without a sampler" };
+				}
+				checkIndex(channel.sampler, animation.samplers.size(), "animation sampler");
+				checkIndex(channel.node, document.nodes.size(), "node");
+			}
+		}
+
+		for (const Glb::Node& node : document.nodes)
+		{
+			checkIndex(node.mesh, document.meshes.size(), "mesh");
+			checkIndex(node.skin, document.skins.size(), "skin");
+			for (const int child : node.children)
+			{
+				checkIndex(child, document.nodes.size(), "node");
+			}
+		}
+
+		for (const int root : document.roots)
+		{
+			checkIndex(root, document.nodes.size(), "node");
+		}
+
+		// Node hierarchies are walked recursively, so a node must not be its own ancestor.
+		// Depth first from every node, without recursion so deep files cannot overflow here.
+		enum class Mark : std::uint8_t { unvisited, onPath, done };
+		std::pmr::vector<Mark> marks(document.nodes.size(), Mark::unvisited, memory);
+		std::pmr::vector<std::pair<int, std::size_t>> path{ memory };
+		for (std::size_t start{ 0 }; start < document.nodes.size(); ++start)
+		{
+			if (marks[start] != Mark::unvisited)
+			{
+				continue;
+			}
+
+			marks[start] = Mark::onPath;
+			path.push_back({ static_cast<int>(start), 0 });
+			while (!path.empty())
+			{
+				auto& [node, next] { path.back() };
+				const std::pmr::vector<int>& children{ document.nodes[node].children };
+				if (next == children.size())
+				{
+					marks[node] = Mark::done;
+					path.pop_back();
+					continue;
+				}
+
+				const int child{ children[next++] };
+				if (marks[child] == Mark::onPath)
+				{
+					throw std::out_of_range{ "node " + std::to_string(child) + " is its own ancestor" };
+				}
+				if (marks[child] == Mark::unvisited)
+				{
+					marks[child] = Mark::onPath;
+					path.push_back({ child, 0 });
+				}
+			}
+		}
+
+		return document;
+	}
+
+}
+
+namespace Glb
+{
+
+	Document parse(std::span<const unsigned char> bytes, std::string_view name, std::pmr::memory_resource* memory)
+	{
+		try
+		{
+			return parseChunks(bytes, memory);
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "MODEL LOADER, ERROR: " << name << ": " << e.what() << '\n';
+		}
+
+		return Document
+		{
+			.accessors{ std::pmr::vector<Accessor>{ memory } },
+			.meshes{ std::pmr::vector<Mesh>{ memory } },
+			.nodes{ std::pmr::vector<Node>{ memory } },
+			.materials{ std::pmr::vector<Material>{ memory } },
+			.skins{ std::pmr::vector<Skin>{ memory } },
+			.animations{ std::pmr::vector<Animation>{ memory } },
+			.images{ std::pmr::vector<std::span<const unsigned char>>{ memory } },
+			.roots{ std::pmr::vector<int>{ memory } },
+		};
+	}
+
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+#include <cstddef>
+#include <memory_resource>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// Reader for binary glTF covering what the model loader needs: the node tree, mesh
+// primitives with their accessors, base colors and base color images, skins and animations.
+// Accessors and images point straight into the BIN chunk of the bytes passed to parse, which
+// have to outlive the document; images stay encoded until someone decodes them.
+namespace Glb
+{
+
+	enum ComponentType
+	{
+		unsignedByte = 5121,
+		unsignedShort = 5123,
+		unsignedInt = 5125,
+		float32 = 5126,
+	};
+
+	struct Accessor
+	{
+		const unsigned char* data{};
+		std::size_t count{};
+		// Bytes between elements, never 0
+		std::size_t stride{};
+		int componentType{};
+		int components{};
+	};
+
+	// -1 for anything absent
+	struct Primitive
+	{
+		int indices{ -1 };
+		int position{ -1 };
+		int normal{ -1 };
+		int texCoord{ -1 };
+		int joints{ -1 };
+		int weights{ -1 };
+		int material{ -1 };
+	};
+
+	struct Mesh
+	{
+		std::pmr::vector<Primitive> primitives{};
+	};
+
+	struct Node
+	{
+		glm::mat4 transform{ 1.0f };
+		// The same transform split up, as animations replace its parts; matrices are decomposed
+		glm::vec3 translation{ 0.0f };
+		glm::quat rotation{ 1.0f, 0.0f, 0.0f, 0.0f };
+		glm::vec3 scale{ 1.0f };
+		int mesh{ -1 };
+		int skin{ -1 };
+		std::pmr::vector<int> children{};
+	};
+
+	struct Skin
+	{
+		std::pmr::vector<int> joints{};
+		// MAT4 floats, one per joint; -1 means identities
+		int inverseBindMatrices{ -1 };
+	};
+
+	enum class Interpolation
+	{
+		step,
+		linear,
+		// Each output holds an in tangent, the value and an out tangent
+		cubicSpline,
+	};
+
+	enum class AnimationPath
+	{
+		translation,
+		rotation,
+		scale,
+		weights,
+	};
+
+	struct AnimationSampler
+	{
+		int input{ -1 };
+		int output{ -1 };
+		Interpolation interpolation{ Interpolation::linear };
+	};
+
+	struct AnimationChannel
+	{
+		int sampler{ -1 };
+		// -1 when the channel targets no node
+		int node{ -1 };
+		AnimationPath path{ AnimationPath::translation };
+	};
+
+	struct Animation
+	{
+		// Raw JSON string contents, pointing into the bytes like the accessors
+		std::string_view name{};
+		std::pmr::vector<AnimationSampler> samplers{};
+		std::pmr::vector<AnimationChannel> channels{};
+	};
+
+	struct Material
+	{
+		glm::vec3 color{ 1.0f };
+		// Index into images, already resolved through the texture
+		int baseColorImage{ -1 };
+	};
+
+	struct Document
+	{
+		std::pmr::vector<Accessor> accessors{};
+		std::pmr::vector<Mesh> meshes{};
+		std::pmr::vector<Node> nodes{};
+		std::pmr::vector<Material> materials{};
+		std::pmr::vector<Skin> skins{};
+		std::pmr::vector<Animation> animations{};
+		// Encoded PNG or JPEG bytes
+		std::pmr::vector<std::span<const unsigned char>> images{};
+		// Roots of every scene
+		std::pmr::vector<int> roots{};
+	};
+
+	// Indices between the parts and accessor ranges are checked here, so users can follow
+	// them freely. Malformed input is reported under name and gives an empty document.
+	Document parse(std::span<const unsigned char> bytes, std::string_view name, std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+}
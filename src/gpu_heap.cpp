@@ -0,0 +1,201 @@
+#include "gpu_heap.hpp"
+
+#include "glad/glad.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <vector>
+
+GpuHeap::GpuHeap(GLsizeiptr elementSize, std::uint32_t initialCapacity)
+	: m_elementSize{ elementSize }, m_initialCapacity{ initialCapacity }
+{
+}
+
+GpuHeap::Handle GpuHeap::allocate(GLState& state, std::uint32_t count, const void* data)
+{
+	if (count == 0)
+	{
+		return {};
+	}
+
+	auto best{ m_free.end() };
+	for (auto it{ m_free.begin() }; it != m_free.end(); ++it)
+	{
+		if (it->second >= count && (best == m_free.end() || it->second < best->second))
+		{
+			best = it;
+		}
+	}
+
+	if (best == m_free.end())
+	{
+		grow(state, count);
+		// Growing leaves one free block at the end that fits
+		best = std::prev(m_free.end());
+	}
+
+	const std::uint32_t offset{ best->first };
+	const std::uint32_t remaining{ best->second - count };
+	m_free.erase(best);
+	if (remaining > 0)
+	{
+		m_free.emplace(offset + count, remaining);
+	}
+
+	m_used += count;
+	glNamedBufferSubData(m_buffer, static_cast<GLintptr>(offset) * m_elementSize, static_cast<GLsizeiptr>(count) * m_elementSize, data);
+
+	return m_blocks.insert({ offset, count });
+}
+
+void GpuHeap::free(Handle handle)
+{
+	const Block* block{ m_blocks.get(handle) };
+	if (!block)
+	{
+		std::cerr << "ENGINE, ERROR, MEDIUM, Freeing a stale GPU heap handle\n";
+		return;
+	}
+
+	release(block->offset, block->count);
+	m_used -= block->count;
+	m_blocks.erase(handle);
+}
+
+std::uint32_t GpuHeap::offset(Handle handle) const
+{
+	const Block* block{ m_blocks.get(handle) };
+	return block ? block->offset : 0;
+}
+
+float GpuHeap::fragmentation() const
+{
+	const std::uint32_t freeCount{ m_capacity - m_used };
+	if (freeCount == 0)
+	{
+		return 0.0f;
+	}
+
+	std::uint32_t largest{ 0 };
+	for (const auto& [offset, count] : m_free)
+	{
+		largest = std::max(largest, count);
+	}
+	return 1.0f - static_cast<float>(largest) / static_cast<float>(freeCount);
+}
+
+void GpuHeap::defragment(GLState& state)
+{
+	if (m_buffer == 0)
+	{
+		return;
+	}
+
+	GLuint packed{};
+	glCreateBuffers(1, &packed);
+	glNamedBufferStorage(packed, static_cast<GLsizeiptr>(m_capacity) * m_elementSize, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+	// Copying into a second buffer keeps source and destination ranges from overlapping
+	std::vector<Block*> blocks{};
+	blocks.reserve(m_blocks.size());
+	for (Block& block : m_blocks)
+	{
+		blocks.push_back(&block);
+	}
+	std::sort(blocks.begin(), blocks.end(), [](const Block* a, const Block* b) { return a->offset < b->offset; });
+
+	std::uint32_t next{ 0 };
+	for (Block* block : blocks)
+	{
+		glCopyNamedBufferSubData(m_buffer, packed, static_cast<GLintptr>(block->offset) * m_elementSize,
+			static_cast<GLintptr>(next) * m_elementSize, static_cast<GLsizeiptr>(block->count) * m_elementSize);
+		block->offset = next;
+		next += block->count;
+	}
+
+	state.forgetBuffer(m_buffer);
+	glDeleteBuffers(1, &m_buffer);
+	m_buffer = packed;
+
+	m_free.clear();
+	if (next < m_capacity)
+	{
+		m_free.emplace(next, m_capacity - next);
+	}
+
+	++m_defragments;
+}
+
+GpuHeap::Stats GpuHeap::stats() const
+{
+	Stats stats{ .capacity{ m_capacity }, .used{ m_used }, .freeBlocks{ m_free.size() }, .grows{ m_grows }, .defragments{ m_defragments } };
+	for (const auto& [offset, count] : m_free)
+	{
+		stats.largestFree = std::max<std::size_t>(stats.largestFree, count);
+	}
+	return stats;
+}
+
+void GpuHeap::destroy(GLState& state)
+{
+	if (m_buffer)
+	{
+		state.forgetBuffer(m_buffer);
+		glDeleteBuffers(1, &m_buffer);
+	}
+
+	m_buffer = 0;
+	m_capacity = 0;
+	m_used = 0;
+	m_blocks.clear();
+	m_free.clear();
+}
+
+void GpuHeap::grow(GLState& state, std::uint32_t minimum)
+{
+	const std::uint32_t oldCapacity{ m_capacity };
+	const std::uint32_t capacity{ std::max({ m_initialCapacity, oldCapacity * 2, oldCapacity + minimum }) };
+
+	GLuint grown{};
+	glCreateBuffers(1, &grown);
+	glNamedBufferStorage(grown, static_cast<GLsizeiptr>(capacity) * m_elementSize, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+	if (m_buffer)
+	{
+		glCopyNamedBufferSubData(m_buffer, grown, 0, 0, static_cast<GLsizeiptr>(oldCapacity) * m_elementSize);
+		state.forgetBuffer(m_buffer);
+		glDeleteBuffers(1, &m_buffer);
+		++m_grows;
+	}
+
+	m_buffer = grown;
+	m_capacity = capacity;
+	release(oldCapacity, capacity - oldCapacity);
+}
+
+void GpuHeap::release(std::uint32_t offset, std::uint32_t count)
+{
+	auto next{ m_free.lower_bound(offset) };
+
+	if (next != m_free.begin())
+	{
+		auto previous{ std::prev(next) };
+		if (previous->first + previous->second == offset)
+		{
+			offset = previous->first;
+			count += previous->second;
+			m_free.erase(previous);
+		}
+	}
+
+	if (next != m_free.end() && offset + count == next->first)
+	{
+		count += next->second;
+		m_free.erase(next);
+	}
+
+	m_free.emplace(offset, count);
+}
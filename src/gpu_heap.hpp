@@ -0,0 +1,80 @@
+#pragma once
+
+#include "gl_state.hpp"
+#include "slot_map.hpp"
+
+#include "glad/glad.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+
+// One growable GL buffer handing out ranges of fixed size elements from a best fit free
+// list; freed neighbours merge again. Ranges are reached through handles because growing
+// and defragment() move them: look offsets up when building draws, never cache them.
+// Either can also replace the buffer itself, so re-read buffer() after allocating.
+class GpuHeap final
+{
+public:
+
+	struct Block
+	{
+		std::uint32_t offset{};
+		std::uint32_t count{};
+	};
+
+	using Handle = SlotMap<Block>::Handle;
+
+	struct Stats
+	{
+		std::size_t capacity{};
+		std::size_t used{};
+		std::size_t freeBlocks{};
+		std::size_t largestFree{};
+		std::uint64_t grows{};
+		std::uint64_t defragments{};
+	};
+
+	// No GL calls happen until the first allocation, so heaps can be members of objects
+	// created before the context
+	GpuHeap(GLsizeiptr elementSize, std::uint32_t initialCapacity);
+	GpuHeap(const GpuHeap&) = delete;
+	GpuHeap& operator=(const GpuHeap&) = delete;
+
+	// Uploads count elements from data; returns an invalid handle for count 0
+	Handle allocate(GLState& state, std::uint32_t count, const void* data);
+	void free(Handle handle);
+
+	// In elements from the start of buffer()
+	std::uint32_t offset(Handle handle) const;
+
+	// Share of the free space lying outside the largest free block
+	float fragmentation() const;
+
+	// Packs every live range to the front of a fresh buffer
+	void defragment(GLState& state);
+
+	GLuint buffer() const { return m_buffer; }
+	Stats stats() const;
+
+	void destroy(GLState& state);
+
+private:
+
+	void grow(GLState& state, std::uint32_t minimum);
+	void release(std::uint32_t offset, std::uint32_t count);
+
+	GLsizeiptr m_elementSize{};
+	std::uint32_t m_initialCapacity{};
+
+	GLuint m_buffer{};
+	std::uint32_t m_capacity{ 0 };
+	std::uint32_t m_used{ 0 };
+
+	SlotMap<Block> m_blocks{};
+	// Free ranges by offset, never adjacent to each other
+	std::map<std::uint32_t, std::uint32_t> m_free{};
+
+	std::uint64_t m_grows{ 0 };
+	std::uint64_t m_defragments{ 0 };
+};
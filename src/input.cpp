@@ -0,0 +1,126 @@
+#include "input.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+void Input::record(int key, bool pressed, double time)
+{
+	if (!valid(key))
+	{
+		return;
+	}
+
+	m_events.push_back({ .time{ time }, .recorded{ time }, .key{ key }, .pressed{ pressed } });
+}
+
+void Input::deferTo(double time)
+{
+	// Stamps never decrease, so the late events are a suffix
+	for (auto event{ m_events.rbegin() }; event != m_events.rend() && event->time > time; ++event)
+	{
+		event->time = time;
+	}
+}
+
+double Input::heldTime(int key, double from, double to) const
+{
+	if (!valid(key) || to <= from)
+	{
+		return 0.0;
+	}
+
+	// Walks the key's intervals of being down and sums their overlap with the window
+	double held{ 0.0 };
+	bool down{ m_baseDown[key] };
+	double since{ from };
+	for (const Event& event : m_events)
+	{
+		if (event.key != key)
+		{
+			continue;
+		}
+		if (event.time >= to)
+		{
+			break;
+		}
+
+		if (down)
+		{
+			held += std::max(0.0, event.time - std::max(since, from));
+		}
+		down = event.pressed;
+		since = event.time;
+	}
+
+	if (down)
+	{
+		held += to - std::max(since, from);
+	}
+	return held;
+}
+
+bool Input::wasDown(int key, double from, double to) const
+{
+	if (!valid(key))
+	{
+		return false;
+	}
+
+	bool down{ m_baseDown[key] };
+	for (const Event& event : m_events)
+	{
+		if (event.key != key)
+		{
+			continue;
+		}
+		if (event.time >= to)
+		{
+			break;
+		}
+		if (event.time >= from && (down || event.pressed))
+		{
+			return true;
+		}
+		down = event.pressed;
+	}
+	return down;
+}
+
+bool Input::isDown(int key) const
+{
+	if (!valid(key))
+	{
+		return false;
+	}
+
+	for (auto event{ m_events.rbegin() }; event != m_events.rend(); ++event)
+	{
+		if (event->key == key)
+		{
+			return event->pressed;
+		}
+	}
+	return m_baseDown[key];
+}
+
+void Input::discardBefore(double time)
+{
+	const auto end{ std::find_if(m_events.begin(), m_events.end(), [time](const Event& event) { return event.time >= time; }) };
+	for (auto event{ m_events.begin() }; event != end; ++event)
+	{
+		m_baseDown[event->key] = event->pressed;
+		if (m_unlatched < 0.0 || event->recorded < m_unlatched)
+		{
+			m_unlatched = event->recorded;
+		}
+	}
+	m_events.erase(m_events.begin(), end);
+}
+
+double Input::latch()
+{
+	const double oldest{ m_unlatched };
+	m_unlatched = -1.0;
+	return oldest;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Key presses and releases in the order they happened, so the simulation can ask how much
+// of each tick a key was held instead of reading its state once per tick. GLFW does not
+// time its events, so each one is stamped when it is polled. The ticks of a frame simulate
+// a span that ends before the poll, so the caller moves fresh events back to the start of
+// the first pending tick with deferTo, or they would wait a frame.
+class Input final
+{
+public:
+
+	struct Event
+	{
+		double time{};
+		// When it was polled, before any deferTo; what the latency stats measure from
+		double recorded{};
+		int key{};
+		bool pressed{};
+	};
+
+	// Covers every GLFW key code
+	static constexpr int keyCount{ 512 };
+
+	Input() = default;
+	Input(const Input&) = delete;
+	Input& operator=(const Input&) = delete;
+
+	// Times must not go backwards; repeats should not be recorded
+	void record(int key, bool pressed, double time);
+
+	// Restamps events later than time to time, keeping their order. Called with the start
+	// of the first pending tick, right after polling.
+	void deferTo(double time);
+
+	// Seconds of [from, to] the key was held
+	double heldTime(int key, double from, double to) const;
+	// Whether the key was down at any moment of [from, to], so a tap shorter than the
+	// window still counts
+	bool wasDown(int key, double from, double to) const;
+	// Held now, after every recorded event
+	bool isDown(int key) const;
+
+	// Folds the events before time into the state they leave behind; windows queried
+	// afterwards should not start before it. The simulation has consumed them.
+	void discardBefore(double time);
+
+	// Poll time of the oldest event discarded since the last call, or a negative time if
+	// there was none. Called when a frame is submitted, to measure how long the input its
+	// ticks consumed took to show; events still waiting for a tick are not counted yet.
+	double latch();
+
+	std::size_t pendingEvents() const { return m_events.size(); }
+
+private:
+
+	static bool valid(int key) { return key >= 0 && key < keyCount; }
+
+	std::vector<Event> m_events{};
+	// Which keys were down before the first kept event
+	bool m_baseDown[keyCount]{};
+	double m_unlatched{ -1.0 };
+};
@@ -0,0 +1,185 @@
+#include "jobs.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+JobSystem::JobSystem(unsigned threadCount)
+{
+	if (threadCount == 0)
+	{
+		const unsigned hardwareThreads{ std::thread::hardware_concurrency() };
+		threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	for (unsigned i{ 0 }; i < threadCount; ++i)
+	{
+		m_threads.emplace_back([this]() { workerLoop(); });
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard lock{ m_mutex };
+		m_stopping = true;
+	}
+	m_condition.notify_all();
+
+	for (auto& thread : m_threads)
+	{
+		thread.join();
+	}
+}
+
+void JobSystem::parallelFor(std::size_t count, std::size_t grain, RangeJob job, void* context)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	grain = std::max<std::size_t>(grain, 1);
+	const std::size_t chunkCount{ (count + grain - 1) / grain };
+
+	if (chunkCount == 1 || m_threads.empty())
+	{
+		job(context, 0, count);
+		return;
+	}
+
+	// Everything the helpers share stays on this stack, which outlives them: the caller
+	// takes back helpers that never started and waits for the rest before returning
+	struct Shared
+	{
+		RangeJob job{};
+		void* context{};
+		std::size_t count{};
+		std::size_t grain{};
+		std::size_t chunkCount{};
+		std::atomic<std::size_t> nextChunk{ 0 };
+		std::atomic<std::size_t> helpersDone{ 0 };
+
+		void runChunks()
+		{
+			for (std::size_t chunk{ nextChunk++ }; chunk < chunkCount; chunk = nextChunk++)
+			{
+				const std::size_t begin{ chunk * grain };
+				job(context, begin, std::min(begin + grain, count));
+			}
+		}
+	};
+
+	struct Helper : Task
+	{
+		Shared* shared{};
+	};
+
+	Shared shared{ .job{ job }, .context{ context }, .count{ count }, .grain{ grain }, .chunkCount{ chunkCount } };
+
+	std::array<Helper, m_maxHelpers> helpers{};
+	const std::size_t helperCount{ std::min({ m_threads.size(), chunkCount - 1, m_maxHelpers }) };
+	for (std::size_t i{ 0 }; i < helperCount; ++i)
+	{
+		helpers[i].shared = &shared;
+		helpers[i].run = [](Task& task)
+			{
+				// The last touch of anything on the caller's stack
+				Shared& shared{ *static_cast<Helper&>(task).shared };
+				shared.runChunks();
+				++shared.helpersDone;
+			};
+		push(helpers[i]);
+	}
+
+	shared.runChunks();
+
+	// Every chunk is claimed, so helpers still queued have nothing left to do. Taking them
+	// back also means a parallelFor issued from inside a job never waits on a busy pool.
+	std::size_t started{ 0 };
+	for (std::size_t i{ 0 }; i < helperCount; ++i)
+	{
+		started += cancel(helpers[i]) ? 0 : 1;
+	}
+
+	while (shared.helpersDone.load() < started)
+	{
+		std::this_thread::yield();
+	}
+}
+
+void JobSystem::push(std::function<void()> job)
+{
+	// Fire and forget work owns its entry, which frees itself once it has run
+	struct FunctionTask : Task
+	{
+		std::function<void()> job{};
+	};
+
+	FunctionTask* task{ new FunctionTask{} };
+	task->job = std::move(job);
+	task->run = [](Task& task)
+		{
+			std::unique_ptr<FunctionTask> owned{ static_cast<FunctionTask*>(&task) };
+			owned->job();
+		};
+	push(*task);
+}
+
+void JobSystem::push(Task& task)
+{
+	{
+		std::lock_guard lock{ m_mutex };
+		task.prev = m_tail;
+		task.next = nullptr;
+		task.queued = true;
+		(m_tail ? m_tail->next : m_head) = &task;
+		m_tail = &task;
+	}
+	m_condition.notify_one();
+}
+
+bool JobSystem::cancel(Task& task)
+{
+	std::lock_guard lock{ m_mutex };
+	if (!task.queued)
+	{
+		return false;
+	}
+
+	(task.prev ? task.prev->next : m_head) = task.next;
+	(task.next ? task.next->prev : m_tail) = task.prev;
+	task.queued = false;
+	return true;
+}
+
+void JobSystem::workerLoop()
+{
+	while (true)
+	{
+		Task* task{};
+
+		{
+			std::unique_lock lock{ m_mutex };
+			m_condition.wait(lock, [this]() { return m_stopping || m_head; });
+
+			if (m_stopping && !m_head)
+			{
+				return;
+			}
+
+			task = m_head;
+			m_head = task->next;
+			(m_head ? m_head->prev : m_tail) = nullptr;
+			task->queued = false;
+		}
+
+		task->run(*task);
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class JobSystem final
+{
+public:
+
+	// 0 picks one worker per hardware thread, minus the calling thread
+	explicit JobSystem(unsigned threadCount = 0);
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	~JobSystem();
+
+	template <typename F>
+	auto submit(F&& job) -> std::future<std::invoke_result_t<F>>
+	{
+		using Result = std::invoke_result_t<F>;
+
+		auto task{ std::make_shared<std::packaged_task<Result()>>(std::forward<F>(job)) };
+		std::future<Result> future{ task->get_future() };
+
+		push([task]() { (*task)(); });
+
+		return future;
+	}
+
+	// Splits [0, count) into chunks of at most grain items and runs them on the workers
+	// and the calling thread. Returns once every chunk has finished. Nothing is allocated:
+	// the job is called through a pointer and the helpers live on the caller's stack.
+	template <typename F>
+	void parallelFor(std::size_t count, std::size_t grain, F&& job)
+	{
+		using Job = std::remove_reference_t<F>;
+		parallelFor(count, grain, [](void* context, std::size_t begin, std::size_t end)
+			{
+				(*static_cast<Job*>(context))(begin, end);
+			}, const_cast<void*>(static_cast<const void*>(std::addressof(job))));
+	}
+
+	unsigned threadCount() const { return static_cast<unsigned>(m_threads.size()); }
+
+private:
+
+	// Queue entry, linked through itself so entries can live wherever their owner keeps
+	// them. A worker must not touch a task after calling run, which may free it.
+	struct Task
+	{
+		void (*run)(Task& task){};
+		Task* prev{};
+		Task* next{};
+		bool queued{ false };
+	};
+
+	// Most helpers one parallelFor queues; their slots are on its stack
+	static constexpr std::size_t m_maxHelpers{ 64 };
+
+	using RangeJob = void (*)(void* context, std::size_t begin, std::size_t end);
+	void parallelFor(std::size_t count, std::size_t grain, RangeJob job, void* context);
+
+	void push(std::function<void()> job);
+	void push(Task& task);
+	// Removes a task that no worker has taken yet; false once one has
+	bool cancel(Task& task);
+	void workerLoop();
+
+	std::vector<std::thread> m_threads{};
+
+	Task* m_head{};
+	Task* m_tail{};
+	std::mutex m_mutex{};
+	std::condition_variable m_condition{};
+	bool m_stopping{ false };
+};
@@ -0,0 +1,449 @@
+#include "level.hpp"
+
+#include "json.hpp"
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Level
+{
+
+	glm::vec3 readVec3(const nlohmann::json& value, const glm::vec3& fallback)
+	{
+		if (!value.is_array() || value.size() != 3)
+		{
+			return fallback;
+		}
+
+		return { value[0].get<float>(), value[1].get<float>(), value[2].get<float>() };
+	}
+
+	// Categories are named as in the memory report, plus "total"; unknown names are reported
+	Memory::Budgets readBudgets(const nlohmann::json& value)
+	{
+		const auto bytes{ [](const nlohmann::json& megabytes) { return static_cast<std::size_t>(megabytes.get<double>() * 1024.0 * 1024.0); } };
+
+		Memory::Budgets budgets{};
+		for (const auto& [name, megabytes] : value.value("cpu", nlohmann::json::object()).items())
+		{
+			std::size_t i{ 0 };
+			while (i < Memory::tagCount && Memory::tagName(static_cast<Memory::Tag>(i)) != name)
+			{
+				++i;
+			}
+
+			if (i < Memory::tagCount)
+			{
+				budgets.cpu[i] = bytes(megabytes);
+			}
+			else if (name == "total")
+			{
+				budgets.cpuTotal = bytes(megabytes);
+			}
+			else
+			{
+				std::cerr << "LEVEL, ERROR: Unknown CPU memory budget " << name << '\n';
+			}
+		}
+
+		for (const auto& [name, megabytes] : value.value("gpu", nlohmann::json::object()).items())
+		{
+			std::size_t i{ 0 };
+			while (i < Memory::gpuKindCount && Memory::gpuKindName(static_cast<Memory::GpuKind>(i)) != name)
+			{
+				++i;
+			}
+
+			if (i < Memory::gpuKindCount)
+			{
+				budgets.gpu[i] = bytes(megabytes);
+			}
+			else if (name == "total")
+			{
+				budgets.gpuTotal = bytes(megabytes);
+			}
+			else
+			{
+				std::cerr << "LEVEL, ERROR: Unknown GPU memory budget " << name << '\n';
+			}
+		}
+		return budgets;
+	}
+
+	Manifest loadManifest(const std::string& path)
+	{
+		const Memory::TagScope tag{ Memory::Tag::level };
+
+		Manifest manifest{};
+		std::pmr::memory_resource* const memory{ manifest.arena.get() };
+
+		std::ifstream file{ path };
+		if (!file)
+		{
+			std::cerr << "LEVEL, ERROR: Could not open " << path << '\n';
+			return manifest;
+		}
+
+		try
+		{
+			// Braces would wrap the document in a one element array
+			const nlohmann::json root = nlohmann::json::parse(file);
+
+			manifest.cellSize = root.value("cellSize", manifest.cellSize);
+			manifest.budgets = readBudgets(root.value("memoryBudgets", nlohmann::json::object()));
+
+			for (const auto& cellJson : root.at("cells"))
+			{
+				CellDesc cell
+				{
+					.coord{ cellJson.at("x").get<int>(), cellJson.at("z").get<int>() },
+					.models{ std::pmr::vector<ModelPlacement>{ memory } },
+					.boxes{ std::pmr::vector<Box>{ memory } },
+					.enemies{ std::pmr::vector<EnemySpawn>{ memory } },
+					.crates{ std::pmr::vector<glm::vec3>{ memory } },
+					.lights{ std::pmr::vector<LightDesc>{ memory } },
+					.goals{ std::pmr::vector<glm::vec3>{ memory } },
+				};
+
+				for (const auto& modelJson : cellJson.value("models", nlohmann::json::array()))
+				{
+					glm::mat4 transform{ glm::translate(glm::mat4{ 1.0f }, readVec3(modelJson.value("position", nlohmann::json{}), glm::vec3{ 0.0f })) };
+					transform = glm::scale(transform, readVec3(modelJson.value("scale", nlohmann::json{}), glm::vec3{ 1.0f }));
+
+					cell.models.push_back({ std::pmr::string{ modelJson.at("path").get_ref<const std::string&>(), memory }, transform });
+				}
+
+				for (const auto& boxJson : cellJson.value("boxes", nlohmann::json::array()))
+				{
+					cell.boxes.push_back({ readVec3(boxJson.at("pos"), glm::vec3{ 0.0f }), readVec3(boxJson.at("scl"), glm::vec3{ 1.0f }), boxJson.value("occluder", false) });
+				}
+
+				for (const auto& enemyJson : cellJson.value("enemies", nlohmann::json::array()))
+				{
+					const glm::vec3 a{ readVec3(enemyJson.at("a"), glm::vec3{ 0.0f }) };
+					cell.enemies.push_back({ a, readVec3(enemyJson.value("b", nlohmann::json{}), a), enemyJson.value("chase", false) });
+				}
+
+				for (const auto& crateJson : cellJson.value("crates", nlohmann::json::array()))
+				{
+					cell.crates.push_back(readVec3(crateJson, glm::vec3{ 0.0f }));
+				}
+
+				for (const auto& lightJson : cellJson.value("lights", nlohmann::json::array()))
+				{
+					cell.lights.push_back({
+						readVec3(lightJson.at("pos"), glm::vec3{ 0.0f }),
+						readVec3(lightJson.value("color", nlohmann::json{}), glm::vec3{ 1.0f }),
+						lightJson.value("radius", 8.0f),
+						lightJson.value("intensity", 1.0f),
+						});
+				}
+
+				for (const auto& goalJson : cellJson.value("goals", nlohmann::json::array()))
+				{
+					cell.goals.push_back(readVec3(goalJson, glm::vec3{ 0.0f }));
+				}
+
+				manifest.cells.push_back(std::move(cell));
+			}
+		}
+		catch (const nlohmann::json::exception& e)
+		{
+			std::cerr << "LEVEL, ERROR: " << path << ": " << e.what() << '\n';
+		}
+
+		return manifest;
+	}
+
+	CellCoord cellAt(const glm::vec3& position, float cellSize)
+	{
+		return { static_cast<int>(std::floor(position.x / cellSize)), static_cast<int>(std::floor(position.z / cellSize)) };
+	}
+
+}
+
+LevelStreamer::LevelStreamer(Renderer& renderer, JobSystem& jobs, Level::Manifest manifest)
+	: m_renderer{ renderer }, m_jobs{ jobs }, m_manifest{ std::move(manifest) }
+{
+	for (std::size_t i{ 0 }; i < m_manifest.cells.size(); ++i)
+	{
+		m_cellLookup[m_manifest.cells[i].coord] = i;
+	}
+}
+
+LevelStreamer::~LevelStreamer()
+{
+	// Jobs read the cell descriptions, which die with us
+	for (auto& [coord, pending] : m_pending)
+	{
+		pending.loaded.wait();
+	}
+}
+
+void LevelStreamer::setCallbacks(CellCallback onLoaded, CellCallback onUnloaded)
+{
+	m_onLoaded = std::move(onLoaded);
+	m_onUnloaded = std::move(onUnloaded);
+}
+
+void LevelStreamer::update(const glm::vec3& focus)
+{
+	m_focusCell = Level::cellAt(focus, m_manifest.cellSize);
+
+	for (int z{ -loadRadius }; z <= loadRadius; ++z)
+	{
+		for (int x{ -loadRadius }; x <= loadRadius; ++x)
+		{
+			const Level::CellCoord coord{ m_focusCell.x + x, m_focusCell.z + z };
+
+			const auto lookup{ m_cellLookup.find(coord) };
+			if (lookup == m_cellLookup.end() || m_resident.contains(coord))
+			{
+				continue;
+			}
+
+			const auto pending{ m_pending.find(coord) };
+			if (pending != m_pending.end())
+			{
+				pending->second.wanted = true;
+			}
+			else
+			{
+				request(m_manifest.cells[lookup->second]);
+			}
+		}
+	}
+
+	std::vector<Level::CellCoord> stale{};
+	for (const auto& [coord, cell] : m_resident)
+	{
+		if (distance(coord, m_focusCell) > loadRadius + 1)
+		{
+			stale.push_back(coord);
+		}
+	}
+	for (const auto& coord : stale)
+	{
+		unload(coord);
+	}
+
+	int uploads{ 0 };
+	for (auto it{ m_pending.begin() }; it != m_pending.end();)
+	{
+		Pending& pending{ it->second };
+
+		if (distance(it->first, m_focusCell) > loadRadius + 1)
+		{
+			pending.wanted = false;
+		}
+
+		// The focus cell holds the ground under the player, so it is never deferred
+		const bool focusCell{ it->first == m_focusCell };
+		if (focusCell && pending.wanted)
+		{
+			pending.loaded.wait();
+		}
+
+		if (pending.loaded.wait_for(std::chrono::seconds{ 0 }) != std::future_status::ready)
+		{
+			++it;
+			continue;
+		}
+
+		if (!pending.wanted)
+		{
+			pending.loaded.get();
+			it = m_pending.erase(it);
+			continue;
+		}
+
+		if (uploads >= uploadsPerUpdate && !focusCell)
+		{
+			++it;
+			continue;
+		}
+
+		upload(*pending.desc, pending.loaded.get());
+		++uploads;
+		it = m_pending.erase(it);
+	}
+}
+
+void LevelStreamer::flush()
+{
+	for (auto it{ m_pending.begin() }; it != m_pending.end(); it = m_pending.erase(it))
+	{
+		Loaded loaded{ it->second.loaded.get() };
+		if (it->second.wanted)
+		{
+			upload(*it->second.desc, std::move(loaded));
+		}
+	}
+}
+
+bool LevelStreamer::raycast(const TriangleBvh::Ray& ray, TriangleBvh::Hit& hit) const
+{
+	bool found{ false };
+	for (const auto& [coord, cell] : m_resident)
+	{
+		if (cell.collision && cell.collision->raycast(ray, hit))
+		{
+			found = true;
+		}
+	}
+	return found;
+}
+
+bool LevelStreamer::sphereCast(const TriangleBvh::Ray& ray, float radius, TriangleBvh::Hit& hit) const
+{
+	bool found{ false };
+	for (const auto& [coord, cell] : m_resident)
+	{
+		if (cell.collision && cell.collision->sphereCast(ray, radius, hit))
+		{
+			found = true;
+		}
+	}
+	return found;
+}
+
+void LevelStreamer::raycastPacket(std::span<const TriangleBvh::Ray> rays, std::span<TriangleBvh::Hit> hits) const
+{
+	for (const auto& [coord, cell] : m_resident)
+	{
+		if (cell.collision)
+		{
+			cell.collision->raycastPacket(rays, hits);
+		}
+	}
+}
+
+bool LevelStreamer::overlaps(const glm::vec3& min, const glm::vec3& max) const
+{
+	for (const auto& [coord, cell] : m_resident)
+	{
+		if (cell.collision && cell.collision->overlaps(min, max))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void LevelStreamer::unloadAll()
+{
+	for (auto& [coord, pending] : m_pending)
+	{
+		pending.loaded.wait();
+	}
+	m_pending.clear();
+
+	while (!m_resident.empty())
+	{
+		unload(m_resident.begin()->first);
+	}
+}
+
+int LevelStreamer::distance(const Level::CellCoord& a, const Level::CellCoord& b)
+{
+	return std::max(std::abs(a.x - b.x), std::abs(a.z - b.z));
+}
+
+void LevelStreamer::request(const Level::CellDesc& desc)
+{
+	const Memory::TagScope tag{ Memory::Tag::level };
+
+	const Level::CellDesc* descPtr{ &desc };
+	auto scratch{ std::make_unique<Memory::LinearArena>(1024 * 1024) };
+	Memory::LinearArena* scratchPtr{ scratch.get() };
+
+	// Only the job touches the arena until the future is ready
+	m_pending[desc.coord] =
+	{
+		.desc{ descPtr },
+		.scratch{ std::move(scratch) },
+		.loaded{ m_jobs.submit([descPtr, scratchPtr]()
+			{
+				const Memory::TagScope tag{ Memory::Tag::level };
+
+				Loaded loaded{ .meshes{ Meshes{ scratchPtr } } };
+				loaded.meshes.reserve(descPtr->models.size());
+
+				std::vector<TriangleBvh::Triangle> triangles{};
+				for (const auto& model : descPtr->models)
+				{
+					loaded.meshes.push_back(ModelLoader::loadGLB(model.path, scratchPtr));
+					ModelLoader::appendCollisionTriangles(loaded.meshes.back(), model.transform, triangles);
+				}
+
+				// Built here so the main thread only has to take ownership
+				if (!triangles.empty())
+				{
+					loaded.collision = std::make_unique<TriangleBvh>(triangles);
+				}
+				return loaded;
+			}) },
+	};
+}
+
+void LevelStreamer::upload(const Level::CellDesc& desc, Loaded&& loaded)
+{
+	Cell cell{ .desc{ &desc }, .collision{ std::move(loaded.collision) } };
+	const Meshes& meshes{ loaded.meshes };
+
+	for (std::size_t i{ 0 }; i < meshes.size(); ++i)
+	{
+		if (meshes[i].primitives.empty())
+		{
+			continue;
+		}
+
+		const Renderer::MeshHandle mesh{ m_renderer.addModel(meshes[i]) };
+		cell.meshes.push_back(mesh);
+		cell.meshInstances.push_back(m_renderer.addMeshInstance(mesh, desc.models[i].transform));
+	}
+
+	const Cell& resident{ m_resident[desc.coord] = std::move(cell) };
+
+	if (m_onLoaded)
+	{
+		m_onLoaded(resident);
+	}
+}
+
+void LevelStreamer::unload(const Level::CellCoord& coord)
+{
+	const auto it{ m_resident.find(coord) };
+	if (it == m_resident.end())
+	{
+		return;
+	}
+
+	if (m_onUnloaded)
+	{
+		m_onUnloaded(it->second);
+	}
+
+	for (const Renderer::MeshInstanceHandle meshInstance : it->second.meshInstances)
+	{
+		m_renderer.removeMeshInstance(meshInstance);
+	}
+	for (const Renderer::MeshHandle mesh : it->second.meshes)
+	{
+		m_renderer.unloadModel(mesh);
+	}
+
+	m_resident.erase(it);
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include "bvh.hpp"
+#include "jobs.hpp"
+#include "memory.hpp"
+#include "memory_report.hpp"
+#include "model_load.hpp"
+#include "renderer.hpp"
+
+#include "glm/glm.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Level
+{
+
+	struct Box
+	{
+		glm::vec3 pos{};
+		glm::vec3 scl{};
+		// Set by the level author only for boxes that lie inside the rendered art, since
+		// anything an occluder covers is culled
+		bool occluder{ false };
+	};
+
+	// Patrolling enemies move between a and b; chasers start at a and follow the nav flow field
+	struct EnemySpawn
+	{
+		glm::vec3 a{};
+		glm::vec3 b{};
+		bool chase{ false };
+	};
+
+	struct LightDesc
+	{
+		glm::vec3 pos{};
+		glm::vec3 color{ 1.0f };
+		float radius{ 8.0f };
+		float intensity{ 1.0f };
+	};
+
+	struct ModelPlacement
+	{
+		std::pmr::string path{};
+		glm::mat4 transform{ 1.0f };
+	};
+
+	// Cells tile the XZ plane; cell (x, z) covers [x, x + 1) * cellSize on both axes
+	struct CellCoord
+	{
+		int x{};
+		int z{};
+
+		bool operator==(const CellCoord&) const = default;
+	};
+
+	struct CellCoordHash
+	{
+		std::size_t operator()(const CellCoord& coord) const
+		{
+			return std::hash<long long>{}((static_cast<long long>(coord.x) << 32) ^ static_cast<unsigned int>(coord.z));
+		}
+	};
+
+	struct CellDesc
+	{
+		CellCoord coord{};
+		std::pmr::vector<ModelPlacement> models{};
+		std::pmr::vector<Box> boxes{};
+		std::pmr::vector<EnemySpawn> enemies{};
+		// Dynamic boxes handed to the physics world
+		std::pmr::vector<glm::vec3> crates{};
+		std::pmr::vector<LightDesc> lights{};
+		// Flags that celebrate the player reaching them
+		std::pmr::vector<glm::vec3> goals{};
+	};
+
+	// Everything the manifest describes lives in its arena and is released in one step with it
+	struct Manifest
+	{
+		std::unique_ptr<Memory::LinearArena> arena{ std::make_unique<Memory::LinearArena>(16 * 1024) };
+
+		float cellSize{ 16.0f };
+		std::pmr::vector<CellDesc> cells{ arena.get() };
+
+		// The level's memory target, from the manifest's "memoryBudgets" in MiB
+		Memory::Budgets budgets{};
+	};
+
+	Manifest loadManifest(const std::string& path);
+
+	CellCoord cellAt(const glm::vec3& position, float cellSize);
+
+}
+
+// Keeps the cells around a focus point resident. Model files are parsed on the job system;
+// GL uploads and the load/unload callbacks run on the thread calling update.
+class LevelStreamer final
+{
+public:
+
+	struct Cell
+	{
+		const Level::CellDesc* desc{};
+		std::vector<Renderer::MeshHandle> meshes{};
+		std::vector<Renderer::MeshInstanceHandle> meshInstances{};
+		// The cell's model triangles in world space, built alongside the meshes; null without models
+		std::unique_ptr<TriangleBvh> collision{};
+	};
+
+	using CellCallback = std::function<void(const Cell& cell)>;
+
+	LevelStreamer(Renderer& renderer, JobSystem& jobs, Level::Manifest manifest);
+	LevelStreamer(const LevelStreamer&) = delete;
+	LevelStreamer& operator=(const LevelStreamer&) = delete;
+
+	~LevelStreamer();
+
+	void setCallbacks(CellCallback onLoaded, CellCallback onUnloaded);
+
+	void update(const glm::vec3& focus);
+
+	// Blocks until every requested cell is resident
+	void flush();
+
+	void unloadAll();
+
+	// Queries run over the collision of every resident cell and follow TriangleBvh's rules
+	bool raycast(const TriangleBvh::Ray& ray, TriangleBvh::Hit& hit) const;
+	bool sphereCast(const TriangleBvh::Ray& ray, float radius, TriangleBvh::Hit& hit) const;
+	void raycastPacket(std::span<const TriangleBvh::Ray> rays, std::span<TriangleBvh::Hit> hits) const;
+	bool overlaps(const glm::vec3& min, const glm::vec3& max) const;
+
+	std::size_t residentCellCount() const { return m_resident.size(); }
+	std::size_t pendingCellCount() const { return m_pending.size(); }
+
+	// Cells within loadRadius of the focus cell are requested; they are dropped again
+	// once they are further than loadRadius + 1, so walking along a border does not thrash
+	int loadRadius{ 2 };
+	int uploadsPerUpdate{ 1 };
+
+private:
+
+	using Meshes = std::pmr::vector<ModelLoader::Mesh>;
+
+	struct Loaded
+	{
+		Meshes meshes{};
+		std::unique_ptr<TriangleBvh> collision{};
+	};
+
+	// The loader's output lives in a scratch arena owned by the request, dropped once uploaded
+	struct Pending
+	{
+		const Level::CellDesc* desc{};
+		std::unique_ptr<Memory::LinearArena> scratch{};
+		std::future<Loaded> loaded{};
+		bool wanted{ true };
+	};
+
+	static int distance(const Level::CellCoord& a, const Level::CellCoord& b);
+
+	void request(const Level::CellDesc& desc);
+	void upload(const Level::CellDesc& desc, Loaded&& loaded);
+	void unload(const Level::CellCoord& coord);
+
+	Renderer& m_renderer;
+	JobSystem& m_jobs;
+
+	Level::Manifest m_manifest{};
+	std::unordered_map<Level::CellCoord, std::size_t, Level::CellCoordHash> m_cellLookup{};
+
+	std::unordered_map<Level::CellCoord, Cell, Level::CellCoordHash> m_resident{};
+	std::unordered_map<Level::CellCoord, Pending, Level::CellCoordHash> m_pending{};
+
+	Level::CellCoord m_focusCell{};
+
+	CellCallback m_onLoaded{};
+	CellCallback m_onUnloaded{};
+};
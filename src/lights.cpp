@@ -0,0 +1,199 @@
+#include "lights.hpp"
+
+#include "glm/glm.hpp"
+
+#include <xmmintrin.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+void LightClusters::build(std::span<const Light> lights, const glm::mat4& view, const glm::mat4& proj)
+{
+	const auto start{ std::chrono::steady_clock::now() };
+
+	m_stats = {};
+	m_stats.lights = lights.size();
+
+	const float zNear{ proj[3][2] / (proj[2][2] - 1.0f) };
+	const float zFar{ proj[3][2] / (proj[2][2] + 1.0f) };
+
+	// Depths outside [sliceNear, sliceFar] fold into the first and last slice
+	const float sliceNear{ std::max(zNear, m_clusterNear) };
+	const float sliceFar{ std::max(sliceNear * 2.0f, std::min(zFar, m_clusterFar)) };
+	const float sliceScale{ static_cast<float>(slices) / std::log(sliceFar / sliceNear) };
+	m_slicing = { sliceScale, -std::log(sliceNear) * sliceScale };
+
+	const auto slice{ [this](float depth)
+		{
+			return std::clamp(static_cast<int>(std::floor(std::log(depth) * m_slicing.x + m_slicing.y)), 0, slices - 1);
+		} };
+
+	const std::size_t padded{ (lights.size() + 3) & ~std::size_t{ 3 } };
+	m_x.resize(padded);
+	m_y.resize(padded);
+	m_z.resize(padded);
+	m_radius.assign(padded, -1.0f);
+	for (std::size_t i{ 0 }; i < lights.size(); ++i)
+	{
+		m_x[i] = lights[i].position.x;
+		m_y[i] = lights[i].position.y;
+		m_z[i] = lights[i].position.z;
+		m_radius[i] = lights[i].radius;
+	}
+
+	// Screen bounds of each light's view space box, four lights at a time. Dividing the
+	// box's x and y extents by both its nearest and farthest depth covers the sphere.
+	const __m128 rowX[4]{ _mm_set1_ps(view[0][0]), _mm_set1_ps(view[1][0]), _mm_set1_ps(view[2][0]), _mm_set1_ps(view[3][0]) };
+	const __m128 rowY[4]{ _mm_set1_ps(view[0][1]), _mm_set1_ps(view[1][1]), _mm_set1_ps(view[2][1]), _mm_set1_ps(view[3][1]) };
+	const __m128 rowZ[4]{ _mm_set1_ps(view[0][2]), _mm_set1_ps(view[1][2]), _mm_set1_ps(view[2][2]), _mm_set1_ps(view[3][2]) };
+	const __m128 projX{ _mm_set1_ps(proj[0][0]) };
+	const __m128 projY{ _mm_set1_ps(proj[1][1]) };
+	const __m128 nearPlane{ _mm_set1_ps(zNear) };
+	const __m128 zero{ _mm_setzero_ps() };
+	const __m128 minusOne{ _mm_set1_ps(-1.0f) };
+	const __m128 one{ _mm_set1_ps(1.0f) };
+	const __m128 half{ _mm_set1_ps(0.5f) };
+	const __m128 tileScaleX{ _mm_set1_ps(static_cast<float>(tilesX)) };
+	const __m128 tileScaleY{ _mm_set1_ps(static_cast<float>(tilesY)) };
+	const __m128 lastTileX{ _mm_set1_ps(static_cast<float>(tilesX - 1)) };
+	const __m128 lastTileY{ _mm_set1_ps(static_cast<float>(tilesY - 1)) };
+
+	auto transform{ [](const __m128 row[4], __m128 x, __m128 y, __m128 z)
+		{
+			return _mm_add_ps(_mm_add_ps(_mm_mul_ps(row[0], x), _mm_mul_ps(row[1], y)), _mm_add_ps(_mm_mul_ps(row[2], z), row[3]));
+		} };
+
+	auto tile{ [&](__m128 ndc, __m128 scale, __m128 last)
+		{
+			return _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(ndc, half), half), scale), zero), last);
+		} };
+
+	m_ranges.clear();
+	for (std::size_t i{ 0 }; i < padded; i += 4)
+	{
+		const __m128 x{ _mm_loadu_ps(m_x.data() + i) };
+		const __m128 y{ _mm_loadu_ps(m_y.data() + i) };
+		const __m128 z{ _mm_loadu_ps(m_z.data() + i) };
+		const __m128 radius{ _mm_loadu_ps(m_radius.data() + i) };
+
+		const __m128 viewX{ transform(rowX, x, y, z) };
+		const __m128 viewY{ transform(rowY, x, y, z) };
+		const __m128 depth{ _mm_sub_ps(zero, transform(rowZ, x, y, z)) };
+
+		const __m128 nearDepth{ _mm_max_ps(_mm_sub_ps(depth, radius), nearPlane) };
+		const __m128 farDepth{ _mm_add_ps(depth, radius) };
+		const __m128 inverseNear{ _mm_div_ps(one, nearDepth) };
+		const __m128 inverseFar{ _mm_div_ps(one, _mm_max_ps(farDepth, nearPlane)) };
+
+		const __m128 lowX{ _mm_mul_ps(_mm_sub_ps(viewX, radius), projX) };
+		const __m128 highX{ _mm_mul_ps(_mm_add_ps(viewX, radius), projX) };
+		const __m128 lowY{ _mm_mul_ps(_mm_sub_ps(viewY, radius), projY) };
+		const __m128 highY{ _mm_mul_ps(_mm_add_ps(viewY, radius), projY) };
+
+		const __m128 ndcX0{ _mm_min_ps(_mm_mul_ps(lowX, inverseNear), _mm_mul_ps(lowX, inverseFar)) };
+		const __m128 ndcX1{ _mm_max_ps(_mm_mul_ps(highX, inverseNear), _mm_mul_ps(highX, inverseFar)) };
+		const __m128 ndcY0{ _mm_min_ps(_mm_mul_ps(lowY, inverseNear), _mm_mul_ps(lowY, inverseFar)) };
+		const __m128 ndcY1{ _mm_max_ps(_mm_mul_ps(highY, inverseNear), _mm_mul_ps(highY, inverseFar)) };
+
+		__m128 visible{ _mm_and_ps(_mm_cmpgt_ps(radius, zero), _mm_cmpgt_ps(farDepth, nearPlane)) };
+		visible = _mm_and_ps(visible, _mm_and_ps(_mm_cmpge_ps(ndcX1, minusOne), _mm_cmple_ps(ndcX0, one)));
+		visible = _mm_and_ps(visible, _mm_and_ps(_mm_cmpge_ps(ndcY1, minusOne), _mm_cmple_ps(ndcY0, one)));
+
+		const int mask{ _mm_movemask_ps(visible) };
+		if (mask == 0)
+		{
+			continue;
+		}
+
+		alignas(16) float tiles[4][4];
+		_mm_store_ps(tiles[0], tile(ndcX0, tileScaleX, lastTileX));
+		_mm_store_ps(tiles[1], tile(ndcX1, tileScaleX, lastTileX));
+		_mm_store_ps(tiles[2], tile(ndcY0, tileScaleY, lastTileY));
+		_mm_store_ps(tiles[3], tile(ndcY1, tileScaleY, lastTileY));
+
+		alignas(16) float depths[2][4];
+		_mm_store_ps(depths[0], nearDepth);
+		_mm_store_ps(depths[1], farDepth);
+
+		for (int lane{ 0 }; lane < 4; ++lane)
+		{
+			if (mask & (1 << lane))
+			{
+				m_ranges.push_back({
+					.light{ static_cast<std::uint32_t>(i + lane) },
+					.x0{ static_cast<int>(tiles[0][lane]) },
+					.x1{ static_cast<int>(tiles[1][lane]) },
+					.y0{ static_cast<int>(tiles[2][lane]) },
+					.y1{ static_cast<int>(tiles[3][lane]) },
+					.z0{ slice(depths[0][lane]) },
+					.z1{ slice(depths[1][lane]) },
+					});
+			}
+		}
+	}
+	m_stats.visible = m_ranges.size();
+
+	auto forEachCluster{ [](const Range& range, auto&& visit)
+		{
+			for (int z{ range.z0 }; z <= range.z1; ++z)
+			{
+				for (int y{ range.y0 }; y <= range.y1; ++y)
+				{
+					for (int x{ range.x0 }; x <= range.x1; ++x)
+					{
+						visit(static_cast<std::size_t>((z * tilesY + y) * tilesX + x));
+					}
+				}
+			}
+		} };
+
+	// Count, reserve each cluster's span of the index list, then fill in the same order
+	// so the lights kept in a full cluster are the same ones that were counted
+	m_clusters.assign(clusterCount, glm::uvec2{ 0 });
+	for (const Range& range : m_ranges)
+	{
+		forEachCluster(range, [this](std::size_t cluster)
+			{
+				if (m_clusters[cluster].y < maxLightsPerCluster)
+				{
+					++m_clusters[cluster].y;
+				}
+				else
+				{
+					++m_stats.dropped;
+				}
+			});
+	}
+
+	std::uint32_t offset{ 0 };
+	for (glm::uvec2& cluster : m_clusters)
+	{
+		cluster.x = offset;
+		offset += cluster.y;
+		m_stats.busiestCluster = std::max<std::size_t>(m_stats.busiestCluster, cluster.y);
+		cluster.y = 0;
+	}
+	m_stats.references = offset;
+
+	m_indices.resize(offset);
+	for (const Range& range : m_ranges)
+	{
+		forEachCluster(range, [this, &range](std::size_t cluster)
+			{
+				glm::uvec2& span{ m_clusters[cluster] };
+				const std::uint32_t end{ cluster + 1 < m_clusters.size() ? m_clusters[cluster + 1].x : static_cast<std::uint32_t>(m_indices.size()) };
+				if (span.x + span.y < end)
+				{
+					m_indices[span.x + span.y] = range.light;
+					++span.y;
+				}
+			});
+	}
+
+	m_stats.buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Bins point lights into view space froxels: a 16x9 grid of screen tiles, each split into
+// depth slices spaced logarithmically. Every cluster gets a range in one shared index list,
+// so a fragment only loops over the lights that can reach its cluster, never over all of them.
+class LightClusters final
+{
+public:
+
+	// Laid out as two vec4s to match the shader's std430 array
+	struct Light
+	{
+		glm::vec3 position{};
+		float radius{ 8.0f };
+		glm::vec3 color{ 1.0f };
+		float intensity{ 1.0f };
+	};
+
+	struct Stats
+	{
+		std::size_t lights{};
+		std::size_t visible{};
+		std::size_t references{};
+		std::size_t busiestCluster{};
+		// References dropped because a cluster was already full
+		std::size_t dropped{};
+		double buildMs{};
+	};
+
+	static constexpr int tilesX{ 16 };
+	static constexpr int tilesY{ 9 };
+	static constexpr int slices{ 24 };
+	static constexpr std::size_t clusterCount{ static_cast<std::size_t>(tilesX) * tilesY * slices };
+
+	// Caps the per-fragment loop however many lights overlap
+	static constexpr std::uint32_t maxLightsPerCluster{ 64 };
+
+	LightClusters() = default;
+	LightClusters(const LightClusters&) = delete;
+	LightClusters& operator=(const LightClusters&) = delete;
+
+	// proj must be a symmetric OpenGL perspective projection
+	void build(std::span<const Light> lights, const glm::mat4& view, const glm::mat4& proj);
+
+	// Per cluster the offset into indices() and the count, x fastest, then y, then slice
+	const std::vector<glm::uvec2>& clusters() const { return m_clusters; }
+	const std::vector<std::uint32_t>& indices() const { return m_indices; }
+
+	// slice = log(view depth) * x + y
+	glm::vec2 slicing() const { return m_slicing; }
+
+	const Stats& stats() const { return m_stats; }
+
+private:
+
+	static constexpr float m_clusterNear{ 0.5f };
+	static constexpr float m_clusterFar{ 300.0f };
+
+	struct Range
+	{
+		std::uint32_t light{};
+		int x0{};
+		int x1{};
+		int y0{};
+		int y1{};
+		int z0{};
+		int z1{};
+	};
+
+	// Lights transposed for the SIMD bounds pass, padded to a multiple of four
+	std::vector<float> m_x{};
+	std::vector<float> m_y{};
+	std::vector<float> m_z{};
+	std::vector<float> m_radius{};
+
+	std::vector<Range> m_ranges{};
+	std::vector<glm::uvec2> m_clusters{};
+	std::vector<std::uint32_t> m_indices{};
+	glm::vec2 m_slicing{};
+
+	Stats m_stats{};
+};
@@ -1,34 +1,135 @@
 #define RENDERER_USE_IMGUI
+#include "batch_sim.hpp"
+#include "bvh.hpp"
+#include "ecs.hpp"
+#include "input.hpp"
+#include "jobs.hpp"
+#include "level.hpp"
+#include "memory.hpp"
+#include "memory_report.hpp"
+#include "model_load.hpp"
+#include "navigation.hpp"
+#include "physics.hpp"
 #include "renderer.hpp"
+#include "sim_lod.hpp"
+#include "stress_scene.hpp"
 
 #include "glm/glm.hpp"
+#include "glm/gtc/constants.hpp"
 #include "glm/gtc/matrix_transform.hpp"
+#include "json.hpp"
 
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <memory_resource>
+#include <random>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <iostream>
+#include <utility>
 
 #include "imgui.h"
 
 constexpr float deltaTime{ 1.0f / 60.0f };
 
+// ECS components
+
 struct AABB
 {
 	glm::vec3 pos{};
 	glm::vec3 scl{};
-	int meshInstance{ 0 };
 };
 
 struct Enemy
 {
 	glm::vec3 pos{};
+};
+
+struct Patrol
+{
 	glm::vec3 a{};
 	glm::vec3 b{};
-	int meshInstance{ -1 };
 };
 
+// Follows the shared nav flow field toward the player
+struct Chaser
+{
+	float speed{};
+};
+
+struct StaticCollider
+{
+	PhysicsWorld::StaticHandle box{};
+};
+
+struct Crate
+{
+	PhysicsWorld::BodyHandle body{};
+};
+
+struct RenderInstance
+{
+	Renderer::MeshInstanceHandle meshInstance{};
+};
+
+struct LightInstance
+{
+	Renderer::LightHandle light{};
+};
+
+// Entities spawned by a streamed cell, destroyed when it unloads
+struct CellMember
+{
+	Level::CellCoord cell{};
+};
+
+struct Goal
+{
+	glm::vec3 pos{};
+	bool reached{ false };
+};
+
+// Emitters shared by every gameplay effect
+struct Effects
+{
+	ParticleSystem::Handle dust{};
+	ParticleSystem::Handle sparks{};
+	ParticleSystem::Handle confetti{};
+	// F7 keeps it full, to measure a million live particles in the running game
+	ParticleSystem::Handle stress{};
+};
+
+Effects createEffects(ParticleSystem& particles)
+{
+	return
+	{
+		.dust{ particles.addEmitter({
+			.capacity{ 4096 }, .minLifetime{ 0.4f }, .maxLifetime{ 0.8f }, .minSpeed{ 0.5f }, .maxSpeed{ 1.5f },
+			.spread{ 1.4f }, .extent{ 0.6f, 0.0f, 0.6f }, .gravity{ 0.0f, -1.0f, 0.0f }, .drag{ 3.0f },
+			.startColor{ 0.8f, 0.75f, 0.65f, 0.6f }, .endColor{ 0.8f, 0.75f, 0.65f, 0.0f }, .startSize{ 0.15f }, .endSize{ 0.4f } }) },
+		.sparks{ particles.addEmitter({
+			.capacity{ 4096 }, .minLifetime{ 0.2f }, .maxLifetime{ 0.5f }, .minSpeed{ 3.0f }, .maxSpeed{ 7.0f },
+			.spread{ 1.2f }, .drag{ 1.0f },
+			.startColor{ 1.0f, 0.8f, 0.3f, 1.0f }, .endColor{ 1.0f, 0.3f, 0.0f, 0.0f }, .startSize{ 0.06f }, .endSize{ 0.02f }, .additive{ true } }) },
+		.confetti{ particles.addEmitter({
+			.capacity{ 8192 }, .minLifetime{ 2.0f }, .maxLifetime{ 3.5f }, .minSpeed{ 4.0f }, .maxSpeed{ 8.0f },
+			.spread{ 0.6f }, .gravity{ 0.0f, -4.0f, 0.0f }, .drag{ 1.5f },
+			.startColor{ 1.0f, 1.0f, 1.0f, 1.0f }, .endColor{ 1.0f, 1.0f, 1.0f, 0.0f }, .startSize{ 0.08f }, .endSize{ 0.08f }, .colorVariance{ 1.0f } }) },
+		.stress{ particles.addEmitter({
+			.capacity{ 1'000'000 }, .minLifetime{ 2.0f }, .maxLifetime{ 4.0f }, .minSpeed{ 2.0f }, .maxSpeed{ 6.0f },
+			.spread{ 0.8f }, .extent{ 8.0f, 0.0f, 8.0f }, .drag{ 0.2f },
+			.startColor{ 0.4f, 0.7f, 1.0f, 0.5f }, .endColor{ 0.4f, 0.7f, 1.0f, 0.0f }, .startSize{ 0.05f }, .endSize{ 0.05f }, .additive{ true } }) },
+	};
+}
+
 bool AABBvsAABB(const AABB& a, const AABB& b)
 {
 	return ((a.pos.x + a.scl.x >= b.pos.x - b.scl.x)
@@ -39,256 +140,1152 @@ bool AABBvsAABB(const AABB& a, const AABB& b)
 		&& (a.pos.z - a.scl.z <= b.pos.z + b.scl.z));
 }
 
-bool AABBvsAABBs(const AABB& aabb, const std::vector<AABB>& aabbs)
+Ecs::Entity AABBvsEnemies(const AABB& aabb, Ecs::World& world)
 {
-	for (const auto& b : aabbs)
-	{
-		if (AABBvsAABB(aabb, b))
+	Ecs::Entity touched{ Ecs::nullEntity };
+	world.each<const Enemy>([&](Ecs::Entity entity, const Enemy& enemy)
 		{
-			return true;
-		}
-	}
+			if (touched == Ecs::nullEntity && AABBvsAABB(aabb, AABB{ enemy.pos, glm::vec3{ 1.0f } }))
+			{
+				touched = entity;
+			}
+		});
 
-	return false;
+	return touched;
 }
 
-int AABBvsEnemies(const AABB& aabb, const std::vector<Enemy>& enemies)
+// Offset from the player to the orbiting camera, before it is pulled in front of walls
+glm::vec3 cameraOffset(float yaw, float pitch)
 {
-	for (std::size_t i{ 0 }; i < enemies.size(); ++i)
+	return 10.0f * glm::vec3
 	{
-		if (AABBvsAABB(aabb, AABB{ enemies[i].pos, glm::vec3{ 1.0f }}))
-		{
-			return i;
-		}
-	}
-
-	return -1;
+		std::cos(glm::radians(yaw)) * std::cos(glm::radians(pitch)),
+		std::sin(glm::radians(pitch)),
+		-std::sin(glm::radians(yaw)) * std::cos(glm::radians(pitch)),
+	};
 }
 
-void updateEnemies(Renderer& renderer, std::vector<Enemy>& enemies)
+void updateEnemies(Renderer& renderer, JobSystem& jobs, Ecs::World& world, NavGrid& nav, SimLod& simLod,
+	const glm::vec3& playerPos, float yaw, float pitch)
 {
+	const glm::vec3 offset{ cameraOffset(yaw, pitch) };
+	simLod.beginTick(deltaTime, playerPos + offset, -offset);
+
 	float speed{ std::sin(static_cast<float>(glfwGetTime())) + 1.0f };
 
-	for (auto& enemy : enemies)
-	{
-		enemy.pos = 
+	// Patrols are a function of time, so a late update loses nothing
+	world.parallelEach<Enemy, SimLod::State, const Patrol>(jobs, [speed, &simLod](Ecs::Entity entity, Enemy& enemy, SimLod::State& lod, const Patrol& patrol)
 		{
-			(((enemy.b.x - enemy.a.x) / 2.0f) * speed) + enemy.a.x,
-			(((enemy.b.y - enemy.a.y) / 2.0f) * speed) + enemy.a.y,
-			(((enemy.b.z - enemy.a.z) / 2.0f) * speed) + enemy.a.z,
-		};
+			if (!simLod.due(lod))
+			{
+				return;
+			}
 
-		renderer.meshInstances[enemy.meshInstance].transform =
-			glm::translate(glm::mat4{ 1.0f }, enemy.pos);
-	}
+			const glm::vec3 previous{ enemy.pos };
+			enemy.pos =
+			{
+				(((patrol.b.x - patrol.a.x) / 2.0f) * speed) + patrol.a.x,
+				(((patrol.b.y - patrol.a.y) / 2.0f) * speed) + patrol.a.y,
+				(((patrol.b.z - patrol.a.z) / 2.0f) * speed) + patrol.a.z,
+			};
+			simLod.updated(lod, entity.index, previous, enemy.pos);
+		});
+
+	nav.setGoal(playerPos, jobs);
+
+	// Chasers cover every tick they skipped in one step
+	world.parallelEach<Enemy, SimLod::State, const Chaser>(jobs, [&nav, &simLod](Ecs::Entity entity, Enemy& enemy, SimLod::State& lod, const Chaser& chaser)
+		{
+			if (!simLod.due(lod))
+			{
+				return;
+			}
+
+			const glm::vec3 previous{ enemy.pos };
+			const float step{ chaser.speed * lod.elapsed / deltaTime };
+			const glm::vec2 direction{ nav.direction(enemy.pos) };
+			enemy.pos.x += direction.x * step;
+			enemy.pos.z += direction.y * step;
+
+			const float floor{ nav.floorHeight(enemy.pos) };
+			if (floor != -INFINITY)
+			{
+				enemy.pos.y = floor + 1.0f;
+			}
+			simLod.updated(lod, entity.index, previous, enemy.pos);
+		});
+
+	// The renderer is single threaded, so extraction stays serial
+	world.each<const Enemy, const SimLod::State, const RenderInstance>([&](Ecs::Entity, const Enemy& enemy, const SimLod::State& lod, const RenderInstance& instance)
+		{
+			glm::vec3 position{};
+			if (simLod.drawPosition(lod, enemy.pos, position))
+			{
+				renderer.setTransform(instance.meshInstance, glm::translate(glm::mat4{ 1.0f }, position));
+			}
+		});
+
+	simLod.endTick();
+}
+
+void updateCrates(Renderer& renderer, const PhysicsWorld& physics, Ecs::World& world)
+{
+	world.each<const Crate, const RenderInstance>([&](Ecs::Entity, const Crate& crate, const RenderInstance& instance)
+		{
+			const PhysicsWorld::Body* body{ physics.body(crate.body) };
+			if (body && !body->sleeping)
+			{
+				glm::mat4 transform{ glm::translate(glm::mat4{ 1.0f }, body->position) };
+				renderer.setTransform(instance.meshInstance, glm::scale(transform, body->halfExtents));
+			}
+		});
+}
+
+constexpr float lookSensitivity{ 100.0f };
+
+// Turns the camera by how long the arrow keys were held between from and to
+void applyLook(const Input& input, double from, double to, float& yaw, float& pitch)
+{
+	pitch -= lookSensitivity * static_cast<float>(input.heldTime(GLFW_KEY_UP, from, to) - input.heldTime(GLFW_KEY_DOWN, from, to));
+	yaw += lookSensitivity * static_cast<float>(input.heldTime(GLFW_KEY_LEFT, from, to) - input.heldTime(GLFW_KEY_RIGHT, from, to));
 }
 
-void update(Renderer& renderer, float& yaw, float& pitch, glm::vec3& playerPos, const std::vector<AABB>& aabbs, std::vector<Enemy>& enemies)
+void update(Renderer& renderer, JobSystem& jobs, Ecs::World& world, PhysicsWorld& physics, NavGrid& nav, SimLod& simLod, const Effects& effects,
+	PhysicsWorld::BodyHandle playerBody, Renderer::MeshInstanceHandle player, double tickStart, float& yaw, float& pitch, glm::vec3& playerPos)
 {
-	updateEnemies(renderer, enemies);
+	const Memory::TagScope tag{ Memory::Tag::gameplay };
+
+	updateEnemies(renderer, jobs, world, nav, simLod, playerPos, yaw, pitch);
 
-	static glm::vec3 playerVel{ 0.0f };
 	static float airTime{ 1.0f };
 
 	airTime += deltaTime;
 
-	playerVel.y -= 0.6f * deltaTime;
+	// Keys act for the share of the tick they were held, not for whole ticks
+	const double tickEnd{ tickStart + deltaTime };
+	const Input& input{ renderer.input };
+	const auto held{ [&](int key) { return static_cast<float>(input.heldTime(key, tickStart, tickEnd)); } };
+
+	glm::vec3 acceleration{ 0.0f };
 
 	constexpr float moveSpeed{ 1.5f };
-	if (glfwGetKey(renderer.window(), GLFW_KEY_W))
+	const float forward{ held(GLFW_KEY_W) - held(GLFW_KEY_S) };
+	const float left{ held(GLFW_KEY_A) - held(GLFW_KEY_D) };
+	acceleration.x -= std::cos(glm::radians(yaw)) * moveSpeed * forward;
+	acceleration.z += std::sin(glm::radians(yaw)) * moveSpeed * forward;
+	acceleration.z += std::cos(glm::radians(yaw)) * moveSpeed * left;
+	acceleration.x += std::sin(glm::radians(yaw)) * moveSpeed * left;
+
+	physics.addVelocity(playerBody, acceleration);
+
+	if (input.wasDown(GLFW_KEY_SPACE, tickStart, tickEnd) && airTime < 0.1f)
 	{
-		playerVel.x -= std::cos(glm::radians(yaw)) * moveSpeed * deltaTime;
-		playerVel.z += std::sin(glm::radians(yaw)) * moveSpeed * deltaTime;
+		const glm::vec3 velocity{ physics.body(playerBody)->velocity };
+		physics.setVelocity(playerBody, { velocity.x, 0.20f, velocity.z });
 	}
-	if (glfwGetKey(renderer.window(), GLFW_KEY_S))
+
+	applyLook(input, tickStart, tickEnd, yaw, pitch);
+
 	{
-		playerVel.x += std::cos(glm::radians(yaw)) * moveSpeed * deltaTime;
-		playerVel.z -= std::sin(glm::radians(yaw)) * moveSpeed * deltaTime;
+		const Memory::TagScope physicsTag{ Memory::Tag::physics };
+		physics.step();
 	}
-	if (glfwGetKey(renderer.window(), GLFW_KEY_A))
+	updateCrates(renderer, physics, world);
+
+	const PhysicsWorld::Body& body{ *physics.body(playerBody) };
+	playerPos = body.position;
+	if (body.grounded)
 	{
-		playerVel.z += std::cos(glm::radians(yaw)) * moveSpeed * deltaTime;
-		playerVel.x += std::sin(glm::radians(yaw)) * moveSpeed * deltaTime;
+		// A puff of dust at the feet after a real fall, not every step off a ledge
+		if (airTime > 0.3f)
+		{
+			renderer.particles.emit(effects.dust, 24, playerPos - glm::vec3{ 0.0f, body.halfExtents.y, 0.0f });
+		}
+		airTime = 0.0f;
 	}
-	if (glfwGetKey(renderer.window(), GLFW_KEY_D))
+
+	if (playerPos.y < -2.0f)
 	{
-		playerVel.z -= std::cos(glm::radians(yaw)) * moveSpeed * deltaTime;
-		playerVel.x -= std::sin(glm::radians(yaw)) * moveSpeed * deltaTime;
+		playerPos = { 0.0f, 6.0f, 2.3f };
+		physics.setPosition(playerBody, playerPos);
+		physics.setVelocity(playerBody, glm::vec3{ 0.0f });
+		airTime = 1.0f;
 	}
 
-	if (glfwGetKey(renderer.window(), GLFW_KEY_SPACE) && airTime < 0.1f)
+	const Ecs::Entity enemyTouched{ AABBvsEnemies({ playerPos, glm::vec3{ 1.0f } }, world) };
+	if (enemyTouched != Ecs::nullEntity)
 	{
-		playerVel.y = 0.20f;
+		if (physics.body(playerBody)->velocity.y < 0.0f)
+		{
+			const glm::vec3 enemyPos{ world.get<Enemy>(enemyTouched)->pos };
+			renderer.particles.emit(effects.sparks, 48, enemyPos);
+			renderer.particles.emit(effects.dust, 32, enemyPos);
+
+			renderer.removeMeshInstance(world.get<RenderInstance>(enemyTouched)->meshInstance);
+			world.destroy(enemyTouched);
+		}
+		else
+		{
+			playerPos = { 0.0f, 6.0f, 2.3f };
+			physics.setPosition(playerBody, playerPos);
+			physics.setVelocity(playerBody, glm::vec3{ 0.0f });
+			airTime = 1.0f;
+		}
 	}
 
-	constexpr float lookSensitivity{ 100.0f };
-	if (glfwGetKey(renderer.window(), GLFW_KEY_UP)) pitch -= lookSensitivity * deltaTime;
-	if (glfwGetKey(renderer.window(), GLFW_KEY_DOWN)) pitch += lookSensitivity * deltaTime;
-	if (glfwGetKey(renderer.window(), GLFW_KEY_LEFT)) yaw += lookSensitivity * deltaTime;
-	if (glfwGetKey(renderer.window(), GLFW_KEY_RIGHT)) yaw -= lookSensitivity * deltaTime;
+	renderer.setTransform(player, glm::translate(glm::mat4{ 1.0f }, playerPos));
 
-	playerPos.y += playerVel.y;
-	if (AABBvsAABBs({ playerPos, glm::vec3{ 1.0f } }, aabbs))
-	{
-		while (AABBvsAABBs({ playerPos, glm::vec3{ 1.0f } }, aabbs))
+	world.each<Goal>([&](Ecs::Entity, Goal& goal)
 		{
-			playerPos.y += 0.001f;
-		}
-		playerVel.y = 0.0f;
-		airTime = 0.0f;
+			if (!goal.reached && glm::distance(goal.pos, playerPos) < 2.0f)
+			{
+				goal.reached = true;
+				renderer.particles.emit(effects.confetti, 400, goal.pos + glm::vec3{ 0.0f, 1.0f, 0.0f });
+			}
+		});
+
+	// Clocks move with the simulation; poses are evaluated once per rendered frame
+	renderer.animator.advance(deltaTime);
+	renderer.particles.update(deltaTime, &jobs);
+}
+
+// Named after the local time, so captures from different runs never collide
+std::string capturePath(std::string_view prefix, std::string_view extension)
+{
+	const std::time_t now{ std::time(nullptr) };
+	std::tm local{};
+#ifdef _WIN32
+	localtime_s(&local, &now);
+#else
+	localtime_r(&now, &local);
+#endif
+	char stamp[32]{};
+	std::strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", &local);
+	return "captures/" + std::string{ prefix } + "_" + stamp + std::string{ extension };
+}
+
+// Sequences are dumped raw, since PNG encoding cannot keep up with the frame rate
+void toggleRecording(FrameCapture& capture)
+{
+	if (capture.recording())
+	{
+		capture.stopSequence();
+	}
+	else
+	{
+		capture.startSequence(capturePath("sequence", ""), FrameCapture::Encoding::raw);
 	}
+}
 
-	playerPos.x += playerVel.x;
-	if (AABBvsAABBs({ playerPos, glm::vec3{ 1.0f } }, aabbs))
+// One row per category; the bar fills toward the budget and turns red past it
+void drawMemoryRow(std::string_view name, std::size_t bytes, std::size_t highWater, std::size_t budget)
+{
+	constexpr double mebibyte{ 1024.0 * 1024.0 };
+
+	ImGui::TableNextRow();
+	ImGui::TableNextColumn();
+	ImGui::TextUnformatted(name.data(), name.data() + name.size());
+	ImGui::TableNextColumn();
+	ImGui::Text("%.2f", static_cast<double>(bytes) / mebibyte);
+	ImGui::TableNextColumn();
+	ImGui::Text("%.2f", static_cast<double>(highWater) / mebibyte);
+	ImGui::TableNextColumn();
+	if (budget == 0)
 	{
-		while (AABBvsAABBs({ playerPos, glm::vec3{ 1.0f } }, aabbs))
-		{
-			playerPos.x -= playerVel.x / 4.0f;
-		}
-		playerVel.x = 0.0f;
+		ImGui::TextUnformatted("-");
+		return;
+	}
+
+	const bool over{ bytes > budget };
+	if (over)
+	{
+		ImGui::PushStyleColor(ImGuiCol_PlotHistogram, ImVec4{ 0.9f, 0.2f, 0.2f, 1.0f });
+	}
+	char label[32]{};
+	std::snprintf(label, sizeof(label), "%.0f%% of %.0f", 100.0 * static_cast<double>(bytes) / static_cast<double>(budget), static_cast<double>(budget) / mebibyte);
+	ImGui::ProgressBar(std::min(1.0f, static_cast<float>(bytes) / static_cast<float>(budget)), ImVec2{ -1.0f, 0.0f }, label);
+	if (over)
+	{
+		ImGui::PopStyleColor();
+	}
+}
+
+void drawMemoryGui()
+{
+	const Memory::TagScope tag{ Memory::Tag::gui };
+
+	ImGui::Begin("Memory");
+
+	if (ImGui::Button("Dump JSON"))
+	{
+		Memory::writeReport(capturePath("memory", ".json"));
 	}
-	playerVel.x *= 0.7f;
 
-	playerPos.z += playerVel.z;
-	if (AABBvsAABBs({ playerPos, glm::vec3{ 1.0f } }, aabbs))
+	const Memory::Budgets& budgets{ Memory::budgets() };
+	const ImGuiTableFlags flags{ ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg };
+
+	ImGui::SeparatorText("CPU, MiB");
+	if (ImGui::BeginTable("cpu", 4, flags))
 	{
-		while (AABBvsAABBs({ playerPos, glm::vec3{ 1.0f } }, aabbs))
+		ImGui::TableSetupColumn("Tag");
+		ImGui::TableSetupColumn("Live");
+		ImGui::TableSetupColumn("High water");
+		ImGui::TableSetupColumn("Budget");
+		ImGui::TableHeadersRow();
+		for (std::size_t i{ 0 }; i < Memory::tagCount; ++i)
 		{
-			playerPos.z -= playerVel.z / 4.0f;
+			const Memory::TagStats stats{ Memory::tagStats(static_cast<Memory::Tag>(i)) };
+			drawMemoryRow(Memory::tagName(static_cast<Memory::Tag>(i)), stats.bytes, stats.highWater, budgets.cpu[i]);
 		}
-		playerVel.z = 0.0f;
+		const Memory::AllocationStats total{ Memory::allocationStats() };
+		drawMemoryRow("total", total.liveBytes, total.highWater, budgets.cpuTotal);
+		ImGui::EndTable();
 	}
-	playerVel.z *= 0.7f;
 
-	if (playerPos.y < -2.0f)
+	ImGui::SeparatorText("GPU, MiB");
+	if (ImGui::BeginTable("gpu", 4, flags))
 	{
-		playerPos = { 0.0f, 6.0f, 2.3f };
-		playerVel = glm::vec3{ 0.0f };
-		airTime = 1.0f;
+		ImGui::TableSetupColumn("Kind");
+		ImGui::TableSetupColumn("Live");
+		ImGui::TableSetupColumn("High water");
+		ImGui::TableSetupColumn("Budget");
+		ImGui::TableHeadersRow();
+		for (std::size_t i{ 0 }; i < Memory::gpuKindCount; ++i)
+		{
+			const Memory::GpuStats stats{ Memory::gpuStats(static_cast<Memory::GpuKind>(i)) };
+			drawMemoryRow(Memory::gpuKindName(static_cast<Memory::GpuKind>(i)), stats.bytes, stats.highWater, budgets.gpu[i]);
+		}
+		const Memory::GpuStats total{ Memory::gpuTotal() };
+		drawMemoryRow("total", total.bytes, total.highWater, budgets.gpuTotal);
+		ImGui::EndTable();
 	}
 
-	int enemyTouched{ AABBvsEnemies({ playerPos, glm::vec3{ 1.0f } }, enemies) };
-	if (enemyTouched != -1)
+	if (ImGui::CollapsingHeader("GPU assets, KiB") && ImGui::BeginTable("assets", 1 + static_cast<int>(Memory::gpuKindCount), flags))
 	{
-		if (playerVel.y < 0.0f)
+		ImGui::TableSetupColumn("Asset");
+		for (std::size_t i{ 0 }; i < Memory::gpuKindCount; ++i)
 		{
-			renderer.meshInstances[enemies[enemyTouched].meshInstance].show = false;
-			enemies.erase(enemies.begin() + enemyTouched);
+			ImGui::TableSetupColumn(Memory::gpuKindName(static_cast<Memory::GpuKind>(i)).data());
 		}
-		else
+		ImGui::TableHeadersRow();
+		for (const Memory::GpuAsset& asset : Memory::gpuAssets())
 		{
-			playerPos = { 0.0f, 6.0f, 2.3f };
-			playerVel = glm::vec3{ 0.0f };
-			airTime = 1.0f;
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(asset.name.c_str());
+			for (const std::size_t bytes : asset.bytes)
+			{
+				ImGui::TableNextColumn();
+				ImGui::Text("%.1f", static_cast<double>(bytes) / 1024.0);
+			}
 		}
+		ImGui::EndTable();
 	}
 
-	renderer.meshInstances[0].transform = glm::translate(glm::mat4{ 1.0f }, playerPos);
+	ImGui::End();
 }
 
-void drawGui(bool &showAabbs, int& aabbTarget, std::vector<AABB>& aabbs, Renderer& renderer, 
-	const glm::vec3& playerPos, bool& drawShadows)
+void drawGui(bool &showAabbs, int& aabbTarget, Ecs::World& world, PhysicsWorld& physics, const NavGrid& nav, const SimLod& simLod, Renderer& renderer, 
+	const glm::vec3& playerPos, bool& drawShadows, std::uint64_t frameAllocations)
 {
+	const Memory::TagScope tag{ Memory::Tag::gui };
+
 	ImGui::Begin("AABB");
 
 	ImGui::Checkbox("Show", &showAabbs);
 
+	std::pmr::vector<Ecs::Entity> aabbs{ &Memory::frameArena() };
+	world.each<const AABB, const StaticCollider, const RenderInstance>([&](Ecs::Entity entity, const AABB&, const StaticCollider&, const RenderInstance&)
+		{
+			aabbs.push_back(entity);
+		});
+
 	ImGui::InputInt("Target", &aabbTarget);
+	if (aabbTarget > static_cast<int>(aabbs.size()) - 1) aabbTarget = static_cast<int>(aabbs.size()) - 1;
 	if (aabbTarget < 0) aabbTarget = 0;
-	if (aabbTarget > aabbs.size() - 1) aabbTarget = aabbs.size() - 1;
 
-	float pos[3]{ aabbs[aabbTarget].pos.x, aabbs[aabbTarget].pos.y, aabbs[aabbTarget].pos.z };
-	ImGui::InputFloat3("Position", pos);
-	aabbs[aabbTarget].pos = { pos[0], pos[1], pos[2] };
+	if (!aabbs.empty())
+	{
+		AABB& aabb{ *world.get<AABB>(aabbs[aabbTarget]) };
+
+		float pos[3]{ aabb.pos.x, aabb.pos.y, aabb.pos.z };
+		ImGui::InputFloat3("Position", pos);
+		aabb.pos = { pos[0], pos[1], pos[2] };
 
-	float scl[3]{ aabbs[aabbTarget].scl.x, aabbs[aabbTarget].scl.y, aabbs[aabbTarget].scl.z };
-	ImGui::InputFloat3("Scale", scl);
-	aabbs[aabbTarget].scl = { scl[0], scl[1], scl[2] };
+		float scl[3]{ aabb.scl.x, aabb.scl.y, aabb.scl.z };
+		ImGui::InputFloat3("Scale", scl);
+		aabb.scl = { scl[0], scl[1], scl[2] };
 
-	{
-		glm::mat4 transform{ glm::translate(glm::mat4{ 1.0f }, aabbs[aabbTarget].pos) };
-		transform = glm::scale(transform, aabbs[aabbTarget].scl);
-		renderer.meshInstances[aabbs[aabbTarget].meshInstance].transform = transform;
+		{
+			glm::mat4 transform{ glm::translate(glm::mat4{ 1.0f }, aabb.pos) };
+			transform = glm::scale(transform, aabb.scl);
+			renderer.setTransform(world.get<RenderInstance>(aabbs[aabbTarget])->meshInstance, transform);
+			physics.setStatic(world.get<StaticCollider>(aabbs[aabbTarget])->box, aabb.pos, aabb.scl);
+		}
 	}
 
 	ImGui::End();
 
 	ImGui::Begin("Global");
 	ImGui::Text("Player position");
-	ImGui::Text(std::string{ std::to_string(playerPos.x) + ' ' + std::to_string(playerPos.y) + ' ' + std::to_string(playerPos.z) }.c_str());
+	{
+		std::pmr::string position{ &Memory::frameArena() };
+		for (const float value : { playerPos.x, playerPos.y, playerPos.z })
+		{
+			char buffer[32]{};
+			const auto result{ std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::fixed, 6) };
+			position.append(buffer, result.ptr);
+			position.push_back(' ');
+		}
+		ImGui::TextUnformatted(position.c_str());
+	}
 	ImGui::Checkbox("Draw shadows?", &drawShadows);
+	ImGui::Text("GL state calls issued %llu, skipped %llu",
+		static_cast<unsigned long long>(renderer.stateStats().issued),
+		static_cast<unsigned long long>(renderer.stateStats().skipped));
+	ImGui::Text("Render graph passes %zu, culled %zu, transient textures %zu",
+		renderer.renderGraph().passCount(), renderer.renderGraph().culledPassCount(), renderer.renderGraph().physicalTextureCount());
+	{
+		const Renderer::FrameStats& frame{ renderer.frameStats() };
+		ImGui::Checkbox("Dynamic resolution", &renderer.resolution.dynamic);
+		ImGui::SliderFloat("GPU budget (ms)", &renderer.resolution.targetGpuMs, 4.0f, 33.0f);
+		ImGui::Text("GPU %.2f ms, scale %.2f (%dx%d), MSAA %dx", frame.gpuMs, frame.scale, frame.width, frame.height, frame.samples);
+	}
+	{
+		const OcclusionCuller::Stats& occlusion{ renderer.occlusion().stats() };
+		ImGui::Checkbox("Occlusion culling", &renderer.occlusion().enabled);
+		ImGui::Text("Occluders %zu, draws tested %zu, occluded %zu, off screen %zu (%.1f%% rejected), raster %.3f ms",
+			occlusion.occluders, occlusion.tested, occlusion.occluded, occlusion.outside,
+			occlusion.tested ? 100.0 * static_cast<double>(occlusion.occluded + occlusion.outside) / static_cast<double>(occlusion.tested) : 0.0,
+			occlusion.rasterizeMs);
+	}
+	ImGui::Text("Geometry heaps: vertices %zu / %zu, indices %zu / %zu, free blocks %zu, grows %llu, defragments %llu",
+		renderer.vertexHeapStats().used, renderer.vertexHeapStats().capacity, renderer.indexHeapStats().used, renderer.indexHeapStats().capacity,
+		renderer.vertexHeapStats().freeBlocks + renderer.indexHeapStats().freeBlocks,
+		static_cast<unsigned long long>(renderer.vertexHeapStats().grows + renderer.indexHeapStats().grows),
+		static_cast<unsigned long long>(renderer.vertexHeapStats().defragments + renderer.indexHeapStats().defragments));
+	ImGui::Text("Textures %zu, %.1f MiB (%.1f MiB as RGBA8)%s, uploads %.1f ms",
+		renderer.textureStats().textures, static_cast<double>(renderer.textureStats().bytes) / (1024.0 * 1024.0),
+		static_cast<double>(renderer.textureStats().uncompressedBytes) / (1024.0 * 1024.0),
+		renderer.textureStats().s3tc ? "" : ", no S3TC", renderer.textureStats().uploadMs);
+	{
+		FrameCapture& capture{ renderer.capture() };
+		if (ImGui::Button("Screenshot"))
+		{
+			capture.screenshot(capturePath("screenshot", ".png"));
+		}
+		ImGui::SameLine();
+		if (ImGui::Button(capture.recording() ? "Stop recording" : "Record"))
+		{
+			toggleRecording(capture);
+		}
+		ImGui::Text("Captured %llu, written %llu, dropped %llu, in flight %zu, %.3f ms",
+			static_cast<unsigned long long>(capture.stats().captured), static_cast<unsigned long long>(capture.stats().written),
+			static_cast<unsigned long long>(capture.stats().dropped), capture.stats().inFlight, capture.stats().updateMs);
+	}
+	ImGui::Text("Debug lines %zu, timed %zu", renderer.debugDraw.stats().lines, renderer.debugDraw.stats().timedLines);
+	ImGui::Text("Animated characters %zu, joints %zu, posing %.3f ms",
+		renderer.animator.stats().characters, renderer.animator.stats().joints, renderer.animator.stats().evaluateMs);
+	ImGui::Text("Particles %zu / %zu in %zu emitters, spawned %zu, killed %zu, update %.3f ms, instances %.3f ms",
+		renderer.particles.stats().live, renderer.particles.stats().capacity, renderer.particles.stats().emitters,
+		renderer.particles.stats().spawned, renderer.particles.stats().killed, renderer.particles.stats().updateMs, renderer.particles.stats().writeMs);
+	ImGui::Text("Input to photon %.1f ms, last %.1f ms, samples %llu, pending key events %zu",
+		renderer.latencyStats().inputToPhotonMs, renderer.latencyStats().lastMs,
+		static_cast<unsigned long long>(renderer.latencyStats().samples), renderer.input.pendingEvents());
+	ImGui::Text("Point lights %zu, on screen %zu, cluster references %zu, busiest cluster %zu, dropped %zu, binning %.3f ms",
+		renderer.lightStats().lights, renderer.lightStats().visible, renderer.lightStats().references,
+		renderer.lightStats().busiestCluster, renderer.lightStats().dropped, renderer.lightStats().buildMs);
+	ImGui::Text("Physics bodies %zu, awake %zu, islands %zu, contacts %zu",
+		physics.stats().bodies, physics.stats().awake, physics.stats().islands, physics.stats().contacts);
+	ImGui::Text("Enemies %zu, updated %zu, transforms %zu, far or offscreen %zu, %.3f ms",
+		simLod.stats().entities, simLod.stats().updated, simLod.stats().drawn, simLod.stats().far, simLod.stats().tickMs);
+	ImGui::Text("Nav cells %zu, walkable %zu, reachable %zu, rebuilds %llu, last rebuild %.3f ms",
+		nav.stats().cells, nav.stats().walkable, nav.stats().reachable,
+		static_cast<unsigned long long>(nav.stats().rebuilds), nav.stats().lastRebuildMs);
+	ImGui::Text("Heap allocations last frame %llu, frame arena %zu / %zu bytes",
+		static_cast<unsigned long long>(frameAllocations), Memory::frameArena().used(), Memory::frameArena().capacity());
 	ImGui::End();
 }
 
-int main()
+// Moves the camera in front of any level geometry between it and the player. The four rays
+// run along the corners of a small box around the boom, so the near plane stays clear too.
+void pullCameraIn(const LevelStreamer& levelStreamer, const glm::vec3& playerPos, glm::vec3& camPos)
 {
-	Renderer renderer{};
+	const glm::vec3 boom{ camPos - playerPos };
+	const glm::vec3 right{ glm::normalize(glm::cross(boom, glm::vec3{ 0.0f, 1.0f, 0.0f })) * 0.3f };
+	const glm::vec3 up{ 0.0f, 0.3f, 0.0f };
+
+	const std::array<TriangleBvh::Ray, 4> rays
+	{ {
+		{ playerPos + right + up, boom, 1.0f },
+		{ playerPos - right + up, boom, 1.0f },
+		{ playerPos + right - up, boom, 1.0f },
+		{ playerPos - right - up, boom, 1.0f },
+	} };
+	std::array<TriangleBvh::Hit, 4> hits{};
+	levelStreamer.raycastPacket(rays, hits);
+
+	float nearest{ 1.0f };
+	for (const TriangleBvh::Hit& hit : hits)
+	{
+		nearest = std::min(nearest, hit.distance);
+	}
 
-	renderer.init();
+	if (nearest < 1.0f)
+	{
+		camPos = playerPos + boom * std::max(nearest - 0.05f, 0.1f);
+	}
+}
 
-	renderer.loadModel("assets/player.glb");
-	renderer.loadModel("assets/grass.glb");
-	renderer.loadModel("assets/cube.glb");
-	renderer.loadModel("assets/flag.glb");
-	renderer.loadModel("assets/lvl1.glb");
-	renderer.loadModel("assets/enemy.glb");
-	renderer.loadModel("assets/sign.glb");
-	renderer.finalizeModels();
-
-	std::vector<AABB> aabbs{};
-	aabbs.push_back({ { 0.0f, 1.7f, 0.0f }, { 2.0f, 2.0f, 4.2f } });
-	aabbs.push_back({ { 0.0f, 1.7f, -12.0f }, { 2.0f, 2.0f, 4.2f } });
-	aabbs.push_back({ { -6.3f, 2.3f, -14.5f }, { 4.2f, 3.0f, 1.7f } });
-	aabbs.push_back({ { -15.7f, 3.5f, -17.9f }, { 2.0f, 3.5f, 5.0f } });
-	aabbs.push_back({ { -8.4f, 3.9f, -23.4f }, { 2.0f, 4.4f, 2.0f } });
-	
-	std::vector<Enemy> enemies{};
-	enemies.push_back({ { 0.0f, 0.0f, 0.0f }, { -15.7f, 8.0f, -15.0f }, { -15.7f, 8.0f, -21.0f } });
-
-	renderer.meshInstances.push_back({
-			.mesh{ 0 },
-			.transform{ glm::mat4{ 1.0f } },
-		});
+// Leaves value alone when the argument is missing or not a number
+void readCountArgument(int argc, char** argv, int index, std::size_t& value)
+{
+	if (index < argc)
+	{
+		const std::string_view text{ argv[index] };
+		std::from_chars(text.data(), text.data() + text.size(), value);
+	}
+}
 
-	renderer.meshInstances.push_back({
-			.mesh{ 4 },
-			.transform{ glm::mat4{ glm::scale(glm::mat4{ 1.0f }, glm::vec3{ 2.0f }) } },
-		});
+// Headless bot playtesting: platformer --batch [environments] [ticks]
+int runBatch(int argc, char** argv)
+{
+	std::size_t environments{ 65536 };
+	std::size_t ticks{ 600 };
+	readCountArgument(argc, argv, 2, environments);
+	readCountArgument(argc, argv, 3, ticks);
 
-	renderer.meshInstances.push_back({
-			.mesh{ 6 },
-			.transform{ glm::mat4{ glm::translate(glm::mat4{ 1.0f }, glm::vec3{ -1.6f, 3.6f, 2.4f }) } },
-		});
+	JobSystem jobs{};
+	BatchSim sim{ Level::loadManifest("assets/lvl1.json"), environments };
+
+	// Runs towards the level's far end with a per environment heading and jump rhythm
+	const BatchSim::Policy policy{ [](const BatchSim& sim, std::size_t begin, std::size_t end, BatchSim::Input* inputs)
+		{
+			for (std::size_t env{ begin }; env < end; ++env)
+			{
+				std::uint64_t hash{ (env + 1) * 0x9E3779B97F4A7C15ull };
+				hash ^= hash >> 31;
+
+				const std::uint64_t period{ 20 + hash % 40 };
+				inputs[env - begin] =
+				{
+					.forward{ 1.0f },
+					.strafe{ static_cast<float>(static_cast<int>(hash >> 8 & 0xFF) - 128) / 256.0f },
+					.yaw{ -90.0f + static_cast<float>(static_cast<int>(hash >> 16 & 0xFF) - 128) / 4.0f },
+					.jump{ sim.grounded(env) && sim.tick() % period == 0 },
+				};
+			}
+		} };
+
+	const auto start{ std::chrono::steady_clock::now() };
+	for (std::size_t tick{ 0 }; tick < ticks; ++tick)
+	{
+		sim.step(jobs, policy);
+	}
+	const double seconds{ std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() };
+
+	std::uint64_t deaths{ 0 };
+	std::uint64_t kills{ 0 };
+	std::size_t survivors{ 0 };
+	for (std::size_t env{ 0 }; env < sim.environmentCount(); ++env)
+	{
+		deaths += sim.deaths(env);
+		kills += sim.kills(env);
+		survivors += sim.deaths(env) == 0 ? 1 : 0;
+	}
+
+	std::cout << "BATCH: " << sim.environmentCount() << " environments, " << sim.tick() << " ticks on "
+		<< jobs.threadCount() + 1 << " threads in " << seconds << " s, "
+		<< static_cast<double>(sim.environmentSteps()) / seconds << " environment-steps/s\n";
+	std::cout << "BATCH: " << deaths << " deaths, " << kills << " enemies stomped, "
+		<< survivors << " environments never died\n";
+	if (sim.skippedChasers() > 0)
+	{
+		std::cout << "BATCH: " << sim.skippedChasers() << " chasers in the level are not simulated\n";
+	}
+
+	return 0;
+}
+
+// ECS query cost at scale: platformer --ecs-bench [entities] [ticks]
+int runEcsBenchmark(int argc, char** argv)
+{
+	std::size_t count{ 1'000'000 };
+	std::size_t ticks{ 300 };
+	readCountArgument(argc, argv, 2, count);
+	readCountArgument(argc, argv, 3, ticks);
+
+	JobSystem jobs{};
+	Ecs::World world{};
 
-	for (auto& aabb : aabbs)
+	auto start{ std::chrono::steady_clock::now() };
+	for (std::size_t i{ 0 }; i < count; ++i)
 	{
-		aabb.meshInstance = renderer.meshInstances.size();
+		world.create(Enemy{ glm::vec3{ static_cast<float>(i % 1000), 0.0f, static_cast<float>(i / 1000) } }, Chaser{ 0.05f });
+	}
+	const double createMs{ std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() };
 
-		glm::mat4 aabbMat{ glm::translate(glm::mat4{ 1.0f }, aabb.pos) };
-		aabbMat = glm::scale(aabbMat, aabb.scl);
+	// The same two component update as the enemies', serially and over the workers
+	const auto move{ [](Ecs::Entity, Enemy& enemy, const Chaser& chaser) { enemy.pos.x += chaser.speed; } };
 
-		renderer.meshInstances.push_back({
-			.mesh{ 2 },
-			.transform{ aabbMat },
-			.pass{ Renderer::AABB }
+	start = std::chrono::steady_clock::now();
+	for (std::size_t tick{ 0 }; tick < ticks; ++tick)
+	{
+		world.each<Enemy, const Chaser>(move);
+	}
+	const double eachMs{ std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() };
+
+	start = std::chrono::steady_clock::now();
+	for (std::size_t tick{ 0 }; tick < ticks; ++tick)
+	{
+		world.parallelEach<Enemy, const Chaser>(jobs, move);
+	}
+	const double parallelMs{ std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() };
+
+	const double perTick{ 1.0 / static_cast<double>(std::max<std::size_t>(ticks, 1)) };
+	std::cout << "ECS: " << world.entityCount() << " entities in " << world.chunkCount() << " chunks, created in " << createMs << " ms\n";
+	std::cout << "ECS: each " << eachMs * perTick << " ms per tick, parallelEach " << parallelMs * perTick
+		<< " ms per tick on " << jobs.threadCount() + 1 << " threads\n";
+
+	return 0;
+}
+
+// Flow field cost with many agents: platformer --nav-bench [agents] [ticks]
+int runNavBenchmark(int argc, char** argv)
+{
+	std::size_t agents{ 10000 };
+	std::size_t ticks{ 600 };
+	readCountArgument(argc, argv, 2, agents);
+	readCountArgument(argc, argv, 3, ticks);
+
+	JobSystem jobs{};
+	const Level::Manifest manifest{ Level::loadManifest("assets/lvl1.json") };
+	NavGrid nav{ manifest };
+
+	std::vector<Level::Box> boxes{};
+	for (const Level::CellDesc& cell : manifest.cells)
+	{
+		boxes.insert(boxes.end(), cell.boxes.begin(), cell.boxes.end());
+	}
+	if (boxes.empty())
+	{
+		std::cerr << "NAV, ERROR: The level has no boxes to walk on\n";
+		return 1;
+	}
+
+	// Agents spread over every box top, and a goal that walks over them in turn
+	std::vector<glm::vec3> positions(agents);
+	for (std::size_t i{ 0 }; i < agents; ++i)
+	{
+		const Level::Box& box{ boxes[i % boxes.size()] };
+		const float u{ static_cast<float>(i * 7919 % 1000) / 1000.0f * 2.0f - 1.0f };
+		const float v{ static_cast<float>(i * 104729 % 1000) / 1000.0f * 2.0f - 1.0f };
+		positions[i] = { box.pos.x + box.scl.x * u, box.pos.y + box.scl.y + 1.0f, box.pos.z + box.scl.z * v };
+	}
+
+	double rebuildMs{ 0.0 };
+	const auto start{ std::chrono::steady_clock::now() };
+	for (std::size_t tick{ 0 }; tick < ticks; ++tick)
+	{
+		const Level::Box& target{ boxes[tick / 60 % boxes.size()] };
+		if (nav.setGoal(target.pos + glm::vec3{ 0.0f, target.scl.y + 1.0f, 0.0f }, jobs))
+		{
+			rebuildMs += nav.stats().lastRebuildMs;
+		}
+
+		jobs.parallelFor(agents, 1024, [&](std::size_t begin, std::size_t end)
+			{
+				for (std::size_t i{ begin }; i < end; ++i)
+				{
+					const glm::vec2 direction{ nav.direction(positions[i]) };
+					positions[i].x += direction.x * 0.05f;
+					positions[i].z += direction.y * 0.05f;
+				}
 			});
 	}
+	const double seconds{ std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() };
+
+	std::cout << "NAV: " << nav.stats().cells << " cells, " << nav.stats().walkable << " walkable, "
+		<< nav.stats().rebuilds << " rebuilds averaging " << rebuildMs / static_cast<double>(std::max<std::uint64_t>(nav.stats().rebuilds, 1)) << " ms\n";
+	std::cout << "NAV: " << agents << " agents for " << ticks << " ticks in " << seconds << " s, "
+		<< seconds * 1e9 / static_cast<double>(std::max<std::size_t>(agents * ticks, 1)) << " ns per agent step\n";
+
+	return 0;
+}
+
+// Collision BVH build and query throughput: platformer --bvh-bench [model.glb] [tiles]
+int runBvhBenchmark(int argc, char** argv)
+{
+	const std::string path{ argc > 2 ? argv[2] : "assets/grass.glb" };
+	std::size_t tiles{ 4 };
+	readCountArgument(argc, argv, 3, tiles);
+
+	const ModelLoader::Mesh mesh{ ModelLoader::loadGLB(path) };
+
+	std::vector<TriangleBvh::Triangle> single{};
+	ModelLoader::appendCollisionTriangles(mesh, glm::mat4{ 1.0f }, single);
+	if (single.empty())
+	{
+		std::cerr << "BVH, ERROR: " << path << " has no triangles\n";
+		return 1;
+	}
+
+	glm::vec3 min{ INFINITY };
+	glm::vec3 max{ -INFINITY };
+	for (const TriangleBvh::Triangle& triangle : single)
+	{
+		min = glm::min(min, glm::min(triangle.v0, glm::min(triangle.v1, triangle.v2)));
+		max = glm::max(max, glm::max(triangle.v0, glm::max(triangle.v1, triangle.v2)));
+	}
+
+	// Copies laid side by side on XZ so the scene can be scaled up from one model
+	const glm::vec3 size{ max - min };
+	std::vector<TriangleBvh::Triangle> triangles{};
+	for (std::size_t z{ 0 }; z < tiles; ++z)
+	{
+		for (std::size_t x{ 0 }; x < tiles; ++x)
+		{
+			ModelLoader::appendCollisionTriangles(mesh, glm::translate(glm::mat4{ 1.0f }, glm::vec3{ size.x * x, 0.0f, size.z * z }), triangles);
+		}
+	}
+	max = min + size * glm::vec3{ static_cast<float>(tiles), 1.0f, static_cast<float>(tiles) };
+
+	const TriangleBvh bvh{ triangles };
+	std::cout << "BVH: " << bvh.stats().triangles << " triangles, " << bvh.stats().nodes << " nodes, "
+		<< bvh.stats().leaves << " leaves, depth " << bvh.stats().depth << ", built in " << bvh.stats().buildMs << " ms\n";
+
+	// Ground probes: bundles of eight downward rays a body width apart
+	std::mt19937 random{ 1 };
+	std::uniform_real_distribution<float> unit{ 0.0f, 1.0f };
+	constexpr std::size_t bundleSize{ 8 };
+	std::vector<TriangleBvh::Ray> rays{};
+	for (std::size_t bundle{ 0 }; bundle < 100000; ++bundle)
+	{
+		const glm::vec3 origin{ min.x + size.x * tiles * unit(random), max.y + 1.0f, min.z + size.z * tiles * unit(random) };
+		for (std::size_t i{ 0 }; i < bundleSize; ++i)
+		{
+			rays.push_back({ origin + glm::vec3{ (i & 1) * 0.5f, 0.0f, (i >> 1) * 0.25f }, glm::vec3{ 0.0f, -1.0f, 0.0f } });
+		}
+	}
+	std::vector<TriangleBvh::Hit> hits(rays.size());
 
-	for (auto& enemy : enemies)
+	const auto time{ [](auto&& run)
+		{
+			const auto start{ std::chrono::steady_clock::now() };
+			run();
+			return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		} };
+
+	const double singleSeconds{ time([&]()
+		{
+			for (std::size_t i{ 0 }; i < rays.size(); ++i)
+			{
+				hits[i] = {};
+				bvh.raycast(rays[i], hits[i]);
+			}
+		}) };
+
+	const double packetSeconds{ time([&]()
+		{
+			std::fill(hits.begin(), hits.end(), TriangleBvh::Hit{});
+			for (std::size_t i{ 0 }; i < rays.size(); i += bundleSize)
+			{
+				bvh.raycastPacket(std::span{ rays }.subspan(i, bundleSize), std::span{ hits }.subspan(i, bundleSize));
+			}
+		}) };
+
+	// One sphere cast and one box query per bundle
+	const double bundles{ static_cast<double>(rays.size() / bundleSize) };
+	const double sphereSeconds{ time([&]()
+		{
+			for (std::size_t i{ 0 }; i < rays.size(); i += bundleSize)
+			{
+				TriangleBvh::Hit hit{};
+				bvh.sphereCast(rays[i], 0.5f, hit);
+			}
+		}) };
+
+	std::size_t overlapping{ 0 };
+	const double overlapSeconds{ time([&]()
+		{
+			for (std::size_t i{ 0 }; i < rays.size(); i += bundleSize)
+			{
+				const glm::vec3 centre{ rays[i].origin.x, min.y + size.y * 0.5f, rays[i].origin.z };
+				overlapping += bvh.overlaps(centre - 0.5f, centre + 0.5f) ? 1 : 0;
+			}
+		}) };
+
+	std::cout << "BVH: raycast " << static_cast<double>(rays.size()) / singleSeconds / 1e6 << " Mrays/s, packets of " << bundleSize << ' '
+		<< static_cast<double>(rays.size()) / packetSeconds / 1e6 << " Mrays/s\n";
+	std::cout << "BVH: sphere cast " << bundles / sphereSeconds / 1e6 << " M/s, box overlap "
+		<< bundles / overlapSeconds / 1e6 << " M/s (" << overlapping << " touching)\n";
+
+	return 0;
+}
+
+// Particle cost at a steady population: platformer --particle-bench [particles] [frames]
+int runParticleBenchmark(int argc, char** argv)
+{
+	std::size_t count{ 1'000'000 };
+	std::size_t frames{ 300 };
+	readCountArgument(argc, argv, 2, count);
+	readCountArgument(argc, argv, 3, frames);
+
+	JobSystem jobs{};
+	ParticleSystem particles{};
+	const ParticleSystem::Handle emitter{ particles.addEmitter({
+		.capacity{ static_cast<std::uint32_t>(count) }, .minLifetime{ 2.0f }, .maxLifetime{ 4.0f }, .spread{ 0.8f }, .drag{ 0.2f } }) };
+	particles.emit(emitter, count, glm::vec3{ 0.0f });
+
+	// Stands in for the mapped buffer the renderer writes into
+	std::vector<ParticleSystem::Instance> instances{};
+	double updateMs{ 0.0 };
+	double writeMs{ 0.0 };
+	std::size_t live{ 0 };
+	for (std::size_t frame{ 0 }; frame < frames; ++frame)
+	{
+		// Refills what died, so the population holds at count
+		particles.emit(emitter, count, glm::vec3{ 0.0f });
+		particles.update(deltaTime, &jobs);
+
+		instances.resize(particles.liveCount());
+		particles.writeInstances(instances, &jobs);
+
+		updateMs += particles.stats().updateMs;
+		writeMs += particles.stats().writeMs;
+		live += particles.stats().live;
+	}
+
+	const double perFrame{ 1.0 / static_cast<double>(std::max<std::size_t>(frames, 1)) };
+	std::cout << "PARTICLES: " << static_cast<double>(live) * perFrame << " live on " << jobs.threadCount() + 1 << " threads, update "
+		<< updateMs * perFrame << " ms, instances " << writeMs * perFrame << " ms ("
+		<< static_cast<double>(sizeof(ParticleSystem::Instance) * count) / (1024.0 * 1024.0) << " MiB uploaded per frame)\n";
+
+	return 0;
+}
+
+// Mean, median, 95th percentile and worst of per frame samples
+nlohmann::json summarize(std::vector<double> samples)
+{
+	if (samples.empty())
+	{
+		return nullptr;
+	}
+
+	std::sort(samples.begin(), samples.end());
+	double sum{ 0.0 };
+	for (const double sample : samples)
+	{
+		sum += sample;
+	}
+	const auto percentile{ [&](double p) { return samples[static_cast<std::size_t>(p * static_cast<double>(samples.size() - 1))]; } };
+	return { { "mean", sum / static_cast<double>(samples.size()) }, { "p50", percentile(0.5) }, { "p95", percentile(0.95) }, { "max", samples.back() } };
+}
+
+// Renderer scaling on a generated scene, in a hidden window with vsync off:
+// platformer --render-bench [instances] [aabbs] [enemies] [textured meshes] [frames] [--egl]
+// Prints one JSON object to stdout; everything else goes to stderr. With --egl and
+// LIBGL_ALWAYS_SOFTWARE=1 it runs on Mesa's llvmpipe, for hosts without a GPU.
+int runRenderBenchmark(int argc, char** argv)
+{
+	std::size_t instanceCount{ 10000 };
+	std::size_t aabbCount{ 1000 };
+	std::size_t enemyCount{ 1000 };
+	std::size_t texturedCount{ 16 };
+	std::size_t frames{ 300 };
+	readCountArgument(argc, argv, 2, instanceCount);
+	readCountArgument(argc, argv, 3, aabbCount);
+	readCountArgument(argc, argv, 4, enemyCount);
+	readCountArgument(argc, argv, 5, texturedCount);
+	readCountArgument(argc, argv, 6, frames);
+	const bool egl{ std::find(argv + 2, argv + argc, std::string_view{ "--egl" }) != argv + argc };
+
+	Renderer renderer{};
+	if (!renderer.init({ .visible{ false }, .egl{ egl }, .vsync{ false } }))
+	{
+		return 1;
+	}
+	// Fixed scale and no MSAA, so runs compare across hosts and software rasterizers finish
+	renderer.resolution = { .dynamic{ false }, .maxSamples{ 1 } };
+
+	JobSystem jobs{};
+	renderer.setJobSystem(jobs);
+
+	Ecs::World world{};
+	NavGrid nav{ Level::loadManifest("assets/lvl1.json") };
+	SimLod simLod{};
+
+	const Renderer::MeshHandle cubeMesh{ renderer.loadModel("assets/cube.glb") };
+	const Renderer::MeshHandle enemyMesh{ renderer.loadModel("assets/enemy.glb") };
+	std::vector<Renderer::MeshHandle> meshes{ cubeMesh, renderer.loadModel("assets/player.glb"), renderer.loadModel("assets/flag.glb") };
+	for (std::size_t i{ 0 }; i < texturedCount; ++i)
 	{
-		enemy.meshInstance = renderer.meshInstances.size();
+		meshes.push_back(renderer.addModel(StressScene::texturedCube(static_cast<std::uint32_t>(i))));
+	}
 
-		renderer.meshInstances.push_back({
-			.mesh{ 5 },
-			.transform{ glm::mat4{ 1.0f } }
+	// The area grows with the object count, so density and the share on screen stay put
+	const float extent{ std::max(20.0f, 2.0f * std::sqrt(static_cast<float>(instanceCount + aabbCount + enemyCount))) };
+	std::size_t scattered{ 0 };
+
+	for (std::size_t i{ 0 }; i < instanceCount; ++i, ++scattered)
+	{
+		const float scale{ 0.3f + StressScene::random(scattered, 3) };
+		const glm::mat4 rotation{ glm::rotate(glm::mat4{ 1.0f }, StressScene::random(scattered, 4) * glm::two_pi<float>(), glm::vec3{ 0.0f, 1.0f, 0.0f }) };
+		renderer.addMeshInstance(meshes[i % meshes.size()],
+			glm::translate(glm::mat4{ 1.0f }, StressScene::scatter(scattered, extent, 4.0f)) * rotation * glm::scale(glm::mat4{ 1.0f }, glm::vec3{ scale }));
+	}
+
+	for (std::size_t i{ 0 }; i < aabbCount; ++i, ++scattered)
+	{
+		const AABB aabb{ StressScene::scatter(scattered, extent, 4.0f), glm::vec3{ 0.5f + StressScene::random(scattered, 3) * 2.0f, 0.5f, 0.5f + StressScene::random(scattered, 4) * 2.0f } };
+		const Renderer::MeshInstanceHandle meshInstance{ renderer.addMeshInstance(cubeMesh, glm::scale(glm::translate(glm::mat4{ 1.0f }, aabb.pos), aabb.scl)) };
+		// Drawn as the very cube it occludes with, so the occluder is exact
+		renderer.setOccluder(meshInstance, true);
+		world.create(aabb, RenderInstance{ meshInstance });
+	}
+
+	for (std::size_t i{ 0 }; i < enemyCount; ++i, ++scattered)
+	{
+		const glm::vec3 a{ StressScene::scatter(scattered, extent, 4.0f) };
+		const glm::vec3 b{ a + glm::vec3{ StressScene::random(scattered, 3) * 8.0f - 4.0f, 0.0f, StressScene::random(scattered, 4) * 8.0f - 4.0f } };
+		world.create(Enemy{ a }, Patrol{ a, b }, SimLod::State{}, RenderInstance{ renderer.addMeshInstance(enemyMesh, glm::translate(glm::mat4{ 1.0f }, a)) });
+	}
+
+	// Frames before this are left out, while heaps, caches and GPU timers settle
+	const std::size_t warmup{ std::min<std::size_t>(frames / 10, 30) };
+	std::vector<double> submitMs{};
+	std::vector<double> frameMs{};
+	std::vector<double> gpuMs{};
+	std::vector<double> drawCalls{};
+	std::vector<double> stateChanges{};
+	std::uint64_t gpuSamples{ renderer.frameStats().gpuSamples };
+
+	const glm::mat4 proj{ glm::perspective(glm::radians(90.0f), renderer.aspectRatio(), 0.01f, 1000.0f) };
+	const auto start{ std::chrono::steady_clock::now() };
+	for (std::size_t frame{ 0 }; frame < frames; ++frame)
+	{
+		const auto frameStart{ std::chrono::steady_clock::now() };
+
+		// Once around the middle of the scene over the run, looking down at it
+		const float yaw{ 360.0f * static_cast<float>(frame) / static_cast<float>(std::max<std::size_t>(frames, 1)) };
+		const float pitch{ 30.0f };
+		const glm::vec3 center{ 0.0f };
+		updateEnemies(renderer, jobs, world, nav, simLod, center, yaw, pitch);
+
+		Memory::frameArena().reset();
+		renderer.pollEvents();
+		renderer.beginFrame();
+
+		world.each<const AABB>([&](Ecs::Entity, const AABB& aabb)
+			{
+				renderer.debugDraw.box(aabb.pos - aabb.scl, aabb.pos + aabb.scl, DebugDraw::red);
 			});
+
+		const glm::mat4 view{ glm::lookAt(center + cameraOffset(yaw, pitch), center, { 0.0f, 1.0f, 0.0f }) };
+		renderer.render(view, proj, false);
+
+		if (frame < warmup)
+		{
+			gpuSamples = renderer.frameStats().gpuSamples;
+			continue;
+		}
+
+		const Renderer::FrameStats& stats{ renderer.frameStats() };
+		submitMs.push_back(stats.submitMs);
+		frameMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+		drawCalls.push_back(static_cast<double>(stats.drawCalls));
+		stateChanges.push_back(static_cast<double>(renderer.stateStats().issued));
+		// Timer results arrive a few frames late and only when ready
+		if (stats.gpuSamples != gpuSamples)
+		{
+			gpuMs.push_back(stats.lastGpuMs);
+			gpuSamples = stats.gpuSamples;
+		}
+	}
+	const double seconds{ std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() };
+
+	const nlohmann::json report
+	{
+		{ "renderer", reinterpret_cast<const char*>(glGetString(GL_RENDERER)) },
+		{ "version", reinterpret_cast<const char*>(glGetString(GL_VERSION)) },
+		{ "scene", { { "instances", instanceCount }, { "aabbs", aabbCount }, { "enemies", enemyCount },
+			{ "texturedMeshes", texturedCount }, { "extent", extent } } },
+		{ "width", renderer.frameStats().width },
+		{ "height", renderer.frameStats().height },
+		{ "frames", frames },
+		{ "warmup", warmup },
+		{ "seconds", seconds },
+		{ "cpuSubmitMs", summarize(std::move(submitMs)) },
+		{ "frameMs", summarize(std::move(frameMs)) },
+		{ "gpuMs", summarize(std::move(gpuMs)) },
+		{ "drawCalls", summarize(std::move(drawCalls)) },
+		{ "stateChanges", summarize(std::move(stateChanges)) },
+	};
+	std::cout << report.dump(1, '\t') << '\n';
+
+	renderer.cleanup();
+
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 1 && std::string_view{ argv[1] } == "--batch")
+	{
+		return runBatch(argc, argv);
+	}
+	if (argc > 1 && std::string_view{ argv[1] } == "--ecs-bench")
+	{
+		return runEcsBenchmark(argc, argv);
+	}
+	if (argc > 1 && std::string_view{ argv[1] } == "--nav-bench")
+	{
+		return runNavBenchmark(argc, argv);
+	}
+	if (argc > 1 && std::string_view{ argv[1] } == "--bvh-bench")
+	{
+		return runBvhBenchmark(argc, argv);
 	}
+	if (argc > 1 && std::string_view{ argv[1] } == "--particle-bench")
+	{
+		return runParticleBenchmark(argc, argv);
+	}
+	if (argc > 1 && std::string_view{ argv[1] } == "--render-bench")
+	{
+		return runRenderBenchmark(argc, argv);
+	}
+
+	Renderer renderer{};
+
+	if (!renderer.init())
+	{
+		return 1;
+	}
+
+	const Renderer::MeshHandle playerMesh{ renderer.loadModel("assets/player.glb") };
+	renderer.loadModel("assets/grass.glb");
+	const Renderer::MeshHandle cubeMesh{ renderer.loadModel("assets/cube.glb") };
+	const Renderer::MeshHandle flagMesh{ renderer.loadModel("assets/flag.glb") };
+	const Renderer::MeshHandle enemyMesh{ renderer.loadModel("assets/enemy.glb") };
+
+	const Renderer::MeshInstanceHandle player{ renderer.addMeshInstance(playerMesh, glm::mat4{ 1.0f }) };
+
+	const Effects effects{ createEffects(renderer.particles) };
+
+	Ecs::World world{};
+
+	glm::vec3 playerPos{ 0.0f, 6.0f, 2.3f };
+
+	PhysicsWorld physics{};
+	const PhysicsWorld::BodyHandle playerBody{ physics.addBody({ .position{ playerPos }, .halfExtents{ glm::vec3{ 1.0f } }, .canSleep{ false } }) };
+
+	JobSystem jobs{};
+	renderer.setJobSystem(jobs);
+	Level::Manifest manifest{ Level::loadManifest("assets/lvl1.json") };
+	Memory::setBudgets(manifest.budgets);
+	NavGrid nav{ manifest };
+	SimLod simLod{};
+	LevelStreamer levelStreamer{ renderer, jobs, std::move(manifest) };
+
+	levelStreamer.setCallbacks(
+		[&](const LevelStreamer::Cell& cell)
+		{
+			const Memory::TagScope tag{ Memory::Tag::gameplay };
+
+			for (const auto& box : cell.desc->boxes)
+			{
+				glm::mat4 aabbMat{ glm::translate(glm::mat4{ 1.0f }, box.pos) };
+				aabbMat = glm::scale(aabbMat, box.scl);
+
+				// Collision boxes are never drawn as meshes; debug draw outlines them on request.
+				// They are gameplay volumes that may stick out of the art, so only the ones the
+				// manifest marks as lying inside it occlude.
+				const Renderer::MeshInstanceHandle meshInstance{ renderer.addMeshInstance(cubeMesh, aabbMat) };
+				renderer.setVisible(meshInstance, false);
+				renderer.setOccluder(meshInstance, box.occluder);
+
+				world.create(AABB{ box.pos, box.scl }, StaticCollider{ physics.addStatic(box.pos, box.scl) },
+					RenderInstance{ meshInstance }, CellMember{ cell.desc->coord });
+			}
+
+			for (const auto& position : cell.desc->crates)
+			{
+				const PhysicsWorld::BodyHandle body{ physics.addBody({ .position{ position } }) };
+
+				glm::mat4 crateMat{ glm::translate(glm::mat4{ 1.0f }, position) };
+				crateMat = glm::scale(crateMat, physics.body(body)->halfExtents);
+
+				const Renderer::MeshInstanceHandle meshInstance{ renderer.addMeshInstance(cubeMesh, crateMat) };
+
+				world.create(Crate{ body }, RenderInstance{ meshInstance }, CellMember{ cell.desc->coord });
+			}
+
+			for (const auto& light : cell.desc->lights)
+			{
+				world.create(LightInstance{ renderer.lights.insert({ light.pos, light.radius, light.color, light.intensity }) }, CellMember{ cell.desc->coord });
+			}
+
+			for (const auto& spawn : cell.desc->enemies)
+			{
+				const Renderer::MeshInstanceHandle meshInstance{ renderer.addMeshInstance(enemyMesh, glm::mat4{ 1.0f }) };
+
+				if (spawn.chase)
+				{
+					world.create(Enemy{ spawn.a }, Chaser{ 0.05f }, SimLod::State{}, RenderInstance{ meshInstance }, CellMember{ cell.desc->coord });
+				}
+				else
+				{
+					world.create(Enemy{ spawn.a }, Patrol{ spawn.a, spawn.b }, SimLod::State{}, RenderInstance{ meshInstance }, CellMember{ cell.desc->coord });
+				}
+			}
+
+			for (const glm::vec3& position : cell.desc->goals)
+			{
+				const Renderer::MeshInstanceHandle meshInstance{ renderer.addMeshInstance(flagMesh, glm::translate(glm::mat4{ 1.0f }, position)) };
+				world.create(Goal{ position }, RenderInstance{ meshInstance }, CellMember{ cell.desc->coord });
+			}
+		},
+		[&](const LevelStreamer::Cell& cell)
+		{
+			const Memory::TagScope tag{ Memory::Tag::gameplay };
+
+			std::vector<Ecs::Entity> unloaded{};
+			world.each<const CellMember>([&](Ecs::Entity entity, const CellMember& member)
+				{
+					if (member.cell == cell.desc->coord)
+					{
+						unloaded.push_back(entity);
+					}
+				});
+
+			for (const Ecs::Entity entity : unloaded)
+			{
+				if (const RenderInstance* instance{ world.get<RenderInstance>(entity) })
+				{
+					renderer.removeMeshInstance(instance->meshInstance);
+				}
+				if (const LightInstance* light{ world.get<LightInstance>(entity) })
+				{
+					renderer.lights.erase(light->light);
+				}
+				if (const StaticCollider* collider{ world.get<StaticCollider>(entity) })
+				{
+					physics.removeStatic(collider->box);
+				}
+				if (const Crate* crate{ world.get<Crate>(entity) })
+				{
+					physics.removeBody(crate->body);
+				}
+				world.destroy(entity);
+			}
+		});
 
 	glm::mat4 proj{ glm::perspective(glm::radians(90.0f), 16.0f / 9.0f, 0.01f, 1000.0f) };
 
 	glm::mat4 view{ glm::translate(glm::mat4{ 1.0f }, glm::vec3{ 0.0f, 0.0f, -2.0f }) };
 
-	glm::vec3 playerPos{ 0.0f, 6.0f, 2.3f };
+	levelStreamer.update(playerPos);
+	levelStreamer.flush();
 
 	float yaw{ -90.0f };
 	float pitch{ 0.0f };
@@ -299,48 +1296,151 @@ int main()
 	bool drawShadows{ false };
 
 	float accumulator{ 0.0f };
-	float lastTime{ static_cast<float>(glfwGetTime()) };
+	double lastTime{ glfwGetTime() };
 	bool drawn{ false };
 
+	std::uint64_t lastAllocations{ Memory::allocationStats().allocations };
+	std::uint64_t frameAllocations{ 0 };
+
+	// F12 takes a screenshot, F9 starts and stops a frame sequence, F8 dumps the memory report,
+	// F7 starts and stops the particle stress test, F6 shows and hides the memory window,
+	// F1 the stats window
+	bool showGui{ false };
+	bool guiHeld{ false };
+	bool showMemory{ false };
+	bool memoryHeld{ false };
+	bool screenshotHeld{ false };
+	bool recordHeld{ false };
+	bool reportHeld{ false };
+	bool stressHeld{ false };
+	bool stressParticles{ false };
+
 	while (!renderer.windowShouldClose())
 	{
-		float currentTime{ static_cast<float>(glfwGetTime()) };
-		accumulator += currentTime - lastTime;
+		renderer.pollEvents();
+
+		const double currentTime{ glfwGetTime() };
+		accumulator += static_cast<float>(currentTime - lastTime);
 		lastTime = currentTime;
 
+		// Everything polled so far happened before the ticks below are simulated, so they
+		// see it now rather than a frame later
+		renderer.input.deferTo(currentTime - accumulator);
+
 		while (accumulator > ::deltaTime)
 		{
-			update(renderer, yaw, pitch, playerPos, aabbs, enemies);
+			// The wall clock span this tick simulates, which its key events are matched against
+			const double tickStart{ currentTime - accumulator };
+			update(renderer, jobs, world, physics, nav, simLod, effects, playerBody, player, tickStart, yaw, pitch, playerPos);
+
+			if (stressParticles)
+			{
+				renderer.particles.emit(effects.stress, 20000, playerPos);
+			}
 
 			accumulator -= deltaTime;
 			drawn = false;
 		}
 
+		// Every tick has consumed the events before the simulation's present
+		const double simulatedTime{ currentTime - accumulator };
+		renderer.input.discardBefore(simulatedTime);
+
+		levelStreamer.update(playerPos);
+
 		if (drawn)
 		{
 			
 		}
 		else
 		{
-			glm::vec3 camPos
+			const std::uint64_t allocations{ Memory::allocationStats().allocations };
+			frameAllocations = allocations - lastAllocations;
+			lastAllocations = allocations;
+
+			Memory::frameArena().reset();
+			Memory::checkBudgets();
+
+			const bool screenshotKey{ glfwGetKey(renderer.window(), GLFW_KEY_F12) == GLFW_PRESS };
+			const bool recordKey{ glfwGetKey(renderer.window(), GLFW_KEY_F9) == GLFW_PRESS };
+			const bool reportKey{ glfwGetKey(renderer.window(), GLFW_KEY_F8) == GLFW_PRESS };
+			const bool stressKey{ glfwGetKey(renderer.window(), GLFW_KEY_F7) == GLFW_PRESS };
+			const bool memoryKey{ glfwGetKey(renderer.window(), GLFW_KEY_F6) == GLFW_PRESS };
+			const bool guiKey{ glfwGetKey(renderer.window(), GLFW_KEY_F1) == GLFW_PRESS };
+			if (screenshotKey && !screenshotHeld)
 			{
-				playerPos.x + 10.0f * (std::cos(glm::radians(yaw)) * std::cos(glm::radians(pitch))),
-					playerPos.y + 10.0f * std::sin(glm::radians(pitch)),
-					playerPos.z - 10.0f * (std::sin(glm::radians(yaw)) * std::cos(glm::radians(pitch)))
-			};
-
-			view = glm::lookAt(camPos, playerPos, { 0.0f, 1.0f, 0.0f });
+				renderer.capture().screenshot(capturePath("screenshot", ".png"));
+			}
+			if (recordKey && !recordHeld)
+			{
+				toggleRecording(renderer.capture());
+			}
+			if (reportKey && !reportHeld)
+			{
+				Memory::writeReport(capturePath("memory", ".json"));
+			}
+			if (stressKey && !stressHeld)
+			{
+				stressParticles = !stressParticles;
+			}
+			if (memoryKey && !memoryHeld)
+			{
+				showMemory = !showMemory;
+			}
+			if (guiKey && !guiHeld)
+			{
+				showGui = !showGui;
+			}
+			screenshotHeld = screenshotKey;
+			recordHeld = recordKey;
+			reportHeld = reportKey;
+			stressHeld = stressKey;
+			memoryHeld = memoryKey;
+			guiHeld = guiKey;
 
 			renderer.beginFrame();
 
-			//drawGui(drawAabbs, aabbTarget, aabbs, renderer, playerPos, drawShadows);
+			if (showGui)
+			{
+				drawGui(drawAabbs, aabbTarget, world, physics, nav, simLod, renderer, playerPos, drawShadows, frameAllocations);
+			}
+			if (showMemory)
+			{
+				drawMemoryGui();
+			}
+
+			if (drawAabbs)
+			{
+				int index{ 0 };
+				// Same walk as the GUI's, so the highlighted box is its target
+				world.each<const AABB, const StaticCollider, const RenderInstance>([&](Ecs::Entity, const AABB& aabb, const StaticCollider&, const RenderInstance&)
+					{
+						const glm::vec4 color{ index++ == aabbTarget ? glm::vec4{ 1.0f, 1.0f, 0.0f, 1.0f } : DebugDraw::red };
+						renderer.debugDraw.box(aabb.pos - aabb.scl, aabb.pos + aabb.scl, color);
+					});
+			}
+
+			// Late latch: poll once more and turn the camera by the look keys held since the last
+			// tick, up to now, so orientation is as fresh as possible when the frame is submitted
+			renderer.pollEvents();
+			float latchedYaw{ yaw };
+			float latchedPitch{ pitch };
+			applyLook(renderer.input, simulatedTime, glfwGetTime(), latchedYaw, latchedPitch);
+
+			glm::vec3 camPos{ playerPos + cameraOffset(latchedYaw, latchedPitch) };
+
+			pullCameraIn(levelStreamer, playerPos, camPos);
+
+			view = glm::lookAt(camPos, playerPos, { 0.0f, 1.0f, 0.0f });
+			proj = glm::perspective(glm::radians(90.0f), renderer.aspectRatio(), 0.01f, 1000.0f);
 
-			renderer.render(proj * view, drawShadows, drawAabbs);
+			renderer.render(view, proj, drawShadows);
 
 			drawn = true;
 		}
 	}
 
+	levelStreamer.unloadAll();
 	renderer.cleanup();
 
 	return 0;
@@ -0,0 +1,106 @@
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(std::string_view path)
+{
+	const std::string terminated{ path };
+	HANDLE file{ CreateFileA(terminated.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr) };
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		std::cerr << "ENGINE, ERROR, MEDIUM, Cannot open " << path << '\n';
+		return;
+	}
+	m_file = file;
+
+	LARGE_INTEGER size{};
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		return;
+	}
+
+	m_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_mapping)
+	{
+		std::cerr << "ENGINE, ERROR, MEDIUM, Cannot map " << path << '\n';
+		return;
+	}
+
+	m_data = static_cast<const unsigned char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	m_size = m_data ? static_cast<std::size_t>(size.QuadPart) : 0;
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_data)
+	{
+		UnmapViewOfFile(m_data);
+	}
+	if (m_mapping)
+	{
+		CloseHandle(m_mapping);
+	}
+	if (m_file)
+	{
+		CloseHandle(m_file);
+	}
+}
+
+#else
+
+MappedFile::MappedFile(std::string_view path)
+{
+	const std::string terminated{ path };
+	m_file = open(terminated.c_str(), O_RDONLY);
+	if (m_file < 0)
+	{
+		std::cerr << "ENGINE, ERROR, MEDIUM, Cannot open " << path << '\n';
+		return;
+	}
+
+	struct stat status{};
+	if (fstat(m_file, &status) != 0 || status.st_size == 0)
+	{
+		return;
+	}
+
+	void* data{ mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_PRIVATE, m_file, 0) };
+	if (data == MAP_FAILED)
+	{
+		std::cerr << "ENGINE, ERROR, MEDIUM, Cannot map " << path << '\n';
+		return;
+	}
+
+	m_data = static_cast<const unsigned char*>(data);
+	m_size = static_cast<std::size_t>(status.st_size);
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_data)
+	{
+		munmap(const_cast<unsigned char*>(m_data), m_size);
+	}
+	if (m_file >= 0)
+	{
+		close(m_file);
+	}
+}
+
+#endif
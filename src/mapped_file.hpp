@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string_view>
+
+// Read only view of a whole file through the OS page cache. Nothing is copied; pages are
+// read in on first touch and the mapping goes away with the object.
+class MappedFile final
+{
+public:
+
+	explicit MappedFile(std::string_view path);
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile();
+
+	// False when the file could not be opened or is empty
+	bool valid() const { return m_data != nullptr; }
+
+	std::span<const unsigned char> bytes() const { return { m_data, m_size }; }
+
+private:
+
+	const unsigned char* m_data{};
+	std::size_t m_size{ 0 };
+
+#ifdef _WIN32
+	void* m_file{};
+	void* m_mapping{};
+#else
+	int m_file{ -1 };
+#endif
+};
@@ -0,0 +1,337 @@
+#include "memory.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory_resource>
+#include <new>
+#include <string_view>
+
+namespace
+{
+
+	std::atomic<std::uint64_t> frees{ 0 };
+	std::atomic<std::uint64_t> bytesAllocated{ 0 };
+	std::atomic<std::size_t> liveBytes{ 0 };
+	std::atomic<std::size_t> highWater{ 0 };
+
+	struct TagCounters
+	{
+		std::atomic<std::size_t> bytes{ 0 };
+		std::atomic<std::size_t> highWater{ 0 };
+		std::atomic<std::uint64_t> allocations{ 0 };
+	};
+
+	TagCounters tagCounters[Memory::tagCount]{};
+
+	thread_local Memory::Tag currentTag{ Memory::Tag::general };
+
+	// Sits right in front of every block handed out. offset leads back to the start of the
+	// underlying allocation, which is further away for over-aligned blocks.
+	struct Header
+	{
+		std::size_t size{};
+		std::uint32_t offset{};
+		Memory::Tag tag{};
+	};
+
+	// Keeps blocks at the alignment malloc guarantees
+	constexpr std::size_t headerSize{ 16 };
+	static_assert(sizeof(Header) <= headerSize);
+
+	// A plain store rather than a compare exchange loop: racing threads can lose an update,
+	// which understates the mark by at most one allocation, for far less traffic on the line
+	void raise(std::atomic<std::size_t>& mark, std::size_t value)
+	{
+		if (value > mark.load(std::memory_order_relaxed))
+		{
+			mark.store(value, std::memory_order_relaxed);
+		}
+	}
+
+	void* track(void* raw, std::size_t size, std::size_t offset)
+	{
+		if (!raw)
+		{
+			return nullptr;
+		}
+
+		const Memory::Tag tag{ currentTag };
+		TagCounters& counters{ tagCounters[static_cast<std::size_t>(tag)] };
+
+		bytesAllocated.fetch_add(size, std::memory_order_relaxed);
+		raise(highWater, liveBytes.fetch_add(size, std::memory_order_relaxed) + size);
+
+		counters.allocations.fetch_add(1, std::memory_order_relaxed);
+		raise(counters.highWater, counters.bytes.fetch_add(size, std::memory_order_relaxed) + size);
+
+		std::byte* const pointer{ static_cast<std::byte*>(raw) + offset };
+		new (pointer - headerSize) Header{ size, static_cast<std::uint32_t>(offset), tag };
+		return pointer;
+	}
+
+	// Returns the start of the underlying allocation
+	void* untrack(void* pointer)
+	{
+		const Header& header{ *reinterpret_cast<const Header*>(static_cast<std::byte*>(pointer) - headerSize) };
+
+		frees.fetch_add(1, std::memory_order_relaxed);
+		liveBytes.fetch_sub(header.size, std::memory_order_relaxed);
+		tagCounters[static_cast<std::size_t>(header.tag)].bytes.fetch_sub(header.size, std::memory_order_relaxed);
+
+		return static_cast<std::byte*>(pointer) - header.offset;
+	}
+
+	void* countedAllocate(std::size_t size)
+	{
+		return track(std::malloc(size + headerSize), size, headerSize);
+	}
+
+	void* countedAllocateAligned(std::size_t size, std::size_t alignment)
+	{
+		// The header needs a whole alignment step in front of the block
+		const std::size_t offset{ std::max(headerSize, alignment) };
+#ifdef _WIN32
+		return track(_aligned_malloc(size + offset, alignment), size, offset);
+#else
+		return track(std::aligned_alloc(alignment, (size + offset + alignment - 1) / alignment * alignment), size, offset);
+#endif
+	}
+
+	void countedFree(void* pointer)
+	{
+		if (pointer)
+		{
+			std::free(untrack(pointer));
+		}
+	}
+
+	void countedFreeAligned(void* pointer)
+	{
+		if (pointer)
+		{
+#ifdef _WIN32
+			_aligned_free(untrack(pointer));
+#else
+			std::free(untrack(pointer));
+#endif
+		}
+	}
+
+}
+
+void* operator new(std::size_t size)
+{
+	if (void* pointer{ countedAllocate(size) })
+	{
+		return pointer;
+	}
+	throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	return countedAllocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	return countedAllocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	if (void* pointer{ countedAllocateAligned(size, static_cast<std::size_t>(alignment)) })
+	{
+		return pointer;
+	}
+	throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return countedAllocateAligned(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return countedAllocateAligned(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* pointer) noexcept { countedFree(pointer); }
+void operator delete[](void* pointer) noexcept { countedFree(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { countedFree(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept { countedFree(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { countedFree(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { countedFree(pointer); }
+
+void operator delete(void* pointer, std::align_val_t) noexcept { countedFreeAligned(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { countedFreeAligned(pointer); }
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept { countedFreeAligned(pointer); }
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept { countedFreeAligned(pointer); }
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { countedFreeAligned(pointer); }
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { countedFreeAligned(pointer); }
+
+namespace Memory
+{
+
+	AllocationStats allocationStats()
+	{
+		// Only the tags count allocations, so the hot path touches one counter less
+		std::uint64_t allocations{ 0 };
+		for (const TagCounters& counters : tagCounters)
+		{
+			allocations += counters.allocations.load(std::memory_order_relaxed);
+		}
+
+		return
+		{
+			.allocations{ allocations },
+			.frees{ frees.load(std::memory_order_relaxed) },
+			.bytesAllocated{ bytesAllocated.load(std::memory_order_relaxed) },
+			.liveBytes{ liveBytes.load(std::memory_order_relaxed) },
+			.highWater{ highWater.load(std::memory_order_relaxed) },
+		};
+	}
+
+	std::string_view tagName(Tag tag)
+	{
+		switch (tag)
+		{
+		case Tag::general: return "general";
+		case Tag::level: return "level";
+		case Tag::models: return "models";
+		case Tag::textures: return "textures";
+		case Tag::renderer: return "renderer";
+		case Tag::physics: return "physics";
+		case Tag::gameplay: return "gameplay";
+		case Tag::gui: return "gui";
+		default: return "unknown";
+		}
+	}
+
+	TagStats tagStats(Tag tag)
+	{
+		const TagCounters& counters{ tagCounters[static_cast<std::size_t>(tag)] };
+		return
+		{
+			.bytes{ counters.bytes.load(std::memory_order_relaxed) },
+			.highWater{ counters.highWater.load(std::memory_order_relaxed) },
+			.allocations{ counters.allocations.load(std::memory_order_relaxed) },
+		};
+	}
+
+	TagScope::TagScope(Tag tag)
+		: m_previous{ currentTag }
+	{
+		currentTag = tag;
+	}
+
+	TagScope::~TagScope()
+	{
+		currentTag = m_previous;
+	}
+
+	LinearArena::LinearArena(std::size_t initialSize)
+		: m_initialSize{ std::max<std::size_t>(initialSize, 64) }
+	{
+	}
+
+	LinearArena::~LinearArena()
+	{
+		release();
+	}
+
+	void LinearArena::reset()
+	{
+		m_highWater = std::max(m_highWater, m_used);
+
+		if (m_blocks.size() > 1)
+		{
+			const std::size_t total{ capacity() };
+			release();
+			addBlock(total);
+		}
+
+		m_block = 0;
+		m_offset = 0;
+		m_used = 0;
+	}
+
+	void LinearArena::release()
+	{
+		m_highWater = std::max(m_highWater, m_used);
+
+		for (const auto& block : m_blocks)
+		{
+			::operator delete(block.data);
+		}
+		m_blocks.clear();
+
+		m_block = 0;
+		m_offset = 0;
+		m_used = 0;
+	}
+
+	std::size_t LinearArena::capacity() const
+	{
+		std::size_t total{ 0 };
+		for (const auto& block : m_blocks)
+		{
+			total += block.size;
+		}
+		return total;
+	}
+
+	void* LinearArena::do_allocate(std::size_t bytes, std::size_t alignment)
+	{
+		while (m_block < m_blocks.size())
+		{
+			const Block& block{ m_blocks[m_block] };
+
+			const std::uintptr_t base{ reinterpret_cast<std::uintptr_t>(block.data) };
+			const std::uintptr_t aligned{ (base + m_offset + alignment - 1) & ~(static_cast<std::uintptr_t>(alignment) - 1) };
+			const std::size_t end{ static_cast<std::size_t>(aligned - base) + bytes };
+
+			if (end <= block.size)
+			{
+				m_used += end - m_offset;
+				m_offset = end;
+				return reinterpret_cast<void*>(aligned);
+			}
+
+			++m_block;
+			m_offset = 0;
+		}
+
+		const std::size_t previous{ m_blocks.empty() ? m_initialSize / 2 : m_blocks.back().size };
+		addBlock(std::max(previous * 2, bytes + alignment));
+		m_block = m_blocks.size() - 1;
+
+		return do_allocate(bytes, alignment);
+	}
+
+	void LinearArena::addBlock(std::size_t size)
+	{
+		m_blocks.push_back({ static_cast<std::byte*>(::operator new(size)), size });
+	}
+
+	LinearArena& frameArena()
+	{
+		static LinearArena arena{ 256 * 1024 };
+		return arena;
+	}
+
+}
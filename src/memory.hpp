@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+namespace Memory
+{
+
+	// Counted by the replacement global operator new and delete
+	struct AllocationStats
+	{
+		std::uint64_t allocations{};
+		std::uint64_t frees{};
+		std::uint64_t bytesAllocated{};
+		// Bytes currently allocated and the most there have ever been at once
+		std::size_t liveBytes{};
+		std::size_t highWater{};
+	};
+
+	AllocationStats allocationStats();
+
+	// What a heap allocation is charged to. Each block remembers its tag, so it is credited
+	// back correctly wherever it is freed.
+	enum class Tag : std::uint8_t
+	{
+		general,
+		level,
+		models,
+		textures,
+		renderer,
+		physics,
+		gameplay,
+		gui,
+		count,
+	};
+
+	constexpr std::size_t tagCount{ static_cast<std::size_t>(Tag::count) };
+
+	std::string_view tagName(Tag tag);
+
+	struct TagStats
+	{
+		std::size_t bytes{};
+		std::size_t highWater{};
+		std::uint64_t allocations{};
+	};
+
+	TagStats tagStats(Tag tag);
+
+	// Heap allocations made on this thread are charged to tag until the scope ends. Arenas
+	// are charged when they take a block, not for what is bumped out of it.
+	class TagScope final
+	{
+	public:
+
+		explicit TagScope(Tag tag);
+		TagScope(const TagScope&) = delete;
+		TagScope& operator=(const TagScope&) = delete;
+
+		~TagScope();
+
+	private:
+
+		Tag m_previous{};
+	};
+
+	// Bump allocator behind a std::pmr interface. Individual frees are no-ops; reset
+	// rewinds everything at once and keeps the memory, release hands it back. Not
+	// thread-safe, so give each thread or job its own arena.
+	class LinearArena final : public std::pmr::memory_resource
+	{
+	public:
+
+		explicit LinearArena(std::size_t initialSize = 64 * 1024);
+		LinearArena(const LinearArena&) = delete;
+		LinearArena& operator=(const LinearArena&) = delete;
+
+		~LinearArena() override;
+
+		// Overflow blocks are merged into one, so a workload that fit once fits again without allocating
+		void reset();
+		void release();
+
+		std::size_t used() const { return m_used; }
+		std::size_t capacity() const;
+		std::size_t highWater() const { return m_highWater; }
+
+	private:
+
+		struct Block
+		{
+			std::byte* data{};
+			std::size_t size{};
+		};
+
+		void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+		void do_deallocate(void*, std::size_t, std::size_t) override {}
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+		void addBlock(std::size_t size);
+
+		std::vector<Block> m_blocks{};
+		std::size_t m_block{};
+		std::size_t m_offset{};
+
+		std::size_t m_used{};
+		std::size_t m_highWater{};
+		std::size_t m_initialSize{};
+	};
+
+	// Reset at the start of every frame; nothing allocated from it may outlive the frame
+	LinearArena& frameArena();
+
+}
@@ -0,0 +1,259 @@
+#include "memory_report.hpp"
+
+#include "memory.hpp"
+
+#include "json.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+
+	struct Ledger
+	{
+		std::mutex mutex{};
+		// Heterogeneous lookup, so reporting an existing asset does not build a string
+		std::map<std::string, Memory::GpuAsset, std::less<>> assets{};
+		Memory::GpuStats kinds[Memory::gpuKindCount]{};
+		Memory::GpuStats total{};
+
+		Memory::Budgets budgets{};
+		// Categories that have already warned: tags, then kinds, then the two totals
+		bool over[Memory::tagCount + Memory::gpuKindCount + 2]{};
+	};
+
+	Ledger& ledger()
+	{
+		static Ledger instance{};
+		return instance;
+	}
+
+	double megabytes(std::size_t bytes)
+	{
+		return static_cast<double>(bytes) / (1024.0 * 1024.0);
+	}
+
+	void check(bool& over, std::string_view category, std::size_t bytes, std::size_t budget)
+	{
+		const bool now{ budget != 0 && bytes > budget };
+		if (now && !over)
+		{
+			std::cerr << "MEMORY, WARNING: " << category << " at " << megabytes(bytes) << " MiB, over its budget of " << megabytes(budget) << " MiB\n";
+		}
+		over = now;
+	}
+
+	nlohmann::json entry(std::size_t bytes, std::size_t highWater, std::size_t budget)
+	{
+		nlohmann::json value{ { "bytes", bytes }, { "highWater", highWater } };
+		if (budget != 0)
+		{
+			value["budget"] = budget;
+			value["overBudget"] = bytes > budget;
+		}
+		return value;
+	}
+
+}
+
+namespace Memory
+{
+
+	std::string_view gpuKindName(GpuKind kind)
+	{
+		switch (kind)
+		{
+		case GpuKind::vertices: return "vertices";
+		case GpuKind::indices: return "indices";
+		case GpuKind::textures: return "textures";
+		case GpuKind::targets: return "targets";
+		case GpuKind::buffers: return "buffers";
+		default: return "unknown";
+		}
+	}
+
+	void addGpuBytes(std::string_view asset, GpuKind kind, std::size_t bytes)
+	{
+		if (bytes == 0)
+		{
+			return;
+		}
+
+		Ledger& state{ ledger() };
+		const std::scoped_lock lock{ state.mutex };
+
+		auto it{ state.assets.find(asset) };
+		if (it == state.assets.end())
+		{
+			it = state.assets.emplace(std::string{ asset }, GpuAsset{ .name{ std::string{ asset } } }).first;
+		}
+		it->second.bytes[static_cast<std::size_t>(kind)] += bytes;
+		it->second.total += bytes;
+
+		for (GpuStats* stats : { &state.kinds[static_cast<std::size_t>(kind)], &state.total })
+		{
+			stats->bytes += bytes;
+			stats->highWater = std::max(stats->highWater, stats->bytes);
+		}
+	}
+
+	void removeGpuBytes(std::string_view asset, GpuKind kind, std::size_t bytes)
+	{
+		if (bytes == 0)
+		{
+			return;
+		}
+
+		Ledger& state{ ledger() };
+		const std::scoped_lock lock{ state.mutex };
+
+		const auto it{ state.assets.find(asset) };
+		if (it == state.assets.end() || it->second.bytes[static_cast<std::size_t>(kind)] < bytes)
+		{
+			std::cerr << "MEMORY, ERROR: Removing " << bytes << " bytes of " << gpuKindName(kind) << " never added for " << asset << '\n';
+			return;
+		}
+
+		it->second.bytes[static_cast<std::size_t>(kind)] -= bytes;
+		it->second.total -= bytes;
+		if (it->second.total == 0)
+		{
+			state.assets.erase(it);
+		}
+
+		state.kinds[static_cast<std::size_t>(kind)].bytes -= bytes;
+		state.total.bytes -= bytes;
+	}
+
+	std::vector<GpuAsset> gpuAssets()
+	{
+		Ledger& state{ ledger() };
+		std::vector<GpuAsset> assets{};
+		{
+			const std::scoped_lock lock{ state.mutex };
+			assets.reserve(state.assets.size());
+			for (const auto& [name, asset] : state.assets)
+			{
+				assets.push_back(asset);
+			}
+		}
+
+		std::stable_sort(assets.begin(), assets.end(), [](const GpuAsset& a, const GpuAsset& b) { return a.total > b.total; });
+		return assets;
+	}
+
+	GpuStats gpuStats(GpuKind kind)
+	{
+		Ledger& state{ ledger() };
+		const std::scoped_lock lock{ state.mutex };
+		return state.kinds[static_cast<std::size_t>(kind)];
+	}
+
+	GpuStats gpuTotal()
+	{
+		Ledger& state{ ledger() };
+		const std::scoped_lock lock{ state.mutex };
+		return state.total;
+	}
+
+	void setBudgets(const Budgets& budgets)
+	{
+		Ledger& state{ ledger() };
+		const std::scoped_lock lock{ state.mutex };
+		state.budgets = budgets;
+		std::fill(std::begin(state.over), std::end(state.over), false);
+	}
+
+	const Budgets& budgets()
+	{
+		return ledger().budgets;
+	}
+
+	void checkBudgets()
+	{
+		Ledger& state{ ledger() };
+		const std::scoped_lock lock{ state.mutex };
+
+		bool* over{ state.over };
+		for (std::size_t i{ 0 }; i < tagCount; ++i)
+		{
+			const Tag tag{ static_cast<Tag>(i) };
+			check(*over++, tagName(tag), tagStats(tag).bytes, state.budgets.cpu[i]);
+		}
+		for (std::size_t i{ 0 }; i < gpuKindCount; ++i)
+		{
+			check(*over++, gpuKindName(static_cast<GpuKind>(i)), state.kinds[i].bytes, state.budgets.gpu[i]);
+		}
+		check(*over++, "CPU total", allocationStats().liveBytes, state.budgets.cpuTotal);
+		check(*over++, "GPU total", state.total.bytes, state.budgets.gpuTotal);
+	}
+
+	std::string reportJson()
+	{
+		const Budgets limits{ [] { Ledger& state{ ledger() }; const std::scoped_lock lock{ state.mutex }; return state.budgets; }() };
+
+		const AllocationStats allocation{ allocationStats() };
+		nlohmann::json cpu{ { "total", entry(allocation.liveBytes, allocation.highWater, limits.cpuTotal) } };
+		cpu["total"]["allocations"] = allocation.allocations;
+		for (std::size_t i{ 0 }; i < tagCount; ++i)
+		{
+			const Tag tag{ static_cast<Tag>(i) };
+			const TagStats stats{ tagStats(tag) };
+			nlohmann::json& value{ cpu["tags"][std::string{ tagName(tag) }] = entry(stats.bytes, stats.highWater, limits.cpu[i]) };
+			value["allocations"] = stats.allocations;
+		}
+
+		const GpuStats total{ gpuTotal() };
+		nlohmann::json gpu{ { "total", entry(total.bytes, total.highWater, limits.gpuTotal) } };
+		for (std::size_t i{ 0 }; i < gpuKindCount; ++i)
+		{
+			const GpuStats stats{ gpuStats(static_cast<GpuKind>(i)) };
+			gpu["kinds"][std::string{ gpuKindName(static_cast<GpuKind>(i)) }] = entry(stats.bytes, stats.highWater, limits.gpu[i]);
+		}
+
+		nlohmann::json assets = nlohmann::json::array();
+		for (const GpuAsset& asset : gpuAssets())
+		{
+			nlohmann::json value{ { "name", asset.name }, { "total", asset.total } };
+			for (std::size_t i{ 0 }; i < gpuKindCount; ++i)
+			{
+				if (asset.bytes[i] != 0)
+				{
+					value[std::string{ gpuKindName(static_cast<GpuKind>(i)) }] = asset.bytes[i];
+				}
+			}
+			assets.push_back(std::move(value));
+		}
+		gpu["assets"] = std::move(assets);
+
+		const nlohmann::json report{ { "cpu", std::move(cpu) }, { "gpu", std::move(gpu) } };
+		return report.dump(1, '\t');
+	}
+
+	bool writeReport(const std::string& path)
+	{
+		std::error_code error{};
+		std::filesystem::create_directories(std::filesystem::path{ path }.parent_path(), error);
+
+		std::ofstream file{ path };
+		file << reportJson() << '\n';
+		if (!file)
+		{
+			std::cerr << "MEMORY, ERROR: Cannot write " << path << '\n';
+			return false;
+		}
+		return true;
+	}
+
+}
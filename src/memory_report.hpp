@@ -0,0 +1,74 @@
+#pragma once
+
+#include "memory.hpp"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Video memory by asset next to the CPU tags, with budgets for both. The GL side is reported
+// by whoever creates the objects, since the driver cannot be asked what anything costs.
+namespace Memory
+{
+
+	enum class GpuKind : std::uint8_t
+	{
+		vertices,
+		indices,
+		textures,
+		// Render targets owned by the render graph
+		targets,
+		// Every other buffer: transforms, lights, captures and the like
+		buffers,
+		count,
+	};
+
+	constexpr std::size_t gpuKindCount{ static_cast<std::size_t>(GpuKind::count) };
+
+	std::string_view gpuKindName(GpuKind kind);
+
+	// Assets are keyed by name, so two loads of one model add up in one entry
+	void addGpuBytes(std::string_view asset, GpuKind kind, std::size_t bytes);
+	void removeGpuBytes(std::string_view asset, GpuKind kind, std::size_t bytes);
+
+	struct GpuAsset
+	{
+		std::string name{};
+		std::size_t bytes[gpuKindCount]{};
+		std::size_t total{};
+	};
+
+	// Largest first
+	std::vector<GpuAsset> gpuAssets();
+
+	struct GpuStats
+	{
+		std::size_t bytes{};
+		std::size_t highWater{};
+	};
+
+	GpuStats gpuStats(GpuKind kind);
+	GpuStats gpuTotal();
+
+	// In bytes; zero leaves a category unlimited
+	struct Budgets
+	{
+		std::size_t cpu[tagCount]{};
+		std::size_t gpu[gpuKindCount]{};
+		std::size_t cpuTotal{};
+		std::size_t gpuTotal{};
+	};
+
+	void setBudgets(const Budgets& budgets);
+	const Budgets& budgets();
+
+	// Warns once when a category goes over its budget, and again only after it has been back
+	// under. Call once a frame.
+	void checkBudgets();
+
+	// Every tag, kind and asset with high-water marks and budgets
+	std::string reportJson();
+	bool writeReport(const std::string& path);
+
+}
@@ -1,254 +1,501 @@
 #include "model_load.hpp"
 
-#define TINYGLTF_IMPLEMENTATION
-#define STB_IMAGE_IMPLEMENTATION
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "tiny_gltf.h"
+#include "glb.hpp"
+#include "mapped_file.hpp"
+#include "memory.hpp"
+#include "texture_compression.hpp"
 
 #include "glm/glm.hpp"
-#include "glm/gtc/matrix_transform.hpp"
-#include "glm/gtx/quaternion.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <initializer_list>
 #include <iostream>
+#include <memory>
+#include <memory_resource>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace ModelLoader
 {
 
-	Material getPrimitiveMaterial(const tinygltf::Model& model, const tinygltf::Primitive& primitive)
+	constexpr std::string_view textureCacheDirectory{ "cache/textures" };
+
+	Material getPrimitiveMaterial(const Glb::Document& document, const Glb::Primitive& primitive, std::pmr::memory_resource* memory)
 	{
-		Material outMaterial{};
+		Material outMaterial{ .texture{ .levels{ std::pmr::vector<TextureCompression::Level>{ memory } }, .data{ std::pmr::vector<unsigned char>{ memory } } } };
 		if (primitive.material != -1)
 		{
-			const tinygltf::Material& material{ model.materials[primitive.material] };
-			const tinygltf::TextureInfo& textureInfo{ material.pbrMetallicRoughness.baseColorTexture };
-			if (textureInfo.index != -1)
+			const Glb::Material& material{ document.materials[primitive.material] };
+			if (material.baseColorImage != -1)
 			{
-				const tinygltf::Texture& texture{ model.textures[textureInfo.index] };
-				const tinygltf::Image& image{ model.images[texture.source] };
-
-				glGenTextures(1, &outMaterial.texture);
-				glBindTexture(GL_TEXTURE_2D, outMaterial.texture);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.image.data());
-				glGenerateMipmap(GL_TEXTURE_2D);
-
-				outMaterial.hasTexture = true;
+				const Memory::TagScope tag{ Memory::Tag::textures };
+				// Decoded only when the compressed cache has no entry for these bytes
+				outMaterial.texture = TextureCompression::loadOrCompress(document.images[material.baseColorImage], textureCacheDirectory, memory);
+				outMaterial.hasTexture = !outMaterial.texture.levels.empty();
 			}
 			else
 			{
 				outMaterial.hasTexture = false;
 			}
-			
-			outMaterial.color =
-			{
-				material.pbrMetallicRoughness.baseColorFactor[0],
-				material.pbrMetallicRoughness.baseColorFactor[1],
-				material.pbrMetallicRoughness.baseColorFactor[2]
-			};
+
+			outMaterial.color = material.color;
 		}
 		
 		return outMaterial;
 	}
 
-	glm::mat4 getNodeTransform(const tinygltf::Node& node)
+	// Null unless the accessor exists and holds floats with the given component count
+	const Glb::Accessor* floatAccessor(const Glb::Document& document, int index, int components, const char* attribute)
 	{
-		if (node.matrix.size() != 0)
+		if (index == -1)
 		{
-			std::cerr << "Transformation found\n";
+			return nullptr;
 		}
 
-		glm::mat4 t{ 1.0f };
-		if (node.translation.size() != 0)
+		const Glb::Accessor& accessor{ document.accessors[index] };
+		if (!accessor.data || accessor.componentType != Glb::float32 || accessor.components != components)
 		{
-			glm::vec3 translation
-			{
-				static_cast<float>(node.translation[0]),
-				static_cast<float>(node.translation[1]),
-				static_cast<float>(node.translation[2]),
-			};
-			t = glm::translate(t, translation);
+			std::cerr << "MODEL LOADER, ERROR: Unsupported " << attribute << " accessor\n";
+			return nullptr;
 		}
+		return &accessor;
+	}
 
-		glm::mat4 r{ 1.0f };
-		if (node.rotation.size() != 0)
+	// The skin a mesh's rig was built from, and where each of its joints ended up in the rig
+	struct Skinning
+	{
+		int skin{ -1 };
+		std::vector<int> rigJoints{};
+	};
+
+	// Null unless the accessor exists and holds four components of one of the given types
+	const Glb::Accessor* vec4Accessor(const Glb::Document& document, int index, std::initializer_list<int> componentTypes, const char* attribute)
+	{
+		if (index == -1)
 		{
-			// glm quaternions are in WXYZ
-			glm::quat rotation
-			{
-				static_cast<float>(node.rotation[3]),
-				static_cast<float>(node.rotation[0]),
-				static_cast<float>(node.rotation[1]),
-				static_cast<float>(node.rotation[2])
-			};
-			r = glm::toMat4(rotation);
+			return nullptr;
 		}
 
-		glm::mat4 s{ 1.0f };
-		if (node.scale.size() != 0)
+		const Glb::Accessor& accessor{ document.accessors[index] };
+		if (!accessor.data || accessor.components != 4
+			|| std::find(componentTypes.begin(), componentTypes.end(), accessor.componentType) == componentTypes.end())
 		{
-			glm::vec3 scale
-			{
-				static_cast<float>(node.scale[0]),
-				static_cast<float>(node.scale[1]),
-				static_cast<float>(node.scale[2])
-			};
-			s = glm::scale(s, scale);
+			std::cerr << "MODEL LOADER, ERROR: Unsupported " << attribute << " accessor\n";
+			return nullptr;
 		}
-
-		return t * r * s;
+		return &accessor;
 	}
 
-	Primitive loadPrimitive(const tinygltf::Model& model, const tinygltf::Primitive& primitive, std::vector<Renderer::Vertex>& vertices)
+	// Unsigned bytes and shorts as stored, floats as they are; normalized callers scale after
+	glm::vec4 readVec4(const Glb::Accessor& accessor, std::size_t i)
 	{
-		Primitive outPrimitive{};
-		outPrimitive.material = getPrimitiveMaterial(model, primitive);
-
-		const auto& accessor{ model.accessors[primitive.indices] };
-		const auto& bufferView{ model.bufferViews[accessor.bufferView] };
-		const auto& buffer{ model.buffers[bufferView.buffer] };
-
-		const unsigned char* indexData{ buffer.data.data() };
-		indexData += bufferView.byteOffset;
+		const unsigned char* data{ accessor.data + i * accessor.stride };
+		glm::vec4 value{};
+		for (int c{ 0 }; c < 4; ++c)
+		{
+			switch (accessor.componentType)
+			{
+			case (Glb::unsignedByte):
+				value[c] = data[c];
+				break;
+			case (Glb::unsignedShort):
+			{
+				std::uint16_t component{};
+				std::memcpy(&component, data + c * sizeof(std::uint16_t), sizeof(std::uint16_t));
+				value[c] = component;
+			}
+			break;
+			default:
+				std::memcpy(&value[c], data + c * sizeof(float), sizeof(float));
+				break;
+			}
+		}
+		return value;
+	}
 
-		const std::uint32_t offset{ static_cast<std::uint32_t>(vertices.size()) };
+	// Quantizes to bytes that still sum to exactly 255, the remainder going to the heaviest joint
+	glm::u8vec4 quantizeWeights(glm::vec4 weights)
+	{
+		weights = glm::max(weights, glm::vec4{ 0.0f });
+		const float sum{ weights.x + weights.y + weights.z + weights.w };
+		if (sum <= 0.0f)
+		{
+			return { 255, 0, 0, 0 };
+		}
 
-		switch (accessor.componentType)
+		glm::ivec4 quantized{ glm::round(weights * (255.0f / sum)) };
+		int heaviest{ 0 };
+		for (int c{ 1 }; c < 4; ++c)
 		{
-		case (TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT):
+			heaviest = quantized[c] > quantized[heaviest] ? c : heaviest;
+		}
+		quantized[heaviest] += 255 - (quantized.x + quantized.y + quantized.z + quantized.w);
+		return glm::u8vec4{ quantized };
+	}
+
+	void loadSkinWeights(const Glb::Document& document, const Glb::Primitive& primitive, const Skinning& skinning, std::size_t vertexCount,
+		std::pmr::vector<SkinWeights>& skinWeights)
+	{
+		const Glb::Accessor* joints{ vec4Accessor(document, primitive.joints, { Glb::unsignedByte, Glb::unsignedShort }, "JOINTS_0") };
+		const Glb::Accessor* weights{ vec4Accessor(document, primitive.weights, { Glb::unsignedByte, Glb::unsignedShort, Glb::float32 }, "WEIGHTS_0") };
+		if (!joints || !weights || joints->count < vertexCount || weights->count < vertexCount)
 		{
-			for (int i{ 0 }; i < (bufferView.byteLength / sizeof(std::uint16_t)); ++i)
-			{
-				std::uint16_t index{};
-				std::memcpy(&index, indexData, sizeof(std::uint16_t));
-				indexData += sizeof(std::uint16_t);
-				
-				outPrimitive.indices.push_back(static_cast<std::uint32_t>(index) + offset);
-			}
+			std::cerr << "MODEL LOADER, ERROR: Skinned primitive without joints and weights for every vertex\n";
+			skinWeights.resize(skinWeights.size() + vertexCount);
+			return;
 		}
-		break;
-		case (TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT):
+
+		for (std::size_t i{ 0 }; i < vertexCount; ++i)
 		{
-			for (int i{ 0 }; i < (bufferView.byteLength / sizeof(std::uint32_t)); ++i)
+			const glm::vec4 skinJoints{ readVec4(*joints, i) };
+			glm::vec4 jointWeights{ readVec4(*weights, i) };
+
+			SkinWeights vertex{};
+			for (int c{ 0 }; c < 4; ++c)
 			{
-				std::uint32_t index{};
-				std::memcpy(&index, indexData, sizeof(std::uint32_t));
-				indexData += sizeof(std::uint32_t);
-				
-				outPrimitive.indices.push_back(index + offset);
+				const std::size_t joint{ static_cast<std::size_t>(skinJoints[c]) };
+				if (joint >= skinning.rigJoints.size())
+				{
+					jointWeights[c] = 0.0f;
+					continue;
+				}
+				vertex.joints[c] = static_cast<std::uint8_t>(skinning.rigJoints[joint]);
 			}
+			vertex.weights = quantizeWeights(jointWeights);
+			skinWeights.push_back(vertex);
 		}
-		break;
-		default:
-		std::cerr << "MODEL LOADER, ERROR: Unrecognized index accessor component type " << accessor.componentType << '\n';
-		break;
+	}
+
+	Primitive loadPrimitive(const Glb::Document& document, const Glb::Primitive& primitive, bool skinned, const Skinning& skinning,
+		Mesh& outMesh, std::pmr::memory_resource* memory)
+	{
+		std::pmr::vector<Renderer::Vertex>& vertices{ outMesh.vertices };
+
+		Primitive outPrimitive{ .indices{ std::pmr::vector<std::uint32_t>{ memory } }, .material{ getPrimitiveMaterial(document, primitive, memory) } };
+
+		const Glb::Accessor* positions{ floatAccessor(document, primitive.position, 3, "POSITION") };
+		if (!positions || primitive.indices == -1)
+		{
+			std::cerr << "MODEL LOADER, ERROR: Primitive without indexed positions\n";
+			return outPrimitive;
 		}
 
-		const unsigned char* positionData{ nullptr };
-		const unsigned char* normalData  { nullptr };
-		const unsigned char* texCoordData{ nullptr };
-		const unsigned char* colorData   { nullptr };
+		const Glb::Accessor& accessor{ document.accessors[primitive.indices] };
+		const std::uint32_t offset{ static_cast<std::uint32_t>(vertices.size()) };
+		outPrimitive.indices.reserve(accessor.count);
 
-		int vertexCount{};
-		
-		for (const auto& attribute : primitive.attributes)
+		const unsigned char* indexData{ accessor.data };
+		for (std::size_t i{ 0 }; indexData && i < accessor.count; ++i, indexData += accessor.stride)
 		{
-			const auto& accessor{ model.accessors[attribute.second] };
-			const auto& bufferView{ model.bufferViews[accessor.bufferView] };
-			const auto& buffer{ model.buffers[bufferView.buffer] };
+			std::uint32_t index{};
+			switch (accessor.componentType)
+			{
+			case (Glb::unsignedByte):
+				index = *indexData;
+				break;
+			case (Glb::unsignedShort):
+			{
+				std::uint16_t shortIndex{};
+				std::memcpy(&shortIndex, indexData, sizeof(std::uint16_t));
+				index = shortIndex;
+			}
+			break;
+			case (Glb::unsignedInt):
+				std::memcpy(&index, indexData, sizeof(std::uint32_t));
+				break;
+			default:
+				std::cerr << "MODEL LOADER, ERROR: Unrecognized index accessor component type " << accessor.componentType << '\n';
+				return outPrimitive;
+			}
 
-			if (attribute.first == "POSITION")
+			if (index >= positions->count)
 			{
-				vertexCount = static_cast<int>(bufferView.byteLength) / sizeof(glm::vec3);
-				positionData = buffer.data.data() + bufferView.byteOffset;
+				std::cerr << "MODEL LOADER, ERROR: Index " << index << " past the last vertex\n";
+				outPrimitive.indices.clear();
+				return outPrimitive;
 			}
-			else if (attribute.first == "NORMAL") normalData = buffer.data.data() + bufferView.byteOffset;
-			else if (attribute.first == "TEXCOORD_0") texCoordData = buffer.data.data() + bufferView.byteOffset;
-			else if (attribute.first == "COLOR_0") std::cerr << "Color\n";
+			outPrimitive.indices.push_back(index + offset);
 		}
 
-		for (int i{ 0 }; i < vertexCount; ++i)
+		const Glb::Accessor* normals{ floatAccessor(document, primitive.normal, 3, "NORMAL") };
+		const Glb::Accessor* texCoords{ floatAccessor(document, primitive.texCoord, 2, "TEXCOORD_0") };
+		if (normals && normals->count < positions->count)
+		{
+			normals = nullptr;
+		}
+		if (texCoords && texCoords->count < positions->count)
+		{
+			texCoords = nullptr;
+		}
+
+		// Read straight out of the mapped file
+		for (std::size_t i{ 0 }; i < positions->count; ++i)
 		{
 			glm::vec3 position{};
-			std::memcpy(&position, positionData, sizeof(glm::vec3));
-			positionData += sizeof(glm::vec3);
+			std::memcpy(&position, positions->data + i * positions->stride, sizeof(glm::vec3));
 
 			glm::vec3 normal{ 0.0f, 1.0f, 0.0f };
-			if (normalData)
+			if (normals)
 			{
-				std::memcpy(&normal, normalData, sizeof(glm::vec3));
-				normalData += sizeof(glm::vec3);
+				std::memcpy(&normal, normals->data + i * normals->stride, sizeof(glm::vec3));
 			}
 
 			glm::vec2 texCoord{ 0.0f, 0.0f };
-			if (texCoordData)
+			if (texCoords)
 			{
-				std::memcpy(&texCoord, texCoordData, sizeof(glm::vec2));
-				texCoordData += sizeof(glm::vec2);
+				std::memcpy(&texCoord, texCoords->data + i * texCoords->stride, sizeof(glm::vec2));
 			}
 
 			vertices.push_back({ position, normal, texCoord });
 		}
 
+		// Once a model has a rig every vertex needs weights; zero ones leave a vertex rigid
+		if (skinned)
+		{
+			loadSkinWeights(document, primitive, skinning, positions->count, outMesh.skinWeights);
+		}
+		else if (outMesh.rig)
+		{
+			outMesh.skinWeights.resize(outMesh.vertices.size());
+		}
+
 		return outPrimitive;
 	}
 
-	void loadNode(const tinygltf::Model& model, const tinygltf::Node& node, const glm::mat4& inheritedTransform, 
-		Mesh& outMesh, std::vector<Renderer::Vertex>& vertices)
+	void loadNode(const Glb::Document& document, const Glb::Node& node, const glm::mat4& inheritedTransform, const Skinning& skinning,
+		Mesh& outMesh, std::pmr::memory_resource* memory)
 	{
-		glm::mat4 transform{ getNodeTransform(node) };
-		transform = inheritedTransform * transform;
+		const glm::mat4 transform{ inheritedTransform * node.transform };
 
 		if (node.mesh != -1)
 		{
-			const auto mesh{ model.meshes[node.mesh] };
-
-			for (const auto& primitive : mesh.primitives)
+			for (const auto& primitive : document.meshes[node.mesh].primitives)
 			{
-				outMesh.primitives.push_back(loadPrimitive(model, primitive, vertices));
-				outMesh.primitives.back().transform = transform;
+				// Skinned vertices are placed by the joints alone, whatever node holds the mesh
+				const bool skinned{ outMesh.rig && node.skin == skinning.skin && primitive.joints != -1 };
+				outMesh.primitives.push_back(loadPrimitive(document, primitive, skinned, skinning, outMesh, memory));
+				outMesh.primitives.back().transform = skinned ? glm::mat4{ 1.0f } : transform;
 			}
 		}
 
-		for (const auto& nodeIndex : node.children)
+		for (const int nodeIndex : node.children)
 		{
-			loadNode(model, model.nodes[nodeIndex], transform, outMesh, vertices);
+			loadNode(document, document.nodes[nodeIndex], transform, skinning, outMesh, memory);
 		}
 	}
 
-	Mesh loadGLB(const std::string& path, std::vector<Renderer::Vertex>& vertices)
+	// Null unless the accessor exists and holds floats with the given component count, one per key
+	const Glb::Accessor* keyAccessor(const Glb::Document& document, int index, int components, std::size_t count)
 	{
-		Mesh outMesh{};
+		const Glb::Accessor* accessor{ floatAccessor(document, index, components, "animation") };
+		return accessor && accessor->count == count ? accessor : nullptr;
+	}
 
-		tinygltf::Model model{};
-		tinygltf::TinyGLTF loader{};
-		std::string warning{};
-		std::string error{};
+	Animation::Clip loadClip(const Glb::Document& document, const Glb::Animation& animation, const std::vector<int>& nodeJoints)
+	{
+		Animation::Clip clip{ .name{ std::string{ animation.name } } };
 
-		loader.LoadBinaryFromFile(&model, &error, &warning, path);
-		if (!error.empty())
+		for (const Glb::AnimationChannel& channel : animation.channels)
 		{
-			std::cerr << "MODEL LOADER, ERROR: " << error << '\n';
+			// Morph target weights are not supported, and only joints are posed
+			if (channel.node == -1 || nodeJoints[channel.node] == -1 || channel.path == Glb::AnimationPath::weights)
+			{
+				continue;
+			}
+
+			const Glb::AnimationSampler& sampler{ animation.samplers[channel.sampler] };
+			const Glb::Accessor* input{ floatAccessor(document, sampler.input, 1, "animation input") };
+			if (!input)
+			{
+				continue;
+			}
+
+			Animation::Track track
+			{
+				.joint{ static_cast<std::uint16_t>(nodeJoints[channel.node]) },
+				.path{ channel.path == Glb::AnimationPath::rotation ? Animation::Path::rotation
+					: channel.path == Glb::AnimationPath::scale ? Animation::Path::scale : Animation::Path::translation },
+				.interpolation{ sampler.interpolation == Glb::Interpolation::step ? Animation::Interpolation::step
+					: sampler.interpolation == Glb::Interpolation::cubicSpline ? Animation::Interpolation::cubicSpline : Animation::Interpolation::linear },
+			};
+
+			const std::size_t valuesPerKey{ track.interpolation == Animation::Interpolation::cubicSpline ? 3u : 1u };
+			const int components{ track.path == Animation::Path::rotation ? 4 : 3 };
+			const Glb::Accessor* output{ keyAccessor(document, sampler.output, components, input->count * valuesPerKey) };
+			if (!output)
+			{
+				std::cerr << "MODEL LOADER, ERROR: Animation output does not match its keyframes\n";
+				continue;
+			}
+
+			track.times.resize(input->count);
+			for (std::size_t i{ 0 }; i < input->count; ++i)
+			{
+				std::memcpy(&track.times[i], input->data + i * input->stride, sizeof(float));
+			}
+			if (!std::is_sorted(track.times.begin(), track.times.end()))
+			{
+				std::cerr << "MODEL LOADER, ERROR: Animation keyframes out of order\n";
+				continue;
+			}
+
+			track.values.resize(output->count);
+			for (std::size_t i{ 0 }; i < output->count; ++i)
+			{
+				std::memcpy(&track.values[i], output->data + i * output->stride, sizeof(float) * components);
+			}
+
+			if (!track.times.empty())
+			{
+				clip.duration = std::max(clip.duration, track.times.back());
+			}
+			clip.tracks.push_back(std::move(track));
+		}
+
+		return clip;
+	}
+
+	// Joints are reordered so parents come first; skinning.rigJoints maps the skin's order to it
+	std::shared_ptr<const Animation::Rig> loadRig(const Glb::Document& document, int skinIndex, Skinning& skinning)
+	{
+		const Glb::Skin& skin{ document.skins[skinIndex] };
+		if (skin.joints.empty() || skin.joints.size() > maxJoints)
+		{
+			std::cerr << "MODEL LOADER, ERROR: Skin with " << skin.joints.size() << " joints, loading the model rigid\n";
+			return nullptr;
+		}
+
+		const Glb::Accessor* inverseBinds{ skin.inverseBindMatrices != -1 ? floatAccessor(document, skin.inverseBindMatrices, 16, "inverse bind matrix") : nullptr };
+		if (skin.inverseBindMatrices != -1 && (!inverseBinds || inverseBinds->count < skin.joints.size()))
+		{
+			std::cerr << "MODEL LOADER, ERROR: Skin without an inverse bind matrix per joint, loading the model rigid\n";
+			return nullptr;
+		}
+
+		std::vector<int> parents(document.nodes.size(), -1);
+		for (std::size_t i{ 0 }; i < document.nodes.size(); ++i)
+		{
+			for (const int child : document.nodes[i].children)
+			{
+				parents[child] = static_cast<int>(i);
+			}
+		}
+
+		const auto depth{ [&](int node)
+			{
+				int levels{ 0 };
+				for (int at{ parents[node] }; at != -1; at = parents[at])
+				{
+					++levels;
+				}
+				return levels;
+			} };
+		std::vector<int> order(skin.joints.size());
+		for (std::size_t i{ 0 }; i < order.size(); ++i)
+		{
+			order[i] = static_cast<int>(i);
 		}
-		if (!warning.empty())
+		std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return depth(skin.joints[a]) < depth(skin.joints[b]); });
+
+		std::vector<int> nodeJoints(document.nodes.size(), -1);
+		skinning.rigJoints.assign(skin.joints.size(), -1);
+		for (std::size_t i{ 0 }; i < order.size(); ++i)
 		{
-			std::cerr << "MODEL LOADER, WARNING: " << warning << '\n';
+			nodeJoints[skin.joints[order[i]]] = static_cast<int>(i);
+			skinning.rigJoints[order[i]] = static_cast<int>(i);
 		}
 
-		for (const auto& scene : model.scenes)
+		auto rig{ std::make_shared<Animation::Rig>() };
+		rig->joints.reserve(order.size());
+		for (const int skinJoint : order)
 		{
-			for (const auto& nodeIndex : scene.nodes)
+			const int node{ skin.joints[skinJoint] };
+			const Glb::Node& glbNode{ document.nodes[node] };
+
+			Animation::Joint joint
 			{
-				loadNode(model, model.nodes[nodeIndex], glm::mat4{ 1.0f }, outMesh, vertices);
+				.parent{ parents[node] != -1 ? nodeJoints[parents[node]] : -1 },
+				.rest{ glbNode.translation, glbNode.rotation, glbNode.scale },
+			};
+			if (inverseBinds)
+			{
+				std::memcpy(&joint.inverseBind, inverseBinds->data + skinJoint * inverseBinds->stride, sizeof(glm::mat4));
+			}
+			// Nodes above a root joint do not animate, so they fold into one matrix
+			if (joint.parent == -1)
+			{
+				for (int at{ parents[node] }; at != -1; at = parents[at])
+				{
+					joint.origin = document.nodes[at].transform * joint.origin;
+				}
 			}
+			rig->joints.push_back(joint);
+		}
+
+		for (const Glb::Animation& animation : document.animations)
+		{
+			rig->clips.push_back(loadClip(document, animation, nodeJoints));
+		}
+
+		skinning.skin = skinIndex;
+		return rig;
+	}
+
+	Mesh loadGLB(std::string_view path, std::pmr::memory_resource* memory)
+	{
+		const Memory::TagScope tag{ Memory::Tag::models };
+
+		Mesh outMesh
+		{
+			.name{ std::pmr::string{ path, memory } },
+			.vertices{ std::pmr::vector<Renderer::Vertex>{ memory } },
+			.primitives{ std::pmr::vector<Primitive>{ memory } },
+			.skinWeights{ std::pmr::vector<SkinWeights>{ memory } },
+		};
+
+		// The document points into the mapping, so both stay alive until the mesh is built
+		const MappedFile file{ path };
+		if (!file.valid())
+		{
+			std::cerr << "MODEL LOADER, ERROR: Cannot read " << path << '\n';
+			return outMesh;
+		}
+
+		const Glb::Document document{ Glb::parse(file.bytes(), path, memory) };
+
+		Skinning skinning{};
+		const auto skinned{ std::find_if(document.nodes.begin(), document.nodes.end(), [](const Glb::Node& node) { return node.skin != -1 && node.mesh != -1; }) };
+		if (skinned != document.nodes.end())
+		{
+			outMesh.rig = loadRig(document, skinned->skin, skinning);
+		}
+
+		for (const int nodeIndex : document.roots)
+		{
+			loadNode(document, document.nodes[nodeIndex], glm::mat4{ 1.0f }, skinning, outMesh, memory);
 		}
 
 		return outMesh;
 	}
 
+	void appendCollisionTriangles(const Mesh& mesh, const glm::mat4& transform, std::vector<TriangleBvh::Triangle>& triangles)
+	{
+		for (const Primitive& primitive : mesh.primitives)
+		{
+			const glm::mat4 toWorld{ transform * primitive.transform };
+			const auto position{ [&](std::uint32_t index) { return glm::vec3{ toWorld * glm::vec4{ mesh.vertices[index].position, 1.0f } }; } };
+
+			triangles.reserve(triangles.size() + primitive.indices.size() / 3);
+			for (std::size_t i{ 0 }; i + 2 < primitive.indices.size(); i += 3)
+			{
+				triangles.push_back({ position(primitive.indices[i]), position(primitive.indices[i + 1]), position(primitive.indices[i + 2]) });
+			}
+		}
+	}
+
 }
\ No newline at end of file
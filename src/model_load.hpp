@@ -1,36 +1,71 @@
 #pragma once
 
+#include "animation.hpp"
+#include "bvh.hpp"
 #include "renderer.hpp"
+#include "texture_compression.hpp"
 
-#include "glad/glad.h"
 #include "glm/glm.hpp"
 
+#include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace ModelLoader
 {
 
+	// Block compressed base color with its mip chain; uploaded by the renderer so loading can
+	// run off the GL thread
 	struct Material
 	{
 		bool hasTexture{};
-		GLuint texture{};
+		TextureCompression::Image texture{};
 		glm::vec3 color{};
 	};
 
 	struct Primitive
 	{
-		std::vector<std::uint32_t> indices{};
+		std::pmr::vector<std::uint32_t> indices{};
 		glm::mat4 transform{};
 		Material material{};
 	};
 
+	// Up to four joints of the rig per vertex, with weights summing to 255. All zero for the
+	// vertices of primitives that are not skinned.
+	struct SkinWeights
+	{
+		glm::u8vec4 joints{};
+		glm::u8vec4 weights{};
+	};
+
 	struct Mesh
 	{
-		std::vector<Primitive> primitives{};
+		// The path it came from, naming it in the memory report
+		std::pmr::string name{};
+		std::pmr::vector<Renderer::Vertex> vertices{};
+		// Indices are relative to vertices
+		std::pmr::vector<Primitive> primitives{};
+
+		// Parallel to vertices when the model has a skin, empty otherwise
+		std::pmr::vector<SkinWeights> skinWeights{};
+		// The first skin of the file with every animation moving its joints; null without one
+		std::shared_ptr<const Animation::Rig> rig{};
 	};
 
-	Mesh loadGLB(const std::string& path, std::vector<Renderer::Vertex>& vertices);
+	// Rigs only index their joints with a byte
+	constexpr std::size_t maxJoints{ 256 };
+
+	// Touches no OpenGL state and is safe to call from worker threads. Every vector of the
+	// result except the shared rig is allocated from memory, which only the calling thread
+	// may be using.
+	Mesh loadGLB(std::string_view path, std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+	// Appends every triangle of the mesh with its node transforms and then transform applied,
+	// for building collision before the vertices are handed to the GPU
+	void appendCollisionTriangles(const Mesh& mesh, const glm::mat4& transform, std::vector<TriangleBvh::Triangle>& triangles);
 
 }
\ No newline at end of file
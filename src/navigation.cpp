@@ -0,0 +1,239 @@
+#include "navigation.hpp"
+
+#include "glm/glm.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+	constexpr int neighbourX[8]{ 1, -1, 0, 0, 1, 1, -1, -1 };
+	constexpr int neighbourZ[8]{ 0, 0, 1, -1, 1, -1, 1, -1 };
+
+}
+
+NavGrid::NavGrid(const Level::Manifest& manifest, float cellSize)
+	: m_cellSize{ cellSize }
+{
+	glm::vec2 min{ INFINITY };
+	glm::vec2 max{ -INFINITY };
+	for (const Level::CellDesc& cell : manifest.cells)
+	{
+		for (const Level::Box& box : cell.boxes)
+		{
+			min = glm::min(min, glm::vec2{ box.pos.x - box.scl.x, box.pos.z - box.scl.z });
+			max = glm::max(max, glm::vec2{ box.pos.x + box.scl.x, box.pos.z + box.scl.z });
+		}
+	}
+
+	if (min.x > max.x)
+	{
+		return;
+	}
+
+	m_origin = min;
+	m_width = static_cast<int>(std::ceil((max.x - min.x) / cellSize));
+	m_depth = static_cast<int>(std::ceil((max.y - min.y) / cellSize));
+
+	const std::size_t cellCount{ static_cast<std::size_t>(m_width) * m_depth };
+	m_floor.assign(cellCount, -INFINITY);
+	m_distance.assign(cellCount, INFINITY);
+	m_flow.assign(cellCount, glm::vec2{ 0.0f });
+
+	// A cell's floor is the highest box top above its centre
+	for (int z{ 0 }; z < m_depth; ++z)
+	{
+		for (int x{ 0 }; x < m_width; ++x)
+		{
+			const glm::vec2 centre{ m_origin + (glm::vec2{ x, z } + 0.5f) * cellSize };
+			float& floor{ m_floor[static_cast<std::size_t>(z) * m_width + x] };
+
+			for (const Level::CellDesc& cell : manifest.cells)
+			{
+				for (const Level::Box& box : cell.boxes)
+				{
+					if (std::abs(centre.x - box.pos.x) <= box.scl.x && std::abs(centre.y - box.pos.z) <= box.scl.z)
+					{
+						floor = std::max(floor, box.pos.y + box.scl.y);
+					}
+				}
+			}
+		}
+	}
+
+	m_stats.cells = cellCount;
+	m_stats.walkable = static_cast<std::size_t>(std::count_if(m_floor.begin(), m_floor.end(), [](float floor) { return floor != -INFINITY; }));
+}
+
+bool NavGrid::setGoal(const glm::vec3& goal, JobSystem& jobs)
+{
+	m_goal = goal;
+
+	const std::uint32_t goalCell{ cellIndex(goal) };
+	if (goalCell == m_goalCell)
+	{
+		return false;
+	}
+	m_goalCell = goalCell;
+
+	const auto start{ std::chrono::steady_clock::now() };
+
+	integrate(goalCell);
+	buildFlow(jobs);
+
+	++m_stats.rebuilds;
+	m_stats.lastRebuildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	return true;
+}
+
+glm::vec2 NavGrid::direction(const glm::vec3& position) const
+{
+	const std::uint32_t cell{ cellIndex(position) };
+	if (cell == m_none)
+	{
+		return glm::vec2{ 0.0f };
+	}
+
+	// Inside the goal's cell head straight for it
+	if (cell == m_goalCell)
+	{
+		const glm::vec2 toGoal{ m_goal.x - position.x, m_goal.z - position.z };
+		const float length{ glm::length(toGoal) };
+		return length > 0.0001f ? toGoal / length : glm::vec2{ 0.0f };
+	}
+
+	return m_flow[cell];
+}
+
+float NavGrid::floorHeight(const glm::vec3& position) const
+{
+	const std::uint32_t cell{ cellIndex(position) };
+	return cell == m_none ? -INFINITY : m_floor[cell];
+}
+
+std::uint32_t NavGrid::cellIndex(const glm::vec3& position) const
+{
+	const int x{ static_cast<int>(std::floor((position.x - m_origin.x) / m_cellSize)) };
+	const int z{ static_cast<int>(std::floor((position.z - m_origin.y) / m_cellSize)) };
+	if (x < 0 || z < 0 || x >= m_width || z >= m_depth)
+	{
+		return m_none;
+	}
+
+	return static_cast<std::uint32_t>(z * m_width + x);
+}
+
+bool NavGrid::connected(std::uint32_t from, int dx, int dz) const
+{
+	const int x{ static_cast<int>(from % m_width) + dx };
+	const int z{ static_cast<int>(from / m_width) + dz };
+	if (x < 0 || z < 0 || x >= m_width || z >= m_depth)
+	{
+		return false;
+	}
+
+	const float fromFloor{ m_floor[from] };
+	const float toFloor{ m_floor[static_cast<std::size_t>(z) * m_width + x] };
+	if (fromFloor == -INFINITY || toFloor == -INFINITY || std::abs(fromFloor - toFloor) > maxStep)
+	{
+		return false;
+	}
+
+	// Diagonals may not cut a corner
+	if (dx != 0 && dz != 0)
+	{
+		return connected(from, dx, 0) && connected(from, 0, dz);
+	}
+
+	return true;
+}
+
+void NavGrid::integrate(std::uint32_t goal)
+{
+	std::fill(m_distance.begin(), m_distance.end(), INFINITY);
+	m_stats.reachable = 0;
+
+	if (goal == m_none || m_floor[goal] == -INFINITY)
+	{
+		return;
+	}
+
+	// Dijkstra with a reused binary heap; stale entries are skipped when popped
+	const auto later{ std::greater<std::pair<float, std::uint32_t>>{} };
+
+	m_open.clear();
+	m_distance[goal] = 0.0f;
+	m_open.emplace_back(0.0f, goal);
+
+	while (!m_open.empty())
+	{
+		std::pop_heap(m_open.begin(), m_open.end(), later);
+		const auto [distance, cell] { m_open.back() };
+		m_open.pop_back();
+
+		if (distance > m_distance[cell])
+		{
+			continue;
+		}
+		++m_stats.reachable;
+
+		for (int i{ 0 }; i < 8; ++i)
+		{
+			if (!connected(cell, neighbourX[i], neighbourZ[i]))
+			{
+				continue;
+			}
+
+			const std::uint32_t next{ static_cast<std::uint32_t>(static_cast<int>(cell) + neighbourZ[i] * m_width + neighbourX[i]) };
+			const float step{ (i < 4 ? 1.0f : 1.41421356f) * m_cellSize };
+			if (distance + step < m_distance[next])
+			{
+				m_distance[next] = distance + step;
+				m_open.emplace_back(distance + step, next);
+				std::push_heap(m_open.begin(), m_open.end(), later);
+			}
+		}
+	}
+}
+
+void NavGrid::buildFlow(JobSystem& jobs)
+{
+	// Each cell only reads the finished distances, so rows are independent
+	jobs.parallelFor(static_cast<std::size_t>(m_depth), 16, [this](std::size_t begin, std::size_t end)
+		{
+			for (std::size_t z{ begin }; z < end; ++z)
+			{
+				for (int x{ 0 }; x < m_width; ++x)
+				{
+					const std::uint32_t cell{ static_cast<std::uint32_t>(z * m_width + x) };
+
+					float best{ m_distance[cell] };
+					glm::vec2 flow{ 0.0f };
+					for (int i{ 0 }; i < 8; ++i)
+					{
+						if (!connected(cell, neighbourX[i], neighbourZ[i]))
+						{
+							continue;
+						}
+
+						const float distance{ m_distance[static_cast<int>(cell) + neighbourZ[i] * m_width + neighbourX[i]] };
+						if (distance < best)
+						{
+							best = distance;
+							flow = glm::normalize(glm::vec2{ neighbourX[i], neighbourZ[i] });
+						}
+					}
+
+					m_flow[cell] = flow;
+				}
+			}
+		});
+}
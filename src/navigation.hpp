@@ -0,0 +1,73 @@
+#pragma once
+
+#include "jobs.hpp"
+#include "level.hpp"
+
+#include "glm/glm.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// A walkable grid over the XZ plane baked from the level's boxes, with one flow field
+// toward a shared goal. The field is only rebuilt when the goal enters a different cell,
+// and every agent reads its heading from its own cell in O(1), so the per-agent cost
+// does not depend on the level size or the distance to the goal.
+class NavGrid final
+{
+public:
+
+	struct Stats
+	{
+		std::size_t cells{};
+		std::size_t walkable{};
+		std::size_t reachable{};
+		std::uint64_t rebuilds{};
+		double lastRebuildMs{};
+	};
+
+	explicit NavGrid(const Level::Manifest& manifest, float cellSize = 1.0f);
+	NavGrid(const NavGrid&) = delete;
+	NavGrid& operator=(const NavGrid&) = delete;
+
+	// Returns true when the goal changed cell and the field was rebuilt
+	bool setGoal(const glm::vec3& goal, JobSystem& jobs);
+
+	// Unit XZ heading toward the goal, zero where there is no floor or no path
+	glm::vec2 direction(const glm::vec3& position) const;
+	// Top of the highest box under the position, -INFINITY off the level
+	float floorHeight(const glm::vec3& position) const;
+
+	const Stats& stats() const { return m_stats; }
+
+	// Neighbouring floors further apart than this are not connected
+	float maxStep{ 0.5f };
+
+private:
+
+	static constexpr std::uint32_t m_none{ 0xFFFFFFFF };
+
+	std::uint32_t cellIndex(const glm::vec3& position) const;
+	bool connected(std::uint32_t from, int dx, int dz) const;
+
+	void integrate(std::uint32_t goal);
+	void buildFlow(JobSystem& jobs);
+
+	float m_cellSize{};
+	glm::vec2 m_origin{};
+	int m_width{};
+	int m_depth{};
+
+	std::vector<float> m_floor{};
+	std::vector<float> m_distance{};
+	std::vector<glm::vec2> m_flow{};
+
+	std::uint32_t m_goalCell{ m_none };
+	glm::vec3 m_goal{};
+
+	// Reused by integrate(); pairs of (distance, cell)
+	std::vector<std::pair<float, std::uint32_t>> m_open{};
+
+	Stats m_stats{};
+};
@@ -0,0 +1,306 @@
+#include "occlusion.hpp"
+
+#include "glm/glm.hpp"
+
+#include <xmmintrin.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace
+{
+
+	// Corner i takes max on axis k when bit k of i is set
+	constexpr int boxTriangles[12][3]
+	{
+		{ 0, 2, 3 }, { 0, 3, 1 },
+		{ 4, 5, 7 }, { 4, 7, 6 },
+		{ 0, 1, 5 }, { 0, 5, 4 },
+		{ 2, 6, 7 }, { 2, 7, 3 },
+		{ 0, 4, 6 }, { 0, 6, 2 },
+		{ 1, 3, 7 }, { 1, 7, 5 },
+	};
+
+	constexpr float nearW{ 0.001f };
+
+	// Clip space corners; false when any lies behind the near plane
+	bool projectBox(const glm::mat4& toClip, const glm::vec3& min, const glm::vec3& max, std::array<glm::vec3, 8>& screen)
+	{
+		for (int i{ 0 }; i < 8; ++i)
+		{
+			const glm::vec3 corner{ (i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z };
+			const glm::vec4 clip{ toClip * glm::vec4{ corner, 1.0f } };
+			if (clip.w <= nearW)
+			{
+				return false;
+			}
+
+			const glm::vec3 ndc{ glm::vec3{ clip } / clip.w };
+			screen[i] =
+			{
+				(ndc.x * 0.5f + 0.5f) * OcclusionCuller::width,
+				(0.5f - ndc.y * 0.5f) * OcclusionCuller::height,
+				ndc.z * 0.5f + 0.5f,
+			};
+		}
+		return true;
+	}
+
+}
+
+OcclusionCuller::OcclusionCuller()
+	: m_depth(static_cast<std::size_t>(width) * height, 1.0f)
+{
+	int levelWidth{ width / m_blockSize };
+	int levelHeight{ height / m_blockSize };
+	while (true)
+	{
+		m_levels.push_back({ levelWidth, levelHeight, std::vector<float>(static_cast<std::size_t>(levelWidth) * levelHeight, 1.0f) });
+		if (levelWidth == 1 && levelHeight == 1)
+		{
+			break;
+		}
+		levelWidth = (levelWidth + 1) / 2;
+		levelHeight = (levelHeight + 1) / 2;
+	}
+}
+
+void OcclusionCuller::beginFrame(const glm::mat4& viewProj)
+{
+	m_viewProj = viewProj;
+	m_occluders.clear();
+	m_stats = {};
+}
+
+void OcclusionCuller::addOccluder(const glm::mat4& world, const glm::vec3& min, const glm::vec3& max)
+{
+	Box screen{};
+	if (projectBox(m_viewProj * world, min, max, screen))
+	{
+		m_occluders.push_back(screen);
+	}
+}
+
+void OcclusionCuller::rasterize(JobSystem* jobs)
+{
+	const auto start{ std::chrono::steady_clock::now() };
+
+	m_stats.occluders = m_occluders.size();
+
+	// Nothing to draw: the buffer only needs clearing if an earlier frame drew into it
+	if (m_occluders.empty())
+	{
+		if (!m_clear)
+		{
+			std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+			for (Level& level : m_levels)
+			{
+				std::fill(level.maxDepth.begin(), level.maxDepth.end(), 1.0f);
+			}
+			m_clear = true;
+		}
+		m_stats.rasterizeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return;
+	}
+	m_clear = false;
+
+	constexpr int bands{ height / m_bandHeight };
+	if (jobs)
+	{
+		jobs->parallelFor(bands, 1, [this](std::size_t begin, std::size_t end)
+			{
+				for (std::size_t band{ begin }; band < end; ++band)
+				{
+					rasterizeBand(static_cast<int>(band));
+				}
+			});
+	}
+	else
+	{
+		for (int band{ 0 }; band < bands; ++band)
+		{
+			rasterizeBand(band);
+		}
+	}
+
+	for (std::size_t level{ 1 }; level < m_levels.size(); ++level)
+	{
+		const Level& source{ m_levels[level - 1] };
+		Level& target{ m_levels[level] };
+		for (int y{ 0 }; y < target.height; ++y)
+		{
+			for (int x{ 0 }; x < target.width; ++x)
+			{
+				float farthest{ 0.0f };
+				for (int sy{ y * 2 }; sy < std::min(y * 2 + 2, source.height); ++sy)
+				{
+					for (int sx{ x * 2 }; sx < std::min(x * 2 + 2, source.width); ++sx)
+					{
+						farthest = std::max(farthest, source.maxDepth[static_cast<std::size_t>(sy) * source.width + sx]);
+					}
+				}
+				target.maxDepth[static_cast<std::size_t>(y) * target.width + x] = farthest;
+			}
+		}
+	}
+
+	m_stats.rasterizeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void OcclusionCuller::rasterizeBand(int band)
+{
+	const int top{ band * m_bandHeight };
+	const int bottom{ top + m_bandHeight };
+
+	std::fill(m_depth.begin() + static_cast<std::ptrdiff_t>(top) * width, m_depth.begin() + static_cast<std::ptrdiff_t>(bottom) * width, 1.0f);
+
+	for (const Box& box : m_occluders)
+	{
+		for (const auto& triangle : boxTriangles)
+		{
+			rasterizeTriangle(box[triangle[0]], box[triangle[1]], box[triangle[2]], top, bottom);
+		}
+	}
+
+	// The band covers whole block rows, so its part of level 0 is final
+	Level& blocks{ m_levels[0] };
+	for (int by{ top / m_blockSize }; by < bottom / m_blockSize; ++by)
+	{
+		for (int bx{ 0 }; bx < blocks.width; ++bx)
+		{
+			__m128 farthest{ _mm_setzero_ps() };
+			for (int y{ by * m_blockSize }; y < (by + 1) * m_blockSize; ++y)
+			{
+				const float* row{ m_depth.data() + static_cast<std::size_t>(y) * width + bx * m_blockSize };
+				farthest = _mm_max_ps(farthest, _mm_max_ps(_mm_loadu_ps(row), _mm_loadu_ps(row + 4)));
+			}
+
+			alignas(16) float lanes[4];
+			_mm_store_ps(lanes, farthest);
+			blocks.maxDepth[static_cast<std::size_t>(by) * blocks.width + bx] = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+		}
+	}
+}
+
+void OcclusionCuller::rasterizeTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, int top, int bottom)
+{
+	float area{ (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x) };
+	if (std::abs(area) < 1e-6f)
+	{
+		return;
+	}
+
+	// Both windings are drawn; flipping one vertex keeps the edge functions positive inside
+	const glm::vec3& v0{ a };
+	const glm::vec3& v1{ area > 0.0f ? b : c };
+	const glm::vec3& v2{ area > 0.0f ? c : b };
+	area = std::abs(area);
+
+	const int minX{ std::max(0, static_cast<int>(std::floor(std::min({ v0.x, v1.x, v2.x })))) & ~3 };
+	const int maxX{ std::min(width - 1, static_cast<int>(std::ceil(std::max({ v0.x, v1.x, v2.x })))) };
+	const int minY{ std::max(top, static_cast<int>(std::floor(std::min({ v0.y, v1.y, v2.y })))) };
+	const int maxY{ std::min(bottom - 1, static_cast<int>(std::ceil(std::max({ v0.y, v1.y, v2.y })))) };
+	if (minX > maxX || minY > maxY)
+	{
+		return;
+	}
+
+	// Edge i is positive on the inside of the edge opposite vertex i
+	const glm::vec3 edgeA{ v1.y - v2.y, v2.x - v1.x, v1.x * v2.y - v1.y * v2.x };
+	const glm::vec3 edgeB{ v2.y - v0.y, v0.x - v2.x, v2.x * v0.y - v2.y * v0.x };
+	const glm::vec3 edgeC{ v0.y - v1.y, v1.x - v0.x, v0.x * v1.y - v0.y * v1.x };
+
+	// Depth as a plane over the screen, from the barycentric weights
+	const glm::vec3 depthPlane{ (edgeA * v0.z + edgeB * v1.z + edgeC * v2.z) / area };
+
+	const __m128 laneOffsets{ _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f) };
+	const __m128 zero{ _mm_setzero_ps() };
+	const __m128 one{ _mm_set1_ps(1.0f) };
+
+	for (int y{ minY }; y <= maxY; ++y)
+	{
+		const float py{ static_cast<float>(y) + 0.5f };
+		float* row{ m_depth.data() + static_cast<std::size_t>(y) * width };
+
+		for (int x{ minX }; x <= maxX; x += 4)
+		{
+			const __m128 px{ _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets) };
+
+			const __m128 wA{ _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(edgeA.x)), _mm_set1_ps(edgeA.y * py + edgeA.z)) };
+			const __m128 wB{ _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(edgeB.x)), _mm_set1_ps(edgeB.y * py + edgeB.z)) };
+			const __m128 wC{ _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(edgeC.x)), _mm_set1_ps(edgeC.y * py + edgeC.z)) };
+			const __m128 inside{ _mm_and_ps(_mm_cmpge_ps(wA, zero), _mm_and_ps(_mm_cmpge_ps(wB, zero), _mm_cmpge_ps(wC, zero))) };
+			if (_mm_movemask_ps(inside) == 0)
+			{
+				continue;
+			}
+
+			__m128 depth{ _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(depthPlane.x)), _mm_set1_ps(depthPlane.y * py + depthPlane.z)) };
+			depth = _mm_min_ps(_mm_max_ps(depth, zero), one);
+
+			const __m128 old{ _mm_loadu_ps(row + x) };
+			const __m128 nearer{ _mm_min_ps(old, depth) };
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+		}
+	}
+}
+
+bool OcclusionCuller::visible(const glm::mat4& world, const glm::vec3& min, const glm::vec3& max)
+{
+	++m_stats.tested;
+
+	Box screen{};
+	if (!enabled || !projectBox(m_viewProj * world, min, max, screen))
+	{
+		return true;
+	}
+
+	glm::vec3 low{ screen[0] };
+	glm::vec3 high{ screen[0] };
+	for (const glm::vec3& corner : screen)
+	{
+		low = glm::min(low, corner);
+		high = glm::max(high, corner);
+	}
+
+	if (high.x < 0.0f || high.y < 0.0f || low.x >= width || low.y >= height || low.z > 1.0f)
+	{
+		++m_stats.outside;
+		return false;
+	}
+
+	int x0{ std::max(0, static_cast<int>(low.x)) / m_blockSize };
+	int y0{ std::max(0, static_cast<int>(low.y)) / m_blockSize };
+	int x1{ std::min(width - 1, static_cast<int>(high.x)) / m_blockSize };
+	int y1{ std::min(height - 1, static_cast<int>(high.y)) / m_blockSize };
+
+	// Climb until the box covers at most two texels per side
+	std::size_t level{ 0 };
+	while (level + 1 < m_levels.size() && (x1 - x0 > 1 || y1 - y0 > 1))
+	{
+		x0 /= 2;
+		y0 /= 2;
+		x1 /= 2;
+		y1 /= 2;
+		++level;
+	}
+
+	const Level& texels{ m_levels[level] };
+	for (int y{ y0 }; y <= y1; ++y)
+	{
+		for (int x{ x0 }; x <= x1; ++x)
+		{
+			if (texels.maxDepth[static_cast<std::size_t>(y) * texels.width + x] >= low.z)
+			{
+				return true;
+			}
+		}
+	}
+
+	++m_stats.occluded;
+	return false;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "jobs.hpp"
+
+#include "glm/glm.hpp"
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+// Software occlusion culling on the CPU. Each frame a handful of occluder boxes is
+// rasterized into a small depth buffer, split into horizontal bands that rasterize in
+// parallel four pixels at a time. A max-depth pyramid over 8x8 blocks then answers
+// whether a bounding box could show through with a few texel reads, so hidden draws are
+// dropped before submission without reading anything back from the GPU.
+class OcclusionCuller final
+{
+public:
+
+	struct Stats
+	{
+		std::size_t occluders{};
+		std::size_t tested{};
+		std::size_t occluded{};
+		// Entirely off screen, counted apart from occluded
+		std::size_t outside{};
+		double rasterizeMs{};
+	};
+
+	OcclusionCuller();
+	OcclusionCuller(const OcclusionCuller&) = delete;
+	OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+	// Clears the buffer and the stats; occluders and tests that follow use viewProj
+	void beginFrame(const glm::mat4& viewProj);
+
+	// Boxes are in the local space of world. Boxes crossing the near plane are skipped,
+	// since dropping an occluder can only make the test more conservative.
+	void addOccluder(const glm::mat4& world, const glm::vec3& min, const glm::vec3& max);
+
+	// Rasterizes the occluders and builds the pyramid; jobs may be null
+	void rasterize(JobSystem* jobs);
+
+	// False only when the box is certainly hidden behind occluders or off screen
+	bool visible(const glm::mat4& world, const glm::vec3& min, const glm::vec3& max);
+
+	const Stats& stats() const { return m_stats; }
+
+	bool enabled{ true };
+
+	static constexpr int width{ 256 };
+	static constexpr int height{ 144 };
+
+private:
+
+	static constexpr int m_blockSize{ 8 };
+	static constexpr int m_bandHeight{ 16 };
+
+	struct Level
+	{
+		int width{};
+		int height{};
+		std::vector<float> maxDepth{};
+	};
+
+	// Screen space x and y in pixels, depth in [0, 1]
+	using Box = std::array<glm::vec3, 8>;
+
+	void rasterizeBand(int band);
+	void rasterizeTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, int top, int bottom);
+
+	glm::mat4 m_viewProj{ 1.0f };
+
+	std::vector<float> m_depth{};
+	std::vector<Box> m_occluders{};
+	// Level 0 holds one texel per 8x8 block, each further level halves both sides
+	std::vector<Level> m_levels{};
+	// Every depth is at the far plane, as after a frame without occluders
+	bool m_clear{ true };
+
+	Stats m_stats{};
+};
@@ -0,0 +1,281 @@
+#include "particles.hpp"
+
+#include "glm/glm.hpp"
+#include "glm/gtc/constants.hpp"
+
+#include <emmintrin.h>
+#include <xmmintrin.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <span>
+#include <vector>
+
+namespace
+{
+
+	// Particles per job; below it a pool is not worth splitting
+	constexpr std::size_t particleGrain{ 16384 };
+
+	// Whole groups of four from begin, which is a multiple of four
+	void integrate(ParticleSystem::Emitter& emitter, std::size_t begin, std::size_t end, float seconds)
+	{
+		const ParticleSystem::EmitterSettings& settings{ emitter.settings };
+		const __m128 dt{ _mm_set1_ps(seconds) };
+		const __m128 keep{ _mm_set1_ps(std::max(0.0f, 1.0f - settings.drag * seconds)) };
+		const __m128 gravityX{ _mm_set1_ps(settings.gravity.x * seconds) };
+		const __m128 gravityY{ _mm_set1_ps(settings.gravity.y * seconds) };
+		const __m128 gravityZ{ _mm_set1_ps(settings.gravity.z * seconds) };
+
+		float* positionX{ emitter.positionX.data() };
+		float* positionY{ emitter.positionY.data() };
+		float* positionZ{ emitter.positionZ.data() };
+		float* velocityX{ emitter.velocityX.data() };
+		float* velocityY{ emitter.velocityY.data() };
+		float* velocityZ{ emitter.velocityZ.data() };
+		float* age{ emitter.age.data() };
+
+		for (std::size_t i{ begin }; i < end; i += 4)
+		{
+			const __m128 vx{ _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(velocityX + i), gravityX), keep) };
+			const __m128 vy{ _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(velocityY + i), gravityY), keep) };
+			const __m128 vz{ _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(velocityZ + i), gravityZ), keep) };
+			_mm_storeu_ps(velocityX + i, vx);
+			_mm_storeu_ps(velocityY + i, vy);
+			_mm_storeu_ps(velocityZ + i, vz);
+
+			_mm_storeu_ps(positionX + i, _mm_add_ps(_mm_loadu_ps(positionX + i), _mm_mul_ps(vx, dt)));
+			_mm_storeu_ps(positionY + i, _mm_add_ps(_mm_loadu_ps(positionY + i), _mm_mul_ps(vy, dt)));
+			_mm_storeu_ps(positionZ + i, _mm_add_ps(_mm_loadu_ps(positionZ + i), _mm_mul_ps(vz, dt)));
+			_mm_storeu_ps(age + i, _mm_add_ps(_mm_loadu_ps(age + i), dt));
+		}
+	}
+
+	void copyParticle(ParticleSystem::Emitter& emitter, std::size_t to, std::size_t from)
+	{
+		emitter.positionX[to] = emitter.positionX[from];
+		emitter.positionY[to] = emitter.positionY[from];
+		emitter.positionZ[to] = emitter.positionZ[from];
+		emitter.velocityX[to] = emitter.velocityX[from];
+		emitter.velocityY[to] = emitter.velocityY[from];
+		emitter.velocityZ[to] = emitter.velocityZ[from];
+		emitter.age[to] = emitter.age[from];
+		emitter.lifetime[to] = emitter.lifetime[from];
+		emitter.seed[to] = emitter.seed[from];
+	}
+
+	// Returns how many died. Groups of four with nobody dead are skipped with one compare;
+	// a dead particle takes the last live one's place, which is then checked in turn.
+	std::size_t kill(ParticleSystem::Emitter& emitter)
+	{
+		const float* age{ emitter.age.data() };
+		const float* lifetime{ emitter.lifetime.data() };
+
+		std::size_t killed{ 0 };
+		std::size_t i{ 0 };
+		while (i < emitter.count)
+		{
+			if (i + 4 <= emitter.count && _mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(age + i), _mm_loadu_ps(lifetime + i))) == 0)
+			{
+				i += 4;
+				continue;
+			}
+
+			if (age[i] >= lifetime[i])
+			{
+				copyParticle(emitter, i, --emitter.count);
+				++killed;
+			}
+			else
+			{
+				++i;
+			}
+		}
+		return killed;
+	}
+
+	// Sequential 16 byte stores, which suits write-combined mapped buffers
+	void writeRange(const ParticleSystem::Emitter& emitter, std::size_t begin, std::size_t end, ParticleSystem::Instance* out)
+	{
+		const __m128 one{ _mm_set1_ps(1.0f) };
+		const __m128 scale{ _mm_set1_ps(65535.0f) };
+
+		alignas(16) std::int32_t life[4]{};
+		for (std::size_t group{ begin }; group < end; group += 4)
+		{
+			const __m128 fraction{ _mm_min_ps(_mm_div_ps(_mm_loadu_ps(emitter.age.data() + group), _mm_loadu_ps(emitter.lifetime.data() + group)), one) };
+			_mm_store_si128(reinterpret_cast<__m128i*>(life), _mm_cvttps_epi32(_mm_mul_ps(fraction, scale)));
+
+			for (std::size_t i{ group }; i < std::min(group + 4, end); ++i)
+			{
+				out[i] =
+				{
+					.position{ emitter.positionX[i], emitter.positionY[i], emitter.positionZ[i] },
+					.lifeAndSeed{ static_cast<std::uint32_t>(life[i - group]) | static_cast<std::uint32_t>(emitter.seed[i]) << 16 },
+				};
+			}
+		}
+	}
+
+	double millisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+}
+
+ParticleSystem::Handle ParticleSystem::addEmitter(const EmitterSettings& settings)
+{
+	const std::size_t padded{ (static_cast<std::size_t>(settings.capacity) + 3) & ~std::size_t{ 3 } };
+
+	// Zeroed, so the lanes past the live particles never integrate garbage
+	Emitter emitter{ .settings{ settings } };
+	for (std::vector<float>* array : { &emitter.positionX, &emitter.positionY, &emitter.positionZ,
+		&emitter.velocityX, &emitter.velocityY, &emitter.velocityZ, &emitter.age, &emitter.lifetime })
+	{
+		array->assign(padded, 0.0f);
+	}
+	emitter.seed.assign(padded, 0);
+
+	return m_emitters.insert(std::move(emitter));
+}
+
+void ParticleSystem::removeEmitter(Handle emitter)
+{
+	if (!m_emitters.erase(emitter))
+	{
+		std::cerr << "ENGINE, ERROR, LOW, Removing a stale particle emitter handle\n";
+	}
+}
+
+const ParticleSystem::EmitterSettings* ParticleSystem::settings(Handle emitter) const
+{
+	const Emitter* found{ m_emitters.get(emitter) };
+	return found ? &found->settings : nullptr;
+}
+
+std::size_t ParticleSystem::emit(Handle handle, std::size_t count, const glm::vec3& position, const glm::vec3& velocity)
+{
+	Emitter* emitter{ m_emitters.get(handle) };
+	if (!emitter)
+	{
+		return 0;
+	}
+
+	const EmitterSettings& settings{ emitter->settings };
+	count = std::min<std::size_t>(count, settings.capacity - emitter->count);
+
+	// A basis around the direction, for picking velocities inside the cone
+	const glm::vec3 axis{ glm::length(settings.direction) > 0.0f ? glm::normalize(settings.direction) : glm::vec3{ 0.0f, 1.0f, 0.0f } };
+	const glm::vec3 helper{ std::abs(axis.y) < 0.99f ? glm::vec3{ 0.0f, 1.0f, 0.0f } : glm::vec3{ 1.0f, 0.0f, 0.0f } };
+	const glm::vec3 tangent{ glm::normalize(glm::cross(helper, axis)) };
+	const glm::vec3 bitangent{ glm::cross(axis, tangent) };
+	const float minCos{ std::cos(std::min(settings.spread, glm::pi<float>())) };
+
+	for (std::size_t n{ 0 }; n < count; ++n)
+	{
+		const float cosTheta{ 1.0f - random() * (1.0f - minCos) };
+		const float sinTheta{ std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta)) };
+		const float phi{ random() * glm::two_pi<float>() };
+		const glm::vec3 direction{ axis * cosTheta + (tangent * std::cos(phi) + bitangent * std::sin(phi)) * sinTheta };
+		const glm::vec3 v{ velocity + direction * glm::mix(settings.minSpeed, settings.maxSpeed, random()) };
+		const glm::vec3 p{ position + settings.extent * (glm::vec3{ random(), random(), random() } * 2.0f - 1.0f) };
+
+		const std::size_t i{ emitter->count++ };
+		emitter->positionX[i] = p.x;
+		emitter->positionY[i] = p.y;
+		emitter->positionZ[i] = p.z;
+		emitter->velocityX[i] = v.x;
+		emitter->velocityY[i] = v.y;
+		emitter->velocityZ[i] = v.z;
+		emitter->age[i] = 0.0f;
+		emitter->lifetime[i] = std::max(glm::mix(settings.minLifetime, settings.maxLifetime, random()), 0.001f);
+		emitter->seed[i] = static_cast<std::uint16_t>(m_random >> 16);
+	}
+
+	m_spawned += count;
+	return count;
+}
+
+void ParticleSystem::update(float seconds, JobSystem* jobs)
+{
+	const auto start{ std::chrono::steady_clock::now() };
+
+	m_stats.killed = 0;
+	m_stats.capacity = 0;
+	for (Emitter& emitter : m_emitters)
+	{
+		const std::size_t groups{ (emitter.count + 3) / 4 };
+		if (jobs && emitter.count > particleGrain)
+		{
+			jobs->parallelFor(groups, particleGrain / 4,
+				[&](std::size_t begin, std::size_t end) { integrate(emitter, begin * 4, end * 4, seconds); });
+		}
+		else
+		{
+			integrate(emitter, 0, groups * 4, seconds);
+		}
+
+		m_stats.killed += kill(emitter);
+		m_stats.capacity += emitter.settings.capacity;
+	}
+
+	m_stats.emitters = m_emitters.size();
+	m_stats.live = liveCount();
+	m_stats.spawned = m_spawned;
+	m_spawned = 0;
+	m_stats.updateMs = millisecondsSince(start);
+}
+
+std::size_t ParticleSystem::liveCount() const
+{
+	std::size_t count{ 0 };
+	for (const Emitter& emitter : m_emitters)
+	{
+		count += emitter.count;
+	}
+	return count;
+}
+
+void ParticleSystem::writeInstances(std::span<Instance> out, JobSystem* jobs)
+{
+	const auto start{ std::chrono::steady_clock::now() };
+
+	m_batches.clear();
+	std::uint32_t first{ 0 };
+	for (const Emitter& emitter : m_emitters)
+	{
+		if (emitter.count == 0 || first + emitter.count > out.size())
+		{
+			continue;
+		}
+
+		Instance* instances{ out.data() + first };
+		if (jobs && emitter.count > particleGrain)
+		{
+			jobs->parallelFor(emitter.count, particleGrain,
+				[&](std::size_t begin, std::size_t end) { writeRange(emitter, begin, end, instances); });
+		}
+		else
+		{
+			writeRange(emitter, 0, emitter.count, instances);
+		}
+
+		m_batches.push_back({ &emitter.settings, first, emitter.count });
+		first += emitter.count;
+	}
+
+	m_stats.writeMs = millisecondsSince(start);
+}
+
+float ParticleSystem::random()
+{
+	m_random ^= m_random << 13;
+	m_random ^= m_random >> 17;
+	m_random ^= m_random << 5;
+	return static_cast<float>(m_random >> 8) * (1.0f / 16777216.0f);
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "jobs.hpp"
+#include "slot_map.hpp"
+
+#include "glm/glm.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Short-lived effects. Every emitter owns a pool of fixed capacity stored as structure of
+// arrays, integrated four particles at a time; dead particles are replaced by the last live
+// one, so spawning and killing are O(1) and the live ones stay packed at the front.
+class ParticleSystem final
+{
+public:
+
+	struct EmitterSettings
+	{
+		// Spawns past it are dropped
+		std::uint32_t capacity{ 1024 };
+
+		// Per particle, picked uniformly between the bounds
+		float minLifetime{ 0.5f };
+		float maxLifetime{ 1.0f };
+		float minSpeed{ 1.0f };
+		float maxSpeed{ 2.0f };
+
+		// Velocities leave within spread radians of direction
+		glm::vec3 direction{ 0.0f, 1.0f, 0.0f };
+		float spread{ 0.5f };
+		// Half size of the box around the emit position particles start in
+		glm::vec3 extent{ 0.0f };
+
+		glm::vec3 gravity{ 0.0f, -9.81f, 0.0f };
+		// Share of the velocity lost per second
+		float drag{ 0.0f };
+
+		// Interpolated over each particle's life on the GPU
+		glm::vec4 startColor{ 1.0f };
+		glm::vec4 endColor{ 1.0f, 1.0f, 1.0f, 0.0f };
+		float startSize{ 0.1f };
+		float endSize{ 0.1f };
+		// How far each particle's colour is pulled toward a hue of its own, for confetti
+		float colorVariance{ 0.0f };
+		// Added onto the scene instead of blended over it, for sparks
+		bool additive{ false };
+	};
+
+	// What the renderer reads per particle: the life fraction in the low 16 bits of
+	// lifeAndSeed, the particle's random seed in the high ones
+	struct Instance
+	{
+		glm::vec3 position{};
+		std::uint32_t lifeAndSeed{};
+	};
+
+	// One draw: an emitter's live particles, starting at first in the written instances
+	struct Batch
+	{
+		const EmitterSettings* settings{};
+		std::uint32_t first{};
+		std::uint32_t count{};
+	};
+
+	struct Emitter
+	{
+		EmitterSettings settings{};
+		std::uint32_t count{};
+
+		// Capacity rounded up to whole groups of four, so integration needs no tail loop
+		std::vector<float> positionX{}, positionY{}, positionZ{};
+		std::vector<float> velocityX{}, velocityY{}, velocityZ{};
+		std::vector<float> age{}, lifetime{};
+		std::vector<std::uint16_t> seed{};
+	};
+
+	using Handle = SlotMap<Emitter>::Handle;
+
+	struct Stats
+	{
+		std::size_t emitters{};
+		std::size_t live{};
+		std::size_t capacity{};
+		// Between the last two updates, and by the last one
+		std::size_t spawned{};
+		std::size_t killed{};
+		double updateMs{};
+		double writeMs{};
+	};
+
+	ParticleSystem() = default;
+	ParticleSystem(const ParticleSystem&) = delete;
+	ParticleSystem& operator=(const ParticleSystem&) = delete;
+
+	// Allocates the whole pool up front; nothing allocates while particles come and go
+	Handle addEmitter(const EmitterSettings& settings);
+	void removeEmitter(Handle emitter);
+	const EmitterSettings* settings(Handle emitter) const;
+
+	// Spawns count particles around position on top of velocity; returns how many fit
+	std::size_t emit(Handle emitter, std::size_t count, const glm::vec3& position, const glm::vec3& velocity = glm::vec3{ 0.0f });
+
+	// Large pools are split over the workers; without jobs everything runs on the calling thread
+	void update(float seconds, JobSystem* jobs);
+
+	std::size_t liveCount() const;
+
+	// Fills out, which must hold liveCount() instances, emitter after emitter and records
+	// one batch per emitter with particles. Batches point at the emitters' settings and are
+	// valid until an emitter is added or removed.
+	void writeInstances(std::span<Instance> out, JobSystem* jobs);
+	std::span<const Batch> batches() const { return m_batches; }
+
+	const Stats& stats() const { return m_stats; }
+
+private:
+
+	float random();
+
+	SlotMap<Emitter> m_emitters{};
+	std::vector<Batch> m_batches{};
+
+	// Xorshift state for spawning
+	std::uint32_t m_random{ 0x9E3779B9u };
+	std::size_t m_spawned{ 0 };
+
+	Stats m_stats{};
+};
@@ -0,0 +1,637 @@
+#include "physics.hpp"
+
+#include "glm/glm.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+PhysicsWorld::BodyHandle PhysicsWorld::addBody(const Body& desc)
+{
+	const BodyHandle handle{ m_bodies.insert({
+		.position{ desc.position },
+		.velocity{ desc.velocity },
+		.halfExtents{ desc.halfExtents },
+		.friction{ desc.friction },
+		.canSleep{ desc.canSleep },
+		}) };
+
+	Body& body{ *m_bodies.get(handle) };
+	insertBody(handle, body);
+	makeAwake(handle, body);
+
+	m_stats.bodies = m_bodies.size();
+	return handle;
+}
+
+void PhysicsWorld::removeBody(BodyHandle handle)
+{
+	Body* body{ m_bodies.get(handle) };
+	if (!body)
+	{
+		std::cerr << "PHYSICS, ERROR: Removing a stale body handle\n";
+		return;
+	}
+
+	const glm::vec3 position{ body->position };
+	const glm::vec3 halfExtents{ body->halfExtents };
+
+	makeAsleep(*body);
+	eraseBody(handle, *body);
+	m_bodies.erase(handle);
+
+	// Whatever rested on it has to fall now
+	wakeAround(position, halfExtents);
+
+	m_stats.bodies = m_bodies.size();
+}
+
+PhysicsWorld::StaticHandle PhysicsWorld::addStatic(const glm::vec3& position, const glm::vec3& halfExtents)
+{
+	const StaticHandle handle{ m_statics.insert({ .position{ position }, .halfExtents{ halfExtents } }) };
+	insertStatic(handle, *m_statics.get(handle));
+
+	wakeAround(position, halfExtents);
+	return handle;
+}
+
+void PhysicsWorld::removeStatic(StaticHandle handle)
+{
+	const StaticBox* box{ m_statics.get(handle) };
+	if (!box)
+	{
+		std::cerr << "PHYSICS, ERROR: Removing a stale static handle\n";
+		return;
+	}
+
+	const glm::vec3 position{ box->position };
+	const glm::vec3 halfExtents{ box->halfExtents };
+
+	eraseStatic(handle, *box);
+	m_statics.erase(handle);
+
+	wakeAround(position, halfExtents);
+}
+
+void PhysicsWorld::setStatic(StaticHandle handle, const glm::vec3& position, const glm::vec3& halfExtents)
+{
+	StaticBox* box{ m_statics.get(handle) };
+	if (!box)
+	{
+		return;
+	}
+
+	wakeAround(box->position, box->halfExtents);
+
+	eraseStatic(handle, *box);
+	box->position = position;
+	box->halfExtents = halfExtents;
+	insertStatic(handle, *box);
+
+	wakeAround(position, halfExtents);
+}
+
+void PhysicsWorld::setPosition(BodyHandle handle, const glm::vec3& position)
+{
+	if (Body* body{ m_bodies.get(handle) })
+	{
+		wakeAround(body->position, body->halfExtents);
+
+		body->position = position;
+		updateCells(handle, *body);
+		makeAwake(handle, *body);
+	}
+}
+
+void PhysicsWorld::setVelocity(BodyHandle handle, const glm::vec3& velocity)
+{
+	if (Body* body{ m_bodies.get(handle) })
+	{
+		body->velocity = velocity;
+		makeAwake(handle, *body);
+	}
+}
+
+void PhysicsWorld::addVelocity(BodyHandle handle, const glm::vec3& velocity)
+{
+	if (Body* body{ m_bodies.get(handle) })
+	{
+		body->velocity += velocity;
+		makeAwake(handle, *body);
+	}
+}
+
+void PhysicsWorld::wake(BodyHandle handle)
+{
+	if (Body* body{ m_bodies.get(handle) })
+	{
+		makeAwake(handle, *body);
+	}
+}
+
+void PhysicsWorld::step()
+{
+	m_stats.contacts = 0;
+
+	// Same order as the original player code: fall, then slide along x and z
+	for (const BodyHandle handle : m_awake)
+	{
+		Body& body{ *m_bodies.get(handle) };
+
+		body.velocity.y -= gravity;
+		body.grounded = false;
+
+		moveAxis(body, 1);
+		moveAxis(body, 0);
+		body.velocity.x *= body.friction;
+		moveAxis(body, 2);
+		body.velocity.z *= body.friction;
+
+		updateCells(handle, body);
+	}
+
+	// Bottom up, so a body knows whether what it rests on is supported before resolving against it
+	std::sort(m_awake.begin(), m_awake.end(), [this](BodyHandle a, BodyHandle b)
+		{
+			const Body& bodyA{ *m_bodies.get(a) };
+			const Body& bodyB{ *m_bodies.get(b) };
+			return bodyA.position.y - bodyA.halfExtents.y < bodyB.position.y - bodyB.halfExtents.y;
+		});
+	for (std::uint32_t slot{ 0 }; slot < m_awake.size(); ++slot)
+	{
+		m_bodies.get(m_awake[slot])->awakeIndex = slot;
+	}
+
+	m_islandParent.resize(m_awake.size());
+	std::iota(m_islandParent.begin(), m_islandParent.end(), 0u);
+
+	// Bodies woken here are appended to m_awake and visited by this same loop
+	for (std::uint32_t slot{ 0 }; slot < m_awake.size(); ++slot)
+	{
+		collideBodies(slot);
+	}
+
+	for (const BodyHandle handle : m_awake)
+	{
+		Body& body{ *m_bodies.get(handle) };
+
+		const bool still{ glm::dot(body.velocity, body.velocity) < sleepSpeed * sleepSpeed };
+		body.stillTicks = still && body.canSleep ? body.stillTicks + 1 : 0;
+	}
+
+	sleepIslands();
+
+	m_stats.bodies = m_bodies.size();
+	m_stats.awake = m_awake.size();
+}
+
+bool PhysicsWorld::overlapsStatic(const glm::vec3& position, const glm::vec3& halfExtents) const
+{
+	const glm::ivec3 cellMin{ cellOf(position - halfExtents) };
+	const glm::ivec3 cellMax{ cellOf(position + halfExtents) };
+
+	for (int z{ cellMin.z }; z <= cellMax.z; ++z)
+	{
+		for (int y{ cellMin.y }; y <= cellMax.y; ++y)
+		{
+			for (int x{ cellMin.x }; x <= cellMax.x; ++x)
+			{
+				const auto cell{ m_cells.find({ x, y, z }) };
+				if (cell == m_cells.end())
+				{
+					continue;
+				}
+
+				for (const StaticHandle handle : cell->second.statics)
+				{
+					const StaticBox& box{ *m_statics.get(handle) };
+					if (glm::all(glm::lessThanEqual(glm::abs(position - box.position), halfExtents + box.halfExtents)))
+					{
+						return true;
+					}
+				}
+			}
+		}
+	}
+
+	return false;
+}
+
+glm::ivec3 PhysicsWorld::cellOf(const glm::vec3& position)
+{
+	return glm::ivec3{ glm::floor(position / m_cellSize) };
+}
+
+template <typename Handle>
+void PhysicsWorld::eraseFrom(std::vector<Handle>& handles, Handle handle)
+{
+	const auto it{ std::find(handles.begin(), handles.end(), handle) };
+	if (it != handles.end())
+	{
+		*it = handles.back();
+		handles.pop_back();
+	}
+}
+
+void PhysicsWorld::queryBodies(const glm::vec3& position, const glm::vec3& halfExtents, std::vector<BodyHandle>& bodies) const
+{
+	bodies.clear();
+
+	const glm::ivec3 cellMin{ cellOf(position - halfExtents) };
+	const glm::ivec3 cellMax{ cellOf(position + halfExtents) };
+
+	for (int z{ cellMin.z }; z <= cellMax.z; ++z)
+	{
+		for (int y{ cellMin.y }; y <= cellMax.y; ++y)
+		{
+			for (int x{ cellMin.x }; x <= cellMax.x; ++x)
+			{
+				const auto cell{ m_cells.find({ x, y, z }) };
+				if (cell != m_cells.end())
+				{
+					bodies.insert(bodies.end(), cell->second.bodies.begin(), cell->second.bodies.end());
+				}
+			}
+		}
+	}
+
+	// Bodies spanning several cells show up once per cell
+	std::sort(bodies.begin(), bodies.end(), [](BodyHandle a, BodyHandle b) { return a.index < b.index; });
+	bodies.erase(std::unique(bodies.begin(), bodies.end()), bodies.end());
+}
+
+void PhysicsWorld::insertBody(BodyHandle handle, Body& body)
+{
+	body.cellMin = cellOf(body.position - body.halfExtents);
+	body.cellMax = cellOf(body.position + body.halfExtents);
+
+	for (int z{ body.cellMin.z }; z <= body.cellMax.z; ++z)
+	{
+		for (int y{ body.cellMin.y }; y <= body.cellMax.y; ++y)
+		{
+			for (int x{ body.cellMin.x }; x <= body.cellMax.x; ++x)
+			{
+				m_cells[{ x, y, z }].bodies.push_back(handle);
+			}
+		}
+	}
+}
+
+void PhysicsWorld::eraseBody(BodyHandle handle, const Body& body)
+{
+	for (int z{ body.cellMin.z }; z <= body.cellMax.z; ++z)
+	{
+		for (int y{ body.cellMin.y }; y <= body.cellMax.y; ++y)
+		{
+			for (int x{ body.cellMin.x }; x <= body.cellMax.x; ++x)
+			{
+				eraseFrom(m_cells[{ x, y, z }].bodies, handle);
+			}
+		}
+	}
+}
+
+void PhysicsWorld::updateCells(BodyHandle handle, Body& body)
+{
+	if (cellOf(body.position - body.halfExtents) != body.cellMin || cellOf(body.position + body.halfExtents) != body.cellMax)
+	{
+		eraseBody(handle, body);
+		insertBody(handle, body);
+	}
+}
+
+void PhysicsWorld::insertStatic(StaticHandle handle, StaticBox& box)
+{
+	box.cellMin = cellOf(box.position - box.halfExtents);
+	box.cellMax = cellOf(box.position + box.halfExtents);
+
+	for (int z{ box.cellMin.z }; z <= box.cellMax.z; ++z)
+	{
+		for (int y{ box.cellMin.y }; y <= box.cellMax.y; ++y)
+		{
+			for (int x{ box.cellMin.x }; x <= box.cellMax.x; ++x)
+			{
+				m_cells[{ x, y, z }].statics.push_back(handle);
+			}
+		}
+	}
+}
+
+void PhysicsWorld::eraseStatic(StaticHandle handle, const StaticBox& box)
+{
+	for (int z{ box.cellMin.z }; z <= box.cellMax.z; ++z)
+	{
+		for (int y{ box.cellMin.y }; y <= box.cellMax.y; ++y)
+		{
+			for (int x{ box.cellMin.x }; x <= box.cellMax.x; ++x)
+			{
+				eraseFrom(m_cells[{ x, y, z }].statics, handle);
+			}
+		}
+	}
+}
+
+void PhysicsWorld::makeAwake(BodyHandle handle, Body& body)
+{
+	body.stillTicks = 0;
+
+	if (body.awakeIndex != 0xFFFFFFFF)
+	{
+		return;
+	}
+
+	const bool wasSleeping{ body.sleeping };
+	m_wakeStack.clear();
+	m_wakeStack.push_back(handle);
+
+	while (!m_wakeStack.empty())
+	{
+		const BodyHandle current{ m_wakeStack.back() };
+		m_wakeStack.pop_back();
+
+		Body& woken{ *m_bodies.get(current) };
+		if (woken.awakeIndex != 0xFFFFFFFF)
+		{
+			continue;
+		}
+
+		woken.sleeping = false;
+		woken.stillTicks = 0;
+		woken.awakeIndex = static_cast<std::uint32_t>(m_awake.size());
+		m_awake.push_back(current);
+
+		// A body woken mid-step starts as its own island
+		if (m_islandParent.size() < m_awake.size())
+		{
+			m_islandParent.push_back(woken.awakeIndex);
+		}
+
+		// A new body has nothing resting on it yet
+		if (!wasSleeping)
+		{
+			continue;
+		}
+
+		const glm::vec3 reach{ woken.halfExtents + glm::vec3{ m_contactMargin } };
+		queryBodies(woken.position, reach, m_wakeQuery);
+		for (const BodyHandle otherHandle : m_wakeQuery)
+		{
+			const Body& other{ *m_bodies.get(otherHandle) };
+			if (other.sleeping && glm::all(glm::lessThanEqual(glm::abs(other.position - woken.position), other.halfExtents + reach)))
+			{
+				m_wakeStack.push_back(otherHandle);
+			}
+		}
+	}
+}
+
+void PhysicsWorld::makeAsleep(Body& body)
+{
+	if (body.awakeIndex == 0xFFFFFFFF)
+	{
+		return;
+	}
+
+	const BodyHandle moved{ m_awake.back() };
+	m_awake[body.awakeIndex] = moved;
+	m_bodies.get(moved)->awakeIndex = body.awakeIndex;
+	m_awake.pop_back();
+
+	body.awakeIndex = 0xFFFFFFFF;
+	body.sleeping = true;
+	body.velocity = glm::vec3{ 0.0f };
+}
+
+void PhysicsWorld::wakeAround(const glm::vec3& position, const glm::vec3& halfExtents)
+{
+	const glm::vec3 reach{ halfExtents + glm::vec3{ m_contactMargin } };
+
+	queryBodies(position, reach, m_query);
+	for (const BodyHandle handle : m_query)
+	{
+		Body& body{ *m_bodies.get(handle) };
+		if (glm::all(glm::lessThanEqual(glm::abs(body.position - position), body.halfExtents + reach)))
+		{
+			makeAwake(handle, body);
+		}
+	}
+}
+
+void PhysicsWorld::moveAxis(Body& body, int axis)
+{
+	const float velocity{ body.velocity[axis] };
+	if (velocity == 0.0f)
+	{
+		return;
+	}
+
+	body.position[axis] += velocity;
+
+	const glm::ivec3 cellMin{ cellOf(body.position - body.halfExtents) };
+	const glm::ivec3 cellMax{ cellOf(body.position + body.halfExtents) };
+
+	bool hit{ false };
+	float limit{ velocity < 0.0f ? -INFINITY : INFINITY };
+
+	for (int z{ cellMin.z }; z <= cellMax.z; ++z)
+	{
+		for (int y{ cellMin.y }; y <= cellMax.y; ++y)
+		{
+			for (int x{ cellMin.x }; x <= cellMax.x; ++x)
+			{
+				const auto cell{ m_cells.find({ x, y, z }) };
+				if (cell == m_cells.end())
+				{
+					continue;
+				}
+
+				for (const StaticHandle handle : cell->second.statics)
+				{
+					const StaticBox& box{ *m_statics.get(handle) };
+					if (!glm::all(glm::lessThan(glm::abs(body.position - box.position), body.halfExtents + box.halfExtents)))
+					{
+						continue;
+					}
+
+					// Back out against the direction of travel to the nearest face
+					hit = true;
+					if (velocity < 0.0f)
+					{
+						limit = std::max(limit, box.position[axis] + box.halfExtents[axis] + body.halfExtents[axis]);
+					}
+					else
+					{
+						limit = std::min(limit, box.position[axis] - box.halfExtents[axis] - body.halfExtents[axis]);
+					}
+				}
+			}
+		}
+	}
+
+	if (hit)
+	{
+		body.position[axis] = limit + (velocity < 0.0f ? m_separation : -m_separation);
+		body.velocity[axis] = 0.0f;
+
+		if (axis == 1 && velocity < 0.0f)
+		{
+			body.grounded = true;
+		}
+	}
+}
+
+void PhysicsWorld::collideBodies(std::uint32_t slot)
+{
+	const BodyHandle handle{ m_awake[slot] };
+
+	{
+		const Body& body{ *m_bodies.get(handle) };
+		queryBodies(body.position, body.halfExtents + glm::vec3{ m_contactMargin }, m_query);
+	}
+
+	for (const BodyHandle otherHandle : m_query)
+	{
+		if (otherHandle == handle)
+		{
+			continue;
+		}
+
+		Body& body{ *m_bodies.get(handle) };
+		Body& other{ *m_bodies.get(otherHandle) };
+
+		// Pairs of awake bodies are handled once, by the earlier slot
+		if (!other.sleeping && other.awakeIndex < slot)
+		{
+			continue;
+		}
+
+		const glm::vec3 delta{ body.position - other.position };
+		const glm::vec3 penetration{ body.halfExtents + other.halfExtents - glm::abs(delta) };
+		if (glm::any(glm::lessThan(penetration, glm::vec3{ -m_contactMargin })))
+		{
+			continue;
+		}
+
+		const bool overlapping{ glm::all(glm::greaterThan(penetration, glm::vec3{ 0.0f })) };
+
+		// Merely touching a sleeping body leaves it asleep; pushing into it wakes it
+		const bool otherWasAsleep{ other.sleeping };
+		if (otherWasAsleep)
+		{
+			if (!overlapping)
+			{
+				continue;
+			}
+			makeAwake(otherHandle, other);
+		}
+
+		++m_stats.contacts;
+		if (body.canSleep && other.canSleep)
+		{
+			uniteIslands(slot, other.awakeIndex);
+		}
+
+		if (!overlapping)
+		{
+			continue;
+		}
+
+		// Split the overlap along the shallowest axis and stop the bodies closing on each other
+		int axis{ 0 };
+		if (penetration.y < penetration[axis]) axis = 1;
+		if (penetration.z < penetration[axis]) axis = 2;
+
+		const float direction{ delta[axis] < 0.0f ? -1.0f : 1.0f };
+
+		Body& upper{ direction > 0.0f ? body : other };
+		Body& lower{ direction > 0.0f ? other : body };
+		const bool lowerSupported{ lower.grounded || (&lower == &other && otherWasAsleep) };
+
+		if (axis == 1 && lowerSupported)
+		{
+			// Resting on something that is itself held up, so only the upper body gives way
+			upper.position.y += penetration.y + m_separation;
+			upper.velocity.y = std::max(upper.velocity.y, lower.velocity.y);
+		}
+		else
+		{
+			const float push{ penetration[axis] * 0.5f + m_separation };
+			body.position[axis] += direction * push;
+			other.position[axis] -= direction * push;
+
+			const float closing{ (body.velocity[axis] - other.velocity[axis]) * direction };
+			if (closing < 0.0f)
+			{
+				const float average{ (body.velocity[axis] + other.velocity[axis]) * 0.5f };
+				body.velocity[axis] = average;
+				other.velocity[axis] = average;
+			}
+		}
+
+		if (axis == 1)
+		{
+			upper.grounded = true;
+		}
+
+		updateCells(handle, body);
+		updateCells(otherHandle, other);
+	}
+}
+
+std::uint32_t PhysicsWorld::findIsland(std::uint32_t slot)
+{
+	while (m_islandParent[slot] != slot)
+	{
+		m_islandParent[slot] = m_islandParent[m_islandParent[slot]];
+		slot = m_islandParent[slot];
+	}
+	return slot;
+}
+
+void PhysicsWorld::uniteIslands(std::uint32_t a, std::uint32_t b)
+{
+	a = findIsland(a);
+	b = findIsland(b);
+	if (a != b)
+	{
+		m_islandParent[std::max(a, b)] = std::min(a, b);
+	}
+}
+
+void PhysicsWorld::sleepIslands()
+{
+	// An island sleeps only when every body in it has been still long enough
+	m_islandStill.assign(m_awake.size(), 1);
+	m_stats.islands = 0;
+
+	for (std::uint32_t slot{ 0 }; slot < m_awake.size(); ++slot)
+	{
+		const std::uint32_t island{ findIsland(slot) };
+		if (island == slot)
+		{
+			++m_stats.islands;
+		}
+		if (m_bodies.get(m_awake[slot])->stillTicks < sleepTicks)
+		{
+			m_islandStill[island] = 0;
+		}
+	}
+
+	m_sleepers.clear();
+	for (std::uint32_t slot{ 0 }; slot < m_awake.size(); ++slot)
+	{
+		if (m_islandStill[findIsland(slot)])
+		{
+			m_sleepers.push_back(m_awake[slot]);
+		}
+	}
+
+	for (const BodyHandle handle : m_sleepers)
+	{
+		makeAsleep(*m_bodies.get(handle));
+	}
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include "slot_map.hpp"
+
+#include "glm/glm.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Axis aligned box bodies moving against static level boxes and each other. Velocities
+// are in units per tick and step() advances one fixed tick, matching the game's update.
+// Bodies that stay slow for a while fall asleep together with everything they touch and
+// are skipped by step() until something moves into them or the world changes around them.
+class PhysicsWorld final
+{
+public:
+
+	struct Body
+	{
+		glm::vec3 position{};
+		glm::vec3 velocity{};
+		glm::vec3 halfExtents{ 0.5f };
+		// Fraction of horizontal velocity kept each tick
+		float friction{ 0.7f };
+		// Characters driven by input never sleep, and do not hold the islands they touch awake
+		bool canSleep{ true };
+
+		// Owned by the world
+		bool grounded{ false };
+		bool sleeping{ false };
+		int stillTicks{};
+		glm::ivec3 cellMin{};
+		glm::ivec3 cellMax{};
+		std::uint32_t awakeIndex{ 0xFFFFFFFF };
+	};
+
+	struct StaticBox
+	{
+		glm::vec3 position{};
+		glm::vec3 halfExtents{};
+
+		glm::ivec3 cellMin{};
+		glm::ivec3 cellMax{};
+	};
+
+	using BodyHandle = SlotMap<Body>::Handle;
+	using StaticHandle = SlotMap<StaticBox>::Handle;
+
+	struct Stats
+	{
+		std::size_t bodies{};
+		std::size_t awake{};
+		std::size_t islands{};
+		std::size_t contacts{};
+	};
+
+	PhysicsWorld() = default;
+	PhysicsWorld(const PhysicsWorld&) = delete;
+	PhysicsWorld& operator=(const PhysicsWorld&) = delete;
+
+	// Only position, velocity, halfExtents, friction and canSleep are read from body
+	BodyHandle addBody(const Body& body);
+	void removeBody(BodyHandle body);
+
+	StaticHandle addStatic(const glm::vec3& position, const glm::vec3& halfExtents);
+	void removeStatic(StaticHandle box);
+	void setStatic(StaticHandle box, const glm::vec3& position, const glm::vec3& halfExtents);
+
+	const Body* body(BodyHandle body) const { return m_bodies.get(body); }
+
+	// These wake the body
+	void setPosition(BodyHandle body, const glm::vec3& position);
+	void setVelocity(BodyHandle body, const glm::vec3& velocity);
+	void addVelocity(BodyHandle body, const glm::vec3& velocity);
+	void wake(BodyHandle body);
+
+	void step();
+
+	// True if the box overlaps any static box
+	bool overlapsStatic(const glm::vec3& position, const glm::vec3& halfExtents) const;
+
+	const Stats& stats() const { return m_stats; }
+
+	float gravity{ 0.6f / 60.0f };
+	// Speed per tick under which a body counts as still, and how long it must stay still
+	float sleepSpeed{ 0.002f };
+	int sleepTicks{ 30 };
+
+private:
+
+	struct CellHash
+	{
+		std::size_t operator()(const glm::ivec3& cell) const
+		{
+			const glm::uvec3 bits{ cell };
+			return (bits.x * 73856093u) ^ (bits.y * 19349663u) ^ (bits.z * 83492791u);
+		}
+	};
+
+	struct Cell
+	{
+		std::vector<BodyHandle> bodies{};
+		std::vector<StaticHandle> statics{};
+	};
+
+	static constexpr float m_cellSize{ 4.0f };
+	// Touching within this distance counts as contact, so resting stacks stay linked
+	static constexpr float m_contactMargin{ 0.01f };
+	static constexpr float m_separation{ 0.0005f };
+
+	static glm::ivec3 cellOf(const glm::vec3& position);
+
+	template <typename Handle>
+	static void eraseFrom(std::vector<Handle>& handles, Handle handle);
+
+	// Every body whose cells overlap the box, each once
+	void queryBodies(const glm::vec3& position, const glm::vec3& halfExtents, std::vector<BodyHandle>& bodies) const;
+
+	void insertBody(BodyHandle handle, Body& body);
+	void eraseBody(BodyHandle handle, const Body& body);
+	void updateCells(BodyHandle handle, Body& body);
+
+	void insertStatic(StaticHandle handle, StaticBox& box);
+	void eraseStatic(StaticHandle handle, const StaticBox& box);
+
+	// Waking a sleeping body wakes everything resting against it, transitively
+	void makeAwake(BodyHandle handle, Body& body);
+	void makeAsleep(Body& body);
+	void wakeAround(const glm::vec3& position, const glm::vec3& halfExtents);
+
+	void moveAxis(Body& body, int axis);
+	void collideBodies(std::uint32_t awakeSlot);
+
+	std::uint32_t findIsland(std::uint32_t slot);
+	void uniteIslands(std::uint32_t a, std::uint32_t b);
+	void sleepIslands();
+
+	SlotMap<Body> m_bodies{};
+	SlotMap<StaticBox> m_statics{};
+	std::unordered_map<glm::ivec3, Cell, CellHash> m_cells{};
+
+	std::vector<BodyHandle> m_awake{};
+
+	// Union-find over awake slots, rebuilt each step from that step's contacts
+	std::vector<std::uint32_t> m_islandParent{};
+	std::vector<unsigned char> m_islandStill{};
+	std::vector<BodyHandle> m_query{};
+	std::vector<BodyHandle> m_wakeQuery{};
+	std::vector<BodyHandle> m_wakeStack{};
+	std::vector<BodyHandle> m_sleepers{};
+
+	Stats m_stats{};
+};
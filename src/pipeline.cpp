@@ -6,6 +6,7 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <utility>
 
 Pipeline::Pipeline(const char* vertexShaderPath, const char* fragmentShaderPath)
@@ -52,14 +53,26 @@ Pipeline::~Pipeline()
 	destruct();
 }
 
-void Pipeline::bind()
+void Pipeline::bind(GLState& state)
 {
-	glUseProgram(m_shaderProgram);
+	state.useProgram(m_shaderProgram);
+}
+
+GLint Pipeline::uniformLocation(const char* name)
+{
+	auto it{ m_uniformLocations.find(std::string_view{ name }) };
+	if (it == m_uniformLocations.end())
+	{
+		it = m_uniformLocations.emplace(name, glGetUniformLocation(m_shaderProgram, name)).first;
+	}
+
+	return it->second;
 }
 
 void Pipeline::move(Pipeline&& p)
 {
 	m_shaderProgram = p.m_shaderProgram;
+	m_uniformLocations = std::move(p.m_uniformLocations);
 
 	p.m_shouldDestruct = false;
 }
@@ -1,7 +1,15 @@
 #pragma once
 
+#include "gl_state.hpp"
+
 #include "glad/glad.h"
 
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
 class Pipeline
 {
 public:
@@ -17,13 +25,15 @@ public:
 
 	~Pipeline();
 
-	void bind();
+	void bind(GLState& state);
 
 	GLuint shaderProgram() const
 	{
 		return m_shaderProgram;
 	}
 
+	GLint uniformLocation(const char* name);
+
 private:
 
 	void move(Pipeline&& p);
@@ -35,4 +45,13 @@ private:
 
 	GLuint m_shaderProgram{};
 
+	// Transparent, so lookups by const char* do not build a std::string
+	struct NameHash
+	{
+		using is_transparent = void;
+		std::size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+	};
+
+	std::unordered_map<std::string, GLint, NameHash, std::equal_to<>> m_uniformLocations{};
+
 };
\ No newline at end of file
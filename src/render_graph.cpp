@@ -0,0 +1,497 @@
+#include "render_graph.hpp"
+
+#include "glad/glad.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+void RenderGraph::Builder::read(Resource resource)
+{
+	m_graph.m_passes[m_pass].reads.push_back(resource);
+}
+
+void RenderGraph::Builder::write(Resource resource)
+{
+	m_graph.m_passes[m_pass].writes.push_back(resource);
+}
+
+void RenderGraph::clear()
+{
+	m_resources.clear();
+	m_passes.clear();
+	m_order.clear();
+}
+
+RenderGraph::Resource RenderGraph::importBackbuffer(GLsizei width, GLsizei height)
+{
+	m_resources.push_back({ .name{ "backbuffer" }, .desc{ width, height, GL_NONE }, .imported{ true } });
+	return static_cast<Resource>(m_resources.size()) - 1;
+}
+
+RenderGraph::Resource RenderGraph::createTexture(const std::string& name, const TextureDesc& desc)
+{
+	m_resources.push_back({ .name{ name }, .desc{ desc } });
+	return static_cast<Resource>(m_resources.size()) - 1;
+}
+
+void RenderGraph::addPass(const std::string& name, const SetupFunction& setup, ExecuteFunction execute)
+{
+	m_passes.push_back({ .name{ name }, .execute{ std::move(execute) } });
+
+	Builder builder{ *this, static_cast<int>(m_passes.size()) - 1 };
+	setup(builder);
+}
+
+void RenderGraph::compile(GLState& state)
+{
+	std::vector<bool> alive(m_passes.size(), false);
+	cull(alive);
+	sort(alive);
+	allocate(state);
+
+	for (const int passIndex : m_order)
+	{
+		PassNode& pass{ m_passes[passIndex] };
+
+		std::vector<GLuint> textures{};
+		std::vector<GLenum> formats{};
+		for (const Resource resource : pass.writes)
+		{
+			const ResourceNode& node{ m_resources[resource] };
+			pass.width = node.desc.width;
+			pass.height = node.desc.height;
+
+			if (!node.imported)
+			{
+				textures.push_back(m_pool[node.physical].texture);
+				formats.push_back(node.desc.format);
+			}
+		}
+
+		pass.framebuffer = textures.empty() ? 0 : framebufferFor(textures, formats);
+		for (const Resource resource : pass.writes)
+		{
+			m_resources[resource].framebuffer = pass.framebuffer;
+		}
+	}
+}
+
+void RenderGraph::execute(GLState& state) const
+{
+	for (const int passIndex : m_order)
+	{
+		const PassNode& pass{ m_passes[passIndex] };
+
+		state.bindFramebuffer(pass.framebuffer);
+		state.viewport(0, 0, pass.width, pass.height);
+
+		pass.execute({
+			.graph{ this },
+			.framebuffer{ pass.framebuffer },
+			.width{ pass.width },
+			.height{ pass.height },
+			});
+	}
+}
+
+void RenderGraph::destroy(GLState& state)
+{
+	for (const auto& [textures, framebuffer] : m_framebuffers)
+	{
+		state.forgetFramebuffer(framebuffer);
+		glDeleteFramebuffers(1, &framebuffer);
+	}
+	m_framebuffers.clear();
+
+	for (const auto& physical : m_pool)
+	{
+		state.forgetTexture(physical.texture);
+		glDeleteTextures(1, &physical.texture);
+	}
+	m_pool.clear();
+
+	clear();
+}
+
+GLuint RenderGraph::texture(Resource resource) const
+{
+	const ResourceNode& node{ m_resources[resource] };
+	return node.physical == -1 ? 0 : m_pool[node.physical].texture;
+}
+
+GLuint RenderGraph::framebuffer(Resource resource) const
+{
+	return m_resources[resource].framebuffer;
+}
+
+std::size_t RenderGraph::transientTextureCount() const
+{
+	return std::count_if(m_resources.begin(), m_resources.end(),
+		[](const ResourceNode& node) { return !node.imported && node.physical != -1; });
+}
+
+std::size_t RenderGraph::physicalTextureBytes() const
+{
+	std::size_t bytes{ 0 };
+	for (const auto& physical : m_pool)
+	{
+		bytes += static_cast<std::size_t>(physical.desc.width) * physical.desc.height * std::max(1, physical.desc.samples) * bytesPerTexel(physical.desc.format);
+	}
+	return bytes;
+}
+
+bool RenderGraph::isDepthFormat(GLenum format)
+{
+	switch (format)
+	{
+	case GL_DEPTH_COMPONENT16:
+	case GL_DEPTH_COMPONENT24:
+	case GL_DEPTH_COMPONENT32:
+	case GL_DEPTH_COMPONENT32F:
+	case GL_DEPTH24_STENCIL8:
+	case GL_DEPTH32F_STENCIL8:
+		return true;
+	default:
+		return false;
+	}
+}
+
+std::size_t RenderGraph::bytesPerTexel(GLenum format)
+{
+	switch (format)
+	{
+	case GL_R8:
+		return 1;
+	case GL_DEPTH_COMPONENT16:
+	case GL_RG8:
+	case GL_R16F:
+		return 2;
+	case GL_RGBA16F:
+	case GL_DEPTH32F_STENCIL8:
+		return 8;
+	case GL_RGBA32F:
+		return 16;
+	default:
+		return 4;
+	}
+}
+
+void RenderGraph::cull(std::vector<bool>& alive) const
+{
+	for (std::size_t i{ 0 }; i < m_passes.size(); ++i)
+	{
+		for (const Resource resource : m_passes[i].writes)
+		{
+			if (m_resources[resource].imported)
+			{
+				alive[i] = true;
+			}
+		}
+	}
+
+	// Walk back from the passes that reach the screen to everything they depend on
+	bool changed{ true };
+	while (changed)
+	{
+		changed = false;
+
+		for (std::size_t reader{ 0 }; reader < m_passes.size(); ++reader)
+		{
+			if (!alive[reader])
+			{
+				continue;
+			}
+
+			for (const Resource resource : m_passes[reader].reads)
+			{
+				for (std::size_t writer{ 0 }; writer < m_passes.size(); ++writer)
+				{
+					if (alive[writer])
+					{
+						continue;
+					}
+
+					const auto& writes{ m_passes[writer].writes };
+					if (std::find(writes.begin(), writes.end(), resource) != writes.end())
+					{
+						alive[writer] = true;
+						changed = true;
+					}
+				}
+			}
+		}
+	}
+}
+
+void RenderGraph::sort(const std::vector<bool>& alive)
+{
+	const std::size_t count{ m_passes.size() };
+
+	auto touches{ [](const std::vector<Resource>& resources, Resource resource)
+		{
+			return std::find(resources.begin(), resources.end(), resource) != resources.end();
+		} };
+
+	// A read sees the writes declared before it, or, when there are none, the writes
+	// declared after it. Later writers also wait for readers of the earlier contents.
+	auto readsEarlierWrite{ [&](std::size_t reader, Resource resource)
+		{
+			for (std::size_t writer{ 0 }; writer < reader; ++writer)
+			{
+				if (alive[writer] && touches(m_passes[writer].writes, resource))
+				{
+					return true;
+				}
+			}
+			return false;
+		} };
+
+	std::vector<std::vector<int>> successors(count);
+	std::vector<int> predecessorCount(count, 0);
+	for (std::size_t a{ 0 }; a < count; ++a)
+	{
+		for (std::size_t b{ 0 }; b < count; ++b)
+		{
+			if (a == b || !alive[a] || !alive[b])
+			{
+				continue;
+			}
+
+			bool edge{ false };
+			for (const Resource resource : m_passes[a].writes)
+			{
+				if (touches(m_passes[b].reads, resource) && (a < b || !readsEarlierWrite(b, resource)))
+				{
+					edge = true;
+				}
+				else if (a < b && touches(m_passes[b].writes, resource))
+				{
+					edge = true;
+				}
+			}
+			for (const Resource resource : m_passes[a].reads)
+			{
+				if (a < b && touches(m_passes[b].writes, resource) && readsEarlierWrite(a, resource))
+				{
+					edge = true;
+				}
+			}
+
+			if (edge)
+			{
+				successors[a].push_back(static_cast<int>(b));
+				++predecessorCount[b];
+			}
+		}
+	}
+
+	m_order.clear();
+	std::vector<bool> emitted(count, false);
+	for (std::size_t step{ 0 }; step < count; ++step)
+	{
+		// Lowest declared index first keeps the order stable and predictable
+		int next{ -1 };
+		for (std::size_t i{ 0 }; i < count; ++i)
+		{
+			if (alive[i] && !emitted[i] && predecessorCount[i] == 0)
+			{
+				next = static_cast<int>(i);
+				break;
+			}
+		}
+
+		if (next == -1)
+		{
+			break;
+		}
+
+		emitted[next] = true;
+		m_order.push_back(next);
+		for (const int successor : successors[next])
+		{
+			--predecessorCount[successor];
+		}
+	}
+
+	if (m_order.size() != static_cast<std::size_t>(std::count(alive.begin(), alive.end(), true)))
+	{
+		std::cerr << "RENDER GRAPH, ERROR: Pass dependencies form a cycle, falling back to declaration order\n";
+
+		m_order.clear();
+		for (std::size_t i{ 0 }; i < count; ++i)
+		{
+			if (alive[i])
+			{
+				m_order.push_back(static_cast<int>(i));
+			}
+		}
+	}
+}
+
+void RenderGraph::allocate(GLState& state)
+{
+	constexpr int unused{ -1 };
+
+	std::vector<int> firstUse(m_resources.size(), unused);
+	std::vector<int> lastUse(m_resources.size(), unused);
+	for (std::size_t step{ 0 }; step < m_order.size(); ++step)
+	{
+		const PassNode& pass{ m_passes[m_order[step]] };
+		for (const auto* resources : { &pass.reads, &pass.writes })
+		{
+			for (const Resource resource : *resources)
+			{
+				if (firstUse[resource] == unused)
+				{
+					firstUse[resource] = static_cast<int>(step);
+				}
+				lastUse[resource] = static_cast<int>(step);
+			}
+		}
+	}
+
+	for (auto& physical : m_pool)
+	{
+		physical.used = false;
+	}
+	std::vector<int> busyUntil(m_pool.size(), unused);
+
+	for (std::size_t step{ 0 }; step < m_order.size(); ++step)
+	{
+		for (std::size_t resource{ 0 }; resource < m_resources.size(); ++resource)
+		{
+			ResourceNode& node{ m_resources[resource] };
+			if (node.imported || firstUse[resource] != static_cast<int>(step))
+			{
+				continue;
+			}
+
+			// Any pooled texture of the same shape whose last holder is done can be aliased
+			int physical{ unused };
+			for (std::size_t i{ 0 }; i < m_pool.size(); ++i)
+			{
+				if (m_pool[i].desc == node.desc && busyUntil[i] < static_cast<int>(step))
+				{
+					physical = static_cast<int>(i);
+					break;
+				}
+			}
+
+			if (physical == unused)
+			{
+				PhysicalTexture created{ .desc{ node.desc } };
+				if (node.desc.samples > 1)
+				{
+					glCreateTextures(GL_TEXTURE_2D_MULTISAMPLE, 1, &created.texture);
+					glTextureStorage2DMultisample(created.texture, node.desc.samples, node.desc.format, node.desc.width, node.desc.height, GL_TRUE);
+				}
+				else
+				{
+					glCreateTextures(GL_TEXTURE_2D, 1, &created.texture);
+					glTextureStorage2D(created.texture, 1, node.desc.format, node.desc.width, node.desc.height);
+					glTextureParameteri(created.texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+					glTextureParameteri(created.texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+					glTextureParameteri(created.texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+					glTextureParameteri(created.texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+				}
+
+				m_pool.push_back(created);
+				busyUntil.push_back(unused);
+				physical = static_cast<int>(m_pool.size()) - 1;
+			}
+
+			node.physical = physical;
+			m_pool[physical].used = true;
+			busyUntil[physical] = lastUse[resource];
+		}
+	}
+
+	// Storage nobody asked for this time is released rather than kept around
+	std::vector<int> remap(m_pool.size(), unused);
+	std::vector<PhysicalTexture> kept{};
+	for (std::size_t i{ 0 }; i < m_pool.size(); ++i)
+	{
+		if (m_pool[i].used)
+		{
+			remap[i] = static_cast<int>(kept.size());
+			kept.push_back(m_pool[i]);
+			continue;
+		}
+
+		for (auto it{ m_framebuffers.begin() }; it != m_framebuffers.end();)
+		{
+			if (std::find(it->first.begin(), it->first.end(), m_pool[i].texture) != it->first.end())
+			{
+				state.forgetFramebuffer(it->second);
+				glDeleteFramebuffers(1, &it->second);
+				it = m_framebuffers.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+
+		state.forgetTexture(m_pool[i].texture);
+		glDeleteTextures(1, &m_pool[i].texture);
+	}
+	m_pool = std::move(kept);
+
+	for (auto& node : m_resources)
+	{
+		if (node.physical != unused)
+		{
+			node.physical = remap[node.physical];
+		}
+	}
+}
+
+GLuint RenderGraph::framebufferFor(const std::vector<GLuint>& textures, const std::vector<GLenum>& formats)
+{
+	const auto it{ m_framebuffers.find(textures) };
+	if (it != m_framebuffers.end())
+	{
+		return it->second;
+	}
+
+	GLuint framebuffer{};
+	glCreateFramebuffers(1, &framebuffer);
+
+	std::vector<GLenum> drawBuffers{};
+	for (std::size_t i{ 0 }; i < textures.size(); ++i)
+	{
+		if (isDepthFormat(formats[i]))
+		{
+			const bool stencil{ formats[i] == GL_DEPTH24_STENCIL8 || formats[i] == GL_DEPTH32F_STENCIL8 };
+			glNamedFramebufferTexture(framebuffer, stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, textures[i], 0);
+		}
+		else
+		{
+			const GLenum attachment{ static_cast<GLenum>(GL_COLOR_ATTACHMENT0 + drawBuffers.size()) };
+			glNamedFramebufferTexture(framebuffer, attachment, textures[i], 0);
+			drawBuffers.push_back(attachment);
+		}
+	}
+
+	if (drawBuffers.empty())
+	{
+		glNamedFramebufferDrawBuffer(framebuffer, GL_NONE);
+		glNamedFramebufferReadBuffer(framebuffer, GL_NONE);
+	}
+	else
+	{
+		glNamedFramebufferDrawBuffers(framebuffer, static_cast<GLsizei>(drawBuffers.size()), drawBuffers.data());
+	}
+
+	if (glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cerr << "RENDER GRAPH, ERROR: Incomplete framebuffer for " << textures.size() << " attachments\n";
+	}
+
+	m_framebuffers.emplace(textures, framebuffer);
+	return framebuffer;
+}
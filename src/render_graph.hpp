@@ -0,0 +1,140 @@
+#pragma once
+
+#include "gl_state.hpp"
+
+#include "glad/glad.h"
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// Passes declare which resources they read and write. compile() drops passes whose
+// results nobody consumes, orders the rest by their dependencies and assigns transient
+// textures from a pool, letting resources whose lifetimes do not overlap share storage.
+class RenderGraph final
+{
+public:
+
+	using Resource = int;
+	static constexpr Resource none{ -1 };
+
+	struct TextureDesc
+	{
+		GLsizei width{};
+		GLsizei height{};
+		GLenum format{};
+		// More than one allocates a multisample texture, which can only be resolved by blitting
+		GLsizei samples{ 1 };
+
+		bool operator==(const TextureDesc&) const = default;
+	};
+
+	class Builder
+	{
+	public:
+
+		void read(Resource resource);
+		void write(Resource resource);
+
+	private:
+
+		friend class RenderGraph;
+
+		Builder(RenderGraph& graph, int pass) : m_graph{ graph }, m_pass{ pass } {}
+
+		RenderGraph& m_graph;
+		int m_pass{};
+	};
+
+	struct Context
+	{
+		const RenderGraph* graph{};
+		GLuint framebuffer{};
+		GLsizei width{};
+		GLsizei height{};
+
+		GLuint texture(Resource resource) const { return graph->texture(resource); }
+		// The framebuffer a resource was last written through, as a blit source
+		GLuint framebufferOf(Resource resource) const { return graph->framebuffer(resource); }
+	};
+
+	using SetupFunction = std::function<void(Builder& builder)>;
+	using ExecuteFunction = std::function<void(const Context& context)>;
+
+	RenderGraph() = default;
+	RenderGraph(const RenderGraph&) = delete;
+	RenderGraph& operator=(const RenderGraph&) = delete;
+
+	// Drops every declared pass and resource; pooled textures survive until the next compile
+	void clear();
+
+	// Imported resources are always considered consumed, so passes writing them are never culled
+	Resource importBackbuffer(GLsizei width, GLsizei height);
+	Resource createTexture(const std::string& name, const TextureDesc& desc);
+
+	void addPass(const std::string& name, const SetupFunction& setup, ExecuteFunction execute);
+
+	void compile(GLState& state);
+	void execute(GLState& state) const;
+
+	// Deletes pooled textures and framebuffers
+	void destroy(GLState& state);
+
+	GLuint texture(Resource resource) const;
+	GLuint framebuffer(Resource resource) const;
+
+	std::size_t passCount() const { return m_passes.size(); }
+	std::size_t culledPassCount() const { return m_passes.size() - m_order.size(); }
+	std::size_t transientTextureCount() const;
+	std::size_t physicalTextureCount() const { return m_pool.size(); }
+	// Estimated from the formats, multisampled textures taking one texel per sample
+	std::size_t physicalTextureBytes() const;
+
+private:
+
+	struct ResourceNode
+	{
+		std::string name{};
+		TextureDesc desc{};
+		bool imported{};
+
+		int physical{ -1 };
+		GLuint framebuffer{};
+	};
+
+	struct PassNode
+	{
+		std::string name{};
+		std::vector<Resource> reads{};
+		std::vector<Resource> writes{};
+		ExecuteFunction execute{};
+
+		GLuint framebuffer{};
+		GLsizei width{};
+		GLsizei height{};
+	};
+
+	struct PhysicalTexture
+	{
+		TextureDesc desc{};
+		GLuint texture{};
+		bool used{};
+	};
+
+	static bool isDepthFormat(GLenum format);
+	static std::size_t bytesPerTexel(GLenum format);
+
+	void cull(std::vector<bool>& alive) const;
+	void sort(const std::vector<bool>& alive);
+	void allocate(GLState& state);
+	GLuint framebufferFor(const std::vector<GLuint>& textures, const std::vector<GLenum>& formats);
+
+	std::vector<ResourceNode> m_resources{};
+	std::vector<PassNode> m_passes{};
+	std::vector<int> m_order{};
+
+	std::vector<PhysicalTexture> m_pool{};
+	std::map<std::vector<GLuint>, GLuint> m_framebuffers{};
+};
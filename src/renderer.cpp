@@ -1,6 +1,8 @@
 #include "renderer.hpp"
 
+#include "memory_report.hpp"
 #include "model_load.hpp"
+#include "texture_compression.hpp"
 
 #include "glad/glad.h"
 #include "GLFW/glfw3.h"
@@ -16,24 +18,54 @@
 #include "glm/gtc/matrix_transform.hpp"
 #include "glm/gtc/type_ptr.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
 #include <iostream>
+#include <memory_resource>
+#include <span>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
-void Renderer::init()
+// Part of GL_EXT_texture_compression_s3tc, which the glad loader was generated without
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
+bool Renderer::init()
+{
+	return init(InitSettings{});
+}
+
+bool Renderer::init(const InitSettings& settings)
 {
-	glfwInit();
-	initWindow();
+	if (!glfwInit() || !initWindow(settings))
+	{
+		std::cerr << "ENGINE, ERROR, HIGH, Cannot create a window with an OpenGL 4.6 context\n";
+		return false;
+	}
 	initOpenGL();
 
 	initPipelines();
 
 	initImgui();
+
+	return true;
+}
+
+void Renderer::pollEvents()
+{
+	glfwPollEvents();
+	readLatencyFences();
 }
 
 void Renderer::beginFrame()
 {
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	m_state.bindFramebuffer(0);
 	glClearColor(0.6f, 0.8f, 1.0f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -42,37 +74,95 @@ void Renderer::beginFrame()
 	ImGui::NewFrame();
 }
 
-void Renderer::render(const glm::mat4& transform, bool shadowpass, bool executeAABBPass)
+void Renderer::render(const glm::mat4& view, const glm::mat4& proj, bool shadowpass)
 {
-	if (shadowpass)
-	{
-		this->shadowpass(transform);
-	}
+	const Memory::TagScope tag{ Memory::Tag::renderer };
 
-	renderpass(transform);
-	
-	if (executeAABBPass)
+	m_view = view;
+	m_proj = proj;
+	m_viewProj = proj * view;
+
+	const auto submitStart{ std::chrono::steady_clock::now() };
+	m_frameStats.drawCalls = 0;
+
+	// The ticks before this frame consumed everything discarded so far
+	const double inputTime{ input.latch() };
+
+	readGpuTimer();
+
+	uploadTransforms();
+	uploadLights();
+	animator.evaluate(m_jobs);
+	uploadPalettes();
+	uploadParticles();
+	buildDrawLists(shadowpass);
+
+	if (!m_graphBuilt || m_graphShadowpass != shadowpass
+		|| m_graphSamples != m_samples || m_graphWidth != m_framebufferWidth || m_graphHeight != m_framebufferHeight)
 	{
-		aabbpass(transform);
+		buildRenderGraph(shadowpass);
 	}
 
-	ImGui::Render();
-	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+	m_frameStats.scale = m_renderScale;
+	m_frameStats.samples = m_samples;
+	m_frameStats.width = std::max(1, static_cast<GLsizei>(std::lround(static_cast<float>(m_framebufferWidth) * m_renderScale)));
+	m_frameStats.height = std::max(1, static_cast<GLsizei>(std::lround(static_cast<float>(m_framebufferHeight) * m_renderScale)));
+
+	// Growing or defragmenting a heap replaces its buffer
+	glVertexArrayVertexBuffer(m_vertexArray, 0, m_vertexHeap.buffer(), 0, sizeof(Vertex));
+	glVertexArrayVertexBuffer(m_skinnedVertexArray, 0, m_skinnedVertexHeap.buffer(), 0, sizeof(SkinnedVertex));
+
+	glBeginQuery(GL_TIME_ELAPSED, m_timerQueries[m_timerFrame % m_timerQueryCount]);
+	m_graph.execute(m_state);
+	glEndQuery(GL_TIME_ELAPSED);
+	++m_timerFrame;
+
+	debugDraw.endFrame();
+
+	reportGpuMemory();
+
+	m_lastFrameStateStats = m_state.stats();
+	m_state.resetStats();
+
+	m_frameStats.submitMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - submitStart).count();
 
-	glfwPollEvents();
 	glfwSwapBuffers(m_window);
+
+	if (inputTime >= 0.0 && m_latencyFences.size() < m_maxLatencyFences)
+	{
+		m_latencyFences.push_back({ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), inputTime });
+	}
 }
 
 void Renderer::cleanup()
 {
+	m_capture.destroy(m_state);
 	glDeleteVertexArrays(1, &m_vertexArray);
-	glDeleteBuffers(1, &m_vertexBuffer);
+	glDeleteVertexArrays(1, &m_skinnedVertexArray);
+	m_vertexHeap.destroy(m_state);
+	m_skinnedVertexHeap.destroy(m_state);
+	m_indexHeap.destroy(m_state);
+	glDeleteBuffers(1, &m_transformBuffer);
+	glDeleteBuffers(1, &m_normalBuffer);
+	glDeleteQueries(m_timerQueryCount, m_timerQueries);
+	for (const LatencyFence& fence : m_latencyFences)
+	{
+		glDeleteSync(fence.fence);
+	}
+	m_latencyFences.clear();
+	glDeleteBuffers(1, &m_lightBuffer);
+	glDeleteBuffers(1, &m_clusterBuffer);
+	glDeleteBuffers(1, &m_lightIndexBuffer);
+	glDeleteBuffers(1, &m_paletteBuffer);
+	glDeleteVertexArrays(1, &m_particleVertexArray);
+	glDeleteBuffers(1, &m_particleBuffer);
+	glDeleteVertexArrays(1, &m_debugVertexArray);
+	glDeleteBuffers(1, &m_debugBuffer);
+	m_graph.destroy(m_state);
 	for (const auto& mesh : m_meshes)
 	{
 		for (const auto& primitive : mesh.primitives)
 		{
-			glDeleteBuffers(1, &primitive.indexBuffer);
-			
 			if (primitive.material.hasTexture)
 			{
 				glDeleteTextures(1, &primitive.material.texture);
@@ -86,57 +176,169 @@ void Renderer::cleanup()
 	glfwTerminate();
 }
 
-void Renderer::loadModel(const std::string& path)
+Renderer::MeshHandle Renderer::loadModel(const std::string& path)
+{
+	return addModel(ModelLoader::loadGLB(path));
+}
+
+Renderer::MeshHandle Renderer::addModel(const ModelLoader::Mesh& loaderMesh)
 {
-	ModelLoader::Mesh modelLoaderMesh{ ModelLoader::loadGLB(path, m_vertices) };
+	const Memory::TagScope tag{ Memory::Tag::renderer };
 
-	Mesh mesh{};
+	const bool skinned{ loaderMesh.rig && loaderMesh.skinWeights.size() == loaderMesh.vertices.size() };
 
-	for (const auto& loaderPrimitive : modelLoaderMesh.primitives)
+	Mesh mesh{ .name{ std::string{ loaderMesh.name } } };
+	mesh.vertexCount = static_cast<std::uint32_t>(loaderMesh.vertices.size());
+	if (skinned)
+	{
+		// Interleaved here, so rigid models keep their smaller vertices
+		std::vector<SkinnedVertex> vertices(mesh.vertexCount);
+		for (std::size_t i{ 0 }; i < vertices.size(); ++i)
+		{
+			const Vertex& vertex{ loaderMesh.vertices[i] };
+			vertices[i] = { vertex.position, vertex.normal, vertex.texCoord, loaderMesh.skinWeights[i].joints, loaderMesh.skinWeights[i].weights };
+		}
+		mesh.vertices = m_skinnedVertexHeap.allocate(m_state, mesh.vertexCount, vertices.data());
+		mesh.rig = loaderMesh.rig;
+	}
+	else
 	{
-		GLuint indexBuffer{};
-		glGenBuffers(1, &indexBuffer);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(std::uint32_t) * loaderPrimitive.indices.size(), 
-			loaderPrimitive.indices.data(), GL_STATIC_DRAW);
+		mesh.vertices = m_vertexHeap.allocate(m_state, mesh.vertexCount, loaderMesh.vertices.data());
+	}
+
+	for (const auto& loaderPrimitive : loaderMesh.primitives)
+	{
+		glm::vec3 boundsMin{ INFINITY };
+		glm::vec3 boundsMax{ -INFINITY };
+		for (const std::uint32_t index : loaderPrimitive.indices)
+		{
+			boundsMin = glm::min(boundsMin, loaderMesh.vertices[index].position);
+			boundsMax = glm::max(boundsMax, loaderMesh.vertices[index].position);
+		}
 
 		mesh.primitives.push_back({
-			.indexBuffer{ indexBuffer },
+			.indices{ m_indexHeap.allocate(m_state, static_cast<std::uint32_t>(loaderPrimitive.indices.size()), loaderPrimitive.indices.data()) },
 			.indexCount{ static_cast<GLsizei>(loaderPrimitive.indices.size()) },
 			.transform{ loaderPrimitive.transform },
-			.material
-			{
-				.texture{ loaderPrimitive.material.texture },
-				.hasTexture{ loaderPrimitive.material.hasTexture },
-				.color{ loaderPrimitive.material.color },
-			},
+			.boundsMin{ boundsMin },
+			.boundsMax{ boundsMax },
+			.material{ createMaterial(loaderPrimitive.material) },
 			});
 	}
 
-	m_meshes.push_back(mesh);
+	Memory::addGpuBytes(mesh.name, Memory::GpuKind::vertices, (skinned ? sizeof(SkinnedVertex) : sizeof(Vertex)) * mesh.vertexCount);
+	for (const Primitive& primitive : mesh.primitives)
+	{
+		Memory::addGpuBytes(mesh.name, Memory::GpuKind::indices, sizeof(std::uint32_t) * primitive.indexCount);
+		Memory::addGpuBytes(mesh.name, Memory::GpuKind::textures, primitive.material.textureBytes);
+	}
+
+	return m_meshes.insert(std::move(mesh));
 }
 
-void Renderer::finalizeModels()
+void Renderer::unloadModel(MeshHandle meshHandle)
 {
-	glGenBuffers(1, &m_vertexBuffer);
-	glGenVertexArrays(1, &m_vertexArray);
+	const Mesh* mesh{ m_meshes.get(meshHandle) };
+	if (!mesh)
+	{
+		std::cerr << "ENGINE, ERROR, MEDIUM, Unloading a stale mesh handle\n";
+		return;
+	}
+
+	for (const auto& primitive : mesh->primitives)
+	{
+		m_indexHeap.free(primitive.indices);
+		Memory::removeGpuBytes(mesh->name, Memory::GpuKind::indices, sizeof(std::uint32_t) * primitive.indexCount);
+		Memory::removeGpuBytes(mesh->name, Memory::GpuKind::textures, primitive.material.textureBytes);
+
+		if (primitive.material.hasTexture)
+		{
+			m_state.forgetTexture(primitive.material.texture);
+			glDeleteTextures(1, &primitive.material.texture);
+
+			--m_textureStats.textures;
+			m_textureStats.bytes -= primitive.material.textureBytes;
+			m_textureStats.uncompressedBytes -= primitive.material.uncompressedBytes;
+		}
+	}
+	(mesh->rig ? m_skinnedVertexHeap : m_vertexHeap).free(mesh->vertices);
+	Memory::removeGpuBytes(mesh->name, Memory::GpuKind::vertices, (mesh->rig ? sizeof(SkinnedVertex) : sizeof(Vertex)) * mesh->vertexCount);
+
+	m_meshes.erase(meshHandle);
 
-	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
-	glBindVertexArray(m_vertexArray);
+	// Streaming leaves holes behind; packing is one GPU side copy of the live data
+	for (GpuHeap* heap : { &m_vertexHeap, &m_skinnedVertexHeap, &m_indexHeap })
+	{
+		if (heap->fragmentation() > m_defragmentThreshold)
+		{
+			heap->defragment(m_state);
+		}
+	}
+}
 
-	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * m_vertices.size(), m_vertices.data(), GL_STATIC_DRAW);
+Renderer::MeshInstanceHandle Renderer::addMeshInstance(MeshHandle mesh, const glm::mat4& transform, SceneGraph::Node parent)
+{
+	const Mesh* loadedMesh{ m_meshes.get(mesh) };
+	if (!loadedMesh)
+	{
+		std::cerr << "ENGINE, ERROR, MEDIUM, Instancing a stale mesh handle\n";
+		return {};
+	}
+
+	MeshInstance meshInstance
+	{
+		.mesh{ mesh },
+		.node{ scene.create(transform, parent) },
+	};
 
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), nullptr);
-	glEnableVertexAttribArray(0);
+	for (const auto& primitive : loadedMesh->primitives)
+	{
+		meshInstance.primitiveNodes.push_back(scene.create(primitive.transform, meshInstance.node));
+	}
+	if (loadedMesh->rig)
+	{
+		meshInstance.character = animator.add(loadedMesh->rig);
+	}
 
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_TRUE, sizeof(Vertex), reinterpret_cast<void*>(sizeof(glm::vec3)));
-	glEnableVertexAttribArray(1);
+	return meshInstances.insert(std::move(meshInstance));
+}
 
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(sizeof(glm::vec3) + sizeof(glm::vec3)));
-	glEnableVertexAttribArray(2);
+void Renderer::removeMeshInstance(MeshInstanceHandle meshInstance)
+{
+	const MeshInstance* instance{ meshInstances.get(meshInstance) };
+	if (!instance)
+	{
+		std::cerr << "ENGINE, ERROR, MEDIUM, Removing a stale mesh instance handle\n";
+		return;
+	}
 
-	m_vertices.clear();
-	m_vertices.shrink_to_fit();
+	scene.destroy(instance->node);
+	animator.remove(instance->character);
+	meshInstances.erase(meshInstance);
+}
+
+void Renderer::setTransform(MeshInstanceHandle meshInstance, const glm::mat4& transform)
+{
+	if (const MeshInstance* instance{ meshInstances.get(meshInstance) })
+	{
+		scene.setLocal(instance->node, transform);
+	}
+}
+
+void Renderer::setOccluder(MeshInstanceHandle meshInstance, bool occluder)
+{
+	if (MeshInstance* instance{ meshInstances.get(meshInstance) })
+	{
+		instance->occluder = occluder;
+	}
+}
+
+void Renderer::setVisible(MeshInstanceHandle meshInstance, bool show)
+{
+	if (MeshInstance* instance{ meshInstances.get(meshInstance) })
+	{
+		instance->show = show;
+	}
 }
 
 bool Renderer::windowShouldClose()
@@ -144,17 +346,34 @@ bool Renderer::windowShouldClose()
 	return glfwWindowShouldClose(m_window);
 }
 
-void Renderer::initWindow()
+bool Renderer::initWindow(const InitSettings& settings)
 {
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-	glfwWindowHint(GLFW_SAMPLES, 8);
+	// Multisampling happens in the offscreen scene target; a multisampled window could not
+	// be the destination of the scaled blit
+	glfwWindowHint(GLFW_SAMPLES, 0);
+
+	glfwWindowHint(GLFW_VISIBLE, settings.visible ? GLFW_TRUE : GLFW_FALSE);
+	if (settings.egl)
+	{
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+	}
 
 	m_window = glfwCreateWindow(m_initialWindowWidth, m_initialWindowHeight, "Platformer", nullptr, nullptr);
+	if (!m_window)
+	{
+		return false;
+	}
 
 	glfwMakeContextCurrent(m_window);
+	if (!settings.vsync)
+	{
+		glfwSwapInterval(0);
+	}
+	return true;
 }
 
 void Renderer::initOpenGL()
@@ -210,42 +429,98 @@ void Renderer::initOpenGL()
 		},
 		nullptr);
 
-	glViewport(0, 0, m_initialWindowWidth, m_initialWindowHeight);
+	m_state.viewport(0, 0, m_initialWindowWidth, m_initialWindowHeight);
+	glfwSetWindowUserPointer(m_window, this);
 	glfwSetFramebufferSizeCallback(m_window, 
 		[](GLFWwindow* window, int width, int height) {
-			glViewport(0, 0, width, height);
+			if (width > 0 && height > 0)
+			{
+				Renderer* renderer{ static_cast<Renderer*>(glfwGetWindowUserPointer(window)) };
+				renderer->m_framebufferWidth = width;
+				renderer->m_framebufferHeight = height;
+			}
+		});
+	// Installed before ImGui's, which chains to it
+	glfwSetKeyCallback(m_window,
+		[](GLFWwindow* window, int key, int, int action, int) {
+			if (action != GLFW_REPEAT)
+			{
+				Renderer* renderer{ static_cast<Renderer*>(glfwGetWindowUserPointer(window)) };
+				renderer->input.record(key, action == GLFW_PRESS, glfwGetTime());
+			}
 		});
 
-	glEnable(GL_DEPTH_TEST);
-
-	glEnable(GL_MULTISAMPLE);
-
-	glGenFramebuffers(1, &m_shadowFBO);
+	glCreateQueries(GL_TIME_ELAPSED, m_timerQueryCount, m_timerQueries);
 
-	glGenTextures(1, &m_shadowMap);
-	glBindTexture(GL_TEXTURE_2D, m_shadowMap);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, 1024, 1024, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	GLint extensionCount{};
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+	for (GLint i{ 0 }; i < extensionCount; ++i)
+	{
+		const std::string_view extension{ reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)) };
+		m_textureStats.s3tc = m_textureStats.s3tc || extension == "GL_EXT_texture_compression_s3tc";
+	}
+	if (!m_textureStats.s3tc)
+	{
+		std::cerr << "ENGINE, ERROR, LOW, S3TC unsupported, BC1 textures are uploaded uncompressed\n";
+	}
 
-	glBindFramebuffer(GL_FRAMEBUFFER, m_shadowFBO);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_shadowMap, 0);
-	glDrawBuffer(GL_NONE);
-	glReadBuffer(GL_NONE);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	m_vertexArray = createVertexArray(0);
+	m_skinnedVertexArray = createSkinnedVertexArray();
+
+	// Respecified every frame by uploadLights; the bindings stay with the names
+	glCreateBuffers(1, &m_lightBuffer);
+	glCreateBuffers(1, &m_clusterBuffer);
+	glCreateBuffers(1, &m_lightIndexBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_lightBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_clusterBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_lightIndexBuffer);
+
+	glCreateBuffers(1, &m_paletteBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, m_paletteBuffer);
+
+	// One instance per particle, each drawn as a four vertex strip
+	glCreateBuffers(1, &m_particleBuffer);
+	glCreateVertexArrays(1, &m_particleVertexArray);
+	glVertexArrayVertexBuffer(m_particleVertexArray, 0, m_particleBuffer, 0, sizeof(ParticleSystem::Instance));
+	glVertexArrayBindingDivisor(m_particleVertexArray, 0, 1);
+	glVertexArrayAttribFormat(m_particleVertexArray, 0, 3, GL_FLOAT, GL_FALSE, offsetof(ParticleSystem::Instance, position));
+	glVertexArrayAttribBinding(m_particleVertexArray, 0, 0);
+	glEnableVertexArrayAttrib(m_particleVertexArray, 0);
+	glVertexArrayAttribIFormat(m_particleVertexArray, 1, 1, GL_UNSIGNED_INT, offsetof(ParticleSystem::Instance, lifeAndSeed));
+	glVertexArrayAttribBinding(m_particleVertexArray, 1, 0);
+	glEnableVertexArrayAttrib(m_particleVertexArray, 1);
+
+	// Debug lines carry their own colour and are already in world space
+	glCreateBuffers(1, &m_debugBuffer);
+	glCreateVertexArrays(1, &m_debugVertexArray);
+	glVertexArrayAttribFormat(m_debugVertexArray, 0, 3, GL_FLOAT, GL_FALSE, offsetof(DebugDraw::Vertex, position));
+	glVertexArrayAttribBinding(m_debugVertexArray, 0, 0);
+	glEnableVertexArrayAttrib(m_debugVertexArray, 0);
+	glVertexArrayAttribFormat(m_debugVertexArray, 1, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(DebugDraw::Vertex, color));
+	glVertexArrayAttribBinding(m_debugVertexArray, 1, 0);
+	glEnableVertexArrayAttrib(m_debugVertexArray, 1);
+
+	m_state.enable(GL_DEPTH_TEST);
+
+	m_state.enable(GL_MULTISAMPLE);
 }
 
 void Renderer::initPipelines()
 {
 	m_uberPipeline = { "shaders/uber.vert", "shaders/uber.frag" };
+	m_skinnedPipeline = { "shaders/uber_skinned.vert", "shaders/uber.frag" };
+
+	m_particlePipeline = { "shaders/particle.vert", "shaders/particle.frag" };
 
-	m_aabbPipeline = { "shaders/aabb.vert", "shaders/aabb.frag" };
+	m_debugPipeline = { "shaders/debug.vert", "shaders/debug.frag" };
 }
 
 void Renderer::initImgui()
 {
+	// Through operator new, so ImGui shows up under its own tag in the memory report
+	ImGui::SetAllocatorFunctions(
+		[](std::size_t size, void*) -> void* { const Memory::TagScope tag{ Memory::Tag::gui }; return ::operator new(size); },
+		[](void* pointer, void*) { ::operator delete(pointer); });
 	ImGui::CreateContext();
 	
 	ImGui_ImplGlfw_InitForOpenGL(m_window, true);
@@ -256,101 +531,663 @@ void Renderer::initImgui()
 	ImGui::StyleColorsLight();
 }
 
-void Renderer::renderpass(const glm::mat4& transform)
+GLuint Renderer::createVertexArray(GLuint vertexBuffer)
 {
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLuint vertexArray{};
+	glCreateVertexArrays(1, &vertexArray);
+	glVertexArrayVertexBuffer(vertexArray, 0, vertexBuffer, 0, sizeof(Vertex));
 
-	glViewport(0, 0, m_initialWindowWidth, m_initialWindowHeight);
+	glVertexArrayAttribFormat(vertexArray, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, position));
+	glVertexArrayAttribBinding(vertexArray, 0, 0);
+	glEnableVertexArrayAttrib(vertexArray, 0);
 
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
-	m_uberPipeline.bind();
+	glVertexArrayAttribFormat(vertexArray, 1, 3, GL_FLOAT, GL_TRUE, offsetof(Vertex, normal));
+	glVertexArrayAttribBinding(vertexArray, 1, 0);
+	glEnableVertexArrayAttrib(vertexArray, 1);
 
-	glBindVertexArray(m_vertexArray);
+	glVertexArrayAttribFormat(vertexArray, 2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, texCoord));
+	glVertexArrayAttribBinding(vertexArray, 2, 0);
+	glEnableVertexArrayAttrib(vertexArray, 2);
 
-	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	return vertexArray;
+}
 
-	for (const auto& meshInstance : meshInstances)
+GLuint Renderer::createSkinnedVertexArray()
+{
+	GLuint vertexArray{};
+	glCreateVertexArrays(1, &vertexArray);
+
+	glVertexArrayAttribFormat(vertexArray, 0, 3, GL_FLOAT, GL_FALSE, offsetof(SkinnedVertex, position));
+	glVertexArrayAttribBinding(vertexArray, 0, 0);
+	glEnableVertexArrayAttrib(vertexArray, 0);
+
+	glVertexArrayAttribFormat(vertexArray, 1, 3, GL_FLOAT, GL_TRUE, offsetof(SkinnedVertex, normal));
+	glVertexArrayAttribBinding(vertexArray, 1, 0);
+	glEnableVertexArrayAttrib(vertexArray, 1);
+
+	glVertexArrayAttribFormat(vertexArray, 2, 2, GL_FLOAT, GL_FALSE, offsetof(SkinnedVertex, texCoord));
+	glVertexArrayAttribBinding(vertexArray, 2, 0);
+	glEnableVertexArrayAttrib(vertexArray, 2);
+
+	// Joint indices stay integers; weights arrive in the shader as 0 to 1
+	glVertexArrayAttribIFormat(vertexArray, 3, 4, GL_UNSIGNED_BYTE, offsetof(SkinnedVertex, joints));
+	glVertexArrayAttribBinding(vertexArray, 3, 0);
+	glEnableVertexArrayAttrib(vertexArray, 3);
+
+	glVertexArrayAttribFormat(vertexArray, 4, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(SkinnedVertex, weights));
+	glVertexArrayAttribBinding(vertexArray, 4, 0);
+	glEnableVertexArrayAttrib(vertexArray, 4);
+
+	return vertexArray;
+}
+
+Renderer::Material Renderer::createMaterial(const ModelLoader::Material& loaderMaterial)
+{
+	Material material
+	{
+		.hasTexture{ loaderMaterial.hasTexture },
+		.color{ loaderMaterial.color },
+	};
+
+	if (loaderMaterial.hasTexture)
 	{
-		if (meshInstance.pass == UBER)
+		const auto start{ std::chrono::steady_clock::now() };
+
+		const TextureCompression::Image* image{ &loaderMaterial.texture };
+		TextureCompression::Image expanded{};
+		if (image->format == TextureCompression::Format::BC1 && !m_textureStats.s3tc)
 		{
-			if (meshInstance.show)
-			{
-				for (const auto& primitive : m_meshes[meshInstance.mesh].primitives)
-				{
-					glUniform1i(glGetUniformLocation(m_uberPipeline.shaderProgram(), "textured"), primitive.material.hasTexture);
-					glUniformMatrix4fv(glGetUniformLocation(m_uberPipeline.shaderProgram(), "transform"), 1, GL_FALSE, glm::value_ptr(glm::mat4{ transform* (meshInstance.transform* primitive.transform) }));
-					glUniform3fv(glGetUniformLocation(m_uberPipeline.shaderProgram(), "color"), 1, glm::value_ptr(primitive.material.color));
+			expanded = TextureCompression::decompress(*image);
+			image = &expanded;
+		}
 
-					glActiveTexture(GL_TEXTURE0);
-					glBindTexture(GL_TEXTURE_2D, primitive.material.texture);
+		const GLenum internalFormat{ [image]() -> GLenum {
+			switch (image->format)
+			{
+			case TextureCompression::Format::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+			case TextureCompression::Format::BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+			default: return GL_RGBA8;
+			}
+		}() };
 
-					glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, primitive.indexBuffer);
+		glCreateTextures(GL_TEXTURE_2D, 1, &material.texture);
+		glTextureParameteri(material.texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTextureParameteri(material.texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTextureParameteri(material.texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTextureParameteri(material.texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureStorage2D(material.texture, static_cast<GLsizei>(image->levels.size()), internalFormat, image->width, image->height);
 
-					glDrawElements(GL_TRIANGLES, primitive.indexCount, GL_UNSIGNED_INT, nullptr);
-				}
+		// Every level was built offline, so nothing is generated here
+		for (std::size_t i{ 0 }; i < image->levels.size(); ++i)
+		{
+			const TextureCompression::Level& level{ image->levels[i] };
+			const unsigned char* data{ image->data.data() + level.offset };
+			if (image->format == TextureCompression::Format::RGBA8)
+			{
+				glTextureSubImage2D(material.texture, static_cast<GLint>(i), 0, 0, level.width, level.height, GL_RGBA, GL_UNSIGNED_BYTE, data);
+			}
+			else
+			{
+				glCompressedTextureSubImage2D(material.texture, static_cast<GLint>(i), 0, 0, level.width, level.height,
+					internalFormat, static_cast<GLsizei>(level.size), data);
 			}
 		}
+
+		material.textureBytes = image->data.size();
+		material.uncompressedBytes = TextureCompression::uncompressedSize(*image);
+
+		++m_textureStats.textures;
+		m_textureStats.bytes += material.textureBytes;
+		m_textureStats.uncompressedBytes += material.uncompressedBytes;
+		m_textureStats.uploadMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 	}
+
+	return material;
 }
 
-void Renderer::shadowpass(const glm::mat4& transform)
+void Renderer::readGpuTimer()
 {
-	glViewport(0, 0, 1024, 1024);
-	glBindFramebuffer(GL_FRAMEBUFFER, m_shadowFBO);
-	glClear(GL_DEPTH_BUFFER_BIT);
+	// The slot about to be reused holds the query issued m_timerQueryCount frames ago
+	if (m_timerFrame < m_timerQueryCount)
+	{
+		return;
+	}
 
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
-	m_uberPipeline.bind();
+	const GLuint query{ m_timerQueries[m_timerFrame % m_timerQueryCount] };
 
-	glBindVertexArray(m_vertexArray);
+	// Never wait on the GPU; a missed sample only delays the next adjustment
+	GLint available{};
+	glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+	{
+		return;
+	}
 
-	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	GLuint64 elapsed{};
+	glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+	m_frameStats.lastGpuMs = static_cast<float>(elapsed) / 1'000'000.0f;
+	++m_frameStats.gpuSamples;
+	adjustResolution(m_frameStats.lastGpuMs);
+}
 
-	for (const auto& meshInstance : meshInstances)
+void Renderer::readLatencyFences()
+{
+	// Fences signal in order, so the first unsignalled one ends the scan
+	std::size_t signalled{ 0 };
+	for (const LatencyFence& fence : m_latencyFences)
 	{
-		if (meshInstance.pass == UBER)
+		GLint status{};
+		glGetSynciv(fence.fence, GL_SYNC_STATUS, 1, nullptr, &status);
+		if (status != GL_SIGNALED)
 		{
-			if (meshInstance.show)
-			{
-				for (const auto& primitive : m_meshes[meshInstance.mesh].primitives)
-				{
-					glUniform1i(glGetUniformLocation(m_uberPipeline.shaderProgram(), "textured"), primitive.material.hasTexture);
-					glUniformMatrix4fv(glGetUniformLocation(m_uberPipeline.shaderProgram(), "transform"), 1, GL_FALSE, glm::value_ptr(glm::mat4{ transform* (meshInstance.transform* primitive.transform) }));
-					glUniform3fv(glGetUniformLocation(m_uberPipeline.shaderProgram(), "color"), 1, glm::value_ptr(primitive.material.color));
+			break;
+		}
 
-					glActiveTexture(GL_TEXTURE0);
-					glBindTexture(GL_TEXTURE_2D, primitive.material.texture);
+		const float latencyMs{ static_cast<float>((glfwGetTime() - fence.inputTime) * 1000.0) };
+		m_latencyStats.lastMs = latencyMs;
+		m_latencyStats.inputToPhotonMs = m_latencyStats.samples == 0 ? latencyMs : m_latencyStats.inputToPhotonMs * 0.9f + latencyMs * 0.1f;
+		++m_latencyStats.samples;
 
-					glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, primitive.indexBuffer);
+		glDeleteSync(fence.fence);
+		++signalled;
+	}
+	m_latencyFences.erase(m_latencyFences.begin(), m_latencyFences.begin() + signalled);
+}
 
-					glDrawElements(GL_TRIANGLES, primitive.indexCount, GL_UNSIGNED_INT, nullptr);
-				}
-			}
+void Renderer::adjustResolution(float gpuMs)
+{
+	m_frameStats.gpuMs = m_frameStats.gpuMs == 0.0f ? gpuMs : m_frameStats.gpuMs * 0.9f + gpuMs * 0.1f;
+
+	if (!resolution.dynamic)
+	{
+		m_renderScale = 1.0f;
+		m_samples = std::max(1, resolution.maxSamples);
+		return;
+	}
+
+	const float target{ resolution.targetGpuMs };
+	const float smoothed{ m_frameStats.gpuMs };
+
+	// Cost follows the pixel count, so the scale moves with the square root of the ratio.
+	// A small dead band and partial steps keep it from hunting around the target.
+	const float wanted{ std::clamp(m_renderScale * std::sqrt(target / smoothed), resolution.minScale, 1.0f) };
+	if (std::abs(wanted - m_renderScale) > 0.02f)
+	{
+		m_renderScale += (wanted - m_renderScale) * 0.25f;
+	}
+
+	// Samples give way only once the scale is exhausted, and come back only at full scale
+	if (m_samplesCooldown > 0)
+	{
+		--m_samplesCooldown;
+	}
+	else if (smoothed > target && m_renderScale <= resolution.minScale + 0.01f && m_samples > 1)
+	{
+		m_samples /= 2;
+	}
+	else if (smoothed < target * 0.6f && m_renderScale >= 0.99f && m_samples * 2 <= resolution.maxSamples)
+	{
+		m_samples *= 2;
+	}
+	else
+	{
+		return;
+	}
+
+	if (m_samples != m_graphSamples)
+	{
+		m_samplesCooldown = m_sampleCooldown;
+		// Timings taken with the old sample count no longer say anything
+		m_frameStats.gpuMs = 0.0f;
+	}
+}
+
+void Renderer::uploadTransforms()
+{
+	scene.update();
+
+	if (scene.capacity() > m_transformBufferCapacity)
+	{
+		glDeleteBuffers(1, &m_transformBuffer);
+		glDeleteBuffers(1, &m_normalBuffer);
+
+		m_transformBufferCapacity = std::max<std::size_t>(scene.capacity() * 2, 256);
+		glCreateBuffers(1, &m_transformBuffer);
+		glNamedBufferData(m_transformBuffer, sizeof(glm::mat4) * m_transformBufferCapacity, nullptr, GL_DYNAMIC_DRAW);
+		glNamedBufferSubData(m_transformBuffer, 0, sizeof(glm::mat4) * scene.capacity(), scene.worlds().data());
+		glCreateBuffers(1, &m_normalBuffer);
+		glNamedBufferData(m_normalBuffer, sizeof(glm::mat3x4) * m_transformBufferCapacity, nullptr, GL_DYNAMIC_DRAW);
+		glNamedBufferSubData(m_normalBuffer, 0, sizeof(glm::mat3x4) * scene.capacity(), scene.normals().data());
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_transformBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, m_normalBuffer);
+	}
+	else if (scene.hasChanges())
+	{
+		// Static nodes between moving ones stay put, so only runs of changed matrices go up
+		scene.changedRanges(m_transformRanges, 8);
+		for (const SceneGraph::Range& range : m_transformRanges)
+		{
+			glNamedBufferSubData(m_transformBuffer, sizeof(glm::mat4) * range.begin,
+				sizeof(glm::mat4) * (range.end - range.begin), scene.worlds().data() + range.begin);
+			glNamedBufferSubData(m_normalBuffer, sizeof(glm::mat3x4) * range.begin,
+				sizeof(glm::mat3x4) * (range.end - range.begin), scene.normals().data() + range.begin);
 		}
 	}
+
+	scene.clearChanged();
+}
+
+void Renderer::uploadLights()
+{
+	const std::pmr::vector<PointLight> lightData{ lights.begin(), lights.end(), &Memory::frameArena() };
+	m_lightClusters.build(lightData, m_view, m_proj);
+
+	// Orphaning last frame's storage avoids waiting for the GPU to finish reading it. Empty
+	// lists still get one element so the bindings never refer to a buffer without storage.
+	m_lightBufferBytes = 0;
+	const auto upload{ [this](GLuint buffer, std::size_t size, const void* data)
+		{
+			m_lightBufferBytes += std::max<std::size_t>(size, 16);
+			glNamedBufferData(buffer, static_cast<GLsizeiptr>(std::max<std::size_t>(size, 16)), size ? data : nullptr, GL_STREAM_DRAW);
+		} };
+	upload(m_lightBuffer, sizeof(PointLight) * lightData.size(), lightData.data());
+	upload(m_clusterBuffer, sizeof(glm::uvec2) * m_lightClusters.clusters().size(), m_lightClusters.clusters().data());
+	upload(m_lightIndexBuffer, sizeof(std::uint32_t) * m_lightClusters.indices().size(), m_lightClusters.indices().data());
+}
+
+void Renderer::uploadPalettes()
+{
+	// Orphaned like the lights; never empty, so binding 4 always has storage
+	const std::span<const glm::mat4> palette{ animator.palette() };
+	m_paletteBufferBytes = std::max<std::size_t>(palette.size_bytes(), sizeof(glm::mat4));
+	glNamedBufferData(m_paletteBuffer, static_cast<GLsizeiptr>(m_paletteBufferBytes), palette.empty() ? nullptr : palette.data(), GL_STREAM_DRAW);
 }
 
-void Renderer::aabbpass(const glm::mat4& transform)
+void Renderer::uploadParticles()
 {
-	glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-	glDisable(GL_DEPTH_TEST);
-	glDisable(GL_CULL_FACE);
-	m_aabbPipeline.bind();
+	m_particleCount = particles.liveCount();
+	if (m_particleCount == 0)
+	{
+		return;
+	}
+
+	// Grows only; the name stays, so the vertex array binding does too
+	if (m_particleCount > m_particleBufferCapacity)
+	{
+		m_particleBufferCapacity = std::max<std::size_t>(m_particleCount + m_particleCount / 2, 4096);
+		glNamedBufferData(m_particleBuffer, static_cast<GLsizeiptr>(sizeof(ParticleSystem::Instance) * m_particleBufferCapacity), nullptr, GL_STREAM_DRAW);
+	}
 
+	// Invalidating the range orphans last frame's instances, and the workers write straight
+	// into the mapping, so there is no staging copy
+	void* mapped{ glMapNamedBufferRange(m_particleBuffer, 0, static_cast<GLsizeiptr>(sizeof(ParticleSystem::Instance) * m_particleCount),
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT) };
+	if (!mapped)
+	{
+		m_particleCount = 0;
+		return;
+	}
+	particles.writeInstances({ static_cast<ParticleSystem::Instance*>(mapped), m_particleCount }, m_jobs);
+	glUnmapNamedBuffer(m_particleBuffer);
+}
+
+void Renderer::reportGpuMemory()
+{
+	// Only changes reach the ledger, so a steady frame costs a few comparisons
+	const auto report{ [](std::string_view asset, Memory::GpuKind kind, std::size_t& reported, std::size_t bytes)
+		{
+			if (bytes != reported)
+			{
+				Memory::removeGpuBytes(asset, kind, reported);
+				Memory::addGpuBytes(asset, kind, bytes);
+				reported = bytes;
+			}
+		} };
+
+	const GpuHeap::Stats vertexHeap{ m_vertexHeap.stats() };
+	const GpuHeap::Stats skinnedVertexHeap{ m_skinnedVertexHeap.stats() };
+	const GpuHeap::Stats indexHeap{ m_indexHeap.stats() };
+	report("geometry heap free space", Memory::GpuKind::vertices, m_reportedBytes.vertexSlack, sizeof(Vertex) * (vertexHeap.capacity - vertexHeap.used));
+	report("skinned geometry heap free space", Memory::GpuKind::vertices, m_reportedBytes.skinnedVertexSlack,
+		sizeof(SkinnedVertex) * (skinnedVertexHeap.capacity - skinnedVertexHeap.used));
+	report("geometry heap free space", Memory::GpuKind::indices, m_reportedBytes.indexSlack, sizeof(std::uint32_t) * (indexHeap.capacity - indexHeap.used));
+	report("scene transforms", Memory::GpuKind::buffers, m_reportedBytes.transforms, (sizeof(glm::mat4) + sizeof(glm::mat3x4)) * m_transformBufferCapacity);
+	report("point lights", Memory::GpuKind::buffers, m_reportedBytes.lights, m_lightBufferBytes);
+	report("joint palettes", Memory::GpuKind::buffers, m_reportedBytes.palettes, m_paletteBufferBytes);
+	report("particles", Memory::GpuKind::buffers, m_reportedBytes.particles, sizeof(ParticleSystem::Instance) * m_particleBufferCapacity);
+	report("debug lines", Memory::GpuKind::buffers, m_reportedBytes.debugLines, m_debugBufferBytes);
+	report("render targets", Memory::GpuKind::targets, m_reportedBytes.targets, m_graph.physicalTextureBytes());
+	report("frame capture", Memory::GpuKind::buffers, m_reportedBytes.capture, m_capture.stats().bufferBytes);
+}
+
+void Renderer::buildDrawLists(bool shadowpass)
+{
+	// Last frame's storage went away with the frame arena reset, so start over instead of clearing
+	m_uberDrawItems = std::pmr::vector<DrawItem>{ &Memory::frameArena() };
+	m_shadowDrawItems = std::pmr::vector<DrawItem>{ &Memory::frameArena() };
+	m_skinnedDrawItems = std::pmr::vector<DrawItem>{ &Memory::frameArena() };
+
+	std::size_t uberCount{ 0 };
+	std::size_t skinnedCount{ 0 };
+	for (const auto& meshInstance : meshInstances)
+	{
+		const Mesh* mesh{ m_meshes.get(meshInstance.mesh) };
+		if (meshInstance.show && mesh)
+		{
+			(mesh->rig ? skinnedCount : uberCount) += mesh->primitives.size();
+		}
+	}
+	m_uberDrawItems.reserve(uberCount);
+	m_skinnedDrawItems.reserve(skinnedCount);
+	if (shadowpass)
+	{
+		m_shadowDrawItems.reserve(uberCount);
+	}
+
+	m_occlusion.beginFrame(m_viewProj);
 	for (const auto& meshInstance : meshInstances)
 	{
-		if (meshInstance.pass == AABB)
+		const Mesh* mesh{ m_meshes.get(meshInstance.mesh) };
+		// Posed characters leave their bind pose bounds, so they neither occlude nor get culled
+		if (meshInstance.occluder && mesh && !mesh->rig)
 		{
-			for (const auto& primitive : m_meshes[meshInstance.mesh].primitives)
+			for (std::size_t i{ 0 }; i < mesh->primitives.size(); ++i)
 			{
-				glUniformMatrix4fv(glGetUniformLocation(m_aabbPipeline.shaderProgram(), "transform"), 1, GL_FALSE, glm::value_ptr(glm::mat4{ transform* (meshInstance.transform* primitive.transform) }));
+				m_occlusion.addOccluder(scene.world(meshInstance.primitiveNodes[i]), mesh->primitives[i].boundsMin, mesh->primitives[i].boundsMax);
+			}
+		}
+	}
+	m_occlusion.rasterize(m_jobs);
+
+	for (const auto& meshInstance : meshInstances)
+	{
+		const Mesh* mesh{ m_meshes.get(meshInstance.mesh) };
+		if (!meshInstance.show || !mesh)
+		{
+			continue;
+		}
+
+		// An occluder would only ever be tested against itself
+		const bool cull{ !meshInstance.occluder && !mesh->rig };
 
-				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, primitive.indexBuffer);
+		const Animator::Character* character{ animator.character(meshInstance.character) };
+		std::pmr::vector<DrawItem>& items{ mesh->rig ? m_skinnedDrawItems : m_uberDrawItems };
+		const GLint baseVertex{ static_cast<GLint>((mesh->rig ? m_skinnedVertexHeap : m_vertexHeap).offset(mesh->vertices)) };
+		for (std::size_t i{ 0 }; i < mesh->primitives.size(); ++i)
+		{
+			const Primitive& primitive{ mesh->primitives[i] };
+			const DrawItem item
+			{
+				.firstIndex{ m_indexHeap.offset(primitive.indices) },
+				.indexCount{ primitive.indexCount },
+				.baseVertex{ baseVertex },
+				.node{ static_cast<GLuint>(meshInstance.primitiveNodes[i]) },
+				.material{ &primitive.material },
+				.paletteOffset{ character ? character->paletteOffset : 0 },
+			};
+
+			// Casters hidden from the camera still shadow what it sees, so the shadow list
+			// skips the camera's culling
+			if (shadowpass && !mesh->rig)
+			{
+				m_shadowDrawItems.push_back(item);
+			}
 
-				glDrawElements(GL_TRIANGLES, primitive.indexCount, GL_UNSIGNED_INT, nullptr);
+			if (cull && !m_occlusion.visible(scene.world(meshInstance.primitiveNodes[i]), primitive.boundsMin, primitive.boundsMax))
+			{
+				continue;
 			}
+			items.push_back(item);
 		}
 	}
+}
+
+void Renderer::buildRenderGraph(bool shadowpass)
+{
+	m_graph.clear();
+
+	const RenderGraph::Resource backbuffer{ m_graph.importBackbuffer(m_framebufferWidth, m_framebufferHeight) };
+	m_shadowMap = m_graph.createTexture("shadow map", { m_shadowMapSize, m_shadowMapSize, GL_DEPTH_COMPONENT32F });
+	m_sceneColor = m_graph.createTexture("scene color", { m_framebufferWidth, m_framebufferHeight, GL_RGBA8, m_samples });
+	m_sceneDepth = m_graph.createTexture("scene depth", { m_framebufferWidth, m_framebufferHeight, GL_DEPTH_COMPONENT32F, m_samples });
+	m_resolvedColor = m_samples > 1 ? m_graph.createTexture("resolved color", { m_framebufferWidth, m_framebufferHeight, GL_RGBA8 }) : RenderGraph::none;
+
+	m_graph.addPass("shadow",
+		[&](RenderGraph::Builder& builder) { builder.write(m_shadowMap); },
+		[this](const RenderGraph::Context& context) { this->shadowpass(context); });
+
+	// Without a consumer the shadow pass is culled and its map is never allocated
+	m_graph.addPass("main",
+		[&](RenderGraph::Builder& builder)
+		{
+			if (shadowpass)
+			{
+				builder.read(m_shadowMap);
+			}
+			builder.write(m_sceneColor);
+			builder.write(m_sceneDepth);
+		},
+		[this](const RenderGraph::Context& context) { renderpass(context); });
+
+	m_graph.addPass("particles",
+		[&](RenderGraph::Builder& builder)
+		{
+			builder.write(m_sceneColor);
+			builder.write(m_sceneDepth);
+		},
+		[this](const RenderGraph::Context& context) { particlepass(context); });
+
+	m_graph.addPass("debug",
+		[&](RenderGraph::Builder& builder) { builder.write(m_sceneColor); },
+		[this](const RenderGraph::Context& context) { debugpass(context); });
+
+	if (m_resolvedColor != RenderGraph::none)
+	{
+		m_graph.addPass("resolve",
+			[&](RenderGraph::Builder& builder)
+			{
+				builder.read(m_sceneColor);
+				builder.write(m_resolvedColor);
+			},
+			[this](const RenderGraph::Context& context) { resolvepass(context); });
+	}
+
+	m_graph.addPass("upscale",
+		[&](RenderGraph::Builder& builder)
+		{
+			builder.read(m_resolvedColor != RenderGraph::none ? m_resolvedColor : m_sceneColor);
+			builder.write(backbuffer);
+		},
+		[this](const RenderGraph::Context& context) { upscalepass(context); });
+
+	m_graph.addPass("imgui",
+		[&](RenderGraph::Builder& builder) { builder.write(backbuffer); },
+		[this](const RenderGraph::Context& context) { imguipass(context); });
+
+	m_graph.compile(m_state);
+
+	m_graphBuilt = true;
+	m_graphShadowpass = shadowpass;
+	m_graphSamples = m_samples;
+	m_graphWidth = m_framebufferWidth;
+	m_graphHeight = m_framebufferHeight;
+}
+
+void Renderer::drawItems(const std::pmr::vector<DrawItem>& drawItems, Pipeline& pipeline, bool materials, bool skinned)
+{
+	m_state.bindVertexArray(skinned ? m_skinnedVertexArray : m_vertexArray);
+	m_state.bindElementBuffer(m_indexHeap.buffer());
+
+	for (const auto& drawItem : drawItems)
+	{
+		if (skinned)
+		{
+			glUniform1ui(pipeline.uniformLocation("paletteOffset"), drawItem.paletteOffset);
+		}
+
+		if (materials)
+		{
+			glUniform1i(pipeline.uniformLocation("textured"), drawItem.material->hasTexture);
+			glUniform3fv(pipeline.uniformLocation("color"), 1, glm::value_ptr(drawItem.material->color));
+
+			m_state.bindTextureUnit(0, drawItem.material->texture);
+		}
+
+		// The base instance carries the node whose world matrix the shader reads
+		glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, drawItem.indexCount, GL_UNSIGNED_INT,
+			reinterpret_cast<const void*>(static_cast<std::uintptr_t>(drawItem.firstIndex) * sizeof(std::uint32_t)), 1, drawItem.baseVertex, drawItem.node);
+		++m_frameStats.drawCalls;
+	}
+}
+
+void Renderer::renderpass(const RenderGraph::Context& context)
+{
+	const GLfloat clearColor[4]{ 0.6f, 0.8f, 1.0f, 1.0f };
+	const GLfloat clearDepth{ 1.0f };
+	glClearNamedFramebufferfv(context.framebuffer, GL_COLOR, 0, clearColor);
+	glClearNamedFramebufferfv(context.framebuffer, GL_DEPTH, 0, &clearDepth);
+
+	// Only the scaled corner of the full size target is drawn and later upscaled
+	m_state.viewport(0, 0, m_frameStats.width, m_frameStats.height);
+
+	m_state.enable(GL_DEPTH_TEST);
+	m_state.enable(GL_CULL_FACE);
+	m_state.polygonMode(GL_FILL);
+
+	if (m_graphShadowpass)
+	{
+		m_state.bindTextureUnit(1, context.texture(m_shadowMap));
+	}
+
+	m_uberPipeline.bind(m_state);
+	setFrameUniforms(m_uberPipeline);
+	drawItems(m_uberDrawItems, m_uberPipeline, true, false);
+
+	if (!m_skinnedDrawItems.empty())
+	{
+		m_skinnedPipeline.bind(m_state);
+		setFrameUniforms(m_skinnedPipeline);
+		drawItems(m_skinnedDrawItems, m_skinnedPipeline, true, true);
+	}
+}
+
+void Renderer::setFrameUniforms(Pipeline& pipeline)
+{
+	glUniformMatrix4fv(pipeline.uniformLocation("viewProj"), 1, GL_FALSE, glm::value_ptr(m_viewProj));
+	glUniformMatrix4fv(pipeline.uniformLocation("view"), 1, GL_FALSE, glm::value_ptr(m_view));
+	glUniform3ui(pipeline.uniformLocation("clusterCount"), LightClusters::tilesX, LightClusters::tilesY, LightClusters::slices);
+	glUniform2fv(pipeline.uniformLocation("clusterSlicing"), 1, glm::value_ptr(m_lightClusters.slicing()));
+	glUniform2f(pipeline.uniformLocation("viewportSize"), static_cast<float>(m_frameStats.width), static_cast<float>(m_frameStats.height));
+}
+
+void Renderer::shadowpass(const RenderGraph::Context& context)
+{
+	const GLfloat clearDepth{ 1.0f };
+	glClearNamedFramebufferfv(context.framebuffer, GL_DEPTH, 0, &clearDepth);
+
+	m_state.enable(GL_DEPTH_TEST);
+	m_state.enable(GL_CULL_FACE);
+	m_state.polygonMode(GL_FILL);
+
+	m_uberPipeline.bind(m_state);
+	glUniformMatrix4fv(m_uberPipeline.uniformLocation("viewProj"), 1, GL_FALSE, glm::value_ptr(m_viewProj));
+	drawItems(m_shadowDrawItems, m_uberPipeline, true, false);
+
+	if (!m_skinnedDrawItems.empty())
+	{
+		m_skinnedPipeline.bind(m_state);
+		glUniformMatrix4fv(m_skinnedPipeline.uniformLocation("viewProj"), 1, GL_FALSE, glm::value_ptr(m_viewProj));
+		drawItems(m_skinnedDrawItems, m_skinnedPipeline, true, true);
+	}
+}
+
+void Renderer::particlepass(const RenderGraph::Context&)
+{
+	if (m_particleCount == 0)
+	{
+		return;
+	}
+
+	// Tested against the scene but not written, and unsorted: soft dots blend well enough in any order
+	m_state.viewport(0, 0, m_frameStats.width, m_frameStats.height);
+	m_state.enable(GL_DEPTH_TEST);
+	m_state.disable(GL_CULL_FACE);
+	m_state.enable(GL_BLEND);
+	m_state.depthMask(GL_FALSE);
+
+	m_particlePipeline.bind(m_state);
+	glUniformMatrix4fv(m_particlePipeline.uniformLocation("viewProj"), 1, GL_FALSE, glm::value_ptr(m_viewProj));
+	glUniform3f(m_particlePipeline.uniformLocation("cameraRight"), m_view[0][0], m_view[1][0], m_view[2][0]);
+	glUniform3f(m_particlePipeline.uniformLocation("cameraUp"), m_view[0][1], m_view[1][1], m_view[2][1]);
+	m_state.bindVertexArray(m_particleVertexArray);
+
+	for (const ParticleSystem::Batch& batch : particles.batches())
+	{
+		const ParticleSystem::EmitterSettings& settings{ *batch.settings };
+		glUniform4fv(m_particlePipeline.uniformLocation("startColor"), 1, glm::value_ptr(settings.startColor));
+		glUniform4fv(m_particlePipeline.uniformLocation("endColor"), 1, glm::value_ptr(settings.endColor));
+		glUniform1f(m_particlePipeline.uniformLocation("startSize"), settings.startSize);
+		glUniform1f(m_particlePipeline.uniformLocation("endSize"), settings.endSize);
+		glUniform1f(m_particlePipeline.uniformLocation("colorVariance"), settings.colorVariance);
+		m_state.blendFunc(GL_SRC_ALPHA, settings.additive ? GL_ONE : GL_ONE_MINUS_SRC_ALPHA);
+
+		glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(batch.count), batch.first);
+		++m_frameStats.drawCalls;
+	}
+
+	// Depth clears obey the mask, so it has to be back on before the next frame
+	m_state.depthMask(GL_TRUE);
+	m_state.disable(GL_BLEND);
+}
+
+void Renderer::debugpass(const RenderGraph::Context&)
+{
+	const std::span<const DebugDraw::Vertex> frameVertices{ debugDraw.frameVertices() };
+	const std::span<const DebugDraw::Vertex> timedVertices{ debugDraw.timedVertices() };
+	const std::size_t count{ frameVertices.size() + timedVertices.size() };
+	if (count == 0)
+	{
+		return;
+	}
+
+	// Orphaned like the light buffers, then filled with both lists back to back
+	m_debugBufferBytes = count * sizeof(DebugDraw::Vertex);
+	glNamedBufferData(m_debugBuffer, static_cast<GLsizeiptr>(m_debugBufferBytes), nullptr, GL_STREAM_DRAW);
+	glNamedBufferSubData(m_debugBuffer, 0, static_cast<GLsizeiptr>(frameVertices.size_bytes()), frameVertices.data());
+	glNamedBufferSubData(m_debugBuffer, static_cast<GLintptr>(frameVertices.size_bytes()), static_cast<GLsizeiptr>(timedVertices.size_bytes()), timedVertices.data());
+	glVertexArrayVertexBuffer(m_debugVertexArray, 0, m_debugBuffer, 0, sizeof(DebugDraw::Vertex));
+
+	// Drawn over everything, so boxes inside walls stay visible
+	m_state.viewport(0, 0, m_frameStats.width, m_frameStats.height);
+	m_state.disable(GL_DEPTH_TEST);
+	m_debugPipeline.bind(m_state);
+	glUniformMatrix4fv(m_debugPipeline.uniformLocation("viewProj"), 1, GL_FALSE, glm::value_ptr(m_viewProj));
+
+	m_state.bindVertexArray(m_debugVertexArray);
+	glDrawArrays(GL_LINES, 0, static_cast<GLsizei>(count));
+	++m_frameStats.drawCalls;
+}
+
+void Renderer::resolvepass(const RenderGraph::Context& context)
+{
+	glBlitNamedFramebuffer(context.framebufferOf(m_sceneColor), context.framebuffer,
+		0, 0, m_frameStats.width, m_frameStats.height, 0, 0, m_frameStats.width, m_frameStats.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+}
+
+void Renderer::upscalepass(const RenderGraph::Context& context)
+{
+	const RenderGraph::Resource source{ m_resolvedColor != RenderGraph::none ? m_resolvedColor : m_sceneColor };
+	glBlitNamedFramebuffer(context.framebufferOf(source), context.framebuffer,
+		0, 0, m_frameStats.width, m_frameStats.height, 0, 0, context.width, context.height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+	m_capture.update(m_state, context.framebuffer, context.width, context.height, m_jobs);
+}
+
+void Renderer::imguipass(const RenderGraph::Context&)
+{
+	ImGui::Render();
+	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+	// The ImGui backend binds its own objects behind the cache's back
+	m_state.invalidate();
 }
\ No newline at end of file
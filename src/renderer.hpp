@@ -1,6 +1,19 @@
 #pragma once
 
+#include "animation.hpp"
+#include "capture.hpp"
+#include "debug_draw.hpp"
+#include "gl_state.hpp"
+#include "gpu_heap.hpp"
+#include "input.hpp"
+#include "lights.hpp"
+#include "memory.hpp"
+#include "occlusion.hpp"
+#include "particles.hpp"
 #include "pipeline.hpp"
+#include "render_graph.hpp"
+#include "scene.hpp"
+#include "slot_map.hpp"
 
 #include "glad/glad.h"
 #include "GLFW/glfw3.h"
@@ -11,9 +24,19 @@
 #include "imgui/imgui_impl_opengl3.h"
 #include "imgui/imgui_impl_glfw.h"
 
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
 #include <string>
 #include <vector>
 
+namespace ModelLoader
+{
+	struct Material;
+	struct Mesh;
+}
+
 class Renderer final
 {
 public:
@@ -29,19 +52,37 @@ public:
 		glm::vec2 texCoord{};
 	};
 
+	// Joints index the character's palette; weights are normalized bytes summing to 255, or
+	// all zero for vertices that follow their primitive's node instead
+	struct SkinnedVertex
+	{
+		glm::vec3 position{};
+		glm::vec3 normal{};
+		glm::vec2 texCoord{};
+		glm::u8vec4 joints{};
+		glm::u8vec4 weights{};
+	};
+
 	struct Material
 	{
 		GLuint texture{};
 		bool hasTexture{};
 		glm::vec3 color{};
+		// Video memory held by texture, for the texture stats
+		std::size_t textureBytes{};
+		std::size_t uncompressedBytes{};
 	};
 
 	struct Primitive
 	{
-		GLuint indexBuffer{};
+		// Indices are relative to the mesh's first vertex
+		GpuHeap::Handle indices{};
 		GLsizei indexCount{};
 
 		glm::mat4 transform{};
+		// Local bounds of the primitive's vertices, before transform
+		glm::vec3 boundsMin{};
+		glm::vec3 boundsMax{};
 
 		Material material{};
 	};
@@ -49,64 +90,340 @@ public:
 	struct Mesh
 	{
 		std::vector<Primitive> primitives{};
+
+		// SkinnedVertex in their own heap when the mesh has a rig
+		GpuHeap::Handle vertices{};
+		std::uint32_t vertexCount{};
+		std::shared_ptr<const Animation::Rig> rig{};
+
+		// Its video memory is charged to this name in the memory report
+		std::string name{};
 	};
 
-	enum Pass
+	using MeshHandle = SlotMap<Mesh>::Handle;
+
+	struct MeshInstance
 	{
-		UBER,
-		AABB,
+		MeshHandle mesh{};
+
+		SceneGraph::Node node{ SceneGraph::none };
+		// Children of node carrying each primitive's transform, in primitive order
+		std::vector<SceneGraph::Node> primitiveNodes{};
+
+		bool show{ true };
+		// Rasterized into the occlusion buffer as its primitives' bounds, whether shown or not
+		bool occluder{ false };
+
+		// Posed by animator when the mesh has a rig
+		Animator::Handle character{};
 	};
 
-	struct MeshInstance
+	using MeshInstanceHandle = SlotMap<MeshInstance>::Handle;
+
+	using PointLight = LightClusters::Light;
+	using LightHandle = SlotMap<PointLight>::Handle;
+
+	// The scene renders offscreen and is upscaled to the window. With dynamic set, the
+	// scale and the MSAA level follow the measured GPU frame time toward targetGpuMs.
+	struct ResolutionSettings
 	{
-		int mesh{};
+		bool dynamic{ true };
+		float targetGpuMs{ 14.0f };
+		float minScale{ 0.5f };
+		int maxSamples{ 8 };
+	};
 
-		glm::mat4 transform{};
+	struct FrameStats
+	{
+		// Smoothed over recent frames, from timer queries read a few frames late
+		float gpuMs{};
+		// The newest of those samples as is, and how many have been read
+		float lastGpuMs{};
+		std::uint64_t gpuSamples{};
+		float scale{ 1.0f };
+		int samples{ 1 };
+		GLsizei width{};
+		GLsizei height{};
+		// Of the last rendered frame: draws issued and time spent in render before the swap
+		std::uint32_t drawCalls{};
+		float submitMs{};
+	};
 
-		Pass pass{ UBER };
+	// A hidden window still gets a default framebuffer but never shows, for benchmarks on
+	// hosts without a display server session. The EGL context API picks Mesa's EGL driver,
+	// which with LIBGL_ALWAYS_SOFTWARE set renders with llvmpipe.
+	struct InitSettings
+	{
+		bool visible{ true };
+		bool egl{ false };
+		// Off lets a benchmark run as fast as the GPU goes; on leaves the driver's default
+		bool vsync{ true };
+	};
 
-		bool show{ true };
+	struct TextureStats
+	{
+		std::size_t textures{};
+		std::size_t bytes{};
+		// What the same textures would take as RGBA8 with full mip chains
+		std::size_t uncompressedBytes{};
+		double uploadMs{};
+		// False when the driver lacks S3TC and BC1 is expanded before upload
+		bool s3tc{};
+	};
+
+	// From the oldest key event a frame took to the GPU finishing that frame, read from a
+	// fence without waiting. Scanout adds up to one refresh on top.
+	struct LatencyStats
+	{
+		float inputToPhotonMs{};
+		float lastMs{};
+		std::uint64_t samples{};
 	};
 
-	void init();
+	// False when no window or context could be created
+	bool init();
+	bool init(const InitSettings& settings);
+	// Call at the top of the frame and again right before building the view, so key events
+	// reach the frame that takes them as late as possible
+	void pollEvents();
 	void beginFrame();
-	void render(const glm::mat4& transform, bool shadowpass, bool executeAABBPass);
+	void render(const glm::mat4& view, const glm::mat4& proj, bool shadowpass);
 	void cleanup();
 
-	void loadModel(const std::string& path);
-	void finalizeModels();
+	// Every mesh sub-allocates its vertices and indices from two shared heaps, so models can
+	// be added and unloaded at any time. Instances of an unloaded mesh stop drawing.
+	MeshHandle loadModel(const std::string& path);
+	MeshHandle addModel(const ModelLoader::Mesh& loaderMesh);
+	void unloadModel(MeshHandle mesh);
+
+	// The instance gets a scene node under parent; removing it destroys that subtree.
+	// Handles of removed instances are rejected rather than aliasing a newer instance.
+	// A stale mesh handle yields an invalid instance handle.
+	MeshInstanceHandle addMeshInstance(MeshHandle mesh, const glm::mat4& transform, SceneGraph::Node parent = SceneGraph::none);
+	void removeMeshInstance(MeshInstanceHandle meshInstance);
+	void setTransform(MeshInstanceHandle meshInstance, const glm::mat4& transform);
+	void setOccluder(MeshInstanceHandle meshInstance, bool occluder);
+	void setVisible(MeshInstanceHandle meshInstance, bool show);
+
+	// Occluders rasterize on these workers; without them the culler runs on the render thread
+	void setJobSystem(JobSystem& jobs) { m_jobs = &jobs; }
 
 	bool windowShouldClose();
 
 	GLFWwindow* window() const { return m_window; }
 
-	std::vector<MeshInstance> meshInstances{};
+	// Redundant state changes filtered during the last rendered frame
+	const GLState::Stats& stateStats() const { return m_lastFrameStateStats; }
+
+	const RenderGraph& renderGraph() const { return m_graph; }
+
+	const FrameStats& frameStats() const { return m_frameStats; }
+	const LightClusters::Stats& lightStats() const { return m_lightClusters.stats(); }
+	GpuHeap::Stats vertexHeapStats() const { return m_vertexHeap.stats(); }
+	GpuHeap::Stats indexHeapStats() const { return m_indexHeap.stats(); }
+	GpuHeap::Stats skinnedVertexHeapStats() const { return m_skinnedVertexHeap.stats(); }
+	const TextureStats& textureStats() const { return m_textureStats; }
+	const LatencyStats& latencyStats() const { return m_latencyStats; }
+	float aspectRatio() const { return static_cast<float>(m_framebufferWidth) / static_cast<float>(m_framebufferHeight); }
+
+	ResolutionSettings resolution{};
+
+	OcclusionCuller& occlusion() { return m_occlusion; }
+	// Grabs the upscaled frame, before the GUI is drawn over it
+	FrameCapture& capture() { return m_capture; }
+
+	SlotMap<MeshInstance> meshInstances{};
+	// Point lights are binned into clusters every frame, so they can move freely
+	SlotMap<PointLight> lights{};
+
+	// Drawn over the scene each frame; see DebugDraw
+	DebugDraw debugDraw{};
+
+	// One character per instance of a rigged mesh; evaluated at the start of render
+	Animator animator{};
+
+	// Simulated by whoever owns the clock; render draws every live particle as a billboard
+	ParticleSystem particles{};
+
+	SceneGraph scene{};
+
+	// Filled by the key callback on every poll; render latches what the ticks consumed for
+	// the latency stats
+	Input input{};
 
 private:
 
-	void initWindow();
+	bool initWindow(const InitSettings& settings);
 	void initOpenGL();
 
 	void initPipelines();
 
 	void initImgui();
 
-	void renderpass(const glm::mat4& transform);
-	void shadowpass(const glm::mat4& transform);
-	void aabbpass(const glm::mat4& transform);
+	GLuint createVertexArray(GLuint vertexBuffer);
+	GLuint createSkinnedVertexArray();
+	Material createMaterial(const ModelLoader::Material& loaderMaterial);
+
+	// One entry per primitive to draw, shared by every pass that draws the same set
+	struct DrawItem
+	{
+		// In elements of the heaps, resolved when the list is built
+		GLuint firstIndex{};
+		GLsizei indexCount{};
+		GLint baseVertex{};
+		GLuint node{};
+		const Material* material{};
+		// First matrix of the character's palette, for skinned items
+		GLuint paletteOffset{};
+	};
+
+	void readGpuTimer();
+	void readLatencyFences();
+	void adjustResolution(float gpuMs);
+
+	void uploadTransforms();
+	void uploadLights();
+	void uploadPalettes();
+	void uploadParticles();
+	void reportGpuMemory();
+	void buildDrawLists(bool shadowpass);
+	void buildRenderGraph(bool shadowpass);
+
+	void drawItems(const std::pmr::vector<DrawItem>& drawItems, Pipeline& pipeline, bool materials, bool skinned);
+	void setFrameUniforms(Pipeline& pipeline);
+
+	void renderpass(const RenderGraph::Context& context);
+	void shadowpass(const RenderGraph::Context& context);
+	void particlepass(const RenderGraph::Context& context);
+	void debugpass(const RenderGraph::Context& context);
+	void resolvepass(const RenderGraph::Context& context);
+	void upscalepass(const RenderGraph::Context& context);
+	void imguipass(const RenderGraph::Context& context);
 
 	GLFWwindow* m_window{};
+
+	GLState m_state{};
+	GLState::Stats m_lastFrameStateStats{};
+
 	static constexpr int m_initialWindowWidth{ 1600 };
 	static constexpr int m_initialWindowHeight{ 900 };
 
-	GLuint m_shadowFBO{};
-	GLuint m_shadowMap{};
+	static constexpr GLsizei m_shadowMapSize{ 1024 };
+
+	static constexpr int m_timerQueryCount{ 4 };
+	// Frames a sample count change waits before the next, so a new allocation can settle
+	static constexpr int m_sampleCooldown{ 120 };
+
+	RenderGraph m_graph{};
+	bool m_graphBuilt{ false };
+	bool m_graphShadowpass{ false };
+	RenderGraph::Resource m_shadowMap{ RenderGraph::none };
+	RenderGraph::Resource m_sceneColor{ RenderGraph::none };
+	RenderGraph::Resource m_sceneDepth{ RenderGraph::none };
+	RenderGraph::Resource m_resolvedColor{ RenderGraph::none };
+	int m_graphSamples{ 0 };
+	GLsizei m_graphWidth{ 0 };
+	GLsizei m_graphHeight{ 0 };
+
+	// Set by the framebuffer size callback; minimising the window leaves it unchanged
+	GLsizei m_framebufferWidth{ m_initialWindowWidth };
+	GLsizei m_framebufferHeight{ m_initialWindowHeight };
 
-	std::vector<Vertex> m_vertices{};
-	GLuint m_vertexBuffer{};
+	// Targets are allocated at full size and the scale only shrinks the viewport, so
+	// scaling never reallocates; changing the sample count does
+	float m_renderScale{ 1.0f };
+	int m_samples{ 4 };
+	int m_samplesCooldown{ 0 };
+
+	TextureStats m_textureStats{};
+
+	// What the memory ledger was last told about storage the renderer owns besides models
+	struct ReportedBytes
+	{
+		std::size_t vertexSlack{};
+		std::size_t skinnedVertexSlack{};
+		std::size_t indexSlack{};
+		std::size_t transforms{};
+		std::size_t lights{};
+		std::size_t palettes{};
+		std::size_t particles{};
+		std::size_t debugLines{};
+		std::size_t targets{};
+		std::size_t capture{};
+	};
+
+	ReportedBytes m_reportedBytes{};
+
+	GLuint m_timerQueries[m_timerQueryCount]{};
+	std::uint64_t m_timerFrame{ 0 };
+	FrameStats m_frameStats{};
+
+	// Fences behind swaps of frames that took input, oldest first
+	struct LatencyFence
+	{
+		GLsync fence{};
+		double inputTime{};
+	};
+
+	static constexpr std::size_t m_maxLatencyFences{ 4 };
+	std::vector<LatencyFence> m_latencyFences{};
+	LatencyStats m_latencyStats{};
+
+	glm::mat4 m_view{ 1.0f };
+	glm::mat4 m_proj{ 1.0f };
+	glm::mat4 m_viewProj{ 1.0f };
+	// Rebuilt every frame in the frame arena
+	std::pmr::vector<DrawItem> m_uberDrawItems{ &Memory::frameArena() };
+	std::pmr::vector<DrawItem> m_skinnedDrawItems{ &Memory::frameArena() };
+	// Every shown static primitive, uncut by occlusion and the view, while shadows are on
+	std::pmr::vector<DrawItem> m_shadowDrawItems{ &Memory::frameArena() };
+
+	JobSystem* m_jobs{};
+	FrameCapture m_capture{};
+	OcclusionCuller m_occlusion{};
+
+	// Heaps defragment once this share of their free space is scattered outside the largest hole
+	static constexpr float m_defragmentThreshold{ 0.5f };
+
+	GpuHeap m_vertexHeap{ sizeof(Vertex), 1 << 18 };
+	GpuHeap m_indexHeap{ sizeof(std::uint32_t), 1 << 20 };
+	// The one vertex array, pointed at the heaps' current buffers every frame
 	GLuint m_vertexArray{};
-	std::vector<Mesh> m_meshes{};
+	GpuHeap m_skinnedVertexHeap{ sizeof(SkinnedVertex), 1 << 16 };
+	GLuint m_skinnedVertexArray{};
+	SlotMap<Mesh> m_meshes{};
+
+
+	// World matrices of every scene node, indexed by node in the vertex shaders
+	GLuint m_transformBuffer{};
+	// Their normal matrices, in a parallel buffer so the transforms keep their layout
+	GLuint m_normalBuffer{};
+	std::size_t m_transformBufferCapacity{};
+	// Kept between frames so collecting the changed runs does not allocate
+	std::vector<SceneGraph::Range> m_transformRanges{};
+
+	LightClusters m_lightClusters{};
+	GLuint m_lightBuffer{};
+	GLuint m_clusterBuffer{};
+	GLuint m_lightIndexBuffer{};
+	std::size_t m_lightBufferBytes{};
 
 	Pipeline m_uberPipeline{};
-	Pipeline m_aabbPipeline{};
+	// Same fragment stage, with the vertices skinned by the palettes first
+	Pipeline m_skinnedPipeline{};
+	// Every character's palette, respecified each frame like the lights
+	GLuint m_paletteBuffer{};
+	std::size_t m_paletteBufferBytes{};
+	Pipeline m_particlePipeline{};
+	// Instances of every live particle, written in place through a mapping each frame
+	GLuint m_particleBuffer{};
+	std::size_t m_particleBufferCapacity{};
+	std::size_t m_particleCount{};
+	GLuint m_particleVertexArray{};
+
+	Pipeline m_debugPipeline{};
+	// Respecified every frame with the debug lines
+	GLuint m_debugBuffer{};
+	std::size_t m_debugBufferBytes{};
+	GLuint m_debugVertexArray{};
 };
\ No newline at end of file
@@ -0,0 +1,244 @@
+#include "scene.hpp"
+
+#include "glm/glm.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+
+	// Cofactors of the upper 3x3: the inverse transpose times the determinant, so no
+	// division and nothing infinite for nodes scaled flat. Taking the determinant's sign
+	// keeps normals facing out under mirroring.
+	glm::mat3x4 normalMatrix(const glm::mat4& world)
+	{
+		const glm::vec3 x{ world[0] };
+		const glm::vec3 y{ world[1] };
+		const glm::vec3 z{ world[2] };
+		const float sign{ glm::dot(x, glm::cross(y, z)) < 0.0f ? -1.0f : 1.0f };
+		return { glm::vec4{ glm::cross(y, z) * sign, 0.0f }, glm::vec4{ glm::cross(z, x) * sign, 0.0f }, glm::vec4{ glm::cross(x, y) * sign, 0.0f } };
+	}
+
+}
+
+SceneGraph::Node SceneGraph::create(const glm::mat4& local, Node parent)
+{
+	Node node{};
+	if (!m_free.empty())
+	{
+		node = m_free.back();
+		m_free.pop_back();
+	}
+	else
+	{
+		node = static_cast<Node>(m_world.size());
+		m_local.emplace_back();
+		m_world.emplace_back();
+		m_normal.emplace_back();
+		m_parent.push_back(none);
+		m_firstChild.push_back(none);
+		m_nextSibling.push_back(none);
+		m_prevSibling.push_back(none);
+		m_dirty.push_back(0);
+		m_alive.push_back(0);
+		m_changedMark.push_back(0);
+	}
+
+	m_local[node] = local;
+	m_parent[node] = none;
+	m_firstChild[node] = none;
+	m_nextSibling[node] = none;
+	m_prevSibling[node] = none;
+	m_dirty[node] = 0;
+	m_alive[node] = 1;
+
+	link(node, parent);
+	markDirty(node);
+
+	return node;
+}
+
+void SceneGraph::destroy(Node node)
+{
+	if (node == none || !m_alive[node])
+	{
+		return;
+	}
+
+	unlink(node);
+
+	m_stack.clear();
+	m_stack.push_back(node);
+	while (!m_stack.empty())
+	{
+		const Node current{ m_stack.back() };
+		m_stack.pop_back();
+
+		for (Node child{ m_firstChild[current] }; child != none; child = m_nextSibling[child])
+		{
+			m_stack.push_back(child);
+		}
+
+		m_alive[current] = 0;
+		m_dirty[current] = 0;
+		m_free.push_back(current);
+	}
+}
+
+void SceneGraph::setParent(Node node, Node parent)
+{
+	for (Node ancestor{ parent }; ancestor != none; ancestor = m_parent[ancestor])
+	{
+		if (ancestor == node)
+		{
+			std::cerr << "SCENE, ERROR: setParent(" << node << ", " << parent << ") would create a cycle\n";
+			return;
+		}
+	}
+
+	unlink(node);
+	link(node, parent);
+	markDirty(node);
+}
+
+void SceneGraph::setLocal(Node node, const glm::mat4& local)
+{
+	m_local[node] = local;
+	markDirty(node);
+}
+
+void SceneGraph::update()
+{
+	for (const Node node : m_dirtyRoots)
+	{
+		if (!m_alive[node] || !m_dirty[node])
+		{
+			continue;
+		}
+
+		// A dirty ancestor will rebuild this subtree on its own
+		bool ancestorDirty{ false };
+		for (Node ancestor{ m_parent[node] }; ancestor != none; ancestor = m_parent[ancestor])
+		{
+			if (m_dirty[ancestor])
+			{
+				ancestorDirty = true;
+				break;
+			}
+		}
+
+		if (!ancestorDirty)
+		{
+			updateSubtree(node);
+		}
+	}
+
+	m_dirtyRoots.clear();
+}
+
+void SceneGraph::changedRanges(std::vector<Range>& out, Node maxGap)
+{
+	out.clear();
+	std::sort(m_changed.begin(), m_changed.end());
+	for (const Node node : m_changed)
+	{
+		if (!out.empty() && node - out.back().end <= maxGap)
+		{
+			out.back().end = node + 1;
+		}
+		else
+		{
+			out.push_back({ node, node + 1 });
+		}
+	}
+}
+
+void SceneGraph::clearChanged()
+{
+	for (const Node node : m_changed)
+	{
+		m_changedMark[node] = 0;
+	}
+	m_changed.clear();
+}
+
+void SceneGraph::markDirty(Node node)
+{
+	if (!m_dirty[node])
+	{
+		m_dirty[node] = 1;
+		m_dirtyRoots.push_back(node);
+	}
+}
+
+void SceneGraph::unlink(Node node)
+{
+	const Node parent{ m_parent[node] };
+	if (parent == none)
+	{
+		return;
+	}
+
+	if (m_prevSibling[node] != none)
+	{
+		m_nextSibling[m_prevSibling[node]] = m_nextSibling[node];
+	}
+	else
+	{
+		m_firstChild[parent] = m_nextSibling[node];
+	}
+
+	if (m_nextSibling[node] != none)
+	{
+		m_prevSibling[m_nextSibling[node]] = m_prevSibling[node];
+	}
+
+	m_parent[node] = none;
+	m_nextSibling[node] = none;
+	m_prevSibling[node] = none;
+}
+
+void SceneGraph::link(Node node, Node parent)
+{
+	m_parent[node] = parent;
+	if (parent == none)
+	{
+		return;
+	}
+
+	m_nextSibling[node] = m_firstChild[parent];
+	if (m_firstChild[parent] != none)
+	{
+		m_prevSibling[m_firstChild[parent]] = node;
+	}
+	m_firstChild[parent] = node;
+}
+
+void SceneGraph::updateSubtree(Node root)
+{
+	m_stack.clear();
+	m_stack.push_back(root);
+	while (!m_stack.empty())
+	{
+		const Node node{ m_stack.back() };
+		m_stack.pop_back();
+
+		const Node parent{ m_parent[node] };
+		m_world[node] = parent == none ? m_local[node] : m_world[parent] * m_local[node];
+		m_normal[node] = normalMatrix(m_world[node]);
+		m_dirty[node] = 0;
+
+		if (!m_changedMark[node])
+		{
+			m_changedMark[node] = 1;
+			m_changed.push_back(node);
+		}
+
+		for (Node child{ m_firstChild[node] }; child != none; child = m_nextSibling[child])
+		{
+			m_stack.push_back(child);
+		}
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Parent-linked transform nodes with cached world matrices. Only subtrees below a
+// changed local transform are recomputed by update, and the nodes whose world matrices
+// changed are tracked so the renderer can upload just those.
+class SceneGraph final
+{
+public:
+
+	using Node = int;
+	static constexpr Node none{ -1 };
+
+	SceneGraph() = default;
+	SceneGraph(const SceneGraph&) = delete;
+	SceneGraph& operator=(const SceneGraph&) = delete;
+
+	Node create(const glm::mat4& local = glm::mat4{ 1.0f }, Node parent = none);
+	// Destroys the node and everything attached below it
+	void destroy(Node node);
+
+	// The local transform is kept, so the node moves with its new parent
+	void setParent(Node node, Node parent);
+	void setLocal(Node node, const glm::mat4& local);
+
+	Node parent(Node node) const { return m_parent[node]; }
+	const glm::mat4& local(Node node) const { return m_local[node]; }
+	// Valid after update
+	const glm::mat4& world(Node node) const { return m_world[node]; }
+
+	void update();
+
+	// World matrices indexed by node; slots of destroyed nodes hold stale data
+	const std::vector<glm::mat4>& worlds() const { return m_world; }
+	// Matching normal matrices, laid out as std430 mat3s and only proportional to the
+	// inverse transpose, so normals need normalizing after them
+	const std::vector<glm::mat3x4>& normals() const { return m_normal; }
+
+	// Half-open node range
+	struct Range
+	{
+		Node begin{};
+		Node end{};
+	};
+
+	// Whether any world matrix changed since the last clearChanged
+	bool hasChanges() const { return !m_changed.empty(); }
+	// Sorted ranges covering every changed node. Runs separated by at most maxGap unchanged
+	// nodes are joined, since one larger upload beats several tiny ones.
+	void changedRanges(std::vector<Range>& out, Node maxGap);
+	void clearChanged();
+
+	std::size_t capacity() const { return m_world.size(); }
+	std::size_t liveCount() const { return m_world.size() - m_free.size(); }
+
+private:
+
+	void markDirty(Node node);
+	void unlink(Node node);
+	void link(Node node, Node parent);
+	void updateSubtree(Node root);
+
+	std::vector<glm::mat4> m_local{};
+	std::vector<glm::mat4> m_world{};
+	std::vector<glm::mat3x4> m_normal{};
+
+	std::vector<Node> m_parent{};
+	std::vector<Node> m_firstChild{};
+	std::vector<Node> m_nextSibling{};
+	std::vector<Node> m_prevSibling{};
+
+	std::vector<std::uint8_t> m_dirty{};
+	std::vector<std::uint8_t> m_alive{};
+	std::vector<std::uint8_t> m_changedMark{};
+
+	std::vector<Node> m_free{};
+	std::vector<Node> m_dirtyRoots{};
+	std::vector<Node> m_stack{};
+
+	// Each changed node once, in the order it changed
+	std::vector<Node> m_changed{};
+};
@@ -0,0 +1,92 @@
+#include "sim_lod.hpp"
+
+#include "glm/glm.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+void SimLod::beginTick(float seconds, const glm::vec3& viewer, const glm::vec3& forward)
+{
+	m_tickStart = std::chrono::steady_clock::now();
+	++m_tick;
+	m_seconds = seconds;
+	m_viewer = viewer;
+	m_forward = glm::length(forward) > 0.0f ? glm::normalize(forward) : glm::vec3{ 0.0f, 0.0f, -1.0f };
+	m_counting = {};
+}
+
+void SimLod::endTick()
+{
+	m_stats = m_counting;
+	m_stats.tickMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_tickStart).count();
+}
+
+bool SimLod::due(State& state) const
+{
+	state.elapsed += m_seconds;
+	++state.sinceUpdate;
+	// Intervals are powers of two, so the phase test is a mask
+	return ((m_tick + state.phase) & (state.interval - 1)) == 0;
+}
+
+void SimLod::updated(State& state, std::uint32_t key, const glm::vec3& previous, const glm::vec3& position) const
+{
+	state.elapsed = 0.0f;
+	state.sinceUpdate = 0;
+	state.previous = previous;
+
+	const glm::vec3 offset{ position - m_viewer };
+	const float distance{ glm::length(offset) };
+	const bool inView{ distance == 0.0f || glm::dot(offset, m_forward) >= m_settings.viewCos * distance };
+
+	state.interval = m_settings.farInterval;
+	state.interpolate = false;
+	if (inView)
+	{
+		for (const Band& band : m_settings.bands)
+		{
+			if (distance < band.distance)
+			{
+				state.interval = band.interval;
+				state.interpolate = true;
+				break;
+			}
+		}
+	}
+
+	// Fibonacci hashing spreads consecutive keys over the phases
+	state.phase = static_cast<std::uint32_t>((static_cast<std::uint64_t>(key) * 0x9E3779B97F4A7C15ull) >> 32) & (state.interval - 1);
+}
+
+bool SimLod::drawPosition(const State& state, const glm::vec3& position, glm::vec3& out)
+{
+	++m_counting.entities;
+	m_counting.updated += state.sinceUpdate == 0;
+	m_counting.far += !state.interpolate;
+
+	if (!state.interpolate)
+	{
+		if (state.sinceUpdate != 0)
+		{
+			return false;
+		}
+		out = position;
+	}
+	else
+	{
+		if (state.sinceUpdate >= state.interval)
+		{
+			return false;
+		}
+
+		// Trails the simulation by interval - 1 ticks: the last update's step is spread over
+		// the ticks until the next one, reaching it just as the next starts
+		const float weight{ std::min(static_cast<float>(state.sinceUpdate + 1) / static_cast<float>(state.interval), 1.0f) };
+		out = glm::mix(state.previous, position, weight);
+	}
+
+	++m_counting.drawn;
+	return true;
+}
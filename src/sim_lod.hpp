@@ -0,0 +1,102 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Update rates by distance from the camera. Entities in the distant bands, or behind the
+// camera, update every few ticks instead of every tick, each on a phase of its own so the
+// work spreads evenly over the interval instead of landing on one tick. Skipped ticks are
+// accumulated and handed to the next update, and drawn positions are interpolated between
+// the last two updates so slow entities still move smoothly.
+class SimLod final
+{
+public:
+
+	struct Band
+	{
+		// Entities closer than this use the band
+		float distance{};
+		// Ticks between updates, a power of two
+		std::uint32_t interval{ 1 };
+	};
+
+	struct Settings
+	{
+		std::array<Band, 3> bands
+		{ {
+			{ .distance{ 25.0f }, .interval{ 1 } },
+			{ .distance{ 50.0f }, .interval{ 2 } },
+			{ .distance{ 100.0f }, .interval{ 4 } },
+		} };
+		// Past the last band, and for anything outside the view cone
+		std::uint32_t farInterval{ 16 };
+		// Cosine of the half angle of the cone around the camera's forward counted as in view,
+		// wider than the screen so entities do not pop in at its edges
+		float viewCos{ 0.25f };
+	};
+
+	// Per entity component
+	struct State
+	{
+		std::uint32_t interval{ 1 };
+		std::uint32_t phase{};
+		// Seconds and ticks since the last update; once due, what the update has to cover
+		float elapsed{};
+		std::uint32_t sinceUpdate{};
+		// Where the entity was before its last update
+		glm::vec3 previous{};
+		// Far and offscreen entities are only moved when they update
+		bool interpolate{ true };
+	};
+
+	struct Stats
+	{
+		std::size_t entities{};
+		std::size_t updated{};
+		// Transforms written, interpolated or not
+		std::size_t drawn{};
+		// Outside the view cone or past the last band
+		std::size_t far{};
+		double tickMs{};
+	};
+
+	SimLod() = default;
+	explicit SimLod(const Settings& settings) : m_settings{ settings } {}
+	SimLod(const SimLod&) = delete;
+	SimLod& operator=(const SimLod&) = delete;
+
+	// Starts a tick seen from a camera at viewer looking along forward
+	void beginTick(float seconds, const glm::vec3& viewer, const glm::vec3& forward);
+	void endTick();
+
+	// Advances the entity's clock and tells whether it updates this tick. Safe to call from
+	// several threads for different entities.
+	bool due(State& state) const;
+	// After an update from previous to position: resets the clock and picks the next
+	// interval from where the entity now is. key staggers entities of the same interval.
+	void updated(State& state, std::uint32_t key, const glm::vec3& previous, const glm::vec3& position) const;
+
+	// Where the entity should be drawn this tick, or false when its transform can stay as
+	// it is. Called once per entity per tick, after the updates, from one thread.
+	bool drawPosition(const State& state, const glm::vec3& position, glm::vec3& out);
+
+	const Settings& settings() const { return m_settings; }
+	const Stats& stats() const { return m_stats; }
+
+private:
+
+	Settings m_settings{};
+
+	std::uint64_t m_tick{ 0 };
+	float m_seconds{};
+	glm::vec3 m_viewer{};
+	glm::vec3 m_forward{ 0.0f, 0.0f, -1.0f };
+
+	std::chrono::steady_clock::time_point m_tickStart{};
+	Stats m_counting{};
+	Stats m_stats{};
+};
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Values live packed in one array; handles go through a slot table that tracks where
+// each value currently sits. Insert and erase are O(1). Erase moves the last value into
+// the hole, so iteration order changes and pointers into the map are invalidated.
+template <typename T>
+class SlotMap final
+{
+public:
+
+	// A slot's generation is bumped when its value is erased, so old handles stop resolving
+	struct Handle
+	{
+		std::uint32_t index{ 0xFFFFFFFF };
+		std::uint32_t generation{};
+
+		bool operator==(const Handle&) const = default;
+	};
+
+	Handle insert(T value)
+	{
+		std::uint32_t slot{};
+		if (m_freeHead != m_none)
+		{
+			slot = m_freeHead;
+			m_freeHead = m_slots[slot].dense;
+		}
+		else
+		{
+			slot = static_cast<std::uint32_t>(m_slots.size());
+			m_slots.emplace_back();
+		}
+
+		m_slots[slot].dense = static_cast<std::uint32_t>(m_values.size());
+		m_values.push_back(std::move(value));
+		m_denseToSlot.push_back(slot);
+
+		return { slot, m_slots[slot].generation };
+	}
+
+	bool erase(Handle handle)
+	{
+		if (!contains(handle))
+		{
+			return false;
+		}
+
+		Slot& slot{ m_slots[handle.index] };
+		const std::uint32_t dense{ slot.dense };
+		const std::uint32_t last{ static_cast<std::uint32_t>(m_values.size() - 1) };
+		if (dense != last)
+		{
+			m_values[dense] = std::move(m_values[last]);
+			m_denseToSlot[dense] = m_denseToSlot[last];
+			m_slots[m_denseToSlot[dense]].dense = dense;
+		}
+		m_values.pop_back();
+		m_denseToSlot.pop_back();
+
+		++slot.generation;
+		slot.dense = m_freeHead;
+		m_freeHead = handle.index;
+
+		return true;
+	}
+
+	bool contains(Handle handle) const
+	{
+		return handle.index < m_slots.size() && m_slots[handle.index].generation == handle.generation;
+	}
+
+	// nullptr for stale handles
+	T* get(Handle handle) { return contains(handle) ? &m_values[m_slots[handle.index].dense] : nullptr; }
+	const T* get(Handle handle) const { return contains(handle) ? &m_values[m_slots[handle.index].dense] : nullptr; }
+
+	// Handle of the value at a position in the packed array
+	Handle handleAt(std::size_t dense) const
+	{
+		const std::uint32_t slot{ m_denseToSlot[dense] };
+		return { slot, m_slots[slot].generation };
+	}
+
+	void clear()
+	{
+		while (!m_values.empty())
+		{
+			erase(handleAt(m_values.size() - 1));
+		}
+	}
+
+	void reserve(std::size_t capacity)
+	{
+		m_slots.reserve(capacity);
+		m_values.reserve(capacity);
+		m_denseToSlot.reserve(capacity);
+	}
+
+	std::size_t size() const { return m_values.size(); }
+	bool empty() const { return m_values.empty(); }
+
+	// Iterates live values only
+	auto begin() { return m_values.begin(); }
+	auto end() { return m_values.end(); }
+	auto begin() const { return m_values.begin(); }
+	auto end() const { return m_values.end(); }
+
+private:
+
+	static constexpr std::uint32_t m_none{ 0xFFFFFFFF };
+
+	// For live slots dense is the value's position; for free slots it links the free list
+	struct Slot
+	{
+		std::uint32_t dense{ m_none };
+		std::uint32_t generation{};
+	};
+
+	std::vector<Slot> m_slots{};
+	std::vector<T> m_values{};
+	std::vector<std::uint32_t> m_denseToSlot{};
+	std::uint32_t m_freeHead{ m_none };
+};
@@ -0,0 +1,123 @@
+#include "stress_scene.hpp"
+
+#include "model_load.hpp"
+#include "renderer.hpp"
+#include "texture_compression.hpp"
+
+#include "glm/glm.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+	std::uint64_t hash(std::uint64_t value)
+	{
+		value += 0x9E3779B97F4A7C15ull;
+		value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+		value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+		return value ^ (value >> 31);
+	}
+
+	glm::vec3 hueToRgb(float hue)
+	{
+		return glm::clamp(glm::abs(glm::mod(hue * 6.0f + glm::vec3{ 0.0f, 4.0f, 2.0f }, 6.0f) - 3.0f) - 1.0f, 0.0f, 1.0f);
+	}
+
+}
+
+namespace StressScene
+{
+
+	ModelLoader::Mesh texturedCube(std::uint32_t seed, int textureSize, std::pmr::memory_resource* memory)
+	{
+		ModelLoader::Mesh mesh
+		{
+			.name{ std::pmr::string{ "stress cube", memory } },
+			.vertices{ std::pmr::vector<Renderer::Vertex>{ memory } },
+			.primitives{ std::pmr::vector<ModelLoader::Primitive>{ memory } },
+			.skinWeights{ std::pmr::vector<ModelLoader::SkinWeights>{ memory } },
+		};
+
+		ModelLoader::Primitive primitive{ .indices{ std::pmr::vector<std::uint32_t>{ memory } }, .transform{ glm::mat4{ 1.0f } } };
+
+		// Per face: the normal and the two axes spanning it, in counter clockwise order seen
+		// from outside
+		const std::array<std::array<glm::vec3, 3>, 6> faces
+		{ {
+			{ glm::vec3{ 1.0f, 0.0f, 0.0f }, glm::vec3{ 0.0f, 0.0f, -1.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f } },
+			{ glm::vec3{ -1.0f, 0.0f, 0.0f }, glm::vec3{ 0.0f, 0.0f, 1.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f } },
+			{ glm::vec3{ 0.0f, 1.0f, 0.0f }, glm::vec3{ 1.0f, 0.0f, 0.0f }, glm::vec3{ 0.0f, 0.0f, -1.0f } },
+			{ glm::vec3{ 0.0f, -1.0f, 0.0f }, glm::vec3{ 1.0f, 0.0f, 0.0f }, glm::vec3{ 0.0f, 0.0f, 1.0f } },
+			{ glm::vec3{ 0.0f, 0.0f, 1.0f }, glm::vec3{ 1.0f, 0.0f, 0.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f } },
+			{ glm::vec3{ 0.0f, 0.0f, -1.0f }, glm::vec3{ -1.0f, 0.0f, 0.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f } },
+		} };
+
+		for (const std::array<glm::vec3, 3>& face : faces)
+		{
+			const std::uint32_t first{ static_cast<std::uint32_t>(mesh.vertices.size()) };
+			for (const glm::vec2 corner : { glm::vec2{ 0.0f, 0.0f }, glm::vec2{ 1.0f, 0.0f }, glm::vec2{ 1.0f, 1.0f }, glm::vec2{ 0.0f, 1.0f } })
+			{
+				mesh.vertices.push_back(
+					{
+						.position{ face[0] + face[1] * (corner.x * 2.0f - 1.0f) + face[2] * (corner.y * 2.0f - 1.0f) },
+						.normal{ face[0] },
+						.texCoord{ corner },
+					});
+			}
+			for (const std::uint32_t index : { 0u, 1u, 2u, 0u, 2u, 3u })
+			{
+				primitive.indices.push_back(first + index);
+			}
+		}
+
+		// Eight checks a side, alternating between the hue and a darker shade of it
+		const glm::vec3 color{ hueToRgb(static_cast<float>(hash(seed) >> 40) / 16777216.0f) };
+		const int check{ std::max(textureSize / 8, 1) };
+		std::vector<unsigned char> rgba(static_cast<std::size_t>(textureSize) * static_cast<std::size_t>(textureSize) * 4);
+		for (int y{ 0 }; y < textureSize; ++y)
+		{
+			for (int x{ 0 }; x < textureSize; ++x)
+			{
+				const glm::vec3 texel{ color * ((x / check + y / check) % 2 == 0 ? 1.0f : 0.4f) };
+				unsigned char* out{ rgba.data() + (static_cast<std::size_t>(y) * static_cast<std::size_t>(textureSize) + static_cast<std::size_t>(x)) * 4 };
+				out[0] = static_cast<unsigned char>(texel.r * 255.0f);
+				out[1] = static_cast<unsigned char>(texel.g * 255.0f);
+				out[2] = static_cast<unsigned char>(texel.b * 255.0f);
+				out[3] = 255;
+			}
+		}
+
+		primitive.material =
+		{
+			.hasTexture{ true },
+			.texture{ TextureCompression::compress(rgba.data(), textureSize, textureSize, memory) },
+			.color{ glm::vec3{ 1.0f } },
+		};
+		mesh.primitives.push_back(std::move(primitive));
+
+		return mesh;
+	}
+
+	glm::vec3 scatter(std::size_t index, float extent, float height)
+	{
+		return
+		{
+			(random(index, 0) * 2.0f - 1.0f) * extent,
+			random(index, 1) * height,
+			(random(index, 2) * 2.0f - 1.0f) * extent,
+		};
+	}
+
+	float random(std::size_t index, std::uint32_t stream)
+	{
+		return static_cast<float>(hash(static_cast<std::uint64_t>(index) * 8 + stream) >> 40) / 16777216.0f;
+	}
+
+}
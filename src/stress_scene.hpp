@@ -0,0 +1,27 @@
+#pragma once
+
+#include "model_load.hpp"
+
+#include "glm/glm.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+// Procedural content for measuring how the renderer scales, so benchmarks do not depend on
+// how many models happen to sit in assets. Everything is a function of its seed.
+namespace StressScene
+{
+
+	// A cube two units across whose faces carry a checker texture in a hue of its own, so
+	// every seed is a separate mesh, material and texture
+	ModelLoader::Mesh texturedCube(std::uint32_t seed, int textureSize = 256, std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+	// The index'th of a stable scatter of points over a square of half size extent, between
+	// heights 0 and height
+	glm::vec3 scatter(std::size_t index, float extent, float height);
+
+	// Uniform in [0, 1), from the index and a stream, for sizes and other per object choices
+	float random(std::size_t index, std::uint32_t stream);
+
+}
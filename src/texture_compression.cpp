@@ -0,0 +1,652 @@
+#include "texture_compression.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+
+	using Texel = std::array<float, 4>;
+	using Block = std::array<Texel, 16>;
+
+	// Bumped whenever the encoders or the file layout change, which invalidates the cache
+	constexpr std::uint32_t cacheVersion{ 2 };
+	constexpr char cacheMagic[4]{ 'B', 'C', 'T', 'X' };
+	// Larger than any texture GL 4.6 has to accept, so bigger headers are garbage
+	constexpr int maxCacheDimension{ 16384 };
+
+	constexpr int bc7Weights[16]{ 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	Block readBlock(const unsigned char* rgba, int width, int height, int blockX, int blockY)
+	{
+		// Partial blocks at the right and bottom edges repeat the last row and column
+		Block block{};
+		for (int y{ 0 }; y < 4; ++y)
+		{
+			for (int x{ 0 }; x < 4; ++x)
+			{
+				const int sx{ std::min(blockX * 4 + x, width - 1) };
+				const int sy{ std::min(blockY * 4 + y, height - 1) };
+				const unsigned char* texel{ rgba + (static_cast<std::size_t>(sy) * width + sx) * 4 };
+				block[y * 4 + x] = { static_cast<float>(texel[0]), static_cast<float>(texel[1]), static_cast<float>(texel[2]), static_cast<float>(texel[3]) };
+			}
+		}
+		return block;
+	}
+
+	float distance2(const Texel& a, const Texel& b, int channels)
+	{
+		float sum{ 0.0f };
+		for (int c{ 0 }; c < channels; ++c)
+		{
+			sum += (a[c] - b[c]) * (a[c] - b[c]);
+		}
+		return sum;
+	}
+
+	std::uint16_t packRgb565(const Texel& color)
+	{
+		const auto quantize{ [](float value, int maximum)
+			{
+				return static_cast<std::uint16_t>(std::clamp(static_cast<int>(std::lround(value * maximum / 255.0f)), 0, maximum));
+			} };
+		return static_cast<std::uint16_t>((quantize(color[0], 31) << 11) | (quantize(color[1], 63) << 5) | quantize(color[2], 31));
+	}
+
+	Texel unpackRgb565(std::uint16_t packed)
+	{
+		const int r{ (packed >> 11) & 31 };
+		const int g{ (packed >> 5) & 63 };
+		const int b{ packed & 31 };
+		return { static_cast<float>((r << 3) | (r >> 2)), static_cast<float>((g << 2) | (g >> 4)), static_cast<float>((b << 3) | (b >> 2)), 255.0f };
+	}
+
+	void bc1Palette(std::uint16_t c0, std::uint16_t c1, Texel palette[4])
+	{
+		palette[0] = unpackRgb565(c0);
+		palette[1] = unpackRgb565(c1);
+		for (int c{ 0 }; c < 3; ++c)
+		{
+			if (c0 > c1)
+			{
+				palette[2][c] = std::floor((2.0f * palette[0][c] + palette[1][c]) / 3.0f);
+				palette[3][c] = std::floor((palette[0][c] + 2.0f * palette[1][c]) / 3.0f);
+			}
+			else
+			{
+				palette[2][c] = std::floor((palette[0][c] + palette[1][c]) / 2.0f);
+				palette[3][c] = 0.0f;
+			}
+		}
+		palette[2][3] = 255.0f;
+		palette[3][3] = c0 > c1 ? 255.0f : 0.0f;
+	}
+
+	// Endpoints on the bounding box diagonal that follows the colours' correlation, pulled in
+	// by a sixteenth of the range since the extremes rarely sit on the palette exactly
+	void encodeBc1(const Block& block, unsigned char* out)
+	{
+		Texel low{ 255.0f, 255.0f, 255.0f, 255.0f };
+		Texel high{ 0.0f, 0.0f, 0.0f, 0.0f };
+		Texel mean{};
+		for (const Texel& texel : block)
+		{
+			for (int c{ 0 }; c < 3; ++c)
+			{
+				low[c] = std::min(low[c], texel[c]);
+				high[c] = std::max(high[c], texel[c]);
+				mean[c] += texel[c] / 16.0f;
+			}
+		}
+
+		float covarianceRG{ 0.0f };
+		float covarianceBG{ 0.0f };
+		for (const Texel& texel : block)
+		{
+			covarianceRG += (texel[0] - mean[0]) * (texel[1] - mean[1]);
+			covarianceBG += (texel[2] - mean[2]) * (texel[1] - mean[1]);
+		}
+		if (covarianceRG < 0.0f)
+		{
+			std::swap(low[0], high[0]);
+		}
+		if (covarianceBG < 0.0f)
+		{
+			std::swap(low[2], high[2]);
+		}
+
+		for (int c{ 0 }; c < 3; ++c)
+		{
+			const float inset{ (high[c] - low[c]) / 16.0f };
+			high[c] -= inset;
+			low[c] += inset;
+		}
+
+		std::uint16_t c0{ packRgb565(high) };
+		std::uint16_t c1{ packRgb565(low) };
+		if (c0 < c1)
+		{
+			std::swap(c0, c1);
+		}
+
+		std::uint32_t indices{ 0 };
+		if (c0 != c1)
+		{
+			Texel palette[4]{};
+			bc1Palette(c0, c1, palette);
+
+			for (int i{ 0 }; i < 16; ++i)
+			{
+				int best{ 0 };
+				float bestError{ INFINITY };
+				for (int p{ 0 }; p < 4; ++p)
+				{
+					const float error{ distance2(block[i], palette[p], 3) };
+					if (error < bestError)
+					{
+						best = p;
+						bestError = error;
+					}
+				}
+				indices |= static_cast<std::uint32_t>(best) << (i * 2);
+			}
+		}
+
+		std::memcpy(out, &c0, 2);
+		std::memcpy(out + 2, &c1, 2);
+		std::memcpy(out + 4, &indices, 4);
+	}
+
+	// Writes bits least significant first into a 128 bit block
+	struct BitWriter
+	{
+		unsigned char* out{};
+		int position{ 0 };
+
+		void write(std::uint32_t value, int count)
+		{
+			for (int i{ 0 }; i < count; ++i, ++position)
+			{
+				if (value & (1u << i))
+				{
+					out[position / 8] |= static_cast<unsigned char>(1u << (position % 8));
+				}
+			}
+		}
+	};
+
+	// Mode 6 only: one subset, 7 bit RGBA endpoints with a shared bit each and 4 bit indices.
+	// The endpoints come from the block's principal axis, found by power iteration.
+	void encodeBc7(const Block& block, unsigned char* out)
+	{
+		Texel mean{};
+		for (const Texel& texel : block)
+		{
+			for (int c{ 0 }; c < 4; ++c)
+			{
+				mean[c] += texel[c] / 16.0f;
+			}
+		}
+
+		float covariance[4][4]{};
+		for (const Texel& texel : block)
+		{
+			for (int a{ 0 }; a < 4; ++a)
+			{
+				for (int b{ 0 }; b < 4; ++b)
+				{
+					covariance[a][b] += (texel[a] - mean[a]) * (texel[b] - mean[b]);
+				}
+			}
+		}
+
+		Texel axis{ 1.0f, 1.0f, 1.0f, 1.0f };
+		for (int iteration{ 0 }; iteration < 8; ++iteration)
+		{
+			Texel next{};
+			float length{ 0.0f };
+			for (int a{ 0 }; a < 4; ++a)
+			{
+				for (int b{ 0 }; b < 4; ++b)
+				{
+					next[a] += covariance[a][b] * axis[b];
+				}
+				length = std::max(length, std::abs(next[a]));
+			}
+			if (length < 1e-6f)
+			{
+				break;
+			}
+			for (int c{ 0 }; c < 4; ++c)
+			{
+				axis[c] = next[c] / length;
+			}
+		}
+
+		float lowT{ 0.0f };
+		float highT{ 0.0f };
+		const float axisLength2{ distance2(axis, Texel{}, 4) };
+		for (const Texel& texel : block)
+		{
+			float t{ 0.0f };
+			for (int c{ 0 }; c < 4; ++c)
+			{
+				t += (texel[c] - mean[c]) * axis[c];
+			}
+			t /= axisLength2;
+			lowT = std::min(lowT, t);
+			highT = std::max(highT, t);
+		}
+
+		int quantized[2][4]{};
+		int pbit[2]{};
+		for (int e{ 0 }; e < 2; ++e)
+		{
+			Texel endpoint{};
+			for (int c{ 0 }; c < 4; ++c)
+			{
+				endpoint[c] = std::clamp(mean[c] + (e == 0 ? lowT : highT) * axis[c], 0.0f, 255.0f);
+			}
+
+			// Try both shared bits and keep whichever reconstructs the endpoint closer
+			float bestError{ INFINITY };
+			for (int p{ 0 }; p < 2; ++p)
+			{
+				int candidate[4]{};
+				float error{ 0.0f };
+				for (int c{ 0 }; c < 4; ++c)
+				{
+					candidate[c] = std::clamp(static_cast<int>(std::lround((endpoint[c] - p) / 2.0f)), 0, 127);
+					const float reconstructed{ static_cast<float>(candidate[c] * 2 + p) };
+					error += (reconstructed - endpoint[c]) * (reconstructed - endpoint[c]);
+				}
+				if (error < bestError)
+				{
+					bestError = error;
+					pbit[e] = p;
+					std::copy(candidate, candidate + 4, quantized[e]);
+				}
+			}
+		}
+
+		int indices[16]{};
+		{
+			Texel palette[16]{};
+			for (int i{ 0 }; i < 16; ++i)
+			{
+				for (int c{ 0 }; c < 4; ++c)
+				{
+					const int a{ quantized[0][c] * 2 + pbit[0] };
+					const int b{ quantized[1][c] * 2 + pbit[1] };
+					palette[i][c] = static_cast<float>(((64 - bc7Weights[i]) * a + bc7Weights[i] * b + 32) >> 6);
+				}
+			}
+
+			for (int i{ 0 }; i < 16; ++i)
+			{
+				float bestError{ INFINITY };
+				for (int p{ 0 }; p < 16; ++p)
+				{
+					const float error{ distance2(block[i], palette[p], 4) };
+					if (error < bestError)
+					{
+						bestError = error;
+						indices[i] = p;
+					}
+				}
+			}
+		}
+
+		// The first index is stored without its top bit, so it has to be below 8
+		if (indices[0] >= 8)
+		{
+			std::swap(quantized[0], quantized[1]);
+			std::swap(pbit[0], pbit[1]);
+			for (int& index : indices)
+			{
+				index = 15 - index;
+			}
+		}
+
+		std::memset(out, 0, 16);
+		BitWriter writer{ out };
+		writer.write(1u << 6, 7);
+		for (int c{ 0 }; c < 4; ++c)
+		{
+			writer.write(static_cast<std::uint32_t>(quantized[0][c]), 7);
+			writer.write(static_cast<std::uint32_t>(quantized[1][c]), 7);
+		}
+		writer.write(static_cast<std::uint32_t>(pbit[0]), 1);
+		writer.write(static_cast<std::uint32_t>(pbit[1]), 1);
+		for (int i{ 0 }; i < 16; ++i)
+		{
+			writer.write(static_cast<std::uint32_t>(indices[i]), i == 0 ? 3 : 4);
+		}
+	}
+
+	std::size_t blockBytes(TextureCompression::Format format)
+	{
+		return format == TextureCompression::Format::BC1 ? 8 : 16;
+	}
+
+	std::size_t levelSize(TextureCompression::Format format, int width, int height)
+	{
+		if (format == TextureCompression::Format::RGBA8)
+		{
+			return static_cast<std::size_t>(width) * height * 4;
+		}
+		return static_cast<std::size_t>((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+	}
+
+	std::uint64_t hashFile(std::span<const unsigned char> encoded)
+	{
+		std::uint64_t hash{ 14695981039346656037ull };
+		const auto mix{ [&hash](const unsigned char* bytes, std::size_t count)
+			{
+				for (std::size_t i{ 0 }; i < count; ++i)
+				{
+					hash = (hash ^ bytes[i]) * 1099511628211ull;
+				}
+			} };
+
+		mix(reinterpret_cast<const unsigned char*>(&cacheVersion), sizeof(cacheVersion));
+		mix(encoded.data(), encoded.size());
+		return hash;
+	}
+
+	struct CacheHeader
+	{
+		char magic[4]{};
+		std::uint32_t version{};
+		std::uint32_t format{};
+		std::int32_t width{};
+		std::int32_t height{};
+		std::uint32_t levels{};
+	};
+
+	bool readCache(const std::filesystem::path& path, TextureCompression::Image& image)
+	{
+		std::ifstream file{ path, std::ios::binary };
+		if (!file)
+		{
+			return false;
+		}
+
+		CacheHeader header{};
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+		if (!file || std::memcmp(header.magic, cacheMagic, 4) != 0 || header.version != cacheVersion)
+		{
+			return false;
+		}
+
+		// Only checked headers size anything, so a foreign or truncated file cannot ask for a
+		// huge allocation or hand GL a format it does not expect
+		const auto format{ static_cast<TextureCompression::Format>(header.format) };
+		const bool knownFormat{ format == TextureCompression::Format::BC1 || format == TextureCompression::Format::BC7 };
+		if (!knownFormat || header.width <= 0 || header.height <= 0 || header.width > maxCacheDimension || header.height > maxCacheDimension)
+		{
+			std::cerr << "TEXTURE, ERROR: Ignoring cache file " << path.string() << " with a bad header\n";
+			return false;
+		}
+
+		// compress always writes the full chain down to 1x1
+		std::uint32_t chainLevels{ 1 };
+		for (int size{ std::max(header.width, header.height) }; size > 1; size /= 2)
+		{
+			++chainLevels;
+		}
+		if (header.levels != chainLevels)
+		{
+			std::cerr << "TEXTURE, ERROR: Ignoring cache file " << path.string() << " with " << header.levels << " mip levels\n";
+			return false;
+		}
+
+		image.format = format;
+		image.width = header.width;
+		image.height = header.height;
+
+		std::size_t total{ 0 };
+		int width{ image.width };
+		int height{ image.height };
+		for (std::uint32_t i{ 0 }; i < header.levels; ++i)
+		{
+			const std::size_t size{ levelSize(format, width, height) };
+			image.levels.push_back({ width, height, total, size });
+			total += size;
+			width = std::max(1, width / 2);
+			height = std::max(1, height / 2);
+		}
+
+		std::error_code error{};
+		const std::uintmax_t fileSize{ std::filesystem::file_size(path, error) };
+		if (error || fileSize != sizeof(header) + total)
+		{
+			std::cerr << "TEXTURE, ERROR: Ignoring cache file " << path.string() << " of the wrong size\n";
+			image.levels.clear();
+			return false;
+		}
+
+		image.data.resize(total);
+		file.read(reinterpret_cast<char*>(image.data.data()), static_cast<std::streamsize>(total));
+		return static_cast<bool>(file);
+	}
+
+	void writeCache(const std::filesystem::path& path, const TextureCompression::Image& image)
+	{
+		std::error_code error{};
+		std::filesystem::create_directories(path.parent_path(), error);
+
+		// Written aside and renamed, so a loader on another thread never sees half a file
+		const std::filesystem::path temporary{ path.string() + ".tmp" };
+		{
+			std::ofstream file{ temporary, std::ios::binary };
+			if (!file)
+			{
+				std::cerr << "TEXTURE, ERROR: Cannot write " << temporary.string() << '\n';
+				return;
+			}
+
+			CacheHeader header{ .version{ cacheVersion }, .format{ static_cast<std::uint32_t>(image.format) },
+				.width{ image.width }, .height{ image.height }, .levels{ static_cast<std::uint32_t>(image.levels.size()) } };
+			std::memcpy(header.magic, cacheMagic, 4);
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(reinterpret_cast<const char*>(image.data.data()), static_cast<std::streamsize>(image.data.size()));
+		}
+
+		std::filesystem::rename(temporary, path, error);
+	}
+
+}
+
+namespace TextureCompression
+{
+
+	Image compress(const unsigned char* rgba, int width, int height, std::pmr::memory_resource* memory)
+	{
+		Image image{ .width{ width }, .height{ height }, .levels{ std::pmr::vector<Level>{ memory } }, .data{ std::pmr::vector<unsigned char>{ memory } } };
+
+		bool opaque{ true };
+		for (std::size_t i{ 3 }; i < static_cast<std::size_t>(width) * height * 4; i += 4)
+		{
+			opaque = opaque && rgba[i] == 255;
+		}
+		image.format = opaque ? Format::BC1 : Format::BC7;
+
+		// Each level is box filtered from the one above in a scratch buffer
+		std::pmr::vector<unsigned char> level{ rgba, rgba + static_cast<std::size_t>(width) * height * 4, memory };
+		std::pmr::vector<unsigned char> next{ memory };
+		int levelWidth{ width };
+		int levelHeight{ height };
+		while (true)
+		{
+			const std::size_t size{ levelSize(image.format, levelWidth, levelHeight) };
+			image.levels.push_back({ levelWidth, levelHeight, image.data.size(), size });
+			image.data.resize(image.data.size() + size);
+
+			unsigned char* out{ image.data.data() + image.levels.back().offset };
+			for (int blockY{ 0 }; blockY < (levelHeight + 3) / 4; ++blockY)
+			{
+				for (int blockX{ 0 }; blockX < (levelWidth + 3) / 4; ++blockX)
+				{
+					const Block block{ readBlock(level.data(), levelWidth, levelHeight, blockX, blockY) };
+					if (image.format == Format::BC1)
+					{
+						encodeBc1(block, out);
+					}
+					else
+					{
+						encodeBc7(block, out);
+					}
+					out += blockBytes(image.format);
+				}
+			}
+
+			if (levelWidth == 1 && levelHeight == 1)
+			{
+				break;
+			}
+
+			const int nextWidth{ std::max(1, levelWidth / 2) };
+			const int nextHeight{ std::max(1, levelHeight / 2) };
+			next.assign(static_cast<std::size_t>(nextWidth) * nextHeight * 4, 0);
+			for (int y{ 0 }; y < nextHeight; ++y)
+			{
+				for (int x{ 0 }; x < nextWidth; ++x)
+				{
+					for (int c{ 0 }; c < 4; ++c)
+					{
+						int sum{ 0 };
+						for (int sy{ 0 }; sy < 2; ++sy)
+						{
+							for (int sx{ 0 }; sx < 2; ++sx)
+							{
+								const int px{ std::min(x * 2 + sx, levelWidth - 1) };
+								const int py{ std::min(y * 2 + sy, levelHeight - 1) };
+								sum += level[(static_cast<std::size_t>(py) * levelWidth + px) * 4 + c];
+							}
+						}
+						next[(static_cast<std::size_t>(y) * nextWidth + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+					}
+				}
+			}
+
+			std::swap(level, next);
+			levelWidth = nextWidth;
+			levelHeight = nextHeight;
+		}
+
+		return image;
+	}
+
+	Image loadOrCompress(std::span<const unsigned char> encoded, std::string_view cacheDirectory, std::pmr::memory_resource* memory)
+	{
+		char name[32]{};
+		std::snprintf(name, sizeof(name), "%016llx.bctx", static_cast<unsigned long long>(hashFile(encoded)));
+		const std::filesystem::path path{ std::filesystem::path{ cacheDirectory } / name };
+
+		Image cached{ .levels{ std::pmr::vector<Level>{ memory } }, .data{ std::pmr::vector<unsigned char>{ memory } } };
+		if (readCache(path, cached))
+		{
+			return cached;
+		}
+
+		int width{};
+		int height{};
+		int channels{};
+		unsigned char* rgba{ stbi_load_from_memory(encoded.data(), static_cast<int>(encoded.size()), &width, &height, &channels, 4) };
+		if (!rgba)
+		{
+			// A miss can leave a partly read cache file behind in cached
+			std::cerr << "TEXTURE, ERROR: Cannot decode image, " << stbi_failure_reason() << '\n';
+			cached.levels.clear();
+			cached.data.clear();
+			return cached;
+		}
+
+		Image image{ compress(rgba, width, height, memory) };
+		stbi_image_free(rgba);
+		writeCache(path, image);
+		return image;
+	}
+
+	Image decompress(const Image& image, std::pmr::memory_resource* memory)
+	{
+		Image decoded{ .format{ Format::RGBA8 }, .width{ image.width }, .height{ image.height },
+			.levels{ std::pmr::vector<Level>{ memory } }, .data{ std::pmr::vector<unsigned char>{ memory } } };
+		if (image.format != Format::BC1)
+		{
+			std::cerr << "TEXTURE, ERROR: Only BC1 images can be decompressed\n";
+			return decoded;
+		}
+
+		for (const Level& level : image.levels)
+		{
+			const std::size_t size{ levelSize(Format::RGBA8, level.width, level.height) };
+			decoded.levels.push_back({ level.width, level.height, decoded.data.size(), size });
+			decoded.data.resize(decoded.data.size() + size);
+			unsigned char* out{ decoded.data.data() + decoded.levels.back().offset };
+
+			const unsigned char* block{ image.data.data() + level.offset };
+			for (int blockY{ 0 }; blockY < (level.height + 3) / 4; ++blockY)
+			{
+				for (int blockX{ 0 }; blockX < (level.width + 3) / 4; ++blockX, block += 8)
+				{
+					std::uint16_t c0{};
+					std::uint16_t c1{};
+					std::uint32_t indices{};
+					std::memcpy(&c0, block, 2);
+					std::memcpy(&c1, block + 2, 2);
+					std::memcpy(&indices, block + 4, 4);
+
+					Texel palette[4]{};
+					bc1Palette(c0, c1, palette);
+
+					for (int i{ 0 }; i < 16; ++i)
+					{
+						const int x{ blockX * 4 + i % 4 };
+						const int y{ blockY * 4 + i / 4 };
+						if (x >= level.width || y >= level.height)
+						{
+							continue;
+						}
+
+						const Texel& texel{ palette[(indices >> (i * 2)) & 3] };
+						for (int c{ 0 }; c < 4; ++c)
+						{
+							out[(static_cast<std::size_t>(y) * level.width + x) * 4 + c] = static_cast<unsigned char>(texel[c]);
+						}
+					}
+				}
+			}
+		}
+
+		return decoded;
+	}
+
+	std::size_t uncompressedSize(const Image& image)
+	{
+		std::size_t size{ 0 };
+		for (const Level& level : image.levels)
+		{
+			size += levelSize(Format::RGBA8, level.width, level.height);
+		}
+		return size;
+	}
+
+}
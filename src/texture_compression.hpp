@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// Block compression for base color textures. Opaque images become BC1 at 4 bits per texel;
+// images with any alpha become BC7 at 8 bits per texel. Mip chains are filtered before
+// encoding, so the renderer uploads every level as is and never generates mipmaps itself.
+namespace TextureCompression
+{
+
+	enum class Format
+	{
+		RGBA8,
+		BC1,
+		BC7,
+	};
+
+	struct Level
+	{
+		int width{};
+		int height{};
+		std::size_t offset{};
+		std::size_t size{};
+	};
+
+	struct Image
+	{
+		Format format{ Format::RGBA8 };
+		int width{};
+		int height{};
+		std::pmr::vector<Level> levels{};
+		std::pmr::vector<unsigned char> data{};
+	};
+
+	// Builds the mip chain of an RGBA8 image and encodes every level
+	Image compress(const unsigned char* rgba, int width, int height, std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+	// Takes a PNG or JPEG file in memory and first looks for an earlier result under
+	// cacheDirectory, keyed by a hash of the encoded file bytes rather than the decoded
+	// pixels, so a hit skips decoding as well. Misses are
+	// decoded, compressed and stored there. Safe to call from worker threads.
+	Image loadOrCompress(std::span<const unsigned char> encoded, std::string_view cacheDirectory,
+		std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+	// Expands BC1 back to RGBA8 with the same levels, for drivers without S3TC
+	Image decompress(const Image& image, std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+	// Size of the same mip chain stored as RGBA8
+	std::size_t uncompressedSize(const Image& image);
+
+}